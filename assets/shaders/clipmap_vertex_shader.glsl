@@ -0,0 +1,56 @@
+#version 460 core
+layout (location = 0) in vec2 aGrid;         // vertex in its level's grid, in quads
+
+// Per-instance, see instance_data_t. The transform scales and moves the grid into place, uv_rect
+// carries the level, whether a coarser level follows and the level sample under the grid's corner
+layout (location = 3) in mat4 aInstanceTransform;
+layout (location = 8) in vec4 aInstanceUV;
+
+out vec3 WorldPos;
+out vec3 Normal;
+
+#include "include/uniforms.glsl"
+
+// CLIPMAP_SIZE square per level, stacked vertically and addressed by sample index mod size
+uniform sampler2D clipmap_heights;
+
+const float morph_width = CLIPMAP_GRID / 10.0;  // quads at the edge that blend into the coarser level
+
+float height_at(int level, ivec2 sample_index) {
+     ivec2 texel = sample_index & (CLIPMAP_SIZE - 1);
+     return texelFetch(clipmap_heights, ivec2(texel.x, texel.y + level * CLIPMAP_SIZE), 0).r;
+}
+
+void main() {
+     int level = int(aInstanceUV.x);
+     ivec2 sample_index = ivec2(aInstanceUV.zw) + ivec2(aGrid);
+     float height = height_at(level, sample_index);
+
+     // Towards the edge follow the coarser level's surface, which is linear between its samples,
+     // so at the edge this level's extra vertices sit on the coarser level's triangles
+     if (aInstanceUV.y > 0.5) {
+          vec2 from_center = abs(aGrid - float(CLIPMAP_GRID) * 0.5);
+          float edge = float(CLIPMAP_GRID) * 0.5 - 1.0;
+          float alpha = clamp((max(from_center.x, from_center.y) - (edge - morph_width)) / morph_width, 0.0, 1.0);
+
+          vec2 coarse = vec2(sample_index) * 0.5;
+          ivec2 c = ivec2(floor(coarse));
+          vec2 f = coarse - vec2(c);
+          float coarse_height = mix(mix(height_at(level + 1, c), height_at(level + 1, c + ivec2(1, 0)), f.x),
+                                mix(height_at(level + 1, c + ivec2(0, 1)), height_at(level + 1, c + ivec2(1, 1)), f.x),
+                                f.y);
+          height = mix(height, coarse_height, alpha);
+     }
+
+     float spacing = aInstanceTransform[0][0];
+     float left = height_at(level, sample_index - ivec2(1, 0));
+     float right = height_at(level, sample_index + ivec2(1, 0));
+     float down = height_at(level, sample_index - ivec2(0, 1));
+     float up = height_at(level, sample_index + ivec2(0, 1));
+     Normal = normalize(vec3(left - right, 2.0 * spacing, down - up));
+
+     vec4 world = aInstanceTransform * vec4(aGrid.x, 0.0, aGrid.y, 1.0);
+     world.y = height;
+     WorldPos = world.xyz;
+     gl_Position = frame.view_projection * world;
+}
@@ -3,9 +3,12 @@ out vec4 FragColor;
 
 in vec3 ourColor;
 in vec2 TexCoord;
+in vec4 Tint;
 
 uniform sampler2D ourTexture;
 
+#include "include/uniforms.glsl"
+
 void main() {
-     FragColor = texture(ourTexture, TexCoord);
+     FragColor = texture(ourTexture, TexCoord * material.uv_transform.xy + material.uv_transform.zw) * material.base_color * Tint;
 }
\ No newline at end of file
@@ -0,0 +1,8 @@
+// Normals stored as VERTEX_OCT16, see vertex_format_convert
+vec3 oct_decode(vec2 e) {
+     vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+     float t = max(-n.z, 0.0);
+     n.x += n.x >= 0.0 ? -t : t;
+     n.y += n.y >= 0.0 ? -t : t;
+     return normalize(n);
+}
@@ -0,0 +1,17 @@
+// Mirrors frame_uniforms_t and material_uniforms_t in include/uniform_buffer.h,
+// checked against the C offsets every time a program links
+
+layout (std140, binding = 0) uniform Frame {
+     mat4 view;
+     mat4 projection;
+     mat4 view_projection;
+     vec4 camera_position;
+     vec4 time;              // x = seconds, y = frame delta
+} frame;
+
+layout (std140, binding = 1) uniform Material {
+     vec4 base_color;
+     vec4 uv_transform;      // xy scale, zw offset
+     float roughness;
+     float metallic;
+} material;
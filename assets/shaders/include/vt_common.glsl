@@ -0,0 +1,14 @@
+// Shared by the VT sampling and feedback passes, so both agree on mip selection
+
+uniform float vt_virtual_pages;   // pages per side at mip 0
+uniform float vt_page_size;       // texels per page side, no border
+uniform float vt_max_mip;
+uniform float vt_mip_bias;        // compensates for the feedback target being smaller
+
+float vt_mip(vec2 uv) {
+     vec2 texels = uv * vt_virtual_pages * vt_page_size;
+     vec2 dx = dFdx(texels);
+     vec2 dy = dFdy(texels);
+     float rho = max(dot(dx, dx), dot(dy, dy));
+     return clamp(0.5 * log2(max(rho, 1e-8)) + vt_mip_bias, 0.0, vt_max_mip);
+}
@@ -0,0 +1,26 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec3 WorldPos;
+in vec3 Normal;
+
+#include "include/uniforms.glsl"
+
+const vec3 light_direction = vec3(0.42, 0.82, 0.38);  // towards the sun
+const vec3 fog_color = vec3(0.3, 0.6, 1.0);           // same as the clear color
+
+void main() {
+     vec3 normal = normalize(Normal);
+
+     // Grass on flat ground, rock on slopes, snow up high
+     float slope = 1.0 - normal.y;
+     vec3 color = mix(vec3(0.25, 0.45, 0.18), vec3(0.45, 0.42, 0.38), smoothstep(0.25, 0.45, slope));
+     color = mix(color, vec3(0.92, 0.94, 0.96), smoothstep(-5.0, 5.0, WorldPos.y) * (1.0 - smoothstep(0.4, 0.6, slope)));
+     color = mix(vec3(0.76, 0.70, 0.50), color, smoothstep(-45.0, -40.0, WorldPos.y));
+
+     float light = max(dot(normal, normalize(light_direction)), 0.0) * 0.8 + 0.2;
+
+     // Fades into the sky before chunks stop
+     float fog = smoothstep(280.0, 380.0, distance(WorldPos, frame.camera_position.xyz));
+     FragColor = vec4(mix(color * light, fog_color, fog), 1.0);
+}
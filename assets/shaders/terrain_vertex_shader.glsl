@@ -0,0 +1,19 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aNormal;
+
+// Per-instance, see instance_data_t. Only the translation to the chunk's corner is used
+layout (location = 3) in mat4 aInstanceTransform;
+
+out vec3 WorldPos;
+out vec3 Normal;
+
+#include "include/uniforms.glsl"
+#include "include/octahedral.glsl"
+
+void main() {
+     vec4 world = aInstanceTransform * vec4(aPos, 1.0);
+     gl_Position = frame.view_projection * world;
+     WorldPos = world.xyz;
+     Normal = oct_decode(aNormal);
+}
@@ -1,13 +1,30 @@
 #version 460 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aColor;
+layout (location = 1) in vec4 aColor;      // RGBA8 in the compact format
 layout (location = 2) in vec2 aTexCoord;
 
+#ifdef INSTANCED
+// Per-instance, see instance_data_t
+layout (location = 3) in mat4 aInstanceTransform;
+layout (location = 7) in vec4 aInstanceColor;
+layout (location = 8) in vec4 aInstanceUV;
+#endif
+
 out vec3 ourColor; 
 out vec2 TexCoord;
+out vec4 Tint;
+
+#include "include/uniforms.glsl"
 
 void main() {
-     gl_Position = vec4(aPos, 1.0);
-     ourColor = aColor;
+#ifdef INSTANCED
+     gl_Position = frame.view_projection * aInstanceTransform * vec4(aPos, 1.0);
+     TexCoord = aInstanceUV.xy + aTexCoord * aInstanceUV.zw;
+     Tint = aInstanceColor;
+#else
+     gl_Position = frame.view_projection * vec4(aPos, 1.0);
      TexCoord = aTexCoord;
-}
\ No newline at end of file
+     Tint = vec4(1.0);
+#endif
+     ourColor = aColor.rgb;
+}
@@ -0,0 +1,15 @@
+#version 460 core
+layout (location = 0) out uint PageId;
+
+in vec3 ourColor;
+in vec2 TexCoord;
+
+#include "include/vt_common.glsl"
+
+void main() {
+     uint mip = uint(vt_mip(TexCoord));
+
+     // Same packing as VT_PAGE_ID: mip << 24 | y << 12 | x
+     uvec2 page = uvec2(fract(TexCoord) * vt_virtual_pages / exp2(float(mip)));
+     PageId = (mip << 24) | (page.y << 12) | page.x;
+}
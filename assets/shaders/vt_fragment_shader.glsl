@@ -0,0 +1,30 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec3 ourColor;
+in vec2 TexCoord;
+
+#include "include/vt_common.glsl"
+
+uniform sampler2D vt_page_table;  // physical page x, y and mapped mip per virtual page
+uniform sampler2D vt_physical;    // cache of bordered pages
+uniform float vt_page_border;
+uniform float vt_physical_size;   // physical cache texels per side
+
+vec4 vt_sample(vec2 uv) {
+     float mip = floor(vt_mip(uv));
+     uv = fract(uv);
+
+     // The entry points at the requested page or the nearest resident ancestor
+     ivec2 page = ivec2(uv * vt_virtual_pages / exp2(mip));
+     vec3 entry = texelFetch(vt_page_table, page, int(mip)).rgb * 255.0;
+
+     float mapped_pages = vt_virtual_pages / exp2(entry.b);
+     vec2 in_page = fract(uv * mapped_pages) * vt_page_size + vt_page_border;
+     vec2 physical = (entry.rg * (vt_page_size + 2.0 * vt_page_border) + in_page) / vt_physical_size;
+     return textureLod(vt_physical, physical, 0.0);
+}
+
+void main() {
+     FragColor = vt_sample(TexCoord);
+}
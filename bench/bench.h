@@ -0,0 +1,16 @@
+#pragma once
+
+// Shared bits for the benchmark executables, built with -DBUILD_BENCHMARKS=ON
+
+#include <time.h>
+
+#ifndef BENCH_ASSET_DIR
+#define BENCH_ASSET_DIR "../assets"
+#endif
+
+static inline double bench_now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+// GL context for the benchmarks that touch the driver. Built with BENCH_HEADLESS it's a surfaceless
+// EGL context, which on Mesa is llvmpipe with no display at all, otherwise a hidden GLFW window.
+// Either way drawing goes to an offscreen framebuffer, so numbers don't depend on a swap chain
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef BENCH_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#else
+#include <GLFW/glfw3.h>
+#endif
+
+// What llvmpipe offers, and nothing the benches touch needs 4.6
+#define BENCH_GL_MAJOR 4
+#define BENCH_GL_MINOR 5
+
+typedef struct {
+#ifdef BENCH_HEADLESS
+  EGLDisplay display;
+  EGLContext context;
+#else
+  GLFWwindow* window;
+#endif
+  GLuint fbo;
+  GLuint color;
+  GLuint depth;
+  uint32_t width;
+  uint32_t height;
+} bench_gl_t;
+
+static bool bench_gl_context(bench_gl_t* gl)
+{
+#ifdef BENCH_HEADLESS
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  gl->display = get_platform_display ?
+    get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+  if (gl->display == EGL_NO_DISPLAY || !eglInitialize(gl->display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API))
+    return false;
+
+  const EGLint attributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, BENCH_GL_MAJOR,
+    EGL_CONTEXT_MINOR_VERSION, BENCH_GL_MINOR,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE,
+  };
+  gl->context = eglCreateContext(gl->display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+  if (gl->context == EGL_NO_CONTEXT || !eglMakeCurrent(gl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, gl->context))
+    return false;
+  return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+#else
+  if (!glfwInit())
+    return false;
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, BENCH_GL_MAJOR);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, BENCH_GL_MINOR);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  gl->window = glfwCreateWindow(64, 64, "bench", NULL, NULL);
+  if (!gl->window)
+    return false;
+  glfwMakeContextCurrent(gl->window);
+  glfwSwapInterval(0);
+  return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) != 0;
+#endif
+}
+
+// Make a context and a width x height colour + depth target, bound and ready to draw into
+static bool bench_gl_init(bench_gl_t* gl, uint32_t width, uint32_t height)
+{
+  *gl = (bench_gl_t){ .width = width, .height = height };
+  if (!bench_gl_context(gl)) {
+    fprintf(stderr, "Failed to create a GL %d.%d context\n", BENCH_GL_MAJOR, BENCH_GL_MINOR);
+    return false;
+  }
+  printf("GL: %s, %s\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+
+  glGenRenderbuffers(1, &gl->color);
+  glBindRenderbuffer(GL_RENDERBUFFER, gl->color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, (GLsizei)width, (GLsizei)height);
+  glGenRenderbuffers(1, &gl->depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, gl->depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, (GLsizei)width, (GLsizei)height);
+
+  glGenFramebuffers(1, &gl->fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, gl->fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, gl->color);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, gl->depth);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "Bench framebuffer incomplete\n");
+    return false;
+  }
+
+  glViewport(0, 0, (GLsizei)width, (GLsizei)height);
+  glEnable(GL_DEPTH_TEST);
+  return true;
+}
+
+// Compile and link from source strings, 0 on failure with the log printed
+static GLuint bench_gl_program(const char* vertex_source, const char* fragment_source)
+{
+  const char* sources[2] = { vertex_source, fragment_source };
+  const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+  GLuint program = glCreateProgram();
+  char log[1024];
+
+  for (int i = 0; i < 2; i++) {
+    GLuint shader = glCreateShader(types[i]);
+    glShaderSource(shader, 1, &sources[i], NULL);
+    glCompileShader(shader);
+    GLint ok;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+      glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+      fprintf(stderr, "Bench shader failed to compile:\n%s\n", log);
+    }
+    glAttachShader(program, shader);
+    glDeleteShader(shader);
+  }
+
+  glLinkProgram(program);
+  GLint ok;
+  glGetProgramiv(program, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    fprintf(stderr, "Bench program failed to link:\n%s\n", log);
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+static void bench_gl_shutdown(bench_gl_t* gl)
+{
+  glDeleteFramebuffers(1, &gl->fbo);
+  glDeleteRenderbuffers(1, &gl->color);
+  glDeleteRenderbuffers(1, &gl->depth);
+#ifdef BENCH_HEADLESS
+  eglMakeCurrent(gl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroyContext(gl->display, gl->context);
+  eglTerminate(gl->display);
+#else
+  glfwDestroyWindow(gl->window);
+  glfwTerminate();
+#endif
+}
@@ -0,0 +1,55 @@
+// Decode throughput of bmp_decode_memory: bmp_bench [file.bmp] [seconds]
+#include "bench.h"
+#include "bmp_decode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char** argv)
+{
+  const char* path = argc > 1 ? argv[1] : BENCH_ASSET_DIR "/textures/bricks.bmp";
+  double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+
+  // Held in memory so only decoding is timed
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Failed to open %s\n", path);
+    return 1;
+  }
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  rewind(file);
+  uint8_t* data = length > 0 ? malloc((size_t)length) : NULL;
+  size_t size = data ? fread(data, 1, (size_t)length, file) : 0;
+  fclose(file);
+
+  bmp_image_t image;
+  bmp_result_t result = bmp_decode_memory(data, size, &image);
+  if (result != BMP_OK) {
+    fprintf(stderr, "Failed to decode %s: %s\n", path, bmp_result_string(result));
+    free(data);
+    return 1;
+  }
+  size_t decoded = image.row_size * image.height;
+  bmp_image_free(&image);
+
+  uint64_t decodes = 0;
+  double start = bench_now_seconds();
+  double elapsed = 0.0;
+  do {
+    for (int i = 0; i < 16; i++) {
+      bmp_decode_memory(data, size, &image);
+      bmp_image_free(&image);
+    }
+    decodes += 16;
+    elapsed = bench_now_seconds() - start;
+  } while (elapsed < seconds);
+
+  printf("%s: %ux%u, %zu bytes\n", path, image.width, image.height, size);
+  printf("%llu decodes in %.3f s, %.2f us each\n", (unsigned long long)decodes, elapsed, elapsed * 1e6 / (double)decodes);
+  printf("%.1f MB/s in, %.1f MB/s decoded\n",
+	 (double)size * (double)decodes / elapsed / 1e6, (double)decoded * (double)decodes / elapsed / 1e6);
+
+  free(data);
+  return 0;
+}
@@ -0,0 +1,144 @@
+// bvh_build, frustum culling and raycasts against testing every box: bvh_bench [boxes] [rays] [threads]
+#include "bench.h"
+#include "bvh.h"
+#include "../tests/test_random.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BRUTE_RAYS 64          // every box per ray, so only a sample
+
+static uint32_t brute_cull(const aabb_t* boxes, uint32_t count, mat4 view_projection, uint32_t* visible)
+{
+  vec4 planes[6];
+  glm_frustum_planes(view_projection, planes);
+
+  uint32_t visible_count = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    bool inside = true;
+    for (uint32_t p = 0; p < 6 && inside; p++) {
+      float distance = planes[p][3], reach = 0.0f;
+      for (uint32_t c = 0; c < 3; c++) {
+	distance += planes[p][c] * 0.5f * (boxes[i].min[c] + boxes[i].max[c]);
+	reach += fabsf(planes[p][c]) * 0.5f * (boxes[i].max[c] - boxes[i].min[c]);
+      }
+      inside = distance + reach >= 0.0f;
+    }
+    if (inside)
+      visible[visible_count++] = i;
+  }
+  return visible_count;
+}
+
+static float brute_ray(const aabb_t* boxes, uint32_t count, const vec3 origin, const vec3 direction, float max_t)
+{
+  float closest = -1.0f;
+  for (uint32_t i = 0; i < count; i++) {
+    float near = 0.0f, far = max_t;
+    for (uint32_t c = 0; c < 3; c++) {
+      float t0 = (boxes[i].min[c] - origin[c]) / direction[c];
+      float t1 = (boxes[i].max[c] - origin[c]) / direction[c];
+      near = fmaxf(near, fminf(t0, t1));
+      far = fminf(far, fmaxf(t0, t1));
+    }
+    if (near <= far && (closest < 0.0f || near < closest))
+      closest = near;
+  }
+  return closest;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t box_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+  uint32_t ray_count = argc > 2 ? (uint32_t)atoi(argv[2]) : 100000;
+  uint32_t threads = argc > 3 ? (uint32_t)atoi(argv[3]) : 0;
+
+  aabb_t* boxes = malloc(box_count * sizeof(aabb_t));
+  uint32_t* visible = malloc(box_count * sizeof(uint32_t));
+  vec3* origins = malloc(ray_count * sizeof(vec3));
+  vec3* directions = malloc(ray_count * sizeof(vec3));
+  thread_pool_t* workers = thread_pool_create(threads);
+  if (!boxes || !visible || !origins || !directions)
+    return 1;
+
+  // Same city layout as cull_bench
+  srand(5);
+  for (uint32_t i = 0; i < box_count; i++) {
+    vec3 center = { random_range(-1000.0f, 1000.0f), random_range(-20.0f, 100.0f), random_range(-1000.0f, 1000.0f) };
+    vec3 extents = { random_range(0.5f, 10.0f), random_range(0.5f, 30.0f), random_range(0.5f, 10.0f) };
+    glm_vec3_sub(center, extents, boxes[i].min);
+    glm_vec3_add(center, extents, boxes[i].max);
+  }
+  for (uint32_t r = 0; r < ray_count; r++) {
+    vec3 origin = { random_range(-1000.0f, 1000.0f), 10.0f, random_range(-1000.0f, 1000.0f) };
+    vec3 direction = { random_range(-1.0f, 1.0f), random_range(-0.2f, 0.2f), random_range(-1.0f, 1.0f) };
+    glm_vec3_copy(origin, origins[r]);
+    glm_vec3_normalize_to(direction, directions[r]);
+  }
+
+  printf("%u boxes, %u rays, %u worker threads\n", box_count, ray_count, thread_pool_size(workers));
+
+  bvh_t* bvh = NULL;
+  for (uint32_t threaded = 0; threaded < (workers ? 2u : 1u); threaded++) {
+    bvh_destroy(bvh);
+    bvh = bvh_build(boxes, box_count, threaded ? workers : NULL);
+    if (!bvh)
+      return 1;
+    bvh_stats_t stats = bvh_get_stats(bvh);
+    printf("build  %-8s %8.1f ms, %u nodes, %u leaves, depth %u\n",
+	   threaded ? "threaded" : "single", stats.build_ms, stats.node_count, stats.leaf_count, stats.depth);
+  }
+
+  mat4 projection, view, view_projection;
+  vec3 eye = { 0.0f, 10.0f, 0.0f }, target = { 1.0f, 9.8f, -0.6f }, up = { 0.0f, 1.0f, 0.0f };
+  glm_perspective(glm_rad(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f, projection);
+  glm_lookat(eye, target, up, view);
+  glm_mat4_mul(projection, view, view_projection);
+
+  double start = bench_now_seconds();
+  uint32_t tree_count = bvh_cull_frustum(bvh, view_projection, visible);
+  double tree_ms = (bench_now_seconds() - start) * 1000.0;
+  start = bench_now_seconds();
+  uint32_t brute_count = brute_cull(boxes, box_count, view_projection, visible);
+  double brute_ms = (bench_now_seconds() - start) * 1000.0;
+  printf("frustum  bvh %8.3f ms, brute force %8.3f ms, %u visible%s\n",
+	 tree_ms, brute_ms, tree_count, tree_count == brute_count ? "" : ", MISMATCH");
+
+  uint32_t hits = 0;
+  bvh_hit_t hit;
+  start = bench_now_seconds();
+  for (uint32_t r = 0; r < ray_count; r++)
+    hits += bvh_raycast(bvh, origins[r], directions[r], 2000.0f, NULL, NULL, &hit);
+  double tree_seconds = bench_now_seconds() - start;
+
+  uint32_t sample = ray_count < BRUTE_RAYS ? ray_count : BRUTE_RAYS, wrong = 0;
+  start = bench_now_seconds();
+  for (uint32_t r = 0; r < sample; r++) {
+    float expected = brute_ray(boxes, box_count, origins[r], directions[r], 2000.0f);
+    bool found = bvh_raycast(bvh, origins[r], directions[r], 2000.0f, NULL, NULL, &hit);
+    if (found != (expected >= 0.0f) || (found && fabsf(hit.t - expected) > 1e-4f * fmaxf(1.0f, expected)))
+      wrong++;
+  }
+  double brute_seconds = bench_now_seconds() - start;
+  printf("rays     bvh %8.3f Mrays/s, brute force %8.6f Mrays/s (%u sampled), %u hits%s\n",
+	 ray_count / tree_seconds / 1e6, sample / brute_seconds / 1e6, sample, hits, wrong ? ", MISMATCH" : "");
+
+  // Everything moves a little, the refit keeps the topology
+  for (uint32_t i = 0; i < box_count; i++) {
+    float offset = random_range(-1.0f, 1.0f);
+    boxes[i].min[1] += offset;
+    boxes[i].max[1] += offset;
+    bvh_update(bvh, i, &boxes[i]);
+  }
+  bvh_refit(bvh);
+  printf("refit  %8.3f ms\n", bvh_get_stats(bvh).refit_ms);
+
+  bvh_destroy(bvh);
+  thread_pool_destroy(workers);
+  free(directions);
+  free(origins);
+  free(visible);
+  free(boxes);
+  return 0;
+}
@@ -0,0 +1,70 @@
+// cull_frustum over a million objects with every path this CPU has: cull_bench [objects] [frames] [threads]
+#include "bench.h"
+#include "cull.h"
+#include "../tests/test_random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char** argv)
+{
+  uint32_t object_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+  uint32_t frames = argc > 2 ? (uint32_t)atoi(argv[2]) : 50;
+  uint32_t threads = argc > 3 ? (uint32_t)atoi(argv[3]) : 0;
+
+  // A city's worth of boxes around the camera, about a quarter of them in view
+  cull_objects_t* objects = cull_objects_create(object_count);
+  uint32_t* visible = malloc(object_count * sizeof(uint32_t));
+  uint32_t* expected = malloc(object_count * sizeof(uint32_t));
+  thread_pool_t* workers = thread_pool_create(threads);
+  if (!objects || !visible || !expected)
+    return 1;
+
+  srand(5);
+  for (uint32_t i = 0; i < object_count; i++) {
+    vec3 center = { random_range(-1000.0f, 1000.0f), random_range(-20.0f, 100.0f), random_range(-1000.0f, 1000.0f) };
+    vec3 extents = { random_range(0.5f, 10.0f), random_range(0.5f, 30.0f), random_range(0.5f, 10.0f) };
+    cull_objects_add(objects, center, extents);
+  }
+
+  mat4 projection, view, view_projection;
+  vec3 eye = { 0.0f, 10.0f, 0.0f }, target = { 1.0f, 9.8f, -0.6f }, up = { 0.0f, 1.0f, 0.0f };
+  glm_perspective(glm_rad(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f, projection);
+  glm_lookat(eye, target, up, view);
+  glm_mat4_mul(projection, view, view_projection);
+
+  printf("%u objects, %u frames, %u worker threads, default path %s\n",
+	 object_count, frames, thread_pool_size(workers), cull_simd_name());
+
+  const char* paths[] = { "scalar", "sse2", "avx2", "neon" };
+  uint32_t expected_count = 0;
+  for (uint32_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++) {
+    if (!cull_set_simd(paths[p]))
+      continue;
+
+    for (uint32_t threaded = 0; threaded < (workers ? 2u : 1u); threaded++) {
+      uint32_t count = 0;
+      double start = bench_now_seconds();
+      for (uint32_t frame = 0; frame < frames; frame++)
+	count = cull_frustum(objects, view_projection, threaded ? workers : NULL, visible);
+      double ms = (bench_now_seconds() - start) * 1000.0 / frames;
+
+      // Scalar runs first and is what the others have to match
+      if (p == 0 && !threaded) {
+	expected_count = count;
+	memcpy(expected, visible, count * sizeof(uint32_t));
+      }
+      bool match = count == expected_count && memcmp(visible, expected, count * sizeof(uint32_t)) == 0;
+
+      printf("%-6s %-8s %8.3f ms/frame %8.1f M objects/s, %u visible%s\n", paths[p],
+	     threaded ? "threaded" : "single", ms, object_count / ms / 1000.0, count, match ? "" : ", MISMATCH");
+    }
+  }
+
+  thread_pool_destroy(workers);
+  free(expected);
+  free(visible);
+  cull_objects_destroy(objects);
+  return 0;
+}
@@ -0,0 +1,185 @@
+// Instanced submission through the render queue: instancing_bench [instances] [frames] [plain draws].
+// Copies of a handful of meshes from one mesh_pool are pushed as instanced packets and should
+// collapse into a single multi-draw, against the same meshes pushed as plain packets, one draw each.
+// Built with BENCH_HEADLESS this is what runs on llvmpipe with no display
+#include "bench.h"
+#include "bench_gl.h"
+#include "gl_state.h"
+#include "mesh_pool.h"
+#include "render_queue.h"
+#include "ring_buffer.h"
+#include "vertex_layout.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MESH_COUNT 16
+#define TARGET_WIDTH 1280
+#define TARGET_HEIGHT 720
+
+// Same attribute locations as vertex_shader.glsl with INSTANCED, GLSL 4.50 so llvmpipe takes it
+static const char* vertex_source =
+  "#version 450 core\n"
+  "layout (location = 0) in vec3 aPos;\n"
+  "layout (location = 1) in vec4 aColor;\n"
+  "layout (location = 2) in vec2 aTexCoord;\n"
+  "layout (location = 3) in mat4 aInstanceTransform;\n"
+  "layout (location = 7) in vec4 aInstanceColor;\n"
+  "layout (location = 8) in vec4 aInstanceUV;\n"
+  "out vec4 Color;\n"
+  "void main() {\n"
+  "  gl_Position = aInstanceTransform * vec4(aPos, 1.0);\n"
+  "  Color = aColor * aInstanceColor;\n"
+  "}\n";
+
+static const char* fragment_source =
+  "#version 450 core\n"
+  "in vec4 Color;\n"
+  "out vec4 FragColor;\n"
+  "void main() { FragColor = Color; }\n";
+
+typedef struct {
+  double push;
+  double sort;
+  double submit;
+  double finish;
+} frame_times_t;
+
+static void print_times(const char* name, uint32_t packets, uint32_t frames, frame_times_t times,
+			render_queue_stats_t stats)
+{
+  printf("%-9s %8u packets: push %8.2f, sort %8.2f, submit %8.2f, gpu %8.2f ms/frame, %u draws, %u commands\n",
+	 name, packets, times.push * 1000.0 / frames, times.sort * 1000.0 / frames,
+	 times.submit * 1000.0 / frames, times.finish * 1000.0 / frames, stats.draws, stats.commands);
+}
+
+static frame_times_t run_frames(render_queue_t* queue, ring_buffer_t* stream, const render_packet_t* packets,
+				const instance_data_t* instances, uint32_t count, uint32_t frames, bool instanced)
+{
+  frame_times_t times = { 0 };
+
+  // One extra frame up front so growing the queue and faulting in the stream aren't counted
+  for (uint32_t frame = 0; frame <= frames; frame++) {
+    ring_buffer_begin_frame(stream);
+    gl_state_begin_frame();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    double start = bench_now_seconds();
+    for (uint32_t i = 0; i < count; i++) {
+      if (instanced)
+	render_queue_push_instanced(queue, &packets[i % MESH_COUNT], &instances[i]);
+      else
+	render_queue_push(queue, &packets[i % MESH_COUNT]);
+    }
+    double pushed = bench_now_seconds();
+    render_queue_sort(queue);
+    double sorted = bench_now_seconds();
+    render_queue_submit(queue);
+    double submitted = bench_now_seconds();
+    glFinish();
+    double finished = bench_now_seconds();
+
+    render_queue_clear(queue);
+    ring_buffer_end_frame(stream);
+
+    if (frame == 0)
+      continue;
+    times.push += pushed - start;
+    times.sort += sorted - pushed;
+    times.submit += submitted - sorted;
+    times.finish += finished - submitted;
+  }
+  return times;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t instance_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+  uint32_t frames = argc > 2 ? (uint32_t)atoi(argv[2]) : 5;
+  uint32_t plain_count = argc > 3 ? (uint32_t)atoi(argv[3]) : 10000;
+
+  bench_gl_t gl;
+  if (!bench_gl_init(&gl, TARGET_WIDTH, TARGET_HEIGHT))
+    return 1;
+
+  shader_t shader = { .id = bench_gl_program(vertex_source, fragment_source) };
+  if (shader.id == 0)
+    return 1;
+  shader_refresh_uniforms(&shader);
+  shader_reflect(&shader);
+
+  // Quads of a few sizes in one pool, so their draws can share a multi-draw
+  const vertex_format_t* format = &vertex_format_pos_color_uv_compact;
+  vertex_layout_t layout = vertex_layout_from_format(format);
+  mesh_pool_t* meshes = mesh_pool_create(&layout, 0, 0);
+  mesh_t mesh[MESH_COUNT];
+  render_packet_t packets[MESH_COUNT];
+  const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+  for (uint32_t m = 0; m < MESH_COUNT; m++) {
+    float s = 0.5f + 0.5f * (float)m / MESH_COUNT;
+    float vertices[] = {
+       s,  s, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f,
+       s, -s, 0.0f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,
+      -s, -s, 0.0f,  0.0f, 0.0f, 1.0f,  0.0f, 0.0f,
+      -s,  s, 0.0f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f,
+    };
+    uint8_t encoded[sizeof(vertices)];
+    vertex_format_convert(format, vertices, 4, encoded);
+    mesh_pool_add(meshes, encoded, 4, indices, 6, &mesh[m]);
+
+    packets[m] = (render_packet_t){
+      .key = render_key_instanced(0, shader.id, 0, 0, mesh[m].index_offset),
+      .shader = &shader,
+    };
+  }
+  for (uint32_t m = 0; m < MESH_COUNT; m++)
+    mesh_pool_packet(meshes, &mesh[m], &packets[m]);
+
+  // Big enough for every instance plus the indirect commands in one frame's region
+  size_t frame_size = (size_t)instance_count * sizeof(instance_data_t) + (1u << 20);
+  ring_buffer_t* stream = ring_buffer_create(frame_size);
+  render_queue_t* queue = render_queue_create(instance_count, stream);
+  if (!stream || !queue)
+    return 1;
+  mesh_pool_bind_instances(meshes, render_queue_instance_buffer(queue), &vertex_layout_instance);
+
+  // A grid of small quads covering the target
+  instance_data_t* instances = calloc(instance_count, sizeof(instance_data_t));
+  if (!instances)
+    return 1;
+  uint32_t side = 1;
+  while (side * side < instance_count)
+    side++;
+  for (uint32_t i = 0; i < instance_count; i++) {
+    float scale = 1.0f / (float)side;
+    instances[i].transform[0][0] = scale;
+    instances[i].transform[1][1] = scale;
+    instances[i].transform[2][2] = 1.0f;
+    instances[i].transform[3][0] = ((float)(i % side) + 0.5f) * 2.0f * scale - 1.0f;
+    instances[i].transform[3][1] = ((float)(i / side) + 0.5f) * 2.0f * scale - 1.0f;
+    instances[i].transform[3][3] = 1.0f;
+    instances[i].color[0] = instances[i].color[1] = instances[i].color[2] = instances[i].color[3] = 1.0f;
+    instances[i].uv_rect[2] = instances[i].uv_rect[3] = 1.0f;
+  }
+
+  printf("%u meshes, %ux%u target, %u frames\n", MESH_COUNT, TARGET_WIDTH, TARGET_HEIGHT, frames);
+
+  frame_times_t times = run_frames(queue, stream, packets, instances, instance_count, frames, true);
+  print_times("instanced", instance_count, frames, times, render_queue_get_stats(queue));
+
+  // Plain packets are a draw each, so far fewer of them keep the run short
+  if (plain_count > 0) {
+    if (plain_count > instance_count)
+      plain_count = instance_count;
+    times = run_frames(queue, stream, packets, instances, plain_count, frames, false);
+    print_times("plain", plain_count, frames, times, render_queue_get_stats(queue));
+  }
+
+  free(instances);
+  render_queue_destroy(queue);
+  ring_buffer_destroy(stream);
+  mesh_pool_destroy(meshes);
+  shader_destroy(&shader);
+  bench_gl_shutdown(&gl);
+  return 0;
+}
@@ -0,0 +1,247 @@
+// render_queue_sort on a frame's worth of packets against qsort, then render_queue_submit of the
+// same packets on a GL context: sort_bench [packets] [frames] [submit frames]. Every packet points
+// at real programs, materials, textures and meshes, so submission does the state changes its key
+// implies. Submit frames 0 skips the GL part, built with BENCH_HEADLESS it runs on llvmpipe
+#include "bench.h"
+#include "bench_gl.h"
+#include "gl_state.h"
+#include "mesh_pool.h"
+#include "render_queue.h"
+#include "sampler.h"
+#include "vertex_layout.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LAYER_COUNT 4
+#define SHADER_COUNT 48
+#define MATERIAL_COUNT 300
+#define TEXTURE_COUNT 400
+#define MESH_COUNT 16
+#define TEXTURE_SIZE 4
+
+typedef struct {
+  uint64_t key;
+  uint32_t index;
+} key_index_t;
+
+typedef struct {
+  uint32_t layer, shader, material, texture, mesh;
+  float depth;
+} packet_state_t;
+
+// Tiny quads, so llvmpipe spends the frame on draws rather than pixels
+static const char* vertex_source =
+  "#version 450 core\n"
+  "layout (location = 0) in vec3 aPos;\n"
+  "layout (location = 2) in vec2 aTexCoord;\n"
+  "out vec2 TexCoord;\n"
+  "void main() { gl_Position = vec4(aPos, 1.0); TexCoord = aTexCoord; }\n";
+
+static const char* fragment_source =
+  "#version 450 core\n"
+  "layout (binding = 0) uniform sampler2D image;\n"
+  "in vec2 TexCoord;\n"
+  "out vec4 FragColor;\n"
+  "void main() { FragColor = texture(image, TexCoord); }\n";
+
+// Same order the radix sort produces, ties by push order
+static int compare_keys(const void* a, const void* b)
+{
+  const key_index_t* x = a;
+  const key_index_t* y = b;
+  if (x->key != y->key)
+    return x->key < y->key ? -1 : 1;
+  return x->index < y->index ? -1 : x->index > y->index;
+}
+
+// Small xorshift so every run sorts the same keys
+static uint32_t next_random(uint32_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static bool time_sort(const uint64_t* keys, uint32_t packet_count, uint32_t frames)
+{
+  key_index_t* reference = malloc(packet_count * sizeof(key_index_t));
+  render_queue_t* queue = render_queue_create(packet_count, NULL);
+  if (!reference || !queue)
+    return false;
+
+  double radix_seconds = 0.0, qsort_seconds = 0.0;
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    for (uint32_t i = 0; i < packet_count; i++) {
+      render_packet_t packet = { .key = keys[i] };
+      render_queue_push(queue, &packet);
+      reference[i] = (key_index_t){ keys[i], i };
+    }
+
+    double start = bench_now_seconds();
+    render_queue_sort(queue);
+    radix_seconds += bench_now_seconds() - start;
+
+    start = bench_now_seconds();
+    qsort(reference, packet_count, sizeof(key_index_t), compare_keys);
+    qsort_seconds += bench_now_seconds() - start;
+
+    // Both should agree exactly, or the numbers mean nothing
+    for (uint32_t i = 0; i < packet_count; i++) {
+      if (render_queue_packet(queue, i)->key != reference[i].key) {
+	fprintf(stderr, "Sorted order differs from qsort at %u\n", i);
+	return false;
+      }
+    }
+    render_queue_clear(queue);
+  }
+
+  printf("render_queue_sort %8.3f ms/frame\n", radix_seconds * 1000.0 / frames);
+  printf("qsort             %8.3f ms/frame\n", qsort_seconds * 1000.0 / frames);
+
+  render_queue_destroy(queue);
+  free(reference);
+  return true;
+}
+
+static bool time_submit(const packet_state_t* states, const uint64_t* keys, uint32_t packet_count, uint32_t frames)
+{
+  bench_gl_t gl;
+  if (!bench_gl_init(&gl, 256, 256))
+    return false;
+
+  shader_t shaders[SHADER_COUNT];
+  for (uint32_t s = 0; s < SHADER_COUNT; s++) {
+    shaders[s] = (shader_t){ .id = bench_gl_program(vertex_source, fragment_source) };
+    if (shaders[s].id == 0)
+      return false;
+  }
+
+  uniform_buffer_t materials = uniform_buffer_create(&material_uniforms_layout, MATERIAL_COUNT);
+
+  GLuint textures[TEXTURE_COUNT];
+  uint8_t pixels[TEXTURE_SIZE * TEXTURE_SIZE * 4];
+  glGenTextures(TEXTURE_COUNT, textures);
+  for (uint32_t t = 0; t < TEXTURE_COUNT; t++) {
+    for (uint32_t p = 0; p < sizeof(pixels); p++)
+      pixels[p] = (uint8_t)(t * 31 + p);
+    gl_state_edit_texture(GL_TEXTURE_2D, textures[t]);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, TEXTURE_SIZE, TEXTURE_SIZE);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TEXTURE_SIZE, TEXTURE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  }
+  sampler_desc_t sampler_desc = SAMPLER_DESC_DEFAULT;
+  GLuint sampler = sampler_get(&sampler_desc);
+
+  const vertex_format_t* format = &vertex_format_pos_color_uv_compact;
+  vertex_layout_t layout = vertex_layout_from_format(format);
+  mesh_pool_t* meshes = mesh_pool_create(&layout, 0, 0);
+  mesh_t mesh[MESH_COUNT];
+  const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+  for (uint32_t m = 0; m < MESH_COUNT; m++) {
+    float x = -0.9f + 0.1f * (float)m, s = 0.01f;
+    float vertices[] = {
+      x + s,  s, 0.0f,  1.0f, 1.0f, 1.0f,  1.0f, 1.0f,
+      x + s, -s, 0.0f,  1.0f, 1.0f, 1.0f,  1.0f, 0.0f,
+      x - s, -s, 0.0f,  1.0f, 1.0f, 1.0f,  0.0f, 0.0f,
+      x - s,  s, 0.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f,
+    };
+    uint8_t encoded[sizeof(vertices)];
+    vertex_format_convert(format, vertices, 4, encoded);
+    if (!mesh_pool_add(meshes, encoded, 4, indices, 6, &mesh[m]))
+      return false;
+  }
+
+  render_packet_t* packets = malloc(packet_count * sizeof(render_packet_t));
+  render_queue_t* queue = render_queue_create(packet_count, NULL);
+  if (!packets || !queue)
+    return false;
+  for (uint32_t i = 0; i < packet_count; i++) {
+    const packet_state_t* state = &states[i];
+    packets[i] = (render_packet_t){
+      .key = keys[i],
+      .shader = &shaders[state->shader],
+      .texture = textures[state->texture],
+      .sampler = sampler,
+      .texture_unit = 0,
+      .material = &materials,
+      .material_index = state->material,
+    };
+    mesh_pool_packet(meshes, &mesh[state->mesh], &packets[i]);
+  }
+
+  // One extra frame up front so driver warm-up isn't counted
+  double sort_seconds = 0.0, submit_seconds = 0.0, finish_seconds = 0.0;
+  for (uint32_t frame = 0; frame <= frames; frame++) {
+    gl_state_begin_frame();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (uint32_t i = 0; i < packet_count; i++)
+      render_queue_push(queue, &packets[i]);
+
+    double start = bench_now_seconds();
+    render_queue_sort(queue);
+    double sorted = bench_now_seconds();
+    render_queue_submit(queue);
+    double submitted = bench_now_seconds();
+    glFinish();
+    double finished = bench_now_seconds();
+    render_queue_clear(queue);
+
+    if (frame == 0)
+      continue;
+    sort_seconds += sorted - start;
+    submit_seconds += submitted - sorted;
+    finish_seconds += finished - submitted;
+  }
+
+  gl_state_stats_t state_stats = gl_state_get_stats();
+  printf("submit %u frames: sort %8.3f, submit %8.3f, gpu %8.3f ms/frame, %u draws, %u binds issued and %u skipped last frame\n",
+	 frames, sort_seconds * 1000.0 / frames, submit_seconds * 1000.0 / frames, finish_seconds * 1000.0 / frames,
+	 render_queue_get_stats(queue).draws, state_stats.total_issued, state_stats.total_skipped);
+
+  render_queue_destroy(queue);
+  free(packets);
+  mesh_pool_destroy(meshes);
+  sampler_cache_destroy();
+  glDeleteTextures(TEXTURE_COUNT, textures);
+  uniform_buffer_destroy(&materials);
+  for (uint32_t s = 0; s < SHADER_COUNT; s++)
+    shader_destroy(&shaders[s]);
+  bench_gl_shutdown(&gl);
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t packet_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+  uint32_t frames = argc > 2 ? (uint32_t)atoi(argv[2]) : 50;
+  uint32_t submit_frames = argc > 3 ? (uint32_t)atoi(argv[3]) : 5;
+
+  // A scene's worth of state: a few layers, dozens of programs, hundreds of materials and
+  // textures, and a depth per packet
+  packet_state_t* states = malloc(packet_count * sizeof(packet_state_t));
+  uint64_t* keys = malloc(packet_count * sizeof(uint64_t));
+  if (!states || !keys)
+    return 1;
+
+  uint32_t state = 0x9E3779B9u;
+  for (uint32_t i = 0; i < packet_count; i++) {
+    uint32_t r = next_random(&state);
+    states[i] = (packet_state_t){
+      r % LAYER_COUNT, (r >> 2) % SHADER_COUNT, (r >> 8) % MATERIAL_COUNT, (r >> 17) % TEXTURE_COUNT,
+      (r >> 27) % MESH_COUNT, (float)(next_random(&state) & 0xFFFFFF) / (float)0xFFFFFF,
+    };
+    keys[i] = render_key(states[i].layer, states[i].shader, states[i].material, states[i].texture,
+			 states[i].depth, false);
+  }
+
+  printf("%u packets, %u frames\n", packet_count, frames);
+  if (!time_sort(keys, packet_count, frames))
+    return 1;
+  if (submit_frames > 0 && !time_submit(states, keys, packet_count, submit_frames))
+    return 1;
+
+  free(keys);
+  free(states);
+  return 0;
+}
@@ -0,0 +1,97 @@
+// Cost of setting uniforms: bench_uniforms [frames]. Each frame sets 100k floats spread over
+// UNIFORM_COUNT names three ways, then draws once so the driver has to consume them
+#include "bench.h"
+#include "bench_gl.h"
+#include "shader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SETS_PER_FRAME 100000
+#define UNIFORM_COUNT 16
+
+typedef enum { SET_BY_LOCATION, SET_BY_NAME, SET_BY_HANDLE, SET_MODE_COUNT } set_mode_t;
+
+static const char* const mode_names[SET_MODE_COUNT] = {
+  "glGetUniformLocation + glUniform1f",
+  "shader_set_float (by name)",
+  "shader_set_uniform_float (handle)",
+};
+
+static const char* vertex_source =
+  "#version 450 core\n"
+  "void main() { gl_Position = vec4(vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0, 0.0, 1.0); }\n";
+
+int main(int argc, char** argv)
+{
+  uint32_t frames = argc > 1 ? (uint32_t)atoi(argv[1]) : 20;
+
+  bench_gl_t gl;
+  if (!bench_gl_init(&gl, 64, 64))
+    return 1;
+
+  // Every uniform feeds the output so none are optimized away
+  char names[UNIFORM_COUNT][8];
+  char fragment_source[2048] = "#version 450 core\nout vec4 color;\n";
+  char sum[512] = "";
+  for (uint32_t i = 0; i < UNIFORM_COUNT; i++) {
+    snprintf(names[i], sizeof(names[i]), "u%u", i);
+    snprintf(fragment_source + strlen(fragment_source), sizeof(fragment_source) - strlen(fragment_source),
+	     "uniform float %s;\n", names[i]);
+    snprintf(sum + strlen(sum), sizeof(sum) - strlen(sum), "%s%s", i ? " + " : "", names[i]);
+  }
+  snprintf(fragment_source + strlen(fragment_source), sizeof(fragment_source) - strlen(fragment_source),
+	   "void main() { color = vec4(%s); }\n", sum);
+
+  shader_t shader = { .id = bench_gl_program(vertex_source, fragment_source) };
+  if (shader.id == 0)
+    return 1;
+  shader_refresh_uniforms(&shader);
+  shader_use(&shader);
+
+  shader_uniform_t handles[UNIFORM_COUNT];
+  for (uint32_t i = 0; i < UNIFORM_COUNT; i++)
+    handles[i] = shader_uniform(&shader, names[i]);
+
+  GLuint vao;
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  printf("%u frames of %u uniform sets\n", frames, SETS_PER_FRAME);
+  for (set_mode_t mode = 0; mode < SET_MODE_COUNT; mode++) {
+    double set_seconds = 0.0;
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      double start = bench_now_seconds();
+      for (uint32_t i = 0; i < SETS_PER_FRAME; i++) {
+	uint32_t u = i % UNIFORM_COUNT;
+	float value = (float)i * 1e-6f;
+	switch (mode) {
+	case SET_BY_LOCATION:
+	  glUniform1f(glGetUniformLocation(shader.id, names[u]), value);
+	  break;
+	case SET_BY_NAME:
+	  shader_set_float(&shader, names[u], value);
+	  break;
+	default:
+	  shader_set_uniform_float(&shader, handles[u], value);
+	  break;
+	}
+      }
+      set_seconds += bench_now_seconds() - start;
+
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+      glFinish();
+    }
+
+    double frame_ms = set_seconds * 1000.0 / frames;
+    printf("%-36s %8.3f ms/frame %7.1f ns/set\n", mode_names[mode], frame_ms,
+	   frame_ms * 1e6 / SETS_PER_FRAME);
+  }
+
+  glDeleteVertexArrays(1, &vao);
+  shader_destroy(&shader);
+  bench_gl_shutdown(&gl);
+  return 0;
+}
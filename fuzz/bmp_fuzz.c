@@ -0,0 +1,14 @@
+// libFuzzer entry for the BMP decoder, built with -DBUILD_FUZZERS=ON under clang.
+// Run as ./bmp_fuzz corpus_dir, seeding the corpus with ../assets/textures/*.bmp
+#include "bmp_decode.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  bmp_image_t image;
+  if (bmp_decode_memory(data, size, &image) == BMP_OK)
+    bmp_image_free(&image);
+  return 0;
+}
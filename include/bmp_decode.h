@@ -0,0 +1,89 @@
+#pragma once
+
+// BMP parsing and decoding with no GL dependency, so it can run on worker threads or be fuzzed
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BMP_MAGIC 0x4D42
+#define BMP_MAX_DIMENSION 32768                  // per side
+#define BMP_MAX_PIXELS ((uint64_t)1 << 28)       // 16k x 16k
+#define BMP_MAX_PALETTE 256
+#define BMP_HEADER_MAX (14 + 124 + BMP_MAX_PALETTE * 4) // file header + V5 info header + palette
+
+/* HEADER STRUCTS ALLIGNED WITH BMP DATA */
+
+#pragma pack(push, 1) // Set no padding so can read directly from BMP into structs
+
+typedef struct {
+  uint16_t signature;        // 0x0000 :: 'BM'
+  uint32_t file_size;        // 0x0002 :: file size in bytes
+  uint32_t reserved;         // 0x0006 :: unused(=0)
+  uint32_t data_offset;      // 0x000A :: offset from beginning of file to beginning of bmp data
+} bmp_file_header_t;
+
+typedef struct {
+  uint32_t size;             // 0x000E :: size of info header = 40
+  int32_t width;             // 0x0012 :: horizontal width of bmp in pixels
+  int32_t height;            // 0x0016 :: vertical height of bmp in pixels, negative = top-down rows
+  uint16_t planes;           // 0x001A :: number of planes (=1)
+  uint16_t bits_per_pixel;   // 0x001C :: bits per pixel				  
+  uint32_t compression;      // 0x001E :: type of compression				  
+  uint32_t image_size;       // 0x0022 :: (compressed) size of image, 0 if no compression 
+  uint32_t x_pixels_per_m;   // 0x0026 :: horizontal resolution pixels/meter		  
+  uint32_t y_pixels_per_m;   // 0x002A :: vertical resolution pixels/meter		  
+  uint32_t colors_used;      // 0x002E :: number of actually used colors                  
+  uint32_t important_colors; // 0x0032 :: number of all important colors, 0 = all
+} bmp_info_header_t;
+
+#pragma pack(pop)
+
+typedef enum {
+  BMP_OK = 0,
+  BMP_ERROR_IO,
+  BMP_ERROR_TRUNCATED,
+  BMP_ERROR_SIGNATURE,
+  BMP_ERROR_HEADER,          // inconsistent header fields
+  BMP_ERROR_UNSUPPORTED,     // valid BMP we can't decode (compression, bit depth)
+  BMP_ERROR_TOO_LARGE,
+  BMP_ERROR_MEMORY,
+} bmp_result_t;
+
+// Validated description of where and how the pixels are stored
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint16_t bits_per_pixel;   // 8 (palette), 16 (X1R5G5B5), 24 or 32 (BGRX)
+  bool top_down;
+  uint32_t data_offset;
+  size_t file_row_size;      // bytes per row in the file, padded to 4
+  size_t row_size;           // bytes per decoded BGR row, padded to 4
+  uint32_t palette_count;
+  uint8_t palette[BMP_MAX_PALETTE * 4]; // BGRX entries
+} bmp_layout_t;
+
+// Decoded pixels in upload order: top-down rows of BGR, each padded to 4 bytes like the file
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  size_t row_size;
+  unsigned char* pixels;
+} bmp_image_t;
+
+// Check the headers in the first size bytes of a file of file_size bytes, no header field is trusted
+bmp_result_t bmp_parse_header(const uint8_t* data, size_t size, uint64_t file_size, bmp_layout_t* layout);
+
+// Convert rows as stored in the file to BGR rows. dst_stride may be negative to flip while converting
+void bmp_convert_rows(const bmp_layout_t* layout, const uint8_t* src, uint32_t rows,
+		      uint8_t* dst, ptrdiff_t dst_stride);
+
+// Decode a BMP held in memory, the entry point for fuzzing
+bmp_result_t bmp_decode_memory(const uint8_t* data, size_t size, bmp_image_t* image);
+
+// Read a whole file and decode it
+bmp_result_t bmp_decode_file(const char* filename, bmp_image_t* image);
+
+void bmp_image_free(bmp_image_t* image);
+
+const char* bmp_result_string(bmp_result_t result);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <cglm/cglm.h>
+
+#include "thread_pool.h"
+
+#define BVH_BINS 16
+#define BVH_LEAF_SIZE 4            // ranges this small become leaves without trying a split
+#define BVH_MAX_LEAF_SIZE 16       // above this a split is taken even if SAH says it doesn't pay
+#define BVH_MAX_DEPTH 64           // traversal stack size, deeper ranges are forced into leaves
+
+typedef struct {
+  vec3 min;
+  vec3 max;
+} aabb_t;
+
+typedef struct {
+  uint32_t primitive;
+  float t;                     // distance along the ray in units of direction
+} bvh_hit_t;
+
+typedef struct {
+  uint32_t node_count;
+  uint32_t leaf_count;
+  uint32_t depth;
+  double build_ms;
+  double refit_ms;
+} bvh_stats_t;
+
+// Exact test for one primitive, returns the hit distance or a negative value for a miss.
+// Only called for primitives whose box the ray hits closer than max_t
+typedef float (*bvh_ray_fn)(void* user, uint32_t primitive, const vec3 origin, const vec3 direction, float max_t);
+
+// Static bounding volume hierarchy over primitive boxes. Nodes are 32 bytes in one array with
+// siblings next to each other, built top down with binned SAH
+typedef struct bvh bvh_t;
+
+// Subtrees below the first few splits are built in parallel on workers, NULL builds on the caller
+bvh_t* bvh_build(const aabb_t* bounds, uint32_t count, thread_pool_t* workers);
+
+// Primitives whose box intersects the frustum of view_projection, in no particular order.
+// Subtrees fully inside are taken whole without testing further. visible_out needs room for
+// every primitive. Returns the visible count
+uint32_t bvh_cull_frustum(const bvh_t* bvh, mat4 view_projection, uint32_t* visible_out);
+
+// Closest hit along origin + t * direction for t in [0, max_t], a segment is max_t = 1 with
+// direction = end - origin. test NULL hits primitive boxes
+bool bvh_raycast(const bvh_t* bvh, const vec3 origin, const vec3 direction, float max_t,
+		 bvh_ray_fn test, void* user, bvh_hit_t* hit_out);
+
+// Move a primitive. Its leaf is marked and bvh_refit grows/shrinks only the nodes above marked
+// leaves, the tree shape stays the same so quality drops as things move far; rebuild then
+void bvh_update(bvh_t* bvh, uint32_t primitive, const aabb_t* bounds);
+void bvh_refit(bvh_t* bvh);
+
+bvh_stats_t bvh_get_stats(const bvh_t* bvh);
+
+void bvh_destroy(bvh_t* bvh);
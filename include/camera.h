@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cglm/cglm.h>
+#include <GLFW/glfw3.h>
+
+#include "uniform_buffer.h"
+
+#define CAMERA_DEFAULT_FOV 60.0f       // vertical, degrees
+#define CAMERA_DEFAULT_SPEED 20.0f     // world units a second
+#define CAMERA_LOOK_SPEED 90.0f        // degrees a second while an arrow key is held
+
+// Free flying camera. Yaw turns around +y with 0 looking down -z, pitch stops short of straight
+// up or down so the view never flips
+typedef struct {
+  vec3 position;
+  float yaw;                   // degrees
+  float pitch;
+  float fov;
+  float near;
+  float far;
+  float speed;
+} camera_t;
+
+camera_t camera_create(const vec3 position, float yaw, float pitch, float far);
+
+// WASD moves, E/Q goes up/down, arrow keys look around. dt in seconds
+void camera_update(camera_t* camera, GLFWwindow* window_ptr, float dt);
+
+void camera_forward(const camera_t* camera, vec3 forward_out);
+
+// Fill in view, projection, view_projection and camera_position
+void camera_frame_uniforms(const camera_t* camera, float aspect, frame_uniforms_t* frame);
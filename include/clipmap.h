@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glad/glad.h>
+#include <cglm/cglm.h>
+
+#include "render_queue.h"
+#include "shader.h"
+#include "thread_pool.h"
+#include "vertex_layout.h"
+
+#define CLIPMAP_VERTEX_SHADER_PATH "../assets/shaders/clipmap_vertex_shader.glsl"
+
+#define CLIPMAP_LEVELS 4               // each one twice the spacing and extent of the one inside it
+#define CLIPMAP_GRID 124               // quads along a level's side, a multiple of 4
+#define CLIPMAP_SIZE 128               // height texels along a level's side, a power of 2 >= CLIPMAP_GRID + 3
+#define CLIPMAP_SPACING 1.0f           // world units between level 0 vertices
+
+// Passed to shader_variant so the vertex shader agrees with the sizes above
+#define CLIPMAP_SHADER_DEFINE_COUNT 2
+extern const char* const clipmap_shader_defines[CLIPMAP_SHADER_DEFINE_COUNT];
+
+typedef struct {
+  uint32_t samples;            // heights generated this frame
+  uint32_t levels_moved;       // levels whose window moved this frame
+  double update_ms;            // generating and uploading this frame
+} clipmap_stats_t;
+
+// Geometry clipmap: the same ring mesh for every level around the camera, displaced in the vertex
+// shader from that level's window of heights. Windows are toroidal, so as the camera moves only the
+// rows and columns that came into view are generated. Fine levels morph into the next coarser
+// one towards their edge, so levels meet without cracks
+typedef struct clipmap clipmap_t;
+
+// Level samples [x0, x0 + width) x [z0, z0 + height)
+typedef struct {
+  int32_t x0, z0;
+  uint32_t width, height;
+} clipmap_region_t;
+
+// Grid positions only, heights come from the texture
+extern const vertex_layout_t clipmap_vertex_layout;
+
+// Level sample under the corner of a level's ring for a camera at camera_position. The level's
+// window, the CLIPMAP_SIZE square of samples held in the texture, starts one sample before it
+void clipmap_level_grid(uint32_t level, const vec3 camera_position, int32_t grid_out[2]);
+
+// Which trim fills the rest of a level's hole around the next finer level, given both grids from
+// clipmap_level_grid: bit 0 set if the finer level sits a quad further in along x, bit 1 along z
+uint32_t clipmap_level_trim(const int32_t finer_grid[2], const int32_t grid[2]);
+
+// Samples that come into view as a level's window moves from from to to, at most 2 regions.
+// The whole window if from_valid is false or it moved a window or more. Returns the count
+uint32_t clipmap_window_regions(bool from_valid, const int32_t from[2], const int32_t to[2],
+				clipmap_region_t regions_out[2]);
+
+// NULL workers generates heights on the calling thread
+clipmap_t* clipmap_create(thread_pool_t* workers);
+
+// Point the VAO's per-instance attributes at buffer, ie render_queue_instance_buffer
+void clipmap_bind_instances(clipmap_t* clipmap, GLuint buffer, const vertex_layout_t* layout);
+
+// Recenter every level on the camera and fill in the heights that came into view
+void clipmap_update(clipmap_t* clipmap, const vec3 camera_position);
+
+// Push every level, they batch into one multi-draw. texture_unit is where the shader reads
+// clipmap_heights from
+void clipmap_draw(clipmap_t* clipmap, render_queue_t* queue, const shader_t* shader, uint32_t texture_unit);
+
+// Counters for the current frame
+clipmap_stats_t clipmap_get_stats(const clipmap_t* clipmap);
+
+void clipmap_destroy(clipmap_t* clipmap);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <cglm/cglm.h>
+
+#include "thread_pool.h"
+
+// Objects per parallel chunk, big enough that handing one out costs nothing next to testing it
+#define CULL_CHUNK_SIZE 16384
+
+// Bounds of every cullable object as structure of arrays, so the test loads 8 of one field at a time.
+// Each object has an AABB (center, half extents) and the sphere around it, an object is culled
+// if either is fully outside a plane
+typedef struct cull_objects cull_objects_t;
+
+typedef struct {
+  uint32_t tested;
+  uint32_t visible;
+  double cull_ms;
+} cull_stats_t;
+
+cull_objects_t* cull_objects_create(uint32_t capacity);
+
+// Returns the object's index, which is what visible lists contain. UINT32_MAX if out of memory
+uint32_t cull_objects_add(cull_objects_t* objects, const vec3 center, const vec3 extents);
+
+void cull_objects_set(cull_objects_t* objects, uint32_t index, const vec3 center, const vec3 extents);
+
+uint32_t cull_objects_count(const cull_objects_t* objects);
+
+// Indices of objects inside the frustum of view_projection, in ascending order. visible_out needs
+// room for every object. Chunks are spread over workers, NULL tests on the calling thread only.
+// Returns the visible count
+uint32_t cull_frustum(cull_objects_t* objects, mat4 view_projection, thread_pool_t* workers,
+		      uint32_t* visible_out);
+
+// "avx2", "sse2", "neon" or "scalar", whichever cull_frustum picked on this CPU
+const char* cull_simd_name(void);
+
+// Use the named path from now on instead, ie "scalar" to check the others against it. False if
+// this build or CPU doesn't have it
+bool cull_set_simd(const char* name);
+
+// Counters for the last cull_frustum
+cull_stats_t cull_get_stats(const cull_objects_t* objects);
+
+void cull_objects_destroy(cull_objects_t* objects);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FILE_WATCH_MAX_FILES 128
+#define FILE_WATCH_MAX_DIRS 32
+#define FILE_WATCH_SETTLE_SECONDS 0.05   // wait this long after the last write before reporting a change
+
+// Watches individual files through their directories (inotify on Linux, no-op elsewhere)
+typedef struct file_watch file_watch_t;
+
+file_watch_t* file_watch_create(void);
+
+// Start watching a file, adding the same path twice is harmless
+bool file_watch_add(file_watch_t* watch, const char* path);
+
+// Non-blocking. Writes up to max paths (as passed to file_watch_add) that changed and have since
+// settled, so a burst of writes to one file is reported once. Returns the number written
+uint32_t file_watch_poll(file_watch_t* watch, const char** changed, uint32_t max);
+
+void file_watch_destroy(file_watch_t* watch);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <glad/glad.h>
+
+// Texture units and indexed buffer bindings tracked, higher ones are passed straight through
+#define GL_STATE_TEXTURE_UNITS 32
+#define GL_STATE_BUFFER_BINDINGS 16
+
+// Shadow copy of the binding state, every bind in the engine goes through here so one that
+// matches the current state costs a compare instead of a driver call.
+// Code that binds behind its back has to call gl_state_invalidate afterwards
+typedef enum {
+  GL_STATE_PROGRAM,
+  GL_STATE_TEXTURE,            // includes glActiveTexture
+  GL_STATE_SAMPLER,
+  GL_STATE_VERTEX_ARRAY,
+  GL_STATE_BUFFER,
+  GL_STATE_KIND_COUNT
+} gl_state_kind_t;
+
+typedef struct {
+  uint32_t issued[GL_STATE_KIND_COUNT];
+  uint32_t skipped[GL_STATE_KIND_COUNT];
+  uint32_t total_issued;
+  uint32_t total_skipped;
+} gl_state_stats_t;
+
+void gl_state_use_program(GLuint program);
+
+// Bind for drawing, switching the active unit only if the binding has to change
+void gl_state_bind_texture(uint32_t unit, GLenum target, GLuint texture);
+
+// Bind on whichever unit is active, for uploads and other edits that don't care about the unit
+void gl_state_edit_texture(GLenum target, GLuint texture);
+
+void gl_state_bind_sampler(uint32_t unit, GLuint sampler);
+void gl_state_bind_vertex_array(GLuint vao);
+
+// GL_ELEMENT_ARRAY_BUFFER is part of the bound VAO, so it's tracked per VAO switch
+void gl_state_bind_buffer(GLenum target, GLuint buffer);
+
+// Indexed GL_UNIFORM_BUFFER / GL_SHADER_STORAGE_BUFFER bindings, also sets the generic binding like GL does
+void gl_state_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+// Call before deleting an object. GL unbinds deleted objects and may hand the name out again,
+// which a stale cache would then skip binding
+void gl_state_forget_program(GLuint program);
+void gl_state_forget_texture(GLuint texture);
+void gl_state_forget_sampler(GLuint sampler);
+void gl_state_forget_vertex_array(GLuint vao);
+void gl_state_forget_buffer(GLuint buffer);
+
+// Treat everything as unknown, the next bind of each kind always goes to GL
+void gl_state_invalidate(void);
+
+// Close the counters for the last frame and start new ones
+void gl_state_begin_frame(void);
+
+// Counters for the last complete frame
+gl_state_stats_t gl_state_get_stats(void);
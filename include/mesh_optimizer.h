@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// FIFO size the stats and overdraw clustering simulate, a conservative guess at real hardware
+#define MESH_CACHE_SIZE 16
+
+// Post-transform cache efficiency of an index buffer
+typedef struct {
+  float acmr;                  // vertices transformed per triangle, 0.5 is ideal, 3 is no reuse
+  float atvr;                  // vertices transformed per referenced vertex, 1 is ideal
+} mesh_cache_stats_t;
+
+typedef struct {
+  uint32_t vertices_before;
+  uint32_t vertices_after;
+  mesh_cache_stats_t before;
+  mesh_cache_stats_t after;
+} mesh_optimize_stats_t;
+
+// True if the indices are whole triangles and every index is below vertex_count, otherwise the
+// problem is reported. Every function below checks this first and leaves the mesh alone if it fails
+bool mesh_indices_valid(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count);
+
+// Simulate a FIFO cache of cache_size over triangle list indices
+mesh_cache_stats_t mesh_analyze(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count,
+				uint32_t cache_size);
+
+// Point indices at the first of any bit-identical vertices. Returns how many distinct vertices are
+// left, the duplicates stay in the buffer until mesh_optimize_vertex_fetch drops them
+uint32_t mesh_weld(const void* vertices, uint32_t vertex_count, uint32_t stride,
+		   uint32_t* indices, uint32_t index_count);
+
+// Reorder triangles for the post-transform cache, Forsyth's linear-speed algorithm
+bool mesh_optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count);
+
+// Split cache-ordered triangles into clusters where the cache starts over and draw the clusters
+// facing outward first, so the depth test rejects more of what's behind them. positions are the
+// first 3 floats of each stride byte vertex
+bool mesh_optimize_overdraw(uint32_t* indices, uint32_t index_count, const float* positions,
+			    uint32_t vertex_count, uint32_t stride);
+
+// Renumber vertices in the order the indices first use them and drop unused ones, so fetches
+// walk the vertex buffer forwards. Returns the new vertex count
+uint32_t mesh_optimize_vertex_fetch(void* vertices, uint32_t vertex_count, uint32_t stride,
+				    uint32_t* indices, uint32_t index_count);
+
+// All of the above in order, on interleaved float vertices with the position first. Returns the new
+// vertex count, or vertex_count untouched if memory ran out or an index is out of range
+uint32_t mesh_optimize(float* vertices, uint32_t vertex_count, uint32_t components,
+		       uint32_t* indices, uint32_t index_count, mesh_optimize_stats_t* stats_out);
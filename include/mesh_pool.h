@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glad/glad.h>
+
+#include "vertex_layout.h"
+#include "render_queue.h"
+
+#define MESH_POOL_DEFAULT_VERTICES (1u << 16)
+#define MESH_POOL_DEFAULT_INDEX_BYTES (1u << 20)
+
+// A range of the pool's buffers. Meshes all share one VAO, so draws of different meshes only
+// differ in these numbers and can go into the same multi-draw
+typedef struct {
+  uint32_t index_offset;       // bytes into the index buffer
+  uint32_t index_count;
+  GLenum index_type;           // GL_UNSIGNED_SHORT whenever the mesh's indices fit
+  int32_t base_vertex;
+  uint32_t vertex_count;
+} mesh_t;
+
+typedef struct mesh_pool mesh_pool_t;
+
+// One VAO over a vertex buffer in layout and an index buffer, both grow as meshes are added
+mesh_pool_t* mesh_pool_create(const vertex_layout_t* layout, uint32_t vertex_capacity, uint32_t index_bytes);
+
+// Copy a mesh in, vertices already in the pool's layout. Indices are relative to the mesh's own
+// vertices, thanks to the base vertex that makes 16 bits enough for any mesh under 64k vertices,
+// however big the pool gets. Static geometry only, there's no removal
+bool mesh_pool_add(mesh_pool_t* pool, const void* vertices, uint32_t vertex_count,
+		   const uint32_t* indices, uint32_t index_count, mesh_t* mesh_out);
+
+// Point the VAO's per-instance attributes at buffer, ie render_queue_instance_buffer
+void mesh_pool_bind_instances(mesh_pool_t* pool, GLuint buffer, const vertex_layout_t* layout);
+
+// Fill in the geometry half of a packet: vao, mode, index type and range
+void mesh_pool_packet(const mesh_pool_t* pool, const mesh_t* mesh, render_packet_t* packet);
+
+GLuint mesh_pool_vertex_array(const mesh_pool_t* pool);
+
+void mesh_pool_destroy(mesh_pool_t* pool);
@@ -1,2 +1,4 @@
 #pragma once
 
+// 2D Perlin noise in the range [0, 1], safe to call from any thread
+float perlin2d(float x, float y);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <cglm/cglm.h>
+
+#include "bvh.h"
+#include "thread_pool.h"
+
+// Small enough to rasterize in well under a millisecond, width must be a multiple of 4
+#define OCCLUSION_DEFAULT_WIDTH 256
+#define OCCLUSION_DEFAULT_HEIGHT 128
+#define OCCLUSION_BANDS 8          // rows are split into this many parallel jobs
+
+typedef struct {
+  uint32_t triangles;          // occluder triangles that made it to the depth buffer
+  uint32_t tested;
+  uint32_t occluded;
+  double raster_ms;            // rasterizing and building the pyramid, off the main thread
+  double wait_ms;              // main thread blocked on it before the first test
+} occlusion_stats_t;
+
+// Occluders rasterized into a low resolution depth buffer and reduced into a max depth pyramid.
+// Objects are hidden if their nearest point is behind the farthest occluder depth over the
+// screen rect they cover
+typedef struct occlusion occlusion_t;
+
+occlusion_t* occlusion_create(uint32_t width, uint32_t height);
+
+// Static occluder, positions are the first 3 floats of every stride floats and are moved into
+// world space by transform once here. Should be simple and fully inside what it stands for. Its
+// depth is pushed back slightly, so it can stand for itself without hiding its own bounds
+bool occlusion_add_occluder(occlusion_t* occlusion, const float* positions, uint32_t stride, uint32_t vertex_count,
+			    const uint32_t* indices, uint32_t index_count, mat4 transform);
+
+// Start rasterizing the occluders from view_projection on workers and return right away.
+// NULL workers does it all here. Waits for the previous frame's if it's still running
+void occlusion_begin_frame(occlusion_t* occlusion, mat4 view_projection, thread_pool_t* workers);
+
+// Both wait for the frame's depth to be ready. Boxes crossing the near plane are always visible
+bool occlusion_test(occlusion_t* occlusion, const aabb_t* bounds);
+
+// Drops the indices whose bounds[index] are occluded, keeping order. Returns the new count
+uint32_t occlusion_filter(occlusion_t* occlusion, const aabb_t* bounds, uint32_t* indices, uint32_t count);
+
+// "sse2", "neon" or "scalar", fixed at compile time
+const char* occlusion_simd_name(void);
+
+// Counters for the current frame
+occlusion_stats_t occlusion_get_stats(const occlusion_t* occlusion);
+
+void occlusion_destroy(occlusion_t* occlusion);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "uniform_buffer.h"
+#include "vertex_layout.h"
+#include "ring_buffer.h"
+
+// Sort key bits, most significant first. Packets sort by layer, then by the state that's most
+// expensive to change, so submission only switches programs/materials/textures between runs
+#define RENDER_KEY_LAYER_BITS 4
+#define RENDER_KEY_SHADER_BITS 12
+#define RENDER_KEY_MATERIAL_BITS 12
+#define RENDER_KEY_TEXTURE_BITS 12
+#define RENDER_KEY_DEPTH_BITS 24
+
+#define RENDER_QUEUE_DEFAULT_CAPACITY 1024
+
+// render_packet_t.instance for packets drawn on their own
+#define RENDER_NO_INSTANCE UINT32_MAX
+
+// Everything needed to issue one indexed draw
+typedef struct {
+  uint64_t key;
+  const shader_t* shader;
+  GLuint vao;
+  GLuint texture;              // GL_TEXTURE_2D, 0 = none
+  GLuint sampler;
+  uint32_t texture_unit;
+  const uniform_buffer_t* material;  // NULL = leave the material binding alone
+  uint32_t material_index;
+  GLenum mode;                 // GL_TRIANGLES, ...
+  GLenum index_type;           // GL_UNSIGNED_INT, ...
+  uint32_t count;
+  uint32_t index_offset;       // bytes into the element buffer
+  int32_t base_vertex;
+  uint32_t instance;           // set by the queue, RENDER_NO_INSTANCE or an index into its instance data
+} render_packet_t;
+
+typedef struct {
+  uint32_t packets;
+  uint32_t draws;              // GL draw calls, a multi-draw counts once
+  uint32_t commands;           // indirect commands, one per run of instances of a mesh
+  uint32_t instances;
+  double sort_ms;
+  double submit_ms;
+} render_queue_stats_t;
+
+typedef struct render_queue render_queue_t;
+
+// Instance data and indirect commands are written into stream each submit, it has to outlive the queue
+render_queue_t* render_queue_create(uint32_t capacity, ring_buffer_t* stream);
+
+// Build a key. Fields are truncated to their bit widths, which only affects ordering since
+// submission compares the real state. depth is 0..1, back_to_front flips it for blended layers
+uint64_t render_key(uint32_t layer, uint32_t shader, uint32_t material, uint32_t texture,
+		    float depth, bool back_to_front);
+
+// Key for instanced packets. The mesh id takes the depth bits so copies of one mesh sort next
+// to each other and become a single indirect command
+uint64_t render_key_instanced(uint32_t layer, uint32_t shader, uint32_t material, uint32_t texture,
+			      uint32_t mesh);
+
+// Copy a packet into the queue, it grows as needed
+void render_queue_push(render_queue_t* queue, const render_packet_t* packet);
+
+// Same, with per-instance data. Consecutive packets (after sorting) that only differ in their
+// instance data are merged into one indirect command, and consecutive commands that share
+// program, textures, material and VAO (ie meshes from one mesh_pool) into one
+// glMultiDrawElementsIndirect. The packet's VAO has to read vertex_layout_instance from
+// render_queue_instance_buffer
+void render_queue_push_instanced(render_queue_t* queue, const render_packet_t* packet,
+				 const instance_data_t* instance);
+
+// Buffer the instance data is streamed into on submit, for VAO setup. Attributes start at offset 0,
+// submission offsets into it through the base instance
+GLuint render_queue_instance_buffer(const render_queue_t* queue);
+
+// LSD radix sort of the keys, 8 bits per pass, passes where every key has the same byte are skipped
+void render_queue_sort(render_queue_t* queue);
+
+// Issue the sorted packets through gl_state so only state that changes reaches GL. Plain packets
+// are one draw each, instanced ones are batched as above
+void render_queue_submit(render_queue_t* queue);
+
+// Forget this frame's packets, keeping the memory
+void render_queue_clear(render_queue_t* queue);
+
+// Packet at position i of the sorted order, valid until the next push or clear
+const render_packet_t* render_queue_packet(const render_queue_t* queue, uint32_t i);
+
+// Counters for the last sort and submit
+render_queue_stats_t render_queue_get_stats(const render_queue_t* queue);
+
+void render_queue_destroy(render_queue_t* queue);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <glad/glad.h>
+
+#include "uniform_buffer.h"
+
+// Frames the GPU may still be reading while the CPU writes the next one
+#define RING_BUFFER_FRAMES 3
+#define RING_BUFFER_DEFAULT_FRAME_SIZE (16u << 20)
+
+// Persistently mapped buffer split into RING_BUFFER_FRAMES regions, one per frame in flight.
+// Transient data is written straight into the mapping, so there's no glBufferData/SubData copy
+// and no implicit sync. A region is only reused once the fence from its frame has signalled
+typedef struct ring_buffer ring_buffer_t;
+
+// Where an allocation landed, data is valid until the end of the frame
+typedef struct {
+  void* data;
+  GLintptr offset;             // from the start of the buffer, for pointers/ranges/base instance
+} ring_alloc_t;
+
+typedef struct {
+  size_t used;                 // bytes allocated last frame
+  size_t peak;
+  double wait_ms;              // time blocked on the fence at the start of last frame
+  uint32_t failed;             // allocations that didn't fit last frame
+} ring_buffer_stats_t;
+
+ring_buffer_t* ring_buffer_create(size_t frame_size);
+
+// Move to the next region, waiting for the GPU to finish with it if it hasn't yet
+void ring_buffer_begin_frame(ring_buffer_t* ring);
+
+// Fence the region after the frame's draws have been issued
+void ring_buffer_end_frame(ring_buffer_t* ring);
+
+// Bump allocate size bytes aligned to alignment (any value, not only powers of two).
+// False if the region is full, there's no fallback
+bool ring_buffer_alloc(ring_buffer_t* ring, size_t size, size_t alignment, ring_alloc_t* alloc_out);
+
+// Copy a block into this frame's region and point the layout's binding at it
+bool ring_buffer_bind_block(ring_buffer_t* ring, const ubo_layout_t* layout, const void* data);
+
+GLuint ring_buffer_id(const ring_buffer_t* ring);
+
+ring_buffer_stats_t ring_buffer_get_stats(const ring_buffer_t* ring);
+
+void ring_buffer_destroy(ring_buffer_t* ring);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <stdint.h>
+
+#define SAMPLER_CACHE_SIZE 32
+
+// Filtering and wrap state, shared by every texture that samples the same way
+typedef struct {
+  GLenum min_filter;
+  GLenum mag_filter;
+  GLenum wrap_s;
+  GLenum wrap_t;
+  float anisotropy;          // 1.0 = anisotropic filtering off
+} sampler_desc_t;
+
+#define SAMPLER_DESC_DEFAULT { GL_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT, 1.0f }
+
+// Get the sampler object for desc, creating it on first use. Equal descs return the same id
+GLuint sampler_get(const sampler_desc_t* desc);
+
+// Delete every cached sampler object
+void sampler_cache_destroy(void);
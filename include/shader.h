@@ -1,27 +1,140 @@
 #pragma once
 #include <glad/glad.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "vertex_layout.h"
 
 #define SHADER_DIR "../assets/shaders/"
 #define VERTEX_SHADER_PATH "../assets/shaders/vertex_shader.glsl"
 #define FRAGMENT_SHADER_PATH "../assets/shaders/fragment_shader.glsl"
 
+// Handle to a uniform, resolved once by name. Index into the shader's uniform table, -1 = not found
+typedef int32_t shader_uniform_t;
+
+// Active uniforms introspected at link time. Entries keep their index when the table is rebuilt,
+// so handles stay valid across relinks
+typedef struct {
+  uint32_t count;
+  uint32_t capacity;
+  char** names;
+  uint32_t* hashes;
+  GLint* locations;          // -1 once a uniform is no longer active
+  uint16_t* index;           // open addressing hash -> entry + 1, 0 = empty
+  uint32_t index_mask;
+} shader_uniforms_t;
+
+// Vertex shader input, built-ins like gl_VertexID are left out
+typedef struct {
+  char* name;
+  GLint location;
+  GLenum type;                 // GL_FLOAT_VEC3, ...
+  GLint array_size;
+} shader_input_t;
+
+// Texture sampler uniform, with the unit it reads and the texture target it expects there
+typedef struct {
+  char* name;
+  GLint location;
+  GLenum type;                 // GL_SAMPLER_2D, ...
+  GLenum target;               // GL_TEXTURE_2D, ...
+  GLint unit;
+} shader_sampler_t;
+
+// Uniform or shader storage block
+typedef struct {
+  char* name;
+  GLenum interface;            // GL_UNIFORM_BLOCK or GL_SHADER_STORAGE_BLOCK
+  GLint binding;
+  GLint size;
+} shader_block_t;
+
+// Everything a program consumes, read once after each link so the renderer can build its
+// binding tables up front instead of querying GL per draw
+typedef struct {
+  uint32_t input_count;
+  shader_input_t* inputs;
+  uint32_t sampler_count;
+  shader_sampler_t* samplers;  // sorted by unit
+  uint32_t block_count;
+  shader_block_t* blocks;
+} shader_reflection_t;
+
 // Represent a shader program as a component in ECS
 typedef struct {
   GLuint id;
+  shader_uniforms_t uniforms;
+  shader_reflection_t reflection;
+  bool compiling;              // first build still in a batch. id stays 0 after one that failed
 } shader_t;
 
-// Create a shader from vertex and fragment source files
+// Create a shader from vertex and fragment source files, blocks until it's linked
 shader_t shader_create(const char* vertex_path, const char* fragment_path);
 
+// Programs compiled together. With GL_KHR_parallel_shader_compile the driver builds them on its own
+// threads while the app keeps rendering, without it they're finished one per poll
+typedef struct shader_batch shader_batch_t;
+
+shader_batch_t* shader_batch_create(void);
+
+// Start compiling a program. out is zeroed now and filled in when the program is finished,
+// so it must stay valid until then
+void shader_batch_add(shader_batch_t* batch, shader_t* out, const char* vertex_path, const char* fragment_path);
+
+// Same, with a block of #define lines from shader_define_block() inserted after #version
+void shader_batch_add_variant(shader_batch_t* batch, shader_t* out, const char* vertex_path,
+			      const char* fragment_path, const char* defines);
+
+// Rebuild an existing program from its (changed) sources. shader is only touched if the new
+// program links: its id is swapped and the uniform table refreshed. On failure the log is
+// printed and the old program stays
+void shader_batch_reload(shader_batch_t* batch, shader_t* shader, const char* vertex_path,
+			 const char* fragment_path, const char* defines);
+
+// Finish any programs the driver has completed, true once every program in the batch is done
+bool shader_batch_poll(shader_batch_t* batch);
+
+// Block until every program is finished
+void shader_batch_finish(shader_batch_t* batch);
+
+void shader_batch_destroy(shader_batch_t* batch);
+
 // Activate the shader
 void shader_use(const shader_t* shader);
 
-// Uniform setters
+// Resolve a uniform handle, do this once up front rather than per draw
+shader_uniform_t shader_uniform(const shader_t* shader, const char* name);
+
+// Uniform setters taking pre-resolved handles, no lookups at all
+void shader_set_uniform_bool(const shader_t* shader, shader_uniform_t uniform, bool value);
+void shader_set_uniform_int(const shader_t* shader, shader_uniform_t uniform, int32_t value);
+void shader_set_uniform_float(const shader_t* shader, shader_uniform_t uniform, float value);
+
+// Uniform setters by name, a hash lookup in the uniform table per call
 void shader_set_bool(const shader_t* shader, const char* name, bool value);
 void shader_set_int(const shader_t* shader, const char* name, int32_t value);
 void shader_set_float(const shader_t* shader, const char* name, float value);
 
+// Re-read active uniforms after (re)linking, existing handles keep pointing at the same names
+void shader_refresh_uniforms(shader_t* shader);
+
+// Re-read inputs, samplers and blocks after (re)linking. Samplers that were all left on unit 0
+// are given units 0, 1, 2... in declaration order so they don't collide
+void shader_reflect(shader_t* shader);
+
+void shader_reflection_free(shader_reflection_t* reflection);
+
+// Index into reflection.samplers, -1 if the program has no such sampler. Resolve once, then
+// bind textures straight to reflection.samplers[i].unit
+int32_t shader_sampler_index(const shader_t* shader, const char* name);
+
+// Check every vertex input has an attribute at its location, in one of the bound layouts, with a
+// matching component count, printing each mismatch. Attributes the shader doesn't read are fine
+bool shader_validate_vertex_layout(const shader_t* shader, const vertex_layout_t* const* layouts, uint32_t count);
+
+// Check no texture unit is read as two different targets, which fails at draw time
+bool shader_validate_samplers(const shader_t* shader);
+
 // Delete shader program when no longer needed
 void shader_destroy(shader_t* shader);
 
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SHADER_CACHE_DIR "shader_cache/"   // relative to where the engine runs, ie the build dir
+#define SHADER_CACHE_MAGIC 0x43505347u     // "GSPC"
+#define SHADER_CACHE_VERSION 1
+
+// Cold vs warm startup numbers, filled in by shader_create
+typedef struct {
+  uint32_t hits;
+  uint32_t misses;
+  double hit_ms;             // total time creating programs from cached binaries
+  double miss_ms;            // total time compiling and linking from source
+} shader_cache_stats_t;
+
+// Key a program by its sources and defines plus the driver, so a driver update invalidates it
+uint64_t shader_cache_key(const char* const* sources, uint32_t count, const char* defines);
+
+// Try to create program from a cached binary, false (and the caller compiles) on any mismatch
+bool shader_cache_load(uint64_t key, GLuint program);
+
+// Store a successfully linked program, needs GL_PROGRAM_BINARY_RETRIEVABLE_HINT set before linking
+void shader_cache_store(uint64_t key, GLuint program);
+
+void shader_cache_record(bool hit, double ms);
+shader_cache_stats_t shader_cache_get_stats(void);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Nested #include depth before giving up, catches include cycles that slip past the once check
+#define SHADER_INCLUDE_DEPTH 16
+
+// Every file a preprocessed source was built from. Index n is GLSL source string n in #line
+// directives, so "0(12)" in a compile log is line 12 of paths[0]
+typedef struct {
+  uint32_t count;
+  uint32_t capacity;
+  char** paths;
+} shader_deps_t;
+
+// Read a whole text file into a NUL terminated heap string, NULL on failure
+char* read_file(const char* file_path);
+
+// Turn a define set ("NAME" or "NAME=VALUE") into sorted #define lines, so the same set
+// in any order gives the same text. Empty string for count 0, NULL on allocation failure
+char* shader_define_block(const char* const* defines, uint32_t count);
+
+// Read path, splice in #include "file" (relative to the including file, each file once)
+// and insert the define block right after #version, which may follow comments and blank lines.
+// deps may be NULL
+char* shader_preprocess(const char* path, const char* defines, shader_deps_t* deps);
+
+void shader_deps_free(shader_deps_t* deps);
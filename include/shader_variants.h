@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "shader.h"
+
+// Permutations of one vertex + fragment pair, each a set of #defines. A variant is only
+// compiled the first time it's asked for, then looked up by the hash of its define set
+typedef struct shader_variants shader_variants_t;
+
+shader_variants_t* shader_variants_create(const char* vertex_path, const char* fragment_path);
+
+// Get the program for a define set ("NAME" or "NAME=VALUE", any order). With a batch the
+// compile is queued and id stays 0 until the batch finishes it, without one this blocks.
+// The pointer stays valid until shader_variants_destroy
+const shader_t* shader_variant(shader_variants_t* variants, const char* const* defines, uint32_t count,
+			       shader_batch_t* batch);
+
+// Number of variants compiled so far
+uint32_t shader_variants_count(const shader_variants_t* variants);
+
+// Finish any batch still compiling a variant first
+void shader_variants_destroy(shader_variants_t* variants);
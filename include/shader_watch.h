@@ -0,0 +1,20 @@
+#pragma once
+
+#include "shader.h"
+
+#define SHADER_WATCH_MAX 64
+
+// Hot reload: recompile programs whose sources or includes change and swap them in if they link
+void shader_watch_init(void);
+
+// Rebuild shader whenever one of its files changes. The shader_t must stay at the same address
+// while watched. Does nothing before shader_watch_init
+void shader_watch_add(shader_t* shader, const char* vertex_path, const char* fragment_path, const char* defines);
+
+// Stop watching, finishing any reload of it that's in flight
+void shader_watch_remove(const shader_t* shader);
+
+// Pick up file changes and swap in finished programs, call once per frame on the GL thread
+void shader_watch_poll(void);
+
+void shader_watch_shutdown(void);
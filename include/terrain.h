@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glad/glad.h>
+#include <cglm/cglm.h>
+
+#include "render_queue.h"
+#include "thread_pool.h"
+#include "vertex_layout.h"
+
+#define TERRAIN_VERTEX_SHADER_PATH "../assets/shaders/terrain_vertex_shader.glsl"
+#define TERRAIN_FRAGMENT_SHADER_PATH "../assets/shaders/terrain_fragment_shader.glsl"
+
+#define TERRAIN_CHUNK_SIZE 64.0f       // world units along a chunk side
+#define TERRAIN_CHUNK_QUADS 64         // quads along a side at LOD 0, each LOD after halves it
+#define TERRAIN_LODS 4
+#define TERRAIN_LOD_RINGS 2            // rings of chunks around the camera per LOD
+#define TERRAIN_DEFAULT_VIEW_CHUNKS 6  // chunks kept loaded in each direction from the camera's
+
+// Heights are octaves of perlin2d, TERRAIN_ELEVATION up to TERRAIN_ELEVATION + TERRAIN_HEIGHT
+#define TERRAIN_NOISE_SCALE (1.0f / 256.0f)  // first octave's cycles per world unit
+#define TERRAIN_OCTAVES 5
+#define TERRAIN_HEIGHT 80.0f
+#define TERRAIN_ELEVATION -70.0f
+
+// Per frame limits that keep streaming from spiking the frame while the camera moves
+#define TERRAIN_UPLOADS_PER_FRAME 4
+#define TERRAIN_JOBS_PER_THREAD 2      // chunk generation jobs in flight per worker
+
+typedef struct {
+  uint32_t resident;           // chunks with a mesh on the GPU
+  uint32_t pending;            // being generated or waiting for an upload
+  uint32_t uploads;            // this frame
+  uint32_t drawn;              // this frame, after frustum culling
+  double generate_ms;          // worker time for the chunks uploaded this frame
+  double upload_ms;            // main thread time in terrain_update this frame
+} terrain_stats_t;
+
+// Chunks on a grid around the camera, generated on workers and streamed into fixed slots of one
+// vertex buffer. Each LOD has one index buffer range shared by every chunk, skirts around each
+// chunk hang down to cover cracks between LODs
+typedef struct terrain terrain_t;
+
+// One chunk position in the window around the camera
+typedef struct {
+  int32_t x, z;                // chunk coordinates, its corner is at x * TERRAIN_CHUNK_SIZE
+  int32_t lod;                 // of the mesh in slot, -1 = none
+  int32_t pending_lod;         // asked for and not uploaded yet, -1 = none
+  uint32_t slot;
+  float min_y, max_y;
+} terrain_cell_t;
+
+// Which chunk each cell of the window stands for and which vertex buffer slots hold their meshes
+typedef struct {
+  uint32_t view_chunks;
+  uint32_t size;               // cells along a side, 2 * view_chunks + 1
+  terrain_cell_t* cells;       // chunk (x, z) lives in cell [wrap(z) * size + wrap(x)]
+  int32_t (*order)[2];         // offsets from the center chunk, nearest first
+  bool centered;
+  int32_t center_x, center_z;
+  uint32_t slot_count;
+  uint32_t* free_slots;
+  uint32_t free_count;
+} terrain_window_t;
+
+// Vertices are chunk-local position and octahedral normal, the instance transform moves them into place
+extern const vertex_layout_t terrain_vertex_layout;
+
+// view_chunks 0 = TERRAIN_DEFAULT_VIEW_CHUNKS. NULL workers generates on the calling thread,
+// TERRAIN_UPLOADS_PER_FRAME at a time
+terrain_t* terrain_create(thread_pool_t* workers, uint32_t view_chunks);
+
+// Height of the ground at a world position, the same function chunks are built from
+float terrain_height(float x, float z);
+
+// Grid vertices then one skirt vertex per edge vertex, edges in turn counterclockwise from x = 0
+uint32_t terrain_lod_vertices(uint32_t lod);
+uint32_t terrain_lod_indices(uint32_t lod);
+
+// Mesh of chunk (x, z) into terrain_lod_vertices(lod) vertices of terrain_vertex_layout, y_range_out
+// gets the lowest and highest ground height. False if scratch memory ran out
+bool terrain_build_chunk(int32_t x, int32_t z, uint32_t lod, void* vertices, float y_range_out[2]);
+
+// Same topology for every chunk at a LOD, returns terrain_lod_indices(lod)
+uint32_t terrain_build_indices(uint32_t lod, uint16_t* out);
+
+// A row and a column of spare slots beyond one per cell, so new chunks and LOD changes have
+// somewhere to go before the chunk they replace is freed
+bool terrain_window_init(terrain_window_t* window, uint32_t view_chunks);
+terrain_cell_t* terrain_window_cell(terrain_window_t* window, int32_t x, int32_t z);
+
+// Chebyshev distance in chunks from the center chunk
+int32_t terrain_window_ring(const terrain_window_t* window, int32_t x, int32_t z);
+
+// LOD a chunk should have at its ring
+int32_t terrain_window_lod(const terrain_window_t* window, int32_t x, int32_t z);
+
+// Cells that now stand for a different chunk let go of the old one and its slot. False if the center
+// didn't move
+bool terrain_window_recenter(terrain_window_t* window, int32_t center_x, int32_t center_z);
+
+// Give a cell a free slot for its new mesh at lod and free the one its old LOD drew from, returns the
+// new slot. Needs free_count > 0
+uint32_t terrain_window_place(terrain_window_t* window, terrain_cell_t* cell, uint32_t lod);
+
+void terrain_window_free(terrain_window_t* window);
+
+// Point the VAO's per-instance attributes at buffer, ie render_queue_instance_buffer
+void terrain_bind_instances(terrain_t* terrain, GLuint buffer, const vertex_layout_t* layout);
+
+// Drop chunks that went out of range, ask for missing or wrong-LOD ones nearest first and upload
+// finished ones, at most TERRAIN_UPLOADS_PER_FRAME. Chunks keep drawing at their old LOD until the
+// new mesh is in
+void terrain_update(terrain_t* terrain, const vec3 camera_position);
+
+// Push every resident chunk inside the frustum, they batch into one multi-draw
+void terrain_draw(terrain_t* terrain, render_queue_t* queue, const shader_t* shader, mat4 view_projection);
+
+// Counters for the current frame
+terrain_stats_t terrain_get_stats(const terrain_t* terrain);
+
+// Waits for chunks still being generated
+void terrain_destroy(terrain_t* terrain);
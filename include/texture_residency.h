@@ -0,0 +1,56 @@
+#pragma once
+
+#include "image_loader.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESIDENCY_MAX_TEXTURES 256
+#define RESIDENCY_DEFAULT_BUDGET ((size_t)256 * 1024 * 1024)
+#define RESIDENCY_MIN_DROP_SIZE 64       // textures at or below this size get evicted instead of shrunk
+#define RESIDENCY_INVALID_HANDLE UINT32_MAX
+
+typedef uint32_t residency_handle_t;
+
+// Loads a texture from its source, lets textures come from somewhere other than loose BMPs (ie a pack file)
+typedef texture_t (*residency_load_fn)(const char* source, void* user);
+
+typedef struct {
+  size_t budget_bytes;
+  size_t resident_bytes;
+  uint32_t resident_textures;
+  uint32_t evictions;
+  uint32_t mip_drops;
+  uint32_t reloads;
+} residency_stats_t;
+
+// Start tracking textures against a GPU memory budget
+void residency_init(size_t budget_bytes);
+void residency_set_budget(size_t budget_bytes);
+
+// Register a texture source, nothing is loaded until the first acquire. load = NULL uses texture_load_bmp
+residency_handle_t residency_register(const char* source, residency_load_fn load, void* user);
+
+// Get the texture for this frame, reloading it at full resolution if it was evicted or shrunk.
+// NULL for an invalid handle, a texture with id 0 if its source failed to load
+const texture_t* residency_acquire(residency_handle_t handle);
+
+// Forget that the source failed to load so the next acquire tries it again, ie once its file changed
+void residency_retry(residency_handle_t handle);
+
+// Texture slot for systems that update it in place (ie hot reload), the address is stable.
+// NULL for an invalid handle
+texture_t* residency_texture(residency_handle_t handle);
+
+// Mark the start of a frame, textures not acquired this frame or last become eviction candidates
+void residency_begin_frame(void);
+
+residency_stats_t residency_get_stats(void);
+
+// Estimated GPU bytes for a mip level / whole texture, drivers pad RGB8 to 4 bytes per texel
+size_t texture_level_bytes(const texture_t* texture, uint32_t level);
+size_t texture_bytes(const texture_t* texture);
+
+// Free every texture and forget all registrations
+void residency_shutdown(void);
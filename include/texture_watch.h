@@ -0,0 +1,21 @@
+#pragma once
+
+#include "image_loader.h"
+#include "thread_pool.h"
+
+#define TEXTURE_WATCH_MAX 64
+
+// Hot reload: re-decode changed BMPs on the thread pool and upload them behind the same texture_t
+void texture_watch_init(thread_pool_t* pool);
+
+// Called on the GL thread when a watched file changes, before it's decoded again
+typedef void (*texture_watch_fn)(void* user);
+
+// Reload texture whenever path changes. The texture_t must stay at the same address while watched.
+// changed can be NULL, ie a residency entry uses it to retry a load that failed
+void texture_watch_add(texture_t* texture, const char* path, texture_watch_fn changed, void* user);
+
+// Pick up file changes and upload finished decodes, call once per frame on the GL thread
+void texture_watch_poll(void);
+
+void texture_watch_shutdown(void);
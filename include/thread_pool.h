@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define THREAD_POOL_MAX_THREADS 32
+#define THREAD_POOL_QUEUE_SIZE 4096
+
+typedef void (*job_fn)(void* arg);
+typedef void (*range_fn)(void* arg, uint32_t chunk, uint32_t begin, uint32_t end);
+
+// Fixed set of worker threads pulling jobs from a shared queue
+typedef struct thread_pool thread_pool_t;
+
+// Start thread_count workers, 0 = one per core leaving one for the main thread. NULL if no worker
+// could be started, every function here takes a NULL pool and does the work on the caller
+thread_pool_t* thread_pool_create(uint32_t thread_count);
+
+// Queue a job, returns false if the queue is full. A NULL pool runs it before returning
+bool thread_pool_submit(thread_pool_t* pool, job_fn fn, void* arg);
+
+// Block until every queued and running job has finished
+void thread_pool_wait(thread_pool_t* pool);
+
+uint32_t thread_pool_size(const thread_pool_t* pool);
+
+// Split [0, count) into chunks of chunk_size and run fn on each, the calling thread included.
+// Returns once every chunk is done without waiting on unrelated jobs. A NULL pool runs inline
+void thread_pool_parallel_for(thread_pool_t* pool, uint32_t count, uint32_t chunk_size, range_fn fn, void* arg);
+
+// Finish outstanding jobs and join the workers
+void thread_pool_destroy(thread_pool_t* pool);
+
+// Number of online CPU cores
+uint32_t thread_cpu_count(void);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <glad/glad.h>
+#include <cglm/cglm.h>
+
+// Binding points, matching layout(binding = N) in assets/shaders/include/uniforms.glsl
+#define UBO_BINDING_FRAME 0
+#define UBO_BINDING_MATERIAL 1
+
+#define UBO_MAX_LAYOUTS 16
+
+// One member of a GLSL block as the C mirror lays it out. Names are the GL resource names,
+// ie "Frame.view" for a block declared with an instance name
+typedef struct {
+  const char* name;
+  uint32_t offset;
+} ubo_member_t;
+
+#define UBO_MEMBER(type, member, glsl_name) { glsl_name, (uint32_t)offsetof(type, member) }
+
+// A C struct mirrored to a std140 uniform block or std430 storage block
+typedef struct {
+  const char* block;           // GLSL block name
+  GLenum interface;            // GL_UNIFORM_BLOCK (std140) or GL_SHADER_STORAGE_BLOCK (std430)
+  GLuint binding;
+  uint32_t size;               // sizeof the C struct
+  const ubo_member_t* members;
+  uint32_t member_count;
+} ubo_layout_t;
+
+// Per-frame data, written once per frame. vec4/mat4 keep C in step with std140 alignment,
+// vec3s would not be
+typedef struct {
+  mat4 view;
+  mat4 projection;
+  mat4 view_projection;
+  vec4 camera_position;        // w unused
+  vec4 time;                   // x = seconds, y = frame delta
+} frame_uniforms_t;
+
+// Per-material data, one slot per material in a shared buffer
+typedef struct {
+  vec4 base_color;
+  vec4 uv_transform;           // xy scale, zw offset
+  float roughness;
+  float metallic;
+  float pad[2];
+} material_uniforms_t;
+
+extern const ubo_layout_t frame_uniforms_layout;
+extern const ubo_layout_t material_uniforms_layout;
+
+// Make a layout known to ubo_layout_verify, the layout must outlive the program
+void ubo_layout_register(const ubo_layout_t* layout);
+
+// Compare every block in a linked program with its registered C mirror: binding, size and
+// member offsets. Prints each mismatch, false if any. Blocks with no registered mirror are skipped
+bool ubo_layout_verify(GLuint program);
+
+// A buffer of count blocks, each in its own slot aligned for glBindBufferRange
+typedef struct {
+  GLuint id;
+  GLenum target;               // GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+  GLuint binding;
+  uint32_t size;               // one block
+  uint32_t stride;             // size rounded up to the offset alignment
+  uint32_t count;
+} uniform_buffer_t;
+
+uniform_buffer_t uniform_buffer_create(const ubo_layout_t* layout, uint32_t count);
+
+// Overwrite one slot
+void uniform_buffer_update(const uniform_buffer_t* buffer, uint32_t index, const void* data);
+
+// Point the layout's binding at one slot, skipped if it's already there
+void uniform_buffer_bind(const uniform_buffer_t* buffer, uint32_t index);
+
+void uniform_buffer_destroy(uniform_buffer_t* buffer);
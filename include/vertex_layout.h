@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glad/glad.h>
+#include <cglm/cglm.h>
+
+#define VERTEX_MAX_ATTRIBUTES 16
+
+// One interleaved attribute, location matches layout(location = N) in the vertex shader
+typedef struct {
+  uint32_t location;
+  uint32_t components;
+  GLenum type;                 // GL_FLOAT, GL_UNSIGNED_BYTE, ...
+  GLboolean normalized;
+  uint32_t offset;
+} vertex_attribute_t;
+
+// How one vertex buffer is laid out, so VAO setup and shader validation read the same table
+typedef struct {
+  uint32_t stride;
+  uint32_t divisor;            // 0 = per vertex, 1 = per instance
+  uint32_t count;
+  vertex_attribute_t attributes[VERTEX_MAX_ATTRIBUTES];
+} vertex_layout_t;
+
+// Position, color and texture coordinates as floats, the format setup_vertex_data used to hard code
+extern const vertex_layout_t vertex_layout_pos_color_uv;
+
+// First location used by per-instance attributes, below it is per-vertex data
+#define VERTEX_INSTANCE_LOCATION 3
+
+// Per-instance data, read by shaders built with INSTANCED through vertex_layout_instance
+typedef struct {
+  mat4 transform;              // locations 3-6, one column each
+  vec4 color;                  // location 7, multiplies the vertex color
+  vec4 uv_rect;                // location 8, xy offset, zw scale into the texture
+} instance_data_t;
+
+extern const vertex_layout_t vertex_layout_instance;
+
+/* VERTEX FORMATS */
+
+// How float source data is stored in the vertex buffer
+typedef enum {
+  VERTEX_FLOAT,
+  VERTEX_HALF,                 // 16-bit float, positions in a mesh's own space and UVs
+  VERTEX_UNORM8,               // 0..1 in a byte, colors. Always 4 bytes (RGBA8) so the attribute stays
+				// 4 byte sized, up to 4 floats in and alpha is 1 when there are 3
+  VERTEX_SNORM16,              // -1..1 in a short
+  VERTEX_OCT16,                // unit vector folded onto an octahedron, 3 floats in, 2 snorm16 out.
+				// The shader reads a vec2 and calls oct_decode from octahedral.glsl
+} vertex_encoding_t;
+
+typedef struct {
+  uint32_t location;
+  uint32_t components;         // floats per vertex in the source data
+  vertex_encoding_t encoding;
+} vertex_element_t;
+
+// A vertex as a list of encoded attributes, source data has the elements' floats back to back
+typedef struct {
+  uint32_t count;
+  vertex_element_t elements[VERTEX_MAX_ATTRIBUTES];
+} vertex_format_t;
+
+// The float layout above, and the same attributes at half the size: half positions and UVs, RGBA8 color
+extern const vertex_format_t vertex_format_pos_color_uv;
+extern const vertex_format_t vertex_format_pos_color_uv_compact;
+
+// Pack a format's attributes in order, each starting on a 4 byte boundary
+vertex_layout_t vertex_layout_from_format(const vertex_format_t* format);
+
+// Floats per source vertex
+uint32_t vertex_format_source_components(const vertex_format_t* format);
+
+// Encode vertex_count vertices of float source data into dst, laid out as vertex_layout_from_format
+void vertex_format_convert(const vertex_format_t* format, const float* src, uint32_t vertex_count, void* dst);
+
+// Point the attributes at the bound GL_ARRAY_BUFFER and enable them with the layout's divisor,
+// on the bound VAO
+void vertex_layout_apply(const vertex_layout_t* layout);
+
+// Attribute at location, NULL if the layout doesn't provide it
+const vertex_attribute_t* vertex_layout_find(const vertex_layout_t* layout, uint32_t location);
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "shader.h"
+#include "thread_pool.h"
+
+#include <glad/glad.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define VT_PAGE_SIZE 128               // texels per page side, without border
+#define VT_PAGE_BORDER 4               // texels of neighbouring data around each page for filtering
+#define VT_DEFAULT_PHYS_PAGES 16       // physical cache is N x N pages
+#define VT_MAX_PENDING 256             // pages being generated at once
+#define VT_MAX_REQUESTS_PER_FRAME 64
+#define VT_MAX_UPLOADS_PER_FRAME 16
+#define VT_FEEDBACK_SCALE 8            // feedback pass renders at 1/N of the viewport
+#define VT_PAGE_NONE 0xFFFFFFFFu       // cleared feedback texel / empty slot
+#define VT_MAX_LEVELS 13               // mips of a 4096 page virtual texture
+
+#define VT_FEEDBACK_FRAGMENT_SHADER_PATH "../assets/shaders/vt_feedback_fragment_shader.glsl"
+#define VT_FRAGMENT_SHADER_PATH "../assets/shaders/vt_fragment_shader.glsl"
+
+// Page ids match what the feedback shader writes: mip in the top byte, then 12 bits each of y and x
+#define VT_PAGE_ID(x, y, mip) (((uint32_t)(mip) << 24) | ((uint32_t)(y) << 12) | (uint32_t)(x))
+#define VT_PAGE_X(id) ((id) & 0xFFFu)
+#define VT_PAGE_Y(id) (((id) >> 12) & 0xFFFu)
+#define VT_PAGE_MIP(id) ((id) >> 24)
+
+// Fill size x size RGBA8 texels of mip level `mip`, starting at texel (texel_x, texel_y) of that level.
+// Runs on worker threads. Coordinates may fall outside the texture by the border, wrap or clamp as suits
+typedef void (*vt_generate_fn)(void* user, uint32_t mip, int64_t texel_x, int64_t texel_y,
+			       uint32_t size, uint8_t* rgba);
+
+typedef struct {
+  uint32_t virtual_pages;      // pages per side at mip 0, power of two up to 4096
+  uint32_t phys_pages;         // physical cache pages per side, up to 256
+  vt_generate_fn generate;
+  void* user;
+} vt_desc_t;
+
+typedef struct {
+  uint32_t resident_pages;
+  uint32_t pending_pages;
+  uint32_t requests;           // new pages requested by the last feedback
+  uint32_t uploads;            // pages uploaded by the last update
+  uint32_t evictions;
+} vt_stats_t;
+
+typedef struct virtual_texture virtual_texture_t;
+
+// CPU copy of the page table, one RGBA8 entry per page of every mip: physical page x, y, the mip it
+// holds and 255. Pages that aren't resident hold the entry of their nearest resident ancestor
+typedef struct {
+  uint32_t virtual_pages;
+  uint32_t phys_pages;
+  uint32_t max_mip;
+  uint32_t* levels[VT_MAX_LEVELS];
+} vt_page_table_t;
+
+// Texels of each level touched by one map, x0 > x1 when none were
+typedef struct {
+  uint32_t x0, y0, x1, y1;
+} vt_dirty_t;
+
+typedef struct {
+  uint32_t page;               // page id held by this slot, VT_PAGE_NONE if free
+  uint64_t last_used;
+  bool pinned;
+} vt_slot_t;
+
+// Create the page table and physical cache and map the coarsest page so there's always a fallback
+virtual_texture_t* vt_create(const vt_desc_t* desc, thread_pool_t* pool);
+
+// Upload finished pages and update the page table, call once per frame on the GL thread
+void vt_update(virtual_texture_t* vt);
+
+// Render the VT geometry with the feedback shader between these to find out which pages are visible.
+// The readback is double buffered, pages requested by a frame are processed the frame after
+void vt_feedback_begin(virtual_texture_t* vt, uint32_t viewport_width, uint32_t viewport_height);
+void vt_feedback_end(virtual_texture_t* vt);
+
+// Request pages from a buffer of page ids (as written by the feedback shader), VT_PAGE_NONE is skipped.
+// Lets the feedback come from anywhere, ie a CPU side estimate or a test
+void vt_feedback_submit(virtual_texture_t* vt, const uint32_t* page_ids, size_t count);
+
+// Bind the page table and physical cache, make the VT shader current and set its vt_* uniforms
+void vt_bind(const virtual_texture_t* vt, const shader_t* shader,
+	     uint32_t page_table_unit, uint32_t physical_unit, bool feedback_pass);
+
+vt_stats_t vt_get_stats(const virtual_texture_t* vt);
+
+// Every entry starts with alpha 0, map the coarsest page before relying on fallbacks
+bool vt_page_table_init(vt_page_table_t* table, uint32_t virtual_pages, uint32_t phys_pages);
+
+// Point a page at a physical slot, or unmap it with VT_PAGE_NONE so it falls back to its parent.
+// Only texels whose fallback changed are rewritten, dirty_out[0..mip] gets their bounds per level
+void vt_page_table_map(vt_page_table_t* table, uint32_t page, uint32_t slot, vt_dirty_t* dirty_out);
+
+uint32_t vt_page_table_entry(const vt_page_table_t* table, uint32_t mip, uint32_t x, uint32_t y);
+void vt_page_table_free(vt_page_table_t* table);
+
+// Free slot if there is one, otherwise the least recently used unpinned page not seen last frame.
+// VT_PAGE_NONE when every slot is busy
+uint32_t vt_find_slot(const vt_slot_t* slots, uint32_t slot_count, uint64_t frame);
+
+// Procedural terrain colours from perlin2d, user = NULL
+void vt_generate_terrain(void* user, uint32_t mip, int64_t texel_x, int64_t texel_y,
+			 uint32_t size, uint8_t* rgba);
+
+void vt_destroy(virtual_texture_t* vt);
@@ -0,0 +1,194 @@
+#include "bmp_decode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BMP_FILE_HEADER_SIZE 14
+#define BMP_BI_RGB 0
+
+bmp_result_t bmp_parse_header(const uint8_t* data, size_t size, uint64_t file_size, bmp_layout_t* layout)
+{
+  memset(layout, 0, sizeof(*layout));
+
+  bmp_file_header_t bmp_header;
+  if (size < sizeof(bmp_header) + sizeof(uint32_t))
+    return BMP_ERROR_TRUNCATED;
+  memcpy(&bmp_header, data, sizeof(bmp_header));
+  if (bmp_header.signature != BMP_MAGIC)
+    return BMP_ERROR_SIGNATURE;
+
+  // Info header size tells the version, 40 = BITMAPINFOHEADER, later versions only add fields
+  uint32_t dib_size;
+  memcpy(&dib_size, data + BMP_FILE_HEADER_SIZE, sizeof(dib_size));
+  if (dib_size < sizeof(bmp_info_header_t) || dib_size > 124)
+    return BMP_ERROR_UNSUPPORTED;
+  if (size < BMP_FILE_HEADER_SIZE + (size_t)dib_size)
+    return BMP_ERROR_TRUNCATED;
+
+  bmp_info_header_t dib_header;
+  memcpy(&dib_header, data + BMP_FILE_HEADER_SIZE, sizeof(dib_header));
+
+  if (dib_header.planes != 1)
+    return BMP_ERROR_HEADER;
+  if (dib_header.compression != BMP_BI_RGB)
+    return BMP_ERROR_UNSUPPORTED;
+
+  uint16_t bpp = dib_header.bits_per_pixel;
+  if (bpp != 8 && bpp != 16 && bpp != 24 && bpp != 32)
+    return BMP_ERROR_UNSUPPORTED;
+
+  // Height is signed, negative means rows are stored top-down
+  int64_t width = dib_header.width;
+  int64_t height = dib_header.height;
+  bool top_down = height < 0;
+  if (top_down)
+    height = -height;
+  if (width <= 0 || height <= 0)
+    return BMP_ERROR_HEADER;
+  if (width > BMP_MAX_DIMENSION || height > BMP_MAX_DIMENSION || (uint64_t)(width * height) > BMP_MAX_PIXELS)
+    return BMP_ERROR_TOO_LARGE;
+
+  // Palette follows the info header
+  uint64_t header_end = BMP_FILE_HEADER_SIZE + (uint64_t)dib_size;
+  if (bpp == 8) {
+    uint32_t count = dib_header.colors_used ? dib_header.colors_used : BMP_MAX_PALETTE;
+    if (count > BMP_MAX_PALETTE)
+      return BMP_ERROR_HEADER;
+    if (size < header_end + (uint64_t)count * 4)
+      return BMP_ERROR_TRUNCATED;
+    memcpy(layout->palette, data + header_end, (size_t)count * 4);
+    layout->palette_count = count;
+    header_end += (uint64_t)count * 4;
+  }
+
+  // All sizes in 64 bits, everything here fits easily after the dimension limits above
+  uint64_t file_row_size = (((uint64_t)width * bpp + 31) / 32) * 4;
+  uint64_t data_size = file_row_size * (uint64_t)height;
+  if (bmp_header.data_offset < header_end || bmp_header.data_offset > file_size ||
+      data_size > file_size - bmp_header.data_offset)
+    return BMP_ERROR_TRUNCATED;
+
+  layout->width = (uint32_t)width;
+  layout->height = (uint32_t)height;
+  layout->bits_per_pixel = bpp;
+  layout->top_down = top_down;
+  layout->data_offset = bmp_header.data_offset;
+  layout->file_row_size = (size_t)file_row_size;
+  layout->row_size = ((size_t)width * 3 + 3) & ~(size_t)3; // Allign to 4-byte boundary
+
+  return BMP_OK;
+}
+
+void bmp_convert_rows(const bmp_layout_t* layout, const uint8_t* src, uint32_t rows,
+		      uint8_t* dst, ptrdiff_t dst_stride)
+{
+  uint32_t width = layout->width;
+
+  for (uint32_t row = 0; row < rows; row++, src += layout->file_row_size, dst += dst_stride) {
+    switch (layout->bits_per_pixel) {
+    case 24:  // Already BGR
+      memcpy(dst, src, (size_t)width * 3);
+      break;
+    case 32:  // BGRX, drop the unused byte
+      for (uint32_t x = 0; x < width; x++) {
+	dst[x * 3 + 0] = src[x * 4 + 0];
+	dst[x * 3 + 1] = src[x * 4 + 1];
+	dst[x * 3 + 2] = src[x * 4 + 2];
+      }
+      break;
+    case 16:  // X1R5G5B5, blue in the low bits, widen each 5 bit channel to 8
+      for (uint32_t x = 0; x < width; x++) {
+	uint16_t pixel = (uint16_t)(src[x * 2] | (src[x * 2 + 1] << 8));
+	uint8_t b = pixel & 0x1F, g = (pixel >> 5) & 0x1F, r = (pixel >> 10) & 0x1F;
+	dst[x * 3 + 0] = (uint8_t)((b << 3) | (b >> 2));
+	dst[x * 3 + 1] = (uint8_t)((g << 3) | (g >> 2));
+	dst[x * 3 + 2] = (uint8_t)((r << 3) | (r >> 2));
+      }
+      break;
+    case 8:   // Palette lookup, out of range indices read entry 0 instead of past the palette
+      for (uint32_t x = 0; x < width; x++) {
+	uint32_t index = src[x] < layout->palette_count ? src[x] : 0;
+	memcpy(dst + x * 3, layout->palette + index * 4, 3);
+      }
+      break;
+    }
+  }
+}
+
+bmp_result_t bmp_decode_memory(const uint8_t* data, size_t size, bmp_image_t* image)
+{
+  memset(image, 0, sizeof(*image));
+
+  bmp_layout_t layout;
+  bmp_result_t result = bmp_parse_header(data, size, size, &layout);
+  if (result != BMP_OK)
+    return result;
+
+  unsigned char* pixels = malloc(layout.row_size * layout.height);
+  if (!pixels)
+    return BMP_ERROR_MEMORY;
+
+  // Bottom-up files are flipped on the way through so the output is always top-down
+  uint8_t* dst = layout.top_down ? pixels : pixels + (layout.height - 1) * layout.row_size;
+  ptrdiff_t stride = layout.top_down ? (ptrdiff_t)layout.row_size : -(ptrdiff_t)layout.row_size;
+  bmp_convert_rows(&layout, data + layout.data_offset, layout.height, dst, stride);
+
+  image->width = layout.width;
+  image->height = layout.height;
+  image->row_size = layout.row_size;
+  image->pixels = pixels;
+  return BMP_OK;
+}
+
+bmp_result_t bmp_decode_file(const char* filename, bmp_image_t* image)
+{
+  memset(image, 0, sizeof(*image));
+
+  FILE* file = fopen(filename, "rb");
+  if (!file)
+    return BMP_ERROR_IO;
+
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  rewind(file);
+  if (length < 0) {
+    fclose(file);
+    return BMP_ERROR_IO;
+  }
+
+  uint8_t* data = malloc(length > 0 ? (size_t)length : 1);
+  if (!data) {
+    fclose(file);
+    return BMP_ERROR_MEMORY;
+  }
+
+  size_t read = fread(data, 1, (size_t)length, file);
+  fclose(file);
+
+  // A short read just decodes as a truncated file
+  bmp_result_t result = bmp_decode_memory(data, read, image);
+  free(data);
+  return result;
+}
+
+void bmp_image_free(bmp_image_t* image)
+{
+  free(image->pixels);
+  image->pixels = NULL;
+}
+
+const char* bmp_result_string(bmp_result_t result)
+{
+  switch (result) {
+  case BMP_OK:                return "ok";
+  case BMP_ERROR_IO:          return "could not read file";
+  case BMP_ERROR_TRUNCATED:   return "truncated or out of range data";
+  case BMP_ERROR_SIGNATURE:   return "not a BMP file";
+  case BMP_ERROR_HEADER:      return "inconsistent header";
+  case BMP_ERROR_UNSUPPORTED: return "only uncompressed 8, 16, 24 and 32-bit BMPs are supported";
+  case BMP_ERROR_TOO_LARGE:   return "image too large";
+  case BMP_ERROR_MEMORY:      return "out of memory";
+  }
+  return "unknown error";
+}
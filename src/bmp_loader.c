@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -6,12 +7,18 @@
 #include <string.h>
 
 #include "image_loader.h"
-
-#define BMP_MAGIC 0x4D42
+#include "gl_state.h"
 
 // Load a bitmap texture file as an OpenGL texture
-texture_t texture_load_bmp(const char* filename) {
-  texture_t texture;
+texture_t texture_load_bmp(const char* filename)
+{
+  return texture_load_bmp_streamed(filename, BMP_STRIP_BUDGET);
+}
+
+// Load a bitmap texture strip by strip so only strip_budget bytes are held in RAM at once
+texture_t texture_load_bmp_streamed(const char* filename, size_t strip_budget)
+{
+  texture_t texture = { 0 };
   
   FILE* file = fopen(filename, "rb");
   if (!file) {
@@ -19,121 +26,151 @@ texture_t texture_load_bmp(const char* filename) {
     return texture;
   }
 
-  bmp_file_header_t bmp_header;
-  fread(&bmp_header, sizeof(bmp_header), 1, file);
-  if (bmp_header.signature != BMP_MAGIC) {
-    fprintf(stderr, "Not a BMP file.\n");
+  fseek(file, 0, SEEK_END);
+  long file_size = ftell(file);
+  rewind(file);
+
+  // Headers and palette come from the start of the file, nothing in them is trusted
+  uint8_t header[BMP_HEADER_MAX];
+  size_t header_size = fread(header, 1, sizeof(header), file);
+  bmp_layout_t layout;
+  bmp_result_t result = file_size < 0 ? BMP_ERROR_IO : bmp_parse_header(header, header_size, file_size, &layout);
+  if (result != BMP_OK) {
+    fprintf(stderr, "Failed to load BMP %s: %s.\n", filename, bmp_result_string(result));
     fclose(file);
     return texture;
   }
 
-  bmp_info_header_t dib_header;
-  fread(&dib_header, sizeof(dib_header), 1, file);
-
-  if (dib_header.bits_per_pixel != 24 || dib_header.compression != 0) {
-    fprintf(stderr, "Only 24-bit uncompressed BMP's are currently supported.\n");
+  uint32_t width = layout.width;
+  uint32_t height = layout.height;
+
+  // Each strip row is held twice, as read from the file and converted to BGR
+  size_t strip_rows = strip_budget / (layout.file_row_size + layout.row_size);
+  if (strip_rows == 0)
+    strip_rows = 1;
+  if (strip_rows > height)
+    strip_rows = height;
+
+  uint8_t* raw = malloc(strip_rows * layout.file_row_size);
+  uint8_t* strip = malloc(strip_rows * layout.row_size);
+  if (!raw || !strip) {
+    free(raw);
+    free(strip);
     fclose(file);
     return texture;
   }
 
-  uint32_t width = dib_header.width;
-  uint32_t height = dib_header.height;
-  size_t row_size = (width * 3 + 3) & ~3; // Allign to 4-byte boundary
-  // width * 3    --> 3 bytes per pixel (24-bit BMP = RGB)
-  // + 3          --> ensures round UP to next multiple of 4
-  // & ~3         --> bitmask clear lowest 2 bits (rounding down to multiple of 4)
-  // ie width = 5 --> 5 x 3 = 15 --> 15 + 3 = 18 --> 17 & ~3 = 16
-  // ie width = 3 --> 3 x 3 = 9  --> 9 + 3  = 12 --> 12 & ~3 = 12
-  size_t data_size = row_size * height;
-
-  unsigned char* data = malloc(data_size);
-  if (!data) {
+  fseek(file, layout.data_offset, SEEK_SET);
+
+  glGenTextures(1, &texture.id);
+  if (texture.id == 0) {
+    fprintf(stderr, "Failed to create texture.\n");
+    free(raw);
+    free(strip);
     fclose(file);
     return texture;
   }
 
-  fseek(file, bmp_header.data_offset, SEEK_SET);
-  fread(data, 1, data_size, file);
-  fclose(file);
+  // Wrapping/filtering lives in a shared sampler object rather than on the texture
+  sampler_desc_t sampler = SAMPLER_DESC_DEFAULT;
+  texture_set_sampler(&texture, &sampler);
 
-  // Flips rows (BMP stores them bottom-up)
-  unsigned char* flipped = malloc(width * height * 3);
-  if (!flipped) {
-    free(data);
-    return texture;
-  }
-  
-  for (uint32_t y = 0; y < height; y++) {
-    for (uint32_t x = 0; x < width; x++) {
-	size_t src_index = y * row_size + x * 3;
-	size_t dst_index = (height - 1 - y) * width * 3 + x * 3;
-
-	flipped[dst_index + 0] = data[src_index + 2]; // R
-	flipped[dst_index + 1] = data[src_index + 1]; // G
-	flipped[dst_index + 2] = data[src_index + 0]; // B
+  texture.width = width;
+  texture.height = height;
+  texture.levels = texture_mip_levels(width, height);
+  texture.format = GL_RGB8;
+
+  // Immutable storage for the whole mip chain, the strips are filled in below
+  gl_state_edit_texture(GL_TEXTURE_2D, texture.id);
+  glTexStorage2D(GL_TEXTURE_2D, texture.levels, texture.format, width, height);
+
+  // Decoded rows are padded to 4 bytes, which is also GL's default unpack alignment,
+  // and GL_BGR lets the driver swizzle
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  // Bottom-up files have file row y land on texture row (height - 1 - y), so those strips are
+  // flipped while converting and uploaded from the far end
+  for (uint32_t y = 0; y < height; y += strip_rows) {
+    size_t rows = height - y < strip_rows ? height - y : strip_rows;
+
+    if (fread(raw, layout.file_row_size, rows, file) != rows) {
+      fprintf(stderr, "Truncated BMP pixel data in %s.\n", filename);
+      texture_destroy_bmp(&texture);
+      break;
+    }
+
+    if (layout.top_down) {
+      bmp_convert_rows(&layout, raw, rows, strip, layout.row_size);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, rows, GL_BGR, GL_UNSIGNED_BYTE, strip);
+    } else {
+      bmp_convert_rows(&layout, raw, rows, strip + (rows - 1) * layout.row_size, -(ptrdiff_t)layout.row_size);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, height - y - rows, width, rows, GL_BGR, GL_UNSIGNED_BYTE, strip);
     }
   }
 
-  free(data);
+  if (texture.id != 0)
+    glGenerateMipmap(GL_TEXTURE_2D);
 
-  glGenTextures(1, &texture.id);
-  glBindTexture(GL_TEXTURE_2D, texture.id);
-  // set the texture wrapping/filtering options (on currently bound texture)
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, flipped);
-  glGenerateMipmap(GL_TEXTURE_2D);
- 
+  free(raw);
+  free(strip);
+  fclose(file);
 
-  free(flipped);
+  return texture;
 
-  if (texture.id == 0) {
-    fprintf(stderr, "Failed to create texture.\n");
-    return texture;
+}
+
+void texture_replace_bmp(texture_t* texture, const bmp_image_t* image)
+{
+  // Immutable storage can't be resized, so only a change of size needs a new texture name
+  if (texture->width != image->width || texture->height != image->height ||
+      texture->levels != texture_mip_levels(image->width, image->height)) {
+    GLuint old = texture->id;
+    glGenTextures(1, &texture->id);
+    texture->width = image->width;
+    texture->height = image->height;
+    texture->levels = texture_mip_levels(image->width, image->height);
+    texture->format = GL_RGB8;
+    gl_state_edit_texture(GL_TEXTURE_2D, texture->id);
+    glTexStorage2D(GL_TEXTURE_2D, texture->levels, texture->format, texture->width, texture->height);
+    gl_state_forget_texture(old);
+    glDeleteTextures(1, &old);
+  } else {
+    gl_state_edit_texture(GL_TEXTURE_2D, texture->id);
   }
 
-  return texture;
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image->width, image->height, GL_BGR, GL_UNSIGNED_BYTE, image->pixels);
+  glGenerateMipmap(GL_TEXTURE_2D);
+}
 
+uint32_t texture_mip_levels(uint32_t width, uint32_t height)
+{
+  uint32_t size = width > height ? width : height;
+  uint32_t levels = 1;
+  while (size > 1) {
+    size >>= 1;
+    levels++;
+  }
+  return levels;
+}
+
+void texture_set_sampler(texture_t* texture, const sampler_desc_t* desc)
+{
+  texture->sampler = sampler_get(desc);
+}
+
+// Textures sharing a sampler, or already on the unit, cost a compare rather than a bind
+void texture_bind(const texture_t* texture, uint32_t unit)
+{
+  gl_state_bind_texture(unit, GL_TEXTURE_2D, texture->id);
+  gl_state_bind_sampler(unit, texture->sampler);
 }
 
 void texture_destroy_bmp(texture_t* texture)
 {
   if (texture && texture->id != 0) {
+    gl_state_forget_texture(texture->id);
     glDeleteTextures(1, &texture->id);
     texture->id = 0;
   }
 }
-
-
-// Ignore for now, eventually will add functionality for more BMP types
-static uint8_t bpp_switch(uint8_t bpp) {
-  switch (bpp) {
-  case 1:  // Monochrome
-    printf("Case 1\n");
-    return 1;
-  case 4:  // maximum 16 colors
-    printf("Case 4\n");
-    break;
-  case 8:  // maximum 256 colors
-    printf("Case 8\n");
-    return 8;
-  case 16: // maximum 2^16 colors
-    // Check compression field
-    // each word represents single pixel
-    // 5 bits per color component, blue is least significant 5 bits, followed by green then red. most significant bit unused
-    printf("Case 16\n");
-    return 16;
-  case 24:  // maximum 2^24 colors
-    // Palette field no entries
-    // each 3 byte triplet in bmp array repr. relative intensities of blue green read per pixel
-    printf("Case 24\n");
-    return 24;
-  default:  // catch-all
-    printf("Default\n");
-    return 0;
-  }
-}
-  
@@ -0,0 +1,635 @@
+#include "bvh.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLFW/glfw3.h>
+
+// Ranges at most this fraction of the whole are handed to workers as one subtree
+#define BVH_TASKS_PER_THREAD 4
+
+// Interior nodes have count 0 and their children at first and first + 1,
+// leaves cover indices[first, first + count)
+typedef struct {
+  float min[3];
+  uint32_t first;
+  float max[3];
+  uint32_t count;
+} bvh_node_t;
+
+struct bvh {
+  bvh_node_t* nodes;
+  uint32_t node_count;
+  uint32_t* parents;           // node -> parent, UINT32_MAX for the root
+  aabb_t* bounds;              // leaf order so a leaf's boxes are next to each other
+  uint32_t* indices;           // leaf order -> primitive
+  uint32_t* slot_of;           // primitive -> leaf order
+  uint32_t* leaf_of;           // primitive -> leaf node
+  uint32_t count;
+  uint32_t* dirty;             // leaves touched since the last refit
+  uint32_t dirty_count;
+  bool* leaf_dirty;            // per node
+  bvh_stats_t stats;
+};
+
+/* BUILD */
+
+// Primitives are partitioned as these rather than as indices so every pass over a range
+// reads memory in order
+typedef struct {
+  float min[3];
+  uint32_t primitive;
+  float max[3];
+  uint32_t pad;
+} build_ref_t;
+
+// Nodes of one subtree as they're built, the top of the tree and each parallel task get their own
+typedef struct {
+  bvh_node_t* nodes;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t depth;
+  bool failed;
+} node_list_t;
+
+// A range below the top of the tree, built separately and spliced in at node
+typedef struct {
+  uint32_t node;
+  uint32_t begin;
+  uint32_t end;
+  uint32_t depth;
+  node_list_t list;
+} build_task_t;
+
+typedef struct {
+  build_ref_t* refs;
+  uint32_t task_threshold;     // 0 = no tasks, build everything here
+  build_task_t* tasks;
+  uint32_t task_count;
+  uint32_t task_capacity;
+} builder_t;
+
+typedef struct {
+  float min[3];
+  float max[3];
+} box_t;
+
+// Compare and select rather than fminf/fmaxf, which are library calls when NaNs have to be handled.
+// A NaN in b leaves a
+static inline float min_f(float a, float b) { return b < a ? b : a; }
+static inline float max_f(float a, float b) { return b > a ? b : a; }
+
+static void box_empty(box_t* box)
+{
+  for (uint32_t i = 0; i < 3; i++) {
+    box->min[i] = FLT_MAX;
+    box->max[i] = -FLT_MAX;
+  }
+}
+
+static void box_grow(box_t* box, const float* min, const float* max)
+{
+  for (uint32_t i = 0; i < 3; i++) {
+    box->min[i] = min_f(box->min[i], min[i]);
+    box->max[i] = max_f(box->max[i], max[i]);
+  }
+}
+
+static float box_area(const box_t* box)
+{
+  float x = box->max[0] - box->min[0];
+  float y = box->max[1] - box->min[1];
+  float z = box->max[2] - box->min[2];
+  if (x < 0.0f || y < 0.0f || z < 0.0f)
+    return 0.0f;
+  return 2.0f * (x * y + y * z + z * x);
+}
+
+static uint32_t node_alloc(node_list_t* list, uint32_t count)
+{
+  if (list->count + count > list->capacity) {
+    uint32_t capacity = list->capacity ? list->capacity * 2 : 1024;
+    while (capacity < list->count + count)
+      capacity *= 2;
+    bvh_node_t* nodes = realloc(list->nodes, capacity * sizeof(bvh_node_t));
+    if (!nodes) {
+      list->failed = true;
+      return UINT32_MAX;
+    }
+    list->nodes = nodes;
+    list->capacity = capacity;
+  }
+  uint32_t first = list->count;
+  list->count += count;
+  return first;
+}
+
+static void make_leaf(node_list_t* list, uint32_t node, uint32_t begin, uint32_t end)
+{
+  list->nodes[node].first = begin;
+  list->nodes[node].count = end - begin;
+}
+
+// Centroids are kept doubled (min + max) throughout, only their ordering matters
+static uint32_t bin_of(const build_ref_t* ref, uint32_t axis, const box_t* centroid_box, float scale)
+{
+  uint32_t b = (uint32_t)((ref->min[axis] + ref->max[axis] - centroid_box->min[axis]) * scale);
+  return b < BVH_BINS ? b : BVH_BINS - 1;
+}
+
+// Binned SAH split of [begin, end), returns the partition point or begin if it should be a leaf
+static uint32_t split(builder_t* builder, uint32_t begin, uint32_t end, const box_t* box,
+		      const box_t* centroid_box)
+{
+  uint32_t count = end - begin;
+  box_t bins[3][BVH_BINS];
+  uint32_t counts[3][BVH_BINS] = { { 0 } };
+  float scale[3];
+  for (uint32_t axis = 0; axis < 3; axis++) {
+    float extent = centroid_box->max[axis] - centroid_box->min[axis];
+    scale[axis] = extent > 0.0f ? BVH_BINS / extent : 0.0f;
+    for (uint32_t b = 0; b < BVH_BINS; b++)
+      box_empty(&bins[axis][b]);
+  }
+
+  // All three axes in one pass over the range
+  for (uint32_t i = begin; i < end; i++) {
+    const build_ref_t* ref = &builder->refs[i];
+    for (uint32_t axis = 0; axis < 3; axis++) {
+      uint32_t b = bin_of(ref, axis, centroid_box, scale[axis]);
+      counts[axis][b]++;
+      box_grow(&bins[axis][b], ref->min, ref->max);
+    }
+  }
+
+  float best_cost = FLT_MAX;
+  uint32_t best_axis = 0;
+  uint32_t best_bin = 0;
+  for (uint32_t axis = 0; axis < 3; axis++) {
+    if (scale[axis] == 0.0f)
+      continue;
+
+    // Sweep from the right for the right side areas, then from the left evaluating each plane
+    float right_area[BVH_BINS];
+    uint32_t right_count[BVH_BINS];
+    box_t sweep;
+    box_empty(&sweep);
+    uint32_t sum = 0;
+    for (uint32_t b = BVH_BINS - 1; b > 0; b--) {
+      box_grow(&sweep, bins[axis][b].min, bins[axis][b].max);
+      sum += counts[axis][b];
+      right_area[b] = box_area(&sweep);
+      right_count[b] = sum;
+    }
+
+    box_empty(&sweep);
+    sum = 0;
+    for (uint32_t b = 0; b < BVH_BINS - 1; b++) {
+      box_grow(&sweep, bins[axis][b].min, bins[axis][b].max);
+      sum += counts[axis][b];
+      if (sum == 0 || right_count[b + 1] == 0)
+	continue;
+      float cost = box_area(&sweep) * sum + right_area[b + 1] * right_count[b + 1];
+      if (cost < best_cost) {
+	best_cost = cost;
+	best_axis = axis;
+	best_bin = b;
+      }
+    }
+  }
+
+  // Every centroid in one spot, halve the range so the leaf size limit still holds
+  if (best_cost == FLT_MAX)
+    return count > BVH_MAX_LEAF_SIZE ? begin + count / 2 : begin;
+
+  // Costs are relative to the parent's area: a split pays if it beats testing everything
+  if (best_cost >= box_area(box) * count && count <= BVH_MAX_LEAF_SIZE)
+    return begin;
+
+  uint32_t left = begin;
+  uint32_t right = end;
+  while (left < right) {
+    if (bin_of(&builder->refs[left], best_axis, centroid_box, scale[best_axis]) <= best_bin) {
+      left++;
+    } else {
+      build_ref_t swap = builder->refs[left];
+      builder->refs[left] = builder->refs[--right];
+      builder->refs[right] = swap;
+    }
+  }
+  return left;
+}
+
+static void build_node(builder_t* builder, node_list_t* list, uint32_t node, uint32_t begin, uint32_t end,
+		       uint32_t depth)
+{
+  box_t box, centroid_box;
+  box_empty(&box);
+  box_empty(&centroid_box);
+  for (uint32_t i = begin; i < end; i++) {
+    const build_ref_t* ref = &builder->refs[i];
+    box_grow(&box, ref->min, ref->max);
+    float centroid[3] = { ref->min[0] + ref->max[0], ref->min[1] + ref->max[1], ref->min[2] + ref->max[2] };
+    box_grow(&centroid_box, centroid, centroid);
+  }
+  memcpy(list->nodes[node].min, box.min, sizeof(box.min));
+  memcpy(list->nodes[node].max, box.max, sizeof(box.max));
+  if (depth > list->depth)
+    list->depth = depth;
+
+  if (end - begin <= BVH_LEAF_SIZE || depth + 1 >= BVH_MAX_DEPTH) {
+    make_leaf(list, node, begin, end);
+    return;
+  }
+
+  // Small enough to be a worker's whole job, finished after the top of the tree is done
+  if (builder->task_threshold && end - begin <= builder->task_threshold) {
+    if (builder->task_count == builder->task_capacity) {
+      uint32_t capacity = builder->task_capacity ? builder->task_capacity * 2 : 64;
+      build_task_t* tasks = realloc(builder->tasks, capacity * sizeof(build_task_t));
+      if (!tasks) {
+	list->failed = true;
+	return;
+      }
+      builder->tasks = tasks;
+      builder->task_capacity = capacity;
+    }
+    build_task_t* task = &builder->tasks[builder->task_count++];
+    memset(task, 0, sizeof(*task));
+    task->node = node;
+    task->begin = begin;
+    task->end = end;
+    task->depth = depth;
+    return;
+  }
+
+  uint32_t middle = split(builder, begin, end, &box, &centroid_box);
+  if (middle == begin) {
+    make_leaf(list, node, begin, end);
+    return;
+  }
+
+  uint32_t children = node_alloc(list, 2);
+  if (children == UINT32_MAX)
+    return;
+  list->nodes[node].first = children;
+  list->nodes[node].count = 0;
+  build_node(builder, list, children, begin, middle, depth + 1);
+  build_node(builder, list, children + 1, middle, end, depth + 1);
+}
+
+static void build_task(void* arg, uint32_t chunk, uint32_t begin, uint32_t end)
+{
+  builder_t* builder = arg;
+  (void)chunk;
+  for (uint32_t t = begin; t < end; t++) {
+    build_task_t* task = &builder->tasks[t];
+    task->list.depth = task->depth;
+    if (node_alloc(&task->list, 1) == UINT32_MAX)
+      continue;
+
+    // Workers never split off tasks of their own
+    builder_t local = *builder;
+    local.task_threshold = 0;
+    build_node(&local, &task->list, 0, task->begin, task->end, task->depth);
+  }
+}
+
+// Copy a task's nodes onto the end of the tree, its root goes in the placeholder at task->node
+static bool splice(node_list_t* tree, const build_task_t* task)
+{
+  if (task->list.failed || task->list.count == 0)
+    return false;
+
+  uint32_t offset = tree->count - 1;  // local node 1 lands at tree->count
+  if (task->list.count > 1 && node_alloc(tree, task->list.count - 1) == UINT32_MAX)
+    return false;
+
+  for (uint32_t i = 0; i < task->list.count; i++) {
+    bvh_node_t node = task->list.nodes[i];
+    if (node.count == 0)
+      node.first += offset;
+    tree->nodes[i == 0 ? task->node : offset + i] = node;
+  }
+  if (task->list.depth > tree->depth)
+    tree->depth = task->list.depth;
+  return true;
+}
+
+static void link_nodes(bvh_t* bvh)
+{
+  bvh->parents[0] = UINT32_MAX;
+  bvh->stats.leaf_count = 0;
+  for (uint32_t n = 0; n < bvh->node_count; n++) {
+    const bvh_node_t* node = &bvh->nodes[n];
+    if (node->count == 0) {
+      bvh->parents[node->first] = n;
+      bvh->parents[node->first + 1] = n;
+      continue;
+    }
+    bvh->stats.leaf_count++;
+    for (uint32_t i = node->first; i < node->first + node->count; i++)
+      bvh->leaf_of[bvh->indices[i]] = n;
+  }
+}
+
+bvh_t* bvh_build(const aabb_t* bounds, uint32_t count, thread_pool_t* workers)
+{
+  double start = glfwGetTime();
+
+  bvh_t* bvh = calloc(1, sizeof(bvh_t));
+  builder_t builder = { 0 };
+  node_list_t tree = { 0 };
+  if (!bvh || count == 0)
+    goto fail;
+
+  bvh->count = count;
+  bvh->bounds = malloc(count * sizeof(aabb_t));
+  bvh->indices = malloc(count * sizeof(uint32_t));
+  bvh->slot_of = malloc(count * sizeof(uint32_t));
+  bvh->leaf_of = malloc(count * sizeof(uint32_t));
+  bvh->dirty = malloc(count * sizeof(uint32_t));
+  builder.refs = malloc(count * sizeof(build_ref_t));
+  if (!bvh->bounds || !bvh->indices || !bvh->slot_of || !bvh->leaf_of || !bvh->dirty || !builder.refs)
+    goto fail;
+
+  for (uint32_t i = 0; i < count; i++) {
+    memcpy(builder.refs[i].min, bounds[i].min, sizeof(vec3));
+    memcpy(builder.refs[i].max, bounds[i].max, sizeof(vec3));
+    builder.refs[i].primitive = i;
+  }
+
+  if (workers) {
+    uint32_t tasks = (thread_pool_size(workers) + 1) * BVH_TASKS_PER_THREAD;
+    builder.task_threshold = count / tasks > BVH_MAX_LEAF_SIZE ? count / tasks : 0;
+  }
+
+  // Top of the tree here, then the subtrees it left as tasks, then stitch them together
+  node_alloc(&tree, 1);
+  if (!tree.failed)
+    build_node(&builder, &tree, 0, 0, count, 0);
+  thread_pool_parallel_for(workers, builder.task_count, 1, build_task, &builder);
+  for (uint32_t t = 0; t < builder.task_count && !tree.failed; t++)
+    tree.failed = !splice(&tree, &builder.tasks[t]);
+  if (tree.failed)
+    goto fail;
+
+  bvh->nodes = tree.nodes;
+  bvh->node_count = tree.count;
+  tree.nodes = NULL;
+  bvh->parents = malloc(bvh->node_count * sizeof(uint32_t));
+  bvh->leaf_dirty = calloc(bvh->node_count, sizeof(bool));
+  if (!bvh->parents || !bvh->leaf_dirty)
+    goto fail;
+
+  for (uint32_t i = 0; i < count; i++) {
+    const build_ref_t* ref = &builder.refs[i];
+    memcpy(bvh->bounds[i].min, ref->min, sizeof(vec3));
+    memcpy(bvh->bounds[i].max, ref->max, sizeof(vec3));
+    bvh->indices[i] = ref->primitive;
+    bvh->slot_of[ref->primitive] = i;
+  }
+  link_nodes(bvh);
+
+  for (uint32_t t = 0; t < builder.task_count; t++)
+    free(builder.tasks[t].list.nodes);
+  free(builder.tasks);
+  free(builder.refs);
+
+  bvh->stats.node_count = bvh->node_count;
+  bvh->stats.depth = tree.depth + 1;
+  bvh->stats.build_ms = (glfwGetTime() - start) * 1000.0;
+  return bvh;
+
+fail:
+  fprintf(stderr, "Failed to build BVH over %u primitives\n", count);
+  for (uint32_t t = 0; t < builder.task_count; t++)
+    free(builder.tasks[t].list.nodes);
+  free(builder.tasks);
+  free(builder.refs);
+  free(tree.nodes);
+  bvh_destroy(bvh);
+  return NULL;
+}
+
+/* QUERIES */
+
+// Everything under node, already known to be inside
+static uint32_t append_subtree(const bvh_t* bvh, uint32_t node, uint32_t* out)
+{
+  uint32_t stack[BVH_MAX_DEPTH];
+  uint32_t top = 0;
+  uint32_t count = 0;
+  stack[top++] = node;
+  while (top > 0) {
+    const bvh_node_t* current = &bvh->nodes[stack[--top]];
+    if (current->count > 0) {
+      memcpy(out + count, bvh->indices + current->first, current->count * sizeof(uint32_t));
+      count += current->count;
+    } else {
+      stack[top++] = current->first;
+      stack[top++] = current->first + 1;
+    }
+  }
+  return count;
+}
+
+// Tests a box against the planes still set in mask, clearing those it's fully inside of.
+// True if it's fully outside any of them
+static bool box_outside(const float* min, const float* max, const vec4* planes, uint8_t* mask)
+{
+  for (uint32_t p = 0; p < 6; p++) {
+    if (!(*mask & (1u << p)))
+      continue;
+    float distance = planes[p][3];
+    float reach = 0.0f;
+    for (uint32_t c = 0; c < 3; c++) {
+      distance += planes[p][c] * 0.5f * (min[c] + max[c]);
+      reach += fabsf(planes[p][c]) * 0.5f * (max[c] - min[c]);
+    }
+    if (distance + reach < 0.0f)
+      return true;
+    if (distance - reach >= 0.0f)
+      *mask &= ~(1u << p);
+  }
+  return false;
+}
+
+uint32_t bvh_cull_frustum(const bvh_t* bvh, mat4 view_projection, uint32_t* visible_out)
+{
+  vec4 planes[6];
+  glm_frustum_planes(view_projection, planes);
+
+  // Each entry carries the planes its parent wasn't already fully inside of
+  uint32_t stack[BVH_MAX_DEPTH];
+  uint8_t masks[BVH_MAX_DEPTH];
+  uint32_t top = 0;
+  uint32_t count = 0;
+  stack[top] = 0;
+  masks[top++] = 0x3F;
+
+  while (top > 0) {
+    top--;
+    const bvh_node_t* node = &bvh->nodes[stack[top]];
+    uint8_t mask = masks[top];
+    if (box_outside(node->min, node->max, planes, &mask))
+      continue;
+
+    if (mask == 0) {
+      count += append_subtree(bvh, stack[top], visible_out + count);
+    } else if (node->count > 0) {
+      for (uint32_t i = node->first; i < node->first + node->count; i++) {
+	const aabb_t* box = &bvh->bounds[i];
+	uint8_t primitive_mask = mask;
+	if (!box_outside(box->min, box->max, planes, &primitive_mask))
+	  visible_out[count++] = bvh->indices[i];
+      }
+    } else {
+      stack[top] = node->first;
+      masks[top++] = mask;
+      stack[top] = node->first + 1;
+      masks[top++] = mask;
+    }
+  }
+  return count;
+}
+
+// Entry distance of the ray into a box if it's before max_t, negative otherwise. A NaN from
+// 0 * inf on a slab boundary never wins a comparison so it doesn't narrow the interval
+static float ray_box(const float* min, const float* max, const float* origin, const float* inverse, float max_t)
+{
+  float near = 0.0f;
+  float far = max_t;
+  for (uint32_t c = 0; c < 3; c++) {
+    float t0 = (min[c] - origin[c]) * inverse[c];
+    float t1 = (max[c] - origin[c]) * inverse[c];
+    near = max_f(near, t0 < t1 ? t0 : t1);
+    far = min_f(far, t0 < t1 ? t1 : t0);
+  }
+  return near <= far ? near : -1.0f;
+}
+
+bool bvh_raycast(const bvh_t* bvh, const vec3 origin, const vec3 direction, float max_t,
+		 bvh_ray_fn test, void* user, bvh_hit_t* hit_out)
+{
+  float inverse[3];
+  for (uint32_t c = 0; c < 3; c++)
+    inverse[c] = 1.0f / direction[c];
+
+  bool hit = false;
+  float closest = max_t;
+  uint32_t stack[BVH_MAX_DEPTH];
+  uint32_t top = 0;
+  if (ray_box(bvh->nodes[0].min, bvh->nodes[0].max, origin, inverse, closest) >= 0.0f)
+    stack[top++] = 0;
+
+  while (top > 0) {
+    const bvh_node_t* node = &bvh->nodes[stack[--top]];
+
+    if (node->count > 0) {
+      for (uint32_t i = node->first; i < node->first + node->count; i++) {
+	uint32_t primitive = bvh->indices[i];
+	const aabb_t* box = &bvh->bounds[i];
+	float t = ray_box(box->min, box->max, origin, inverse, closest);
+	if (t >= 0.0f && test)
+	  t = test(user, primitive, origin, direction, closest);
+	if (t >= 0.0f && t <= closest) {
+	  closest = t;
+	  hit_out->primitive = primitive;
+	  hit_out->t = t;
+	  hit = true;
+	}
+      }
+      continue;
+    }
+
+    // Nearer child on top so it's visited first and shortens the ray for the other
+    const bvh_node_t* left = &bvh->nodes[node->first];
+    const bvh_node_t* right = &bvh->nodes[node->first + 1];
+    float t_left = ray_box(left->min, left->max, origin, inverse, closest);
+    float t_right = ray_box(right->min, right->max, origin, inverse, closest);
+    if (t_left >= 0.0f && t_right >= 0.0f) {
+      bool left_first = t_left <= t_right;
+      stack[top++] = left_first ? node->first + 1 : node->first;
+      stack[top++] = left_first ? node->first : node->first + 1;
+    } else if (t_left >= 0.0f) {
+      stack[top++] = node->first;
+    } else if (t_right >= 0.0f) {
+      stack[top++] = node->first + 1;
+    }
+  }
+  return hit;
+}
+
+/* REFIT */
+
+void bvh_update(bvh_t* bvh, uint32_t primitive, const aabb_t* bounds)
+{
+  bvh->bounds[bvh->slot_of[primitive]] = *bounds;
+  uint32_t leaf = bvh->leaf_of[primitive];
+  if (!bvh->leaf_dirty[leaf]) {
+    bvh->leaf_dirty[leaf] = true;
+    bvh->dirty[bvh->dirty_count++] = leaf;
+  }
+}
+
+// Recompute a node's box from its children or primitives, false if it didn't change
+static bool refit_node(bvh_t* bvh, uint32_t n)
+{
+  bvh_node_t* node = &bvh->nodes[n];
+  box_t box;
+  box_empty(&box);
+  if (node->count > 0) {
+    for (uint32_t i = node->first; i < node->first + node->count; i++)
+      box_grow(&box, bvh->bounds[i].min, bvh->bounds[i].max);
+  } else {
+    box_grow(&box, bvh->nodes[node->first].min, bvh->nodes[node->first].max);
+    box_grow(&box, bvh->nodes[node->first + 1].min, bvh->nodes[node->first + 1].max);
+  }
+
+  if (memcmp(box.min, node->min, sizeof(box.min)) == 0 && memcmp(box.max, node->max, sizeof(box.max)) == 0)
+    return false;
+  memcpy(node->min, box.min, sizeof(box.min));
+  memcpy(node->max, box.max, sizeof(box.max));
+  return true;
+}
+
+void bvh_refit(bvh_t* bvh)
+{
+  double start = glfwGetTime();
+
+  // Walk up from each touched leaf, stopping where a box comes out the same since nothing above
+  // it can change because of this leaf
+  for (uint32_t d = 0; d < bvh->dirty_count; d++) {
+    uint32_t n = bvh->dirty[d];
+    bvh->leaf_dirty[n] = false;
+    while (n != UINT32_MAX && refit_node(bvh, n))
+      n = bvh->parents[n];
+  }
+  bvh->dirty_count = 0;
+
+  bvh->stats.refit_ms = (glfwGetTime() - start) * 1000.0;
+}
+
+bvh_stats_t bvh_get_stats(const bvh_t* bvh)
+{
+  return bvh->stats;
+}
+
+void bvh_destroy(bvh_t* bvh)
+{
+  if (!bvh)
+    return;
+
+  free(bvh->nodes);
+  free(bvh->parents);
+  free(bvh->indices);
+  free(bvh->slot_of);
+  free(bvh->leaf_of);
+  free(bvh->bounds);
+  free(bvh->dirty);
+  free(bvh->leaf_dirty);
+  free(bvh);
+}
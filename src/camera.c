@@ -0,0 +1,69 @@
+#include "camera.h"
+
+#include <math.h>
+
+#define CAMERA_MAX_PITCH 89.0f
+
+camera_t camera_create(const vec3 position, float yaw, float pitch, float far)
+{
+  camera_t camera = {
+    .position = { position[0], position[1], position[2] },
+    .yaw = yaw,
+    .pitch = pitch,
+    .fov = CAMERA_DEFAULT_FOV,
+    .near = 0.1f,
+    .far = far,
+    .speed = CAMERA_DEFAULT_SPEED,
+  };
+  return camera;
+}
+
+void camera_forward(const camera_t* camera, vec3 forward_out)
+{
+  float yaw = glm_rad(camera->yaw);
+  float pitch = glm_rad(camera->pitch);
+  forward_out[0] = cosf(pitch) * sinf(yaw);
+  forward_out[1] = sinf(pitch);
+  forward_out[2] = -cosf(pitch) * cosf(yaw);
+}
+
+static float key_axis(GLFWwindow* window_ptr, int32_t positive, int32_t negative)
+{
+  return (float)(glfwGetKey(window_ptr, positive) == GLFW_PRESS) - (float)(glfwGetKey(window_ptr, negative) == GLFW_PRESS);
+}
+
+void camera_update(camera_t* camera, GLFWwindow* window_ptr, float dt)
+{
+  camera->yaw += key_axis(window_ptr, GLFW_KEY_RIGHT, GLFW_KEY_LEFT) * CAMERA_LOOK_SPEED * dt;
+  camera->pitch += key_axis(window_ptr, GLFW_KEY_UP, GLFW_KEY_DOWN) * CAMERA_LOOK_SPEED * dt;
+  if (camera->pitch > CAMERA_MAX_PITCH) camera->pitch = CAMERA_MAX_PITCH;
+  if (camera->pitch < -CAMERA_MAX_PITCH) camera->pitch = -CAMERA_MAX_PITCH;
+
+  // Strafing stays level, forward follows the pitch
+  vec3 forward, right = { cosf(glm_rad(camera->yaw)), 0.0f, sinf(glm_rad(camera->yaw)) };
+  camera_forward(camera, forward);
+
+  float step = camera->speed * dt;
+  vec3 move;
+  glm_vec3_scale(forward, key_axis(window_ptr, GLFW_KEY_W, GLFW_KEY_S) * step, move);
+  glm_vec3_add(camera->position, move, camera->position);
+  glm_vec3_scale(right, key_axis(window_ptr, GLFW_KEY_D, GLFW_KEY_A) * step, move);
+  glm_vec3_add(camera->position, move, camera->position);
+  camera->position[1] += key_axis(window_ptr, GLFW_KEY_E, GLFW_KEY_Q) * step;
+}
+
+void camera_frame_uniforms(const camera_t* camera, float aspect, frame_uniforms_t* frame)
+{
+  vec3 eye, forward, center, up = { 0.0f, 1.0f, 0.0f };
+  glm_vec3_copy((float*)camera->position, eye);
+  camera_forward(camera, forward);
+  glm_vec3_add(eye, forward, center);
+
+  glm_lookat(eye, center, up, frame->view);
+  glm_perspective(glm_rad(camera->fov), aspect, camera->near, camera->far, frame->projection);
+  glm_mat4_mul(frame->projection, frame->view, frame->view_projection);
+  frame->camera_position[0] = eye[0];
+  frame->camera_position[1] = eye[1];
+  frame->camera_position[2] = eye[2];
+  frame->camera_position[3] = 1.0f;
+}
@@ -0,0 +1,377 @@
+#include "clipmap.h"
+#include "gl_state.h"
+#include "mesh_optimizer.h"
+#include "mesh_pool.h"
+#include "sampler.h"
+#include "terrain.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLFW/glfw3.h>
+
+#define CLIPMAP_STRING(x) #x
+#define CLIPMAP_EXPAND(x) CLIPMAP_STRING(x)
+
+#define CLIPMAP_HOLE (CLIPMAP_GRID / 4)  // first quad of the hole the next finer level sits in
+#define CLIPMAP_ROWS_PER_JOB 16
+
+const char* const clipmap_shader_defines[CLIPMAP_SHADER_DEFINE_COUNT] = {
+  "CLIPMAP_GRID=" CLIPMAP_EXPAND(CLIPMAP_GRID),
+  "CLIPMAP_SIZE=" CLIPMAP_EXPAND(CLIPMAP_SIZE),
+};
+
+// Grid coordinates are small whole numbers, exact in half floats
+static const vertex_format_t clipmap_format = {
+  1, {
+    { 0, 2, VERTEX_HALF },
+  }
+};
+
+const vertex_layout_t clipmap_vertex_layout = {
+  4, 0, 1, {
+    { 0, 2, GL_HALF_FLOAT, GL_FALSE, 0 },
+  }
+};
+
+// Quads [x0, x1) x [z0, z1) of a level's grid
+typedef struct {
+  int32_t x0, z0, x1, z1;
+} grid_rect_t;
+
+typedef struct {
+  int32_t grid_x, grid_z;      // level sample under the grid's corner, always even
+  int32_t window_x, window_z;  // first sample held in the texture, one before the grid for normals
+  uint32_t trim;               // which L fills the hole around the next finer level
+  bool valid;
+} clipmap_level_t;
+
+struct clipmap {
+  thread_pool_t* workers;
+  clipmap_level_t levels[CLIPMAP_LEVELS];
+
+  // Levels stacked vertically, each CLIPMAP_SIZE square and addressed by sample index mod size
+  GLuint heights;
+  float* scratch;
+
+  mesh_pool_t* meshes;
+  mesh_t ring;                 // every level, around the hole the next finer one fills
+  mesh_t trims[4];             // the part of the hole the finer level leaves, by which side it sits on
+  mesh_t center;               // level 0's hole, nothing finer goes there
+
+  clipmap_stats_t stats;
+};
+
+static float level_spacing(uint32_t level)
+{
+  return CLIPMAP_SPACING * (float)(1u << level);
+}
+
+/* MESHES */
+
+// Grid over outer with the quads in inner left out, reordered for the vertex cache and encoded
+static bool add_region(clipmap_t* clipmap, grid_rect_t outer, grid_rect_t inner, mesh_t* mesh_out)
+{
+  uint32_t side_x = (uint32_t)(outer.x1 - outer.x0 + 1);
+  uint32_t side_z = (uint32_t)(outer.z1 - outer.z0 + 1);
+  uint32_t vertex_count = side_x * side_z;
+  uint32_t max_indices = (side_x - 1) * (side_z - 1) * 6;
+
+  float* vertices = malloc(vertex_count * 2 * sizeof(float));
+  uint32_t* indices = malloc(max_indices * sizeof(uint32_t));
+  uint8_t* encoded = malloc(vertex_count * clipmap_vertex_layout.stride);
+  if (!vertices || !indices || !encoded) {
+    fprintf(stderr, "Memory allocation failed for clipmap mesh\n");
+    free(vertices);
+    free(indices);
+    free(encoded);
+    return false;
+  }
+
+  for (uint32_t z = 0; z < side_z; z++) {
+    for (uint32_t x = 0; x < side_x; x++) {
+      vertices[(z * side_x + x) * 2 + 0] = (float)(outer.x0 + (int32_t)x);
+      vertices[(z * side_x + x) * 2 + 1] = (float)(outer.z0 + (int32_t)z);
+    }
+  }
+
+  uint32_t index_count = 0;
+  for (int32_t z = outer.z0; z < outer.z1; z++) {
+    for (int32_t x = outer.x0; x < outer.x1; x++) {
+      if (x >= inner.x0 && x < inner.x1 && z >= inner.z0 && z < inner.z1)
+	continue;
+      uint32_t i0 = (uint32_t)(z - outer.z0) * side_x + (uint32_t)(x - outer.x0);
+      uint32_t i1 = i0 + 1;
+      uint32_t i2 = i0 + side_x;
+      uint32_t i3 = i2 + 1;
+      indices[index_count++] = i0; indices[index_count++] = i2; indices[index_count++] = i1;
+      indices[index_count++] = i1; indices[index_count++] = i2; indices[index_count++] = i3;
+    }
+  }
+
+  // Vertices in the hole are dropped here
+  mesh_optimize_vertex_cache(indices, index_count, vertex_count);
+  vertex_count = mesh_optimize_vertex_fetch(vertices, vertex_count, 2 * sizeof(float), indices, index_count);
+  vertex_format_convert(&clipmap_format, vertices, vertex_count, encoded);
+  bool added = mesh_pool_add(clipmap->meshes, encoded, vertex_count, indices, index_count, mesh_out);
+
+  free(vertices);
+  free(indices);
+  free(encoded);
+  return added;
+}
+
+static bool build_meshes(clipmap_t* clipmap)
+{
+  grid_rect_t none = { 0, 0, 0, 0 };
+  grid_rect_t all = { 0, 0, CLIPMAP_GRID, CLIPMAP_GRID };
+
+  // One quad wider than the finer level, whose corner sits on an odd or even quad of this level
+  int32_t hole_end = CLIPMAP_HOLE + CLIPMAP_GRID / 2 + 1;
+  grid_rect_t hole = { CLIPMAP_HOLE, CLIPMAP_HOLE, hole_end, hole_end };
+
+  if (!add_region(clipmap, all, hole, &clipmap->ring) || !add_region(clipmap, hole, none, &clipmap->center))
+    return false;
+
+  for (uint32_t trim = 0; trim < 4; trim++) {
+    int32_t x0 = CLIPMAP_HOLE + (int32_t)(trim & 1);
+    int32_t z0 = CLIPMAP_HOLE + (int32_t)(trim >> 1);
+    grid_rect_t finer = { x0, z0, x0 + CLIPMAP_GRID / 2, z0 + CLIPMAP_GRID / 2 };
+    if (!add_region(clipmap, hole, finer, &clipmap->trims[trim]))
+      return false;
+  }
+  return true;
+}
+
+/* SETUP */
+
+clipmap_t* clipmap_create(thread_pool_t* workers)
+{
+  clipmap_t* clipmap = calloc(1, sizeof(clipmap_t));
+  if (!clipmap) {
+    fprintf(stderr, "Memory allocation failed for clipmap\n");
+    return NULL;
+  }
+  clipmap->workers = workers;
+
+  clipmap->scratch = malloc(CLIPMAP_SIZE * CLIPMAP_SIZE * sizeof(float));
+  clipmap->meshes = mesh_pool_create(&clipmap_vertex_layout, 0, 0);
+  if (!clipmap->scratch || !clipmap->meshes || !build_meshes(clipmap)) {
+    fprintf(stderr, "Failed to create clipmap\n");
+    clipmap_destroy(clipmap);
+    return NULL;
+  }
+
+  glGenTextures(1, &clipmap->heights);
+  gl_state_edit_texture(GL_TEXTURE_2D, clipmap->heights);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, CLIPMAP_SIZE, CLIPMAP_SIZE * CLIPMAP_LEVELS);
+
+  return clipmap;
+}
+
+void clipmap_bind_instances(clipmap_t* clipmap, GLuint buffer, const vertex_layout_t* layout)
+{
+  mesh_pool_bind_instances(clipmap->meshes, buffer, layout);
+}
+
+/* HEIGHTS */
+
+typedef struct {
+  float spacing;
+  int32_t x0, z0;              // level sample of the first height
+  uint32_t width;
+  float* out;
+} region_job_t;
+
+static void generate_rows(void* arg, uint32_t chunk, uint32_t begin, uint32_t end)
+{
+  region_job_t* job = arg;
+  (void)chunk;
+  for (uint32_t z = begin; z < end; z++) {
+    float world_z = (float)(job->z0 + (int32_t)z) * job->spacing;
+    float* row = &job->out[z * job->width];
+    for (uint32_t x = 0; x < job->width; x++)
+      row[x] = terrain_height((float)(job->x0 + (int32_t)x) * job->spacing, world_z);
+  }
+}
+
+static int32_t wrap(int32_t value)
+{
+  return value & (CLIPMAP_SIZE - 1);
+}
+
+// Samples [x0, x0 + width) x [z0, z0 + height), split where they wrap around the texture
+static void update_region(clipmap_t* clipmap, uint32_t level, int32_t x0, int32_t z0, uint32_t width, uint32_t height)
+{
+  for (uint32_t z_done = 0; z_done < height;) {
+    int32_t z = z0 + (int32_t)z_done;
+    uint32_t rows = CLIPMAP_SIZE - (uint32_t)wrap(z);
+    if (rows > height - z_done)
+      rows = height - z_done;
+
+    for (uint32_t x_done = 0; x_done < width;) {
+      int32_t x = x0 + (int32_t)x_done;
+      uint32_t columns = CLIPMAP_SIZE - (uint32_t)wrap(x);
+      if (columns > width - x_done)
+	columns = width - x_done;
+
+      region_job_t job = { level_spacing(level), x, z, columns, clipmap->scratch };
+      thread_pool_parallel_for(clipmap->workers, rows, CLIPMAP_ROWS_PER_JOB, generate_rows, &job);
+
+      glTexSubImage2D(GL_TEXTURE_2D, 0, wrap(x), wrap(z) + (int32_t)(level * CLIPMAP_SIZE),
+		      (GLsizei)columns, (GLsizei)rows, GL_RED, GL_FLOAT, clipmap->scratch);
+      clipmap->stats.samples += columns * rows;
+      x_done += columns;
+    }
+    z_done += rows;
+  }
+}
+
+// Level sample the camera's level center snaps to, even so the next coarser level lines up
+static int32_t snapped_center(float position, uint32_t level)
+{
+  return (int32_t)floorf(position / (2.0f * level_spacing(level))) * 2;
+}
+
+void clipmap_level_grid(uint32_t level, const vec3 camera_position, int32_t grid_out[2])
+{
+  grid_out[0] = snapped_center(camera_position[0], level) - CLIPMAP_GRID / 2;
+  grid_out[1] = snapped_center(camera_position[2], level) - CLIPMAP_GRID / 2;
+}
+
+uint32_t clipmap_level_trim(const int32_t finer_grid[2], const int32_t grid[2])
+{
+  // The finer level's center is on this level's sample grid, 0 or 1 past this one's
+  int32_t dx = (finer_grid[0] + CLIPMAP_GRID / 2) / 2 - (grid[0] + CLIPMAP_GRID / 2);
+  int32_t dz = (finer_grid[1] + CLIPMAP_GRID / 2) / 2 - (grid[1] + CLIPMAP_GRID / 2);
+  return (uint32_t)(dx | dz << 1);
+}
+
+uint32_t clipmap_window_regions(bool from_valid, const int32_t from[2], const int32_t to[2],
+				clipmap_region_t regions_out[2])
+{
+  int32_t dx = to[0] - from[0];
+  int32_t dz = to[1] - from[1];
+  if (!from_valid || abs(dx) >= CLIPMAP_SIZE || abs(dz) >= CLIPMAP_SIZE) {
+    regions_out[0] = (clipmap_region_t){ to[0], to[1], CLIPMAP_SIZE, CLIPMAP_SIZE };
+    return 1;
+  }
+
+  // Columns that came into view, then rows. Their corner is generated twice, it's tiny
+  uint32_t count = 0;
+  if (dx > 0)
+    regions_out[count++] = (clipmap_region_t){ from[0] + CLIPMAP_SIZE, to[1], (uint32_t)dx, CLIPMAP_SIZE };
+  else if (dx < 0)
+    regions_out[count++] = (clipmap_region_t){ to[0], to[1], (uint32_t)-dx, CLIPMAP_SIZE };
+  if (dz > 0)
+    regions_out[count++] = (clipmap_region_t){ to[0], from[1] + CLIPMAP_SIZE, CLIPMAP_SIZE, (uint32_t)dz };
+  else if (dz < 0)
+    regions_out[count++] = (clipmap_region_t){ to[0], to[1], CLIPMAP_SIZE, (uint32_t)-dz };
+  return count;
+}
+
+void clipmap_update(clipmap_t* clipmap, const vec3 camera_position)
+{
+  double start = glfwGetTime();
+  clipmap->stats.samples = 0;
+  clipmap->stats.levels_moved = 0;
+
+  gl_state_edit_texture(GL_TEXTURE_2D, clipmap->heights);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  for (uint32_t l = 0; l < CLIPMAP_LEVELS; l++) {
+    clipmap_level_t* level = &clipmap->levels[l];
+    int32_t grid[2];
+    clipmap_level_grid(l, camera_position, grid);
+    level->grid_x = grid[0];
+    level->grid_z = grid[1];
+
+    if (l > 0) {
+      int32_t finer[2] = { clipmap->levels[l - 1].grid_x, clipmap->levels[l - 1].grid_z };
+      level->trim = clipmap_level_trim(finer, grid);
+    }
+
+    int32_t from[2] = { level->window_x, level->window_z };
+    int32_t to[2] = { level->grid_x - 1, level->grid_z - 1 };
+    clipmap_region_t regions[2];
+    uint32_t region_count = clipmap_window_regions(level->valid, from, to, regions);
+    if (region_count == 0)
+      continue;
+    clipmap->stats.levels_moved++;
+
+    for (uint32_t r = 0; r < region_count; r++)
+      update_region(clipmap, l, regions[r].x0, regions[r].z0, regions[r].width, regions[r].height);
+
+    level->window_x = to[0];
+    level->window_z = to[1];
+    level->valid = true;
+  }
+
+  clipmap->stats.update_ms = (glfwGetTime() - start) * 1000.0;
+}
+
+/* DRAWING */
+
+static void push(render_queue_t* queue, const render_packet_t* base, const clipmap_t* clipmap,
+		 const mesh_t* mesh, const instance_data_t* instance)
+{
+  render_packet_t packet = *base;
+  packet.key = render_key_instanced(0, base->shader->id, 0, base->texture, mesh->index_offset);
+  mesh_pool_packet(clipmap->meshes, mesh, &packet);
+  render_queue_push_instanced(queue, &packet, instance);
+}
+
+void clipmap_draw(clipmap_t* clipmap, render_queue_t* queue, const shader_t* shader, uint32_t texture_unit)
+{
+  if (shader->id == 0 || !clipmap->levels[0].valid)
+    return;
+
+  // texelFetch only, the sampler just has to make the texture complete
+  sampler_desc_t heights_sampler = { GL_NEAREST, GL_NEAREST, GL_REPEAT, GL_REPEAT, 1.0f };
+  render_packet_t base = {
+    .shader = shader,
+    .texture = clipmap->heights,
+    .sampler = sampler_get(&heights_sampler),
+    .texture_unit = texture_unit,
+  };
+
+  // Every level's ring is the same mesh, so they become one indirect command
+  for (uint32_t l = 0; l < CLIPMAP_LEVELS; l++) {
+    const clipmap_level_t* level = &clipmap->levels[l];
+    float spacing = level_spacing(l);
+
+    // uv_rect carries the level, whether a coarser one follows and the grid's first sample
+    instance_data_t instance = {
+      .color = { 1.0f, 1.0f, 1.0f, 1.0f },
+      .uv_rect = { (float)l, l + 1 < CLIPMAP_LEVELS ? 1.0f : 0.0f, (float)level->grid_x, (float)level->grid_z },
+    };
+    glm_mat4_identity(instance.transform);
+    instance.transform[0][0] = spacing;
+    instance.transform[2][2] = spacing;
+    instance.transform[3][0] = (float)level->grid_x * spacing;
+    instance.transform[3][2] = (float)level->grid_z * spacing;
+
+    push(queue, &base, clipmap, &clipmap->ring, &instance);
+    push(queue, &base, clipmap, l == 0 ? &clipmap->center : &clipmap->trims[level->trim], &instance);
+  }
+}
+
+clipmap_stats_t clipmap_get_stats(const clipmap_t* clipmap)
+{
+  return clipmap->stats;
+}
+
+void clipmap_destroy(clipmap_t* clipmap)
+{
+  if (!clipmap)
+    return;
+
+  if (clipmap->heights != 0) {
+    gl_state_forget_texture(clipmap->heights);
+    glDeleteTextures(1, &clipmap->heights);
+  }
+  mesh_pool_destroy(clipmap->meshes);
+  free(clipmap->scratch);
+  free(clipmap);
+}
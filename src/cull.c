@@ -0,0 +1,393 @@
+#include "cull.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLFW/glfw3.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CULL_X86
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CULL_NEON
+#endif
+
+struct cull_objects {
+  float* center_x;
+  float* center_y;
+  float* center_z;
+  float* extent_x;
+  float* extent_y;
+  float* extent_z;
+  float* radius;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t* chunk_counts;
+  uint32_t chunk_capacity;
+  cull_stats_t stats;
+};
+
+// Planes as nx, ny, nz, d with the inside positive, plus |n| for the box's reach along the normal
+typedef struct {
+  float plane[6][4];
+  float abs_normal[6][3];
+} cull_frustum_t;
+
+// Writes the indices of visible objects in [begin, end) to out, returns how many
+typedef uint32_t (*cull_fn)(const cull_objects_t* objects, const cull_frustum_t* frustum,
+			    uint32_t begin, uint32_t end, uint32_t* out);
+
+static bool reserve(cull_objects_t* objects, uint32_t capacity)
+{
+  float** fields[] = {
+    &objects->center_x, &objects->center_y, &objects->center_z,
+    &objects->extent_x, &objects->extent_y, &objects->extent_z, &objects->radius
+  };
+  for (uint32_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    float* field = realloc(*fields[i], capacity * sizeof(float));
+    if (!field) {
+      fprintf(stderr, "Memory allocation failed for cull objects\n");
+      return false;
+    }
+    *fields[i] = field;
+  }
+  objects->capacity = capacity;
+  return true;
+}
+
+cull_objects_t* cull_objects_create(uint32_t capacity)
+{
+  cull_objects_t* objects = calloc(1, sizeof(cull_objects_t));
+  if (!objects) {
+    fprintf(stderr, "Memory allocation failed for cull objects\n");
+    return NULL;
+  }
+
+  if (!reserve(objects, capacity ? capacity : CULL_CHUNK_SIZE)) {
+    cull_objects_destroy(objects);
+    return NULL;
+  }
+  return objects;
+}
+
+uint32_t cull_objects_add(cull_objects_t* objects, const vec3 center, const vec3 extents)
+{
+  if (objects->count == objects->capacity && !reserve(objects, objects->capacity * 2))
+    return UINT32_MAX;
+
+  uint32_t index = objects->count++;
+  cull_objects_set(objects, index, center, extents);
+  return index;
+}
+
+void cull_objects_set(cull_objects_t* objects, uint32_t index, const vec3 center, const vec3 extents)
+{
+  objects->center_x[index] = center[0];
+  objects->center_y[index] = center[1];
+  objects->center_z[index] = center[2];
+  objects->extent_x[index] = fabsf(extents[0]);
+  objects->extent_y[index] = fabsf(extents[1]);
+  objects->extent_z[index] = fabsf(extents[2]);
+  objects->radius[index] = sqrtf(extents[0] * extents[0] + extents[1] * extents[1] + extents[2] * extents[2]);
+}
+
+uint32_t cull_objects_count(const cull_objects_t* objects)
+{
+  return objects->count;
+}
+
+/* PLANE TESTS */
+
+// Inside every plane: distance to the plane plus the smaller of the sphere radius and the box's
+// reach towards it is non-negative
+static uint32_t cull_scalar(const cull_objects_t* objects, const cull_frustum_t* frustum,
+			    uint32_t begin, uint32_t end, uint32_t* out)
+{
+  uint32_t count = 0;
+  for (uint32_t i = begin; i < end; i++) {
+    bool inside = true;
+    for (uint32_t p = 0; p < 6; p++) {
+      const float* plane = frustum->plane[p];
+      const float* abs_normal = frustum->abs_normal[p];
+      float distance = plane[0] * objects->center_x[i] + plane[1] * objects->center_y[i] +
+	plane[2] * objects->center_z[i] + plane[3];
+      float reach = abs_normal[0] * objects->extent_x[i] + abs_normal[1] * objects->extent_y[i] +
+	abs_normal[2] * objects->extent_z[i];
+      if (reach > objects->radius[i])
+	reach = objects->radius[i];
+      inside &= distance + reach >= 0.0f;
+    }
+
+    // Written either way, only kept if visible
+    out[count] = i;
+    count += inside;
+  }
+  return count;
+}
+
+#ifdef CULL_X86
+
+__attribute__((target("avx2,fma")))
+static uint32_t cull_avx2(const cull_objects_t* objects, const cull_frustum_t* frustum,
+			  uint32_t begin, uint32_t end, uint32_t* out)
+{
+  uint32_t count = 0;
+  uint32_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 center_x = _mm256_loadu_ps(objects->center_x + i);
+    __m256 center_y = _mm256_loadu_ps(objects->center_y + i);
+    __m256 center_z = _mm256_loadu_ps(objects->center_z + i);
+    __m256 extent_x = _mm256_loadu_ps(objects->extent_x + i);
+    __m256 extent_y = _mm256_loadu_ps(objects->extent_y + i);
+    __m256 extent_z = _mm256_loadu_ps(objects->extent_z + i);
+    __m256 radius = _mm256_loadu_ps(objects->radius + i);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for (uint32_t p = 0; p < 6; p++) {
+      const float* plane = frustum->plane[p];
+      const float* abs_normal = frustum->abs_normal[p];
+      __m256 distance = _mm256_fmadd_ps(_mm256_set1_ps(plane[0]), center_x,
+			  _mm256_fmadd_ps(_mm256_set1_ps(plane[1]), center_y,
+			  _mm256_fmadd_ps(_mm256_set1_ps(plane[2]), center_z, _mm256_set1_ps(plane[3]))));
+      __m256 reach = _mm256_fmadd_ps(_mm256_set1_ps(abs_normal[0]), extent_x,
+		       _mm256_fmadd_ps(_mm256_set1_ps(abs_normal[1]), extent_y,
+		       _mm256_mul_ps(_mm256_set1_ps(abs_normal[2]), extent_z)));
+      reach = _mm256_min_ps(reach, radius);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+
+    uint32_t mask = (uint32_t)_mm256_movemask_ps(inside);
+    while (mask) {
+      out[count++] = i + (uint32_t)__builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+  return count + cull_scalar(objects, frustum, i, end, out + count);
+}
+
+__attribute__((target("sse2")))
+static uint32_t cull_sse2(const cull_objects_t* objects, const cull_frustum_t* frustum,
+			  uint32_t begin, uint32_t end, uint32_t* out)
+{
+  uint32_t count = 0;
+  uint32_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 center_x = _mm_loadu_ps(objects->center_x + i);
+    __m128 center_y = _mm_loadu_ps(objects->center_y + i);
+    __m128 center_z = _mm_loadu_ps(objects->center_z + i);
+    __m128 extent_x = _mm_loadu_ps(objects->extent_x + i);
+    __m128 extent_y = _mm_loadu_ps(objects->extent_y + i);
+    __m128 extent_z = _mm_loadu_ps(objects->extent_z + i);
+    __m128 radius = _mm_loadu_ps(objects->radius + i);
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    for (uint32_t p = 0; p < 6; p++) {
+      const float* plane = frustum->plane[p];
+      const float* abs_normal = frustum->abs_normal[p];
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), center_x),
+					      _mm_mul_ps(_mm_set1_ps(plane[1]), center_y)),
+				   _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[2]), center_z), _mm_set1_ps(plane[3])));
+      __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(abs_normal[0]), extent_x),
+					   _mm_mul_ps(_mm_set1_ps(abs_normal[1]), extent_y)),
+				_mm_mul_ps(_mm_set1_ps(abs_normal[2]), extent_z));
+      reach = _mm_min_ps(reach, radius);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+    }
+
+    uint32_t mask = (uint32_t)_mm_movemask_ps(inside);
+    while (mask) {
+      out[count++] = i + (uint32_t)__builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+  return count + cull_scalar(objects, frustum, i, end, out + count);
+}
+
+#endif
+
+#ifdef CULL_NEON
+
+static uint32_t cull_neon(const cull_objects_t* objects, const cull_frustum_t* frustum,
+			  uint32_t begin, uint32_t end, uint32_t* out)
+{
+  uint32_t count = 0;
+  uint32_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    float32x4_t center_x = vld1q_f32(objects->center_x + i);
+    float32x4_t center_y = vld1q_f32(objects->center_y + i);
+    float32x4_t center_z = vld1q_f32(objects->center_z + i);
+    float32x4_t extent_x = vld1q_f32(objects->extent_x + i);
+    float32x4_t extent_y = vld1q_f32(objects->extent_y + i);
+    float32x4_t extent_z = vld1q_f32(objects->extent_z + i);
+    float32x4_t radius = vld1q_f32(objects->radius + i);
+    uint32x4_t inside = vdupq_n_u32(UINT32_MAX);
+
+    for (uint32_t p = 0; p < 6; p++) {
+      const float* plane = frustum->plane[p];
+      const float* abs_normal = frustum->abs_normal[p];
+      float32x4_t distance = vdupq_n_f32(plane[3]);
+      distance = vmlaq_n_f32(distance, center_x, plane[0]);
+      distance = vmlaq_n_f32(distance, center_y, plane[1]);
+      distance = vmlaq_n_f32(distance, center_z, plane[2]);
+      float32x4_t reach = vmulq_n_f32(extent_x, abs_normal[0]);
+      reach = vmlaq_n_f32(reach, extent_y, abs_normal[1]);
+      reach = vmlaq_n_f32(reach, extent_z, abs_normal[2]);
+      reach = vminq_f32(reach, radius);
+      inside = vandq_u32(inside, vcgeq_f32(vaddq_f32(distance, reach), vdupq_n_f32(0.0f)));
+    }
+
+    uint32_t lanes[4];
+    vst1q_u32(lanes, inside);
+    for (uint32_t l = 0; l < 4; l++) {
+      out[count] = i + l;
+      count += lanes[l] & 1;
+    }
+  }
+  return count + cull_scalar(objects, frustum, i, end, out + count);
+}
+
+#endif
+
+// Picked once, every CPU this runs on in practice has at least the baseline SIMD of its arch
+static cull_fn cull_test = NULL;
+static const char* cull_test_name = "scalar";
+
+static void select_test(void)
+{
+  if (cull_test)
+    return;
+  cull_test = cull_scalar;
+
+#ifdef CULL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    cull_test = cull_avx2;
+    cull_test_name = "avx2";
+  } else if (__builtin_cpu_supports("sse2")) {
+    cull_test = cull_sse2;
+    cull_test_name = "sse2";
+  }
+#elif defined(CULL_NEON)
+  cull_test = cull_neon;
+  cull_test_name = "neon";
+#endif
+}
+
+const char* cull_simd_name(void)
+{
+  select_test();
+  return cull_test_name;
+}
+
+bool cull_set_simd(const char* name)
+{
+  select_test();
+
+  if (strcmp(name, "scalar") == 0) {
+    cull_test = cull_scalar;
+    cull_test_name = "scalar";
+    return true;
+  }
+#ifdef CULL_X86
+  if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    cull_test = cull_avx2;
+    cull_test_name = "avx2";
+    return true;
+  }
+  if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+    cull_test = cull_sse2;
+    cull_test_name = "sse2";
+    return true;
+  }
+#elif defined(CULL_NEON)
+  if (strcmp(name, "neon") == 0) {
+    cull_test = cull_neon;
+    cull_test_name = "neon";
+    return true;
+  }
+#endif
+  return false;
+}
+
+/* FRUSTUM CULLING */
+
+typedef struct {
+  const cull_objects_t* objects;
+  cull_frustum_t frustum;
+  uint32_t* visible;
+  uint32_t* chunk_counts;
+} cull_job_t;
+
+// Each chunk writes from its own start in the output, they're packed together afterwards
+static void cull_chunk(void* arg, uint32_t chunk, uint32_t begin, uint32_t end)
+{
+  cull_job_t* job = arg;
+  job->chunk_counts[chunk] = cull_test(job->objects, &job->frustum, begin, end, job->visible + begin);
+}
+
+uint32_t cull_frustum(cull_objects_t* objects, mat4 view_projection, thread_pool_t* workers,
+		      uint32_t* visible_out)
+{
+  double start = glfwGetTime();
+  select_test();
+
+  uint32_t chunks = (objects->count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+  if (chunks > objects->chunk_capacity) {
+    uint32_t* counts = realloc(objects->chunk_counts, chunks * sizeof(uint32_t));
+    if (!counts) {
+      fprintf(stderr, "Memory allocation failed for cull chunks\n");
+      return 0;
+    }
+    objects->chunk_counts = counts;
+    objects->chunk_capacity = chunks;
+  }
+
+  cull_job_t job;
+  job.objects = objects;
+  job.visible = visible_out;
+  job.chunk_counts = objects->chunk_counts;
+  vec4 planes[6];
+  glm_frustum_planes(view_projection, planes);
+  for (uint32_t p = 0; p < 6; p++) {
+    for (uint32_t c = 0; c < 4; c++)
+      job.frustum.plane[p][c] = planes[p][c];
+    for (uint32_t c = 0; c < 3; c++)
+      job.frustum.abs_normal[p][c] = fabsf(planes[p][c]);
+  }
+
+  thread_pool_parallel_for(workers, objects->count, CULL_CHUNK_SIZE, cull_chunk, &job);
+
+  uint32_t visible = chunks > 0 ? objects->chunk_counts[0] : 0;
+  for (uint32_t c = 1; c < chunks; c++) {
+    memmove(visible_out + visible, visible_out + c * CULL_CHUNK_SIZE, objects->chunk_counts[c] * sizeof(uint32_t));
+    visible += objects->chunk_counts[c];
+  }
+
+  objects->stats.tested = objects->count;
+  objects->stats.visible = visible;
+  objects->stats.cull_ms = (glfwGetTime() - start) * 1000.0;
+  return visible;
+}
+
+cull_stats_t cull_get_stats(const cull_objects_t* objects)
+{
+  return objects->stats;
+}
+
+void cull_objects_destroy(cull_objects_t* objects)
+{
+  if (!objects)
+    return;
+
+  free(objects->center_x);
+  free(objects->center_y);
+  free(objects->center_z);
+  free(objects->extent_x);
+  free(objects->extent_y);
+  free(objects->extent_z);
+  free(objects->radius);
+  free(objects->chunk_counts);
+  free(objects);
+}
@@ -0,0 +1,216 @@
+#include "file_watch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <sys/inotify.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  char* path;
+  const char* name;            // points into path, after the last '/'
+  int32_t wd;                  // watch descriptor of the directory
+  bool dirty;
+  double last_event;
+} watched_file_t;
+
+typedef struct {
+  char* dir;
+  int32_t wd;
+} watched_dir_t;
+
+struct file_watch {
+  int fd;
+  watched_file_t files[FILE_WATCH_MAX_FILES];
+  uint32_t file_count;
+  watched_dir_t dirs[FILE_WATCH_MAX_DIRS];
+  uint32_t dir_count;
+};
+
+static double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+file_watch_t* file_watch_create(void)
+{
+  file_watch_t* watch = calloc(1, sizeof(file_watch_t));
+  if (!watch)
+    return NULL;
+
+  watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watch->fd < 0) {
+    fprintf(stderr, "Failed to start inotify: %s\n", strerror(errno));
+    free(watch);
+    return NULL;
+  }
+
+  return watch;
+}
+
+static int32_t watch_dir(file_watch_t* watch, const char* dir)
+{
+  for (uint32_t i = 0; i < watch->dir_count; i++) {
+    if (strcmp(watch->dirs[i].dir, dir) == 0)
+      return watch->dirs[i].wd;
+  }
+
+  if (watch->dir_count == FILE_WATCH_MAX_DIRS) {
+    fprintf(stderr, "Too many watched directories (%d).\n", FILE_WATCH_MAX_DIRS);
+    return -1;
+  }
+
+  // Editors often save by writing a temp file and renaming it over the original
+  int32_t wd = inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (wd < 0) {
+    fprintf(stderr, "Failed to watch %s: %s\n", dir, strerror(errno));
+    return -1;
+  }
+
+  size_t length = strlen(dir);
+  watched_dir_t* entry = &watch->dirs[watch->dir_count];
+  entry->dir = malloc(length + 1);
+  if (!entry->dir) {
+    inotify_rm_watch(watch->fd, wd);
+    return -1;
+  }
+  memcpy(entry->dir, dir, length + 1);
+  entry->wd = wd;
+  watch->dir_count++;
+
+  return wd;
+}
+
+bool file_watch_add(file_watch_t* watch, const char* path)
+{
+  for (uint32_t i = 0; i < watch->file_count; i++) {
+    if (strcmp(watch->files[i].path, path) == 0)
+      return true;
+  }
+
+  if (watch->file_count == FILE_WATCH_MAX_FILES) {
+    fprintf(stderr, "Too many watched files (%d).\n", FILE_WATCH_MAX_FILES);
+    return false;
+  }
+
+  size_t length = strlen(path);
+  char* copy = malloc(length + 1);
+  char* dir = malloc(length + 2);
+  if (!copy || !dir) {
+    free(copy);
+    free(dir);
+    return false;
+  }
+  memcpy(copy, path, length + 1);
+
+  // Split into directory and file name, a bare name lives in "."
+  const char* slash = strrchr(copy, '/');
+  if (slash) {
+    memcpy(dir, copy, slash - copy);
+    dir[slash - copy] = '\0';
+    if (slash == copy)
+      strcpy(dir, "/");
+  } else {
+    strcpy(dir, ".");
+  }
+
+  int32_t wd = watch_dir(watch, dir);
+  free(dir);
+  if (wd < 0) {
+    free(copy);
+    return false;
+  }
+
+  watched_file_t* file = &watch->files[watch->file_count++];
+  file->path = copy;
+  file->name = slash ? slash + 1 : copy;
+  file->wd = wd;
+  file->dirty = false;
+  file->last_event = 0.0;
+
+  return true;
+}
+
+uint32_t file_watch_poll(file_watch_t* watch, const char** changed, uint32_t max)
+{
+  double now = now_seconds();
+
+  // Drain every queued event, marking the watched files they name
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;) {
+    ssize_t length = read(watch->fd, buffer, sizeof(buffer));
+    if (length <= 0)
+      break;
+
+    for (char* ptr = buffer; ptr < buffer + length;) {
+      const struct inotify_event* event = (const struct inotify_event*)ptr;
+      ptr += sizeof(struct inotify_event) + event->len;
+      if (event->len == 0)
+	continue;
+
+      for (uint32_t i = 0; i < watch->file_count; i++) {
+	watched_file_t* file = &watch->files[i];
+	if (file->wd == event->wd && strcmp(file->name, event->name) == 0) {
+	  file->dirty = true;
+	  file->last_event = now;
+	}
+      }
+    }
+  }
+
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < watch->file_count && count < max; i++) {
+    watched_file_t* file = &watch->files[i];
+    if (file->dirty && now - file->last_event >= FILE_WATCH_SETTLE_SECONDS) {
+      file->dirty = false;
+      changed[count++] = file->path;
+    }
+  }
+
+  return count;
+}
+
+void file_watch_destroy(file_watch_t* watch)
+{
+  if (!watch)
+    return;
+
+  for (uint32_t i = 0; i < watch->file_count; i++)
+    free(watch->files[i].path);
+  for (uint32_t i = 0; i < watch->dir_count; i++)
+    free(watch->dirs[i].dir);
+  close(watch->fd);
+  free(watch);
+}
+
+#else
+
+// No inotify, hot reload is simply unavailable
+file_watch_t* file_watch_create(void)
+{
+  fprintf(stderr, "File watching is only supported on Linux.\n");
+  return NULL;
+}
+
+bool file_watch_add(file_watch_t* watch, const char* path)
+{
+  return false;
+}
+
+uint32_t file_watch_poll(file_watch_t* watch, const char** changed, uint32_t max)
+{
+  return 0;
+}
+
+void file_watch_destroy(file_watch_t* watch)
+{
+}
+
+#endif
@@ -0,0 +1,250 @@
+#include "gl_state.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// Never a valid object name, so the first bind of anything after an invalidate goes through
+#define UNKNOWN 0xFFFFFFFFu
+
+// Texture targets with their own binding per unit, others aren't cached
+static const GLenum texture_targets[] = {
+  GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP
+};
+#define TEXTURE_TARGETS (sizeof(texture_targets) / sizeof(texture_targets[0]))
+
+static const GLenum buffer_targets[] = {
+  GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER,
+  GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+  GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER
+};
+#define BUFFER_TARGETS (sizeof(buffer_targets) / sizeof(buffer_targets[0]))
+
+typedef struct {
+  GLuint buffer;
+  GLintptr offset;
+  GLsizeiptr size;
+} buffer_range_t;
+
+static struct {
+  GLuint program;
+  GLuint active_unit;
+  GLuint textures[GL_STATE_TEXTURE_UNITS][TEXTURE_TARGETS];
+  GLuint samplers[GL_STATE_TEXTURE_UNITS];
+  GLuint vertex_array;
+  GLuint buffers[BUFFER_TARGETS];
+  buffer_range_t uniform_ranges[GL_STATE_BUFFER_BINDINGS];
+  buffer_range_t storage_ranges[GL_STATE_BUFFER_BINDINGS];
+  bool valid;
+} state;
+
+static gl_state_stats_t frame_stats;
+static gl_state_stats_t last_stats;
+
+void gl_state_invalidate(void)
+{
+  // Names are all GLuint, so 0xFF bytes make every one UNKNOWN
+  memset(&state, 0xFF, sizeof(state));
+  state.valid = true;
+}
+
+static void ensure_valid(void)
+{
+  if (!state.valid)
+    gl_state_invalidate();
+}
+
+// Count the call and report whether it has to reach GL
+static bool changed(gl_state_kind_t kind, GLuint* cached, GLuint value)
+{
+  if (*cached == value) {
+    frame_stats.skipped[kind]++;
+    return false;
+  }
+  *cached = value;
+  frame_stats.issued[kind]++;
+  return true;
+}
+
+static int32_t texture_target_index(GLenum target)
+{
+  for (uint32_t i = 0; i < TEXTURE_TARGETS; i++) {
+    if (texture_targets[i] == target)
+      return i;
+  }
+  return -1;
+}
+
+static int32_t buffer_target_index(GLenum target)
+{
+  for (uint32_t i = 0; i < BUFFER_TARGETS; i++) {
+    if (buffer_targets[i] == target)
+      return i;
+  }
+  return -1;
+}
+
+void gl_state_use_program(GLuint program)
+{
+  ensure_valid();
+  if (changed(GL_STATE_PROGRAM, &state.program, program))
+    glUseProgram(program);
+}
+
+static void set_active_unit(uint32_t unit)
+{
+  if (changed(GL_STATE_TEXTURE, &state.active_unit, unit))
+    glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void gl_state_bind_texture(uint32_t unit, GLenum target, GLuint texture)
+{
+  ensure_valid();
+  int32_t index = texture_target_index(target);
+  if (unit >= GL_STATE_TEXTURE_UNITS || index < 0) {
+    set_active_unit(unit);
+    frame_stats.issued[GL_STATE_TEXTURE]++;
+    glBindTexture(target, texture);
+    return;
+  }
+
+  // The unit only needs to be active if the binding on it actually changes
+  if (state.textures[unit][index] == texture) {
+    frame_stats.skipped[GL_STATE_TEXTURE]++;
+    return;
+  }
+  set_active_unit(unit);
+  changed(GL_STATE_TEXTURE, &state.textures[unit][index], texture);
+  glBindTexture(target, texture);
+}
+
+void gl_state_edit_texture(GLenum target, GLuint texture)
+{
+  ensure_valid();
+  if (state.active_unit == UNKNOWN)
+    set_active_unit(0);
+  gl_state_bind_texture(state.active_unit, target, texture);
+}
+
+void gl_state_bind_sampler(uint32_t unit, GLuint sampler)
+{
+  ensure_valid();
+  if (unit >= GL_STATE_TEXTURE_UNITS) {
+    frame_stats.issued[GL_STATE_SAMPLER]++;
+    glBindSampler(unit, sampler);
+    return;
+  }
+  if (changed(GL_STATE_SAMPLER, &state.samplers[unit], sampler))
+    glBindSampler(unit, sampler);
+}
+
+void gl_state_bind_vertex_array(GLuint vao)
+{
+  ensure_valid();
+  if (changed(GL_STATE_VERTEX_ARRAY, &state.vertex_array, vao)) {
+    glBindVertexArray(vao);
+    // The element buffer binding belongs to the VAO that was just bound
+    state.buffers[buffer_target_index(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+  }
+}
+
+void gl_state_bind_buffer(GLenum target, GLuint buffer)
+{
+  ensure_valid();
+  int32_t index = buffer_target_index(target);
+  if (index < 0) {
+    frame_stats.issued[GL_STATE_BUFFER]++;
+    glBindBuffer(target, buffer);
+    return;
+  }
+  if (changed(GL_STATE_BUFFER, &state.buffers[index], buffer))
+    glBindBuffer(target, buffer);
+}
+
+void gl_state_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+  ensure_valid();
+  buffer_range_t* ranges = target == GL_UNIFORM_BUFFER ? state.uniform_ranges :
+    target == GL_SHADER_STORAGE_BUFFER ? state.storage_ranges : NULL;
+
+  if (ranges && index < GL_STATE_BUFFER_BINDINGS) {
+    buffer_range_t* range = &ranges[index];
+    if (range->buffer == buffer && range->offset == offset && range->size == size) {
+      frame_stats.skipped[GL_STATE_BUFFER]++;
+      return;
+    }
+    range->buffer = buffer;
+    range->offset = offset;
+    range->size = size;
+  }
+
+  frame_stats.issued[GL_STATE_BUFFER]++;
+  glBindBufferRange(target, index, buffer, offset, size);
+
+  int32_t generic = buffer_target_index(target);
+  if (generic >= 0)
+    state.buffers[generic] = buffer;
+}
+
+void gl_state_forget_program(GLuint program)
+{
+  if (state.program == program)
+    state.program = UNKNOWN;
+}
+
+void gl_state_forget_texture(GLuint texture)
+{
+  for (uint32_t unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++) {
+    for (uint32_t t = 0; t < TEXTURE_TARGETS; t++) {
+      if (state.textures[unit][t] == texture)
+	state.textures[unit][t] = UNKNOWN;
+    }
+  }
+}
+
+void gl_state_forget_sampler(GLuint sampler)
+{
+  for (uint32_t unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++) {
+    if (state.samplers[unit] == sampler)
+      state.samplers[unit] = UNKNOWN;
+  }
+}
+
+void gl_state_forget_vertex_array(GLuint vao)
+{
+  if (state.vertex_array == vao) {
+    state.vertex_array = UNKNOWN;
+    state.buffers[buffer_target_index(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+  }
+}
+
+void gl_state_forget_buffer(GLuint buffer)
+{
+  for (uint32_t i = 0; i < BUFFER_TARGETS; i++) {
+    if (state.buffers[i] == buffer)
+      state.buffers[i] = UNKNOWN;
+  }
+  for (uint32_t i = 0; i < GL_STATE_BUFFER_BINDINGS; i++) {
+    if (state.uniform_ranges[i].buffer == buffer)
+      state.uniform_ranges[i].buffer = UNKNOWN;
+    if (state.storage_ranges[i].buffer == buffer)
+      state.storage_ranges[i].buffer = UNKNOWN;
+  }
+}
+
+void gl_state_begin_frame(void)
+{
+  frame_stats.total_issued = 0;
+  frame_stats.total_skipped = 0;
+  for (uint32_t i = 0; i < GL_STATE_KIND_COUNT; i++) {
+    frame_stats.total_issued += frame_stats.issued[i];
+    frame_stats.total_skipped += frame_stats.skipped[i];
+  }
+
+  last_stats = frame_stats;
+  memset(&frame_stats, 0, sizeof(frame_stats));
+}
+
+gl_state_stats_t gl_state_get_stats(void)
+{
+  return last_stats;
+}
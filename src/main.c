@@ -1,6 +1,24 @@
 #include "main.h"
+#include "camera.h"
+#include "clipmap.h"
+#include "gl_state.h"
 #include "shader.h"
+#include "shader_cache.h"
+#include "shader_variants.h"
+#include "shader_watch.h"
 #include "image_loader.h"
+#include "texture_residency.h"
+#include "texture_watch.h"
+#include "thread_pool.h"
+#include "render_queue.h"
+#include "mesh_pool.h"
+#include "mesh_optimizer.h"
+#include "cull.h"
+#include "occlusion.h"
+#include "ring_buffer.h"
+#include "terrain.h"
+#include "uniform_buffer.h"
+#include "virtual_texture.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,6 +30,9 @@
 
 #define WIDTH 800
 #define HEIGHT 600
+#define VT_DEMO_PAGES 64             // virtual texture pages per side, 8192 texels at mip 0
+#define VT_PAGE_TABLE_UNIT 4         // clear of the units the reflection hands out
+#define VT_PHYSICAL_UNIT 5
 
 // TODO: Check for memory leaks
 // TODO: change all the ints to lower level with minimum sizing, ie 16 bit etc.
@@ -21,7 +42,6 @@ int main()
   // STEP 0 :: INITIALIZE VARIABLES
   GLFWwindow* window_ptr = NULL; // Initialize pointers to NULL
   
-  uint32_t VBO, EBO, VAO;
   int32_t success, nrAttributes;
   
   float vertices[] = {
@@ -42,36 +62,283 @@ int main()
   
   // STEP 1 :: CREATE & INITIALIZE WINDOW
   make_window(&window_ptr, WIDTH, HEIGHT, background_color);
+  thread_pool_t* workers = thread_pool_create(0);
 
   // STEP 2 :: SETUP VERTICES / INDICES DATA
-  setup_vertex_data(vertices, sizeof(vertices), indices, sizeof(indices), &VAO, &VBO, &EBO);
+  // Every mesh lives in the pool's shared buffers behind one VAO, so their draws can be merged
+  // Stored as half floats and bytes, 16 bytes a vertex instead of 32
+  const vertex_format_t* quad_format = &vertex_format_pos_color_uv_compact;
+  vertex_layout_t quad_layout = vertex_layout_from_format(quad_format);
+  uint32_t quad_components = vertex_format_source_components(quad_format);
+  uint32_t quad_index_count = sizeof(indices) / sizeof(indices[0]);
+
+  // Reordered for the vertex cache, overdraw and fetch locality before encoding
+  mesh_optimize_stats_t optimize_stats;
+  uint32_t quad_vertex_count = mesh_optimize(vertices, sizeof(vertices) / sizeof(float) / quad_components,
+					     quad_components, indices, quad_index_count, &optimize_stats);
+  printf("Mesh optimized: %u -> %u vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+	 optimize_stats.vertices_before, optimize_stats.vertices_after,
+	 optimize_stats.before.acmr, optimize_stats.after.acmr, optimize_stats.before.atvr, optimize_stats.after.atvr);
+
+  uint8_t quad_vertices[sizeof(vertices)];  // encoded is never bigger than the floats
+  vertex_format_convert(quad_format, vertices, quad_vertex_count, quad_vertices);
+
+  mesh_pool_t* meshes = mesh_pool_create(&quad_layout, 0, 0);
+  mesh_t quad_mesh;
+  mesh_pool_add(meshes, quad_vertices, quad_vertex_count,
+		indices, quad_index_count, &quad_mesh);
+
+  // Bounds of everything drawable, tested against the frustum each frame
+  cull_objects_t* cullables = cull_objects_create(0);
+  cull_objects_add(cullables, (vec3){ 0.0f, 0.0f, 0.0f }, (vec3){ 0.5f, 0.5f, 0.0f });
+  uint32_t* visible = malloc(cull_objects_count(cullables) * sizeof(uint32_t));
+  printf("Culling with %s\n", cull_simd_name());
+
+  // Static scene in a BVH for picking, same indices as cullables
+  aabb_t scene_bounds[] = { { { -0.5f, -0.5f, 0.0f }, { 0.5f, 0.5f, 0.0f } } };
+  bvh_t* scene = bvh_build(scene_bounds, sizeof(scene_bounds) / sizeof(scene_bounds[0]), workers);
+  bool mouse_was_down = false;
+
+  // Big flat things hide what's behind them, the quad is its own occluder. Occluder depth is
+  // pushed back, so testing the quad's own bounds against it never hides the quad
+  occlusion_t* occluders = occlusion_create(OCCLUSION_DEFAULT_WIDTH, OCCLUSION_DEFAULT_HEIGHT);
+  mat4 quad_transform;
+  glm_mat4_identity(quad_transform);
+  occlusion_add_occluder(occluders, vertices, quad_components, quad_vertex_count,
+			 indices, quad_index_count, quad_transform);
+  printf("Occlusion rasterizer using %s\n", occlusion_simd_name());
   
-  // STEP 3 :: CREATE SHADER
-  shader_t shader = shader_create(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
-  printf("Shader loaded: (ID %u)\n", shader.id);
+  // STEP 3 :: CREATE UNIFORM BUFFERS
+  // Registered before any program links so their blocks get checked against the C structs
+  // Per-frame data is rewritten every frame, so it's streamed instead of living in its own buffer
+  ring_buffer_t* stream = ring_buffer_create(RING_BUFFER_DEFAULT_FRAME_SIZE);
+  ubo_layout_register(&frame_uniforms_layout);
+  uniform_buffer_t material_ubo = uniform_buffer_create(&material_uniforms_layout, 1);
+
+  // Materials only change when edited, not per frame
+  material_uniforms_t material = {
+    .base_color = { 1.0f, 1.0f, 1.0f, 1.0f },
+    .uv_transform = { 1.0f, 1.0f, 0.0f, 0.0f },
+    .roughness = 1.0f,
+  };
+  uniform_buffer_update(&material_ubo, 0, &material);
+
+  frame_uniforms_t frame = { 0 };
+  glm_mat4_identity(frame.view);
+  glm_mat4_identity(frame.projection);
+  glm_mat4_identity(frame.view_projection);
+  double last_time = glfwGetTime();
+
+  // Starts just behind the quad, looking at it
+  camera_t camera = camera_create((vec3){ 0.0f, 0.0f, 2.0f }, 0.0f, 0.0f, 1000.0f);
+
+  // STEP 4 :: CREATE SHADER
+  // Compiled in the background, frames are drawn without it until it's ready
+  // Only the permutations actually requested get compiled, this quad needs the base one
+  shader_watch_init();
+  shader_batch_t* shaders = shader_batch_create();
+  shader_variants_t* quad_variants = shader_variants_create(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+  const char* quad_defines[] = { "INSTANCED" };
+  const shader_t* shader = shader_variant(quad_variants, quad_defines, 1, shaders);
+  shader_variants_t* terrain_variants = shader_variants_create(TERRAIN_VERTEX_SHADER_PATH, TERRAIN_FRAGMENT_SHADER_PATH);
+  const shader_t* terrain_shader = shader_variant(terrain_variants, NULL, 0, shaders);
+  shader_variants_t* clipmap_variants = shader_variants_create(CLIPMAP_VERTEX_SHADER_PATH, TERRAIN_FRAGMENT_SHADER_PATH);
+  const shader_t* clipmap_shader = shader_variant(clipmap_variants, clipmap_shader_defines,
+						  CLIPMAP_SHADER_DEFINE_COUNT, shaders);
+  shader_variants_t* vt_variants = shader_variants_create(VERTEX_SHADER_PATH, VT_FRAGMENT_SHADER_PATH);
+  const shader_t* vt_shader = shader_variant(vt_variants, quad_defines, 1, shaders);
+  shader_variants_t* vt_feedback_variants = shader_variants_create(VERTEX_SHADER_PATH, VT_FEEDBACK_FRAGMENT_SHADER_PATH);
+  const shader_t* vt_feedback_shader = shader_variant(vt_feedback_variants, quad_defines, 1, shaders);
+  uint32_t clipmap_unit = 0;
+  uint32_t texture_unit = 0;    // looked up whenever the program is (re)linked
+  GLuint clipmap_unit_program = 0;
+  GLuint texture_unit_program = 0;
+
+  // Draws are pushed as packets each frame and sorted to keep state changes down
+  render_queue_t* queue = render_queue_create(RENDER_QUEUE_DEFAULT_CAPACITY, stream);
+
+  // Per-instance attributes come from the queue's instance stream
+  mesh_pool_bind_instances(meshes, render_queue_instance_buffer(queue), &vertex_layout_instance);
+
+  // Ground chunks are generated on the workers as the camera moves, without them only the
+  // clipmap is drawn
+  terrain_t* terrain = terrain_create(workers, TERRAIN_DEFAULT_VIEW_CHUNKS);
+  if (terrain)
+    terrain_bind_instances(terrain, render_queue_instance_buffer(queue), &vertex_layout_instance);
+
+  // Or the same ground as a clipmap displaced on the GPU, C switches between them when both exist
+  clipmap_t* clipmap = clipmap_create(workers);
+  if (clipmap)
+    clipmap_bind_instances(clipmap, render_queue_instance_buffer(queue), &vertex_layout_instance);
+  bool use_clipmap = !terrain && clipmap;
+  bool toggle_was_down = false;
+
+  instance_data_t quad_instance = {
+    .color = { 1.0f, 1.0f, 1.0f, 1.0f },
+    .uv_rect = { 0.0f, 0.0f, 1.0f, 1.0f },
+  };
+  glm_mat4_identity(quad_instance.transform);
+
+  // A panel left of the quad textured from a virtual texture, finer pages stream in as the camera
+  // gets closer. Only the panel goes through the feedback pass
+  vt_desc_t vt_desc = { VT_DEMO_PAGES, VT_DEFAULT_PHYS_PAGES, vt_generate_terrain, NULL };
+  virtual_texture_t* vt = vt_create(&vt_desc, workers);
+  instance_data_t panel_instance = quad_instance;
+  glm_translate(panel_instance.transform, (vec3){ -1.5f, 0.0f, 0.0f });
   
-  // STEP 4 :: ADD TEXTURES
-  texture_t texture = texture_load_bmp(TEXTURE_PATH);
-  printf("Texture loaded: (ID %u)\n", texture.id);
+  // STEP 5 :: ADD TEXTURES
+  // Textures are loaded on first use and may be evicted/reloaded to stay under budget
+  residency_init(RESIDENCY_DEFAULT_BUDGET);
+  residency_handle_t texture = residency_register(TEXTURE_PATH, NULL, NULL);
+  if (texture != RESIDENCY_INVALID_HANDLE)
+    printf("Texture loaded: (ID %u)\n", residency_acquire(texture)->id);
+
+  // Re-decode textures on the workers when their file is saved
+  texture_watch_init(workers);
+  if (texture != RESIDENCY_INVALID_HANDLE)
+    texture_watch_add(residency_texture(texture), TEXTURE_PATH, retry_texture, &texture);
 
   // Main Loop
   while (!glfwWindowShouldClose(window_ptr)) {
     // Input
     process_input(window_ptr);
 
-    // Clear screen
-    glClear(GL_COLOR_BUFFER_BIT);
+    // Move the camera before anything reads this frame's matrices
+    double now = glfwGetTime();
+    float dt = (float)(now - last_time);
+    last_time = now;
+    camera_update(&camera, window_ptr, dt);
+
+    int32_t framebuffer_width, framebuffer_height;
+    glfwGetFramebufferSize(window_ptr, &framebuffer_width, &framebuffer_height);
+    if (framebuffer_width > 0 && framebuffer_height > 0)
+      camera_frame_uniforms(&camera, (float)framebuffer_width / (float)framebuffer_height, &frame);
+    frame.time[0] = (float)now;
+    frame.time[1] = dt;
+
+    // Occluders rasterize on the workers while the rest of the frame gets going
+    occlusion_begin_frame(occluders, frame.view_projection, workers);
+    bool mouse_down = glfwGetMouseButton(window_ptr, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    if (mouse_down && !mouse_was_down)
+      pick_object(window_ptr, frame.view_projection, scene);
+    mouse_was_down = mouse_down;
+    bool toggle_down = glfwGetKey(window_ptr, GLFW_KEY_C) == GLFW_PRESS;
+    if (toggle_down && !toggle_was_down && terrain && clipmap) {
+      use_clipmap = !use_clipmap;
+      printf("Terrain: %s\n", use_clipmap ? "clipmap" : "chunks");
+    }
+    toggle_was_down = toggle_down;
+    gl_state_begin_frame();
+    ring_buffer_begin_frame(stream);
+    residency_begin_frame();
+    texture_watch_poll();
+    shader_watch_poll();
+    if (use_clipmap)
+      clipmap_update(clipmap, camera.position);
+    else if (terrain)
+      terrain_update(terrain, camera.position);
+
+    // Pick up shaders as they finish compiling
+    if (shaders && shader_batch_poll(shaders)) {
+      shader_batch_destroy(shaders);
+      shaders = NULL;
+      printf("Shader loaded: (ID %u)\n", shader->id);
+
+      // Catch attribute and sampler mismatches now instead of as a broken picture
+      const vertex_layout_t* quad_layouts[] = { &quad_layout, &vertex_layout_instance };
+      shader_validate_vertex_layout(shader, quad_layouts, 2);
+      shader_validate_samplers(shader);
+      shader_validate_vertex_layout(vt_shader, quad_layouts, 2);
+      shader_validate_vertex_layout(vt_feedback_shader, quad_layouts, 2);
+      const vertex_layout_t* terrain_layouts[] = { &terrain_vertex_layout, &vertex_layout_instance };
+      shader_validate_vertex_layout(terrain_shader, terrain_layouts, 2);
+      const vertex_layout_t* clipmap_layouts[] = { &clipmap_vertex_layout, &vertex_layout_instance };
+      shader_validate_vertex_layout(clipmap_shader, clipmap_layouts, 2);
+      shader_validate_samplers(clipmap_shader);
+
+      shader_cache_stats_t shader_stats = shader_cache_get_stats();
+      printf("Shader startup: %u from cache (%.2f ms), %u compiled (%.2f ms)\n",
+	     shader_stats.hits, shader_stats.hit_ms, shader_stats.misses, shader_stats.miss_ms);
+    }
+
+    // Sampler units come from the program's reflection, so look them up again whenever the batch
+    // or a hot reload hands over a new program
+    if (clipmap_shader->id != clipmap_unit_program) {
+      int32_t slot = shader_sampler_index(clipmap_shader, "clipmap_heights");
+      clipmap_unit = slot >= 0 ? clipmap_shader->reflection.samplers[slot].unit : 0;
+      clipmap_unit_program = clipmap_shader->id;
+    }
+    if (shader->id != texture_unit_program) {
+      int32_t slot = shader_sampler_index(shader, "ourTexture");
+      texture_unit = slot >= 0 ? shader->reflection.samplers[slot].unit : 0;
+      texture_unit_program = shader->id;
+    }
+
+    // Everything per frame goes up in one update, shaders read it from binding 0
+    ring_buffer_bind_block(stream, &frame_uniforms_layout, &frame);
+
+    // Upload the pages last frame's feedback asked for, then find out which this view needs
+    bool draw_panel = vt && vt_shader->id != 0 && vt_feedback_shader->id != 0;
+    render_packet_t panel = { 0 };
+    mesh_pool_packet(meshes, &quad_mesh, &panel);
+    if (vt)
+      vt_update(vt);
+    if (draw_panel && framebuffer_width > 0 && framebuffer_height > 0) {
+      vt_feedback_begin(vt, (uint32_t)framebuffer_width, (uint32_t)framebuffer_height);
+      vt_bind(vt, vt_feedback_shader, VT_PAGE_TABLE_UNIT, VT_PHYSICAL_UNIT, true);
+      panel.key = render_key_instanced(0, vt_feedback_shader->id, 0, 0, quad_mesh.index_offset);
+      panel.shader = vt_feedback_shader;
+      render_queue_push_instanced(queue, &panel, &panel_instance);
+      render_queue_sort(queue);
+      render_queue_submit(queue);
+      render_queue_clear(queue);
+      vt_feedback_end(vt);
+    }
 
-    // Use correct shader program
-    shader_use(&shader);
-
-    // Activate and bind texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture.id);
+    // Clear screen
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // The quad is the only object, so anything visible is it
+    uint32_t visible_count = cull_frustum(cullables, frame.view_projection, workers, visible);
+    visible_count = occlusion_filter(occluders, scene_bounds, visible, visible_count);
+
+    const texture_t* quad_texture = NULL;
+    if (shader->id != 0 && visible_count > 0)
+      quad_texture = residency_acquire(texture);
+
+    // Skipped while the file fails to load, the watch retries it when it's saved again
+    if (quad_texture && quad_texture->id != 0) {
+      render_packet_t quad = {
+	.key = render_key_instanced(0, shader->id, 0, quad_texture->id, quad_mesh.index_offset),
+	.shader = shader,
+	.texture = quad_texture->id,
+	.sampler = quad_texture->sampler,
+	.texture_unit = texture_unit,
+	.material = &material_ubo,
+	.material_index = 0,
+      };
+      mesh_pool_packet(meshes, &quad_mesh, &quad);
+      render_queue_push_instanced(queue, &quad, &quad_instance);
+    }
+
+    // Page table and cache stay on their own units, the packet binds no texture of its own
+    if (draw_panel) {
+      vt_bind(vt, vt_shader, VT_PAGE_TABLE_UNIT, VT_PHYSICAL_UNIT, false);
+      panel.key = render_key_instanced(0, vt_shader->id, 0, 0, quad_mesh.index_offset);
+      panel.shader = vt_shader;
+      render_queue_push_instanced(queue, &panel, &panel_instance);
+    }
+
+    if (use_clipmap)
+      clipmap_draw(clipmap, queue, clipmap_shader, clipmap_unit);
+    else if (terrain)
+      terrain_draw(terrain, queue, terrain_shader, frame.view_projection);
 
     // Draw to screen
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    render_queue_sort(queue);
+    render_queue_submit(queue);
+    render_queue_clear(queue);
+    ring_buffer_end_frame(stream);
 
     // Check and call events and swap the buffers
     glfwSwapBuffers(window_ptr);
@@ -79,11 +346,51 @@ int main()
   }
 
   // Upon termination
-  glDeleteVertexArrays(1, &VAO);
-  glDeleteBuffers(1, &VBO);
+  gl_state_stats_t state_stats = gl_state_get_stats();
+  printf("GL binds last frame: %u issued, %u skipped\n", state_stats.total_issued, state_stats.total_skipped);
+  ring_buffer_stats_t stream_stats = ring_buffer_get_stats(stream);
+  printf("Stream buffer: %zu bytes last frame, %zu peak\n", stream_stats.used, stream_stats.peak);
+  occlusion_stats_t occlusion_stats = occlusion_get_stats(occluders);
+  printf("Occlusion last frame: %u of %u hidden, %.3f ms rasterizing, %.3f ms waited on\n",
+	 occlusion_stats.occluded, occlusion_stats.tested, occlusion_stats.raster_ms, occlusion_stats.wait_ms);
+  if (terrain) {
+    terrain_stats_t terrain_stats = terrain_get_stats(terrain);
+    printf("Terrain last frame: %u chunks resident, %u drawn, %u pending\n",
+	   terrain_stats.resident, terrain_stats.drawn, terrain_stats.pending);
+  }
+  if (clipmap) {
+    clipmap_stats_t clipmap_stats = clipmap_get_stats(clipmap);
+    printf("Clipmap last update: %u heights generated in %u levels, %.3f ms\n",
+	   clipmap_stats.samples, clipmap_stats.levels_moved, clipmap_stats.update_ms);
+  }
+  if (vt) {
+    vt_stats_t vt_stats = vt_get_stats(vt);
+    printf("Virtual texture: %u pages resident, %u pending, %u evicted\n",
+	   vt_stats.resident_pages, vt_stats.pending_pages, vt_stats.evictions);
+  }
 
-  texture_destroy_bmp(&texture);
-  shader_destroy(&shader);
+  vt_destroy(vt);
+  terrain_destroy(terrain);
+  clipmap_destroy(clipmap);
+  mesh_pool_destroy(meshes);
+  cull_objects_destroy(cullables);
+  free(visible);
+  bvh_destroy(scene);
+  occlusion_destroy(occluders);
+  texture_watch_shutdown();
+  residency_shutdown();
+  sampler_cache_destroy();
+  shader_batch_destroy(shaders);
+  shader_watch_shutdown();
+  shader_variants_destroy(quad_variants);
+  shader_variants_destroy(terrain_variants);
+  shader_variants_destroy(clipmap_variants);
+  shader_variants_destroy(vt_variants);
+  shader_variants_destroy(vt_feedback_variants);
+  render_queue_destroy(queue);
+  ring_buffer_destroy(stream);
+  uniform_buffer_destroy(&material_ubo);
+  thread_pool_destroy(workers);
   glfwDestroyWindow(window_ptr);
   glfwTerminate();
   
@@ -101,68 +408,38 @@ void process_input(GLFWwindow* window_ptr)
     glfwSetWindowShouldClose(window_ptr, true);
 }
 
-void setup_vertex_data(
-   float* vertices, size_t vert_size,
-   uint32_t* indices, size_t index_size,
-   uint32_t* vao_out, uint32_t* vbo_out, uint32_t* ebo_out)
+void retry_texture(void* user)
 {
-  // VAO --> Vertex Array Object: Remembers how vertex data is laid out
-  // VBO --> Vertex Buffer Object: Holds vertex data
-  // EBO --> Element Buffer Object: Holds index data if reusing vertices
-
-  // Generate and bind VAO
-  glGenVertexArrays(1, vao_out);
-  glBindVertexArray(*vao_out);
-
-  // Generate and bind VBO
-  glGenBuffers(1, vbo_out);
-  glBindBuffer(GL_ARRAY_BUFFER, *vbo_out);
-  glBufferData(GL_ARRAY_BUFFER, vert_size, vertices, GL_STATIC_DRAW);
-
-  // Generate and bind EBO
-  glGenBuffers(1, ebo_out);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *ebo_out);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size, indices, GL_STATIC_DRAW);
-
-  // Describe vertex data layout
-  const uint32_t stride = 8 * sizeof(float);
-
-  // Vertex Position
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0); //(void*)0 --> index starts at 0 position
-  glEnableVertexAttribArray(0);
-
-  // Vertex Color
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float))); 
-  glEnableVertexAttribArray(1);
-
-  // Vertex Texture
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
+  residency_retry(*(const residency_handle_t*)user);
+}
 
-  // Example //
-  
-  /* float vertices[] = */
-  /* { */
-  /*    // positions         // colors */
-  /*    0.0f,  0.5f, 0.0f,  1.0f, 0.0f, 0.0f,  // top center */
-  /*    0.5f, -0.5f, 0.0f,  0.0f, 1.0f, 0.0f,  // bottom right */
-  /*   -0.5f, -0.5f, 0.0f,  0.0f, 0.0f, 1.0f   // bottom left */
-  /* }; */
-
-  /* unsigned int indices[] = */
-  /* {  */
-  /*   0, 1, 2, // first triangle */
-  /* }; */
-
-  // End Example //
+void pick_object(GLFWwindow* window_ptr, mat4 view_projection, const bvh_t* scene)
+{
+  double x, y;
+  int32_t width, height;
+  glfwGetCursorPos(window_ptr, &x, &y);
+  glfwGetWindowSize(window_ptr, &width, &height);
+
+  // Segment from the near to the far plane under the cursor, window y points down
+  vec4 viewport = { 0.0f, 0.0f, (float)width, (float)height };
+  vec3 near = { (float)x, (float)(height - y), 0.0f };
+  vec3 far = { (float)x, (float)(height - y), 1.0f };
+  vec3 origin, end, direction;
+  glm_unproject(near, view_projection, viewport, origin);
+  glm_unproject(far, view_projection, viewport, end);
+  glm_vec3_sub(end, origin, direction);
+
+  bvh_hit_t hit;
+  if (bvh_raycast(scene, origin, direction, 1.0f, NULL, NULL, &hit))
+    printf("Picked object %u\n", hit.primitive);
 }
 
 int make_window(GLFWwindow** window_ptr, int32_t width, int32_t height, const float background_color[4])
 {
   // Initialize GLFW Window
   glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
   // Create GLFW Window
@@ -185,6 +462,9 @@ int make_window(GLFWwindow** window_ptr, int32_t width, int32_t height, const fl
   // Set screen color
   glClearColor(background_color[0], background_color[1], background_color[2], background_color[3]);
 
+  // Nearer surfaces hide farther ones, the terrain isn't drawn in any particular order
+  glEnable(GL_DEPTH_TEST);
+
   // Tell OpenGL size of rendering window
   glViewport(0, 0, width, height);
 
@@ -0,0 +1,453 @@
+#include "mesh_optimizer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_SCALE 2.0f
+#define FORSYTH_VALENCE_POWER 0.5f
+
+/* VALIDATION */
+
+bool mesh_indices_valid(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count)
+{
+  if (index_count % 3 != 0) {
+    fprintf(stderr, "Mesh index count %u is not whole triangles\n", index_count);
+    return false;
+  }
+  for (uint32_t i = 0; i < index_count; i++) {
+    if (indices[i] >= vertex_count) {
+      fprintf(stderr, "Mesh index %u is %u, past the last of %u vertices\n", i, indices[i], vertex_count);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* ANALYSIS */
+
+mesh_cache_stats_t mesh_analyze(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count,
+				uint32_t cache_size)
+{
+  mesh_cache_stats_t stats = { 0.0f, 0.0f };
+  if (index_count < 3 || vertex_count == 0 || !mesh_indices_valid(indices, index_count, vertex_count))
+    return stats;
+
+  // A vertex is in the FIFO if it went in less than cache_size misses ago
+  uint32_t* timestamps = calloc(vertex_count, sizeof(uint32_t));
+  if (!timestamps) {
+    fprintf(stderr, "Memory allocation failed for mesh analysis\n");
+    return stats;
+  }
+
+  uint32_t misses = 0;
+  uint32_t referenced = 0;
+  for (uint32_t i = 0; i < index_count; i++) {
+    uint32_t* stamp = &timestamps[indices[i]];
+    if (*stamp == 0)
+      referenced++;
+    if (*stamp == 0 || misses + 1 - *stamp > cache_size) {
+      misses++;
+      *stamp = misses;
+    }
+  }
+  free(timestamps);
+
+  stats.acmr = (float)misses / (float)(index_count / 3);
+  stats.atvr = (float)misses / (float)referenced;
+  return stats;
+}
+
+/* WELDING */
+
+// FNV-1a 64
+static uint64_t hash_bytes(const uint8_t* data, uint32_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (uint32_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+uint32_t mesh_weld(const void* vertices, uint32_t vertex_count, uint32_t stride,
+		   uint32_t* indices, uint32_t index_count)
+{
+  if (!mesh_indices_valid(indices, index_count, vertex_count))
+    return vertex_count;
+
+  // Open addressing, at most half full
+  uint32_t table_size = 1;
+  while (table_size < vertex_count * 2)
+    table_size *= 2;
+
+  uint32_t* table = malloc(table_size * sizeof(uint32_t));
+  uint32_t* remap = malloc(vertex_count * sizeof(uint32_t));
+  if (!table || !remap) {
+    fprintf(stderr, "Memory allocation failed for mesh welding\n");
+    free(table);
+    free(remap);
+    return vertex_count;
+  }
+  memset(table, 0xFF, table_size * sizeof(uint32_t));
+
+  const uint8_t* bytes = vertices;
+  uint32_t unique = 0;
+  for (uint32_t v = 0; v < vertex_count; v++) {
+    const uint8_t* vertex = bytes + (size_t)v * stride;
+    uint32_t slot = (uint32_t)hash_bytes(vertex, stride) & (table_size - 1);
+    while (table[slot] != UINT32_MAX && memcmp(bytes + (size_t)table[slot] * stride, vertex, stride) != 0)
+      slot = (slot + 1) & (table_size - 1);
+
+    if (table[slot] == UINT32_MAX) {
+      table[slot] = v;
+      unique++;
+    }
+    remap[v] = table[slot];
+  }
+
+  for (uint32_t i = 0; i < index_count; i++)
+    indices[i] = remap[indices[i]];
+
+  free(table);
+  free(remap);
+  return unique;
+}
+
+/* VERTEX CACHE */
+
+static float vertex_score(int32_t cache_position, uint32_t live_triangles)
+{
+  if (live_triangles == 0)
+    return -1.0f;
+
+  float score = 0.0f;
+  if (cache_position >= 0) {
+    // The last triangle's vertices get a fixed score so the next one doesn't just reuse its edge
+    if (cache_position < 3)
+      score = FORSYTH_LAST_TRIANGLE_SCORE;
+    else
+      score = powf(1.0f - (float)(cache_position - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_DECAY_POWER);
+  }
+
+  // Finish off vertices with few triangles left so they don't need loading again later
+  return score + FORSYTH_VALENCE_SCALE * powf((float)live_triangles, -FORSYTH_VALENCE_POWER);
+}
+
+bool mesh_optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count)
+{
+  if (!mesh_indices_valid(indices, index_count, vertex_count))
+    return false;
+
+  uint32_t triangle_count = index_count / 3;
+  if (triangle_count < 2)
+    return true;
+
+  uint32_t* live = calloc(vertex_count, sizeof(uint32_t));
+  uint32_t* offsets = malloc((vertex_count + 1) * sizeof(uint32_t));
+  uint32_t* adjacency = malloc(index_count * sizeof(uint32_t));
+  int32_t* cache_position = malloc(vertex_count * sizeof(int32_t));
+  float* scores = malloc(vertex_count * sizeof(float));
+  bool* emitted = calloc(triangle_count, sizeof(bool));
+  uint32_t* output = malloc(index_count * sizeof(uint32_t));
+  bool ok = live && offsets && adjacency && cache_position && scores && emitted && output;
+  if (!ok) {
+    fprintf(stderr, "Memory allocation failed for vertex cache optimization\n");
+    goto done;
+  }
+
+  // Triangles using each vertex, packed by vertex
+  for (uint32_t i = 0; i < index_count; i++)
+    live[indices[i]]++;
+  offsets[0] = 0;
+  for (uint32_t v = 0; v < vertex_count; v++)
+    offsets[v + 1] = offsets[v] + live[v];
+  memset(live, 0, vertex_count * sizeof(uint32_t));
+  for (uint32_t t = 0; t < triangle_count; t++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      uint32_t v = indices[t * 3 + c];
+      adjacency[offsets[v] + live[v]++] = t;
+    }
+  }
+
+  for (uint32_t v = 0; v < vertex_count; v++) {
+    cache_position[v] = -1;
+    scores[v] = vertex_score(-1, live[v]);
+  }
+
+  // Room for the triangle being added on top of a full cache
+  uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+  uint32_t cache_count = 0;
+  uint32_t cursor = 0;
+  int64_t best = -1;
+
+  for (uint32_t out = 0; out < triangle_count; out++) {
+    // Nothing left next to the cache, start again from the next triangle in input order
+    if (best < 0) {
+      while (emitted[cursor])
+	cursor++;
+      best = cursor;
+    }
+
+    uint32_t triangle = (uint32_t)best;
+    const uint32_t* corners = &indices[triangle * 3];
+    memcpy(&output[out * 3], corners, 3 * sizeof(uint32_t));
+    emitted[triangle] = true;
+
+    for (uint32_t c = 0; c < 3; c++) {
+      uint32_t v = corners[c];
+      uint32_t* list = &adjacency[offsets[v]];
+      for (uint32_t i = 0; i < live[v]; i++) {
+	if (list[i] == triangle) {
+	  list[i] = list[--live[v]];
+	  break;
+	}
+      }
+    }
+
+    // LRU: this triangle's vertices go to the front, everything else shifts back
+    uint32_t next[FORSYTH_CACHE_SIZE + 3];
+    uint32_t next_count = 0;
+    for (uint32_t c = 0; c < 3; c++)
+      next[next_count++] = corners[c];
+    for (uint32_t i = 0; i < cache_count; i++) {
+      uint32_t v = cache[i];
+      if (v != corners[0] && v != corners[1] && v != corners[2])
+	next[next_count++] = v;
+    }
+
+    for (uint32_t i = 0; i < next_count; i++) {
+      uint32_t v = next[i];
+      cache_position[v] = i < FORSYTH_CACHE_SIZE ? (int32_t)i : -1;
+      scores[v] = vertex_score(cache_position[v], live[v]);
+    }
+    cache_count = next_count < FORSYTH_CACHE_SIZE ? next_count : FORSYTH_CACHE_SIZE;
+    memcpy(cache, next, cache_count * sizeof(uint32_t));
+
+    // Only triangles touching the cache changed score, the best one is among them
+    best = -1;
+    float best_score = -1.0f;
+    for (uint32_t i = 0; i < next_count; i++) {
+      uint32_t v = next[i];
+      for (uint32_t a = 0; a < live[v]; a++) {
+	uint32_t t = adjacency[offsets[v] + a];
+	float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+	if (score > best_score) {
+	  best_score = score;
+	  best = t;
+	}
+      }
+    }
+  }
+
+  memcpy(indices, output, index_count * sizeof(uint32_t));
+
+done:
+  free(live);
+  free(offsets);
+  free(adjacency);
+  free(cache_position);
+  free(scores);
+  free(emitted);
+  free(output);
+  return ok;
+}
+
+/* OVERDRAW */
+
+typedef struct {
+  uint32_t first;              // triangle
+  uint32_t count;
+  float sort_key;
+} overdraw_cluster_t;
+
+static const float* position(const float* positions, uint32_t stride, uint32_t vertex)
+{
+  return (const float*)((const uint8_t*)positions + (size_t)vertex * stride);
+}
+
+static int compare_clusters(const void* a, const void* b)
+{
+  const overdraw_cluster_t* ca = a;
+  const overdraw_cluster_t* cb = b;
+  if (ca->sort_key != cb->sort_key)
+    return ca->sort_key > cb->sort_key ? -1 : 1;
+  // Keep the cache order between equal clusters
+  return ca->first < cb->first ? -1 : ca->first > cb->first;
+}
+
+bool mesh_optimize_overdraw(uint32_t* indices, uint32_t index_count, const float* positions,
+			    uint32_t vertex_count, uint32_t stride)
+{
+  if (!mesh_indices_valid(indices, index_count, vertex_count))
+    return false;
+
+  uint32_t triangle_count = index_count / 3;
+  if (triangle_count < 2)
+    return true;
+
+  uint32_t* timestamps = calloc(vertex_count, sizeof(uint32_t));
+  overdraw_cluster_t* clusters = malloc(triangle_count * sizeof(overdraw_cluster_t));
+  uint32_t* output = malloc(index_count * sizeof(uint32_t));
+  bool ok = timestamps && clusters && output;
+  if (!ok) {
+    fprintf(stderr, "Memory allocation failed for overdraw optimization\n");
+    goto done;
+  }
+
+  // A triangle whose three vertices all miss is where the cache order jumped somewhere new,
+  // splitting there keeps each cluster's reuse intact
+  uint32_t cluster_count = 0;
+  uint32_t misses = 0;
+  for (uint32_t t = 0; t < triangle_count; t++) {
+    uint32_t triangle_misses = 0;
+    for (uint32_t c = 0; c < 3; c++) {
+      uint32_t* stamp = &timestamps[indices[t * 3 + c]];
+      if (*stamp == 0 || misses + 1 - *stamp > MESH_CACHE_SIZE) {
+	misses++;
+	*stamp = misses;
+	triangle_misses++;
+      }
+    }
+    if (t == 0 || triangle_misses == 3)
+      clusters[cluster_count++] = (overdraw_cluster_t){ t, 0, 0.0f };
+    clusters[cluster_count - 1].count++;
+  }
+
+  // First pass finds the area weighted centroid of the mesh, second keys each cluster against it
+  float mesh_centroid[3] = { 0.0f, 0.0f, 0.0f };
+  float mesh_area = 0.0f;
+
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (uint32_t k = 0; k < cluster_count; k++) {
+      overdraw_cluster_t* cluster = &clusters[k];
+      float centroid[3] = { 0.0f, 0.0f, 0.0f };
+      float normal[3] = { 0.0f, 0.0f, 0.0f };
+      float area = 0.0f;
+
+      for (uint32_t t = cluster->first; t < cluster->first + cluster->count; t++) {
+	const float* a = position(positions, stride, indices[t * 3]);
+	const float* b = position(positions, stride, indices[t * 3 + 1]);
+	const float* c = position(positions, stride, indices[t * 3 + 2]);
+	float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	float n[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+	float weight = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+	for (uint32_t i = 0; i < 3; i++) {
+	  centroid[i] += (a[i] + b[i] + c[i]) / 3.0f * weight;
+	  normal[i] += n[i];
+	}
+	area += weight;
+      }
+
+      if (area > 0.0f) {
+	for (uint32_t i = 0; i < 3; i++)
+	  centroid[i] /= area;
+      }
+
+      if (pass == 0) {
+	for (uint32_t i = 0; i < 3; i++)
+	  mesh_centroid[i] += centroid[i] * area;
+	mesh_area += area;
+	continue;
+      }
+
+      // How far the cluster faces away from the middle, the most outward ones occlude the most
+      float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+      float key = 0.0f;
+      if (length > 0.0f) {
+	for (uint32_t i = 0; i < 3; i++)
+	  key += (centroid[i] - mesh_centroid[i]) * normal[i] / length;
+      }
+      cluster->sort_key = key;
+    }
+
+    if (pass == 0 && mesh_area > 0.0f) {
+      for (uint32_t i = 0; i < 3; i++)
+	mesh_centroid[i] /= mesh_area;
+    }
+  }
+
+  qsort(clusters, cluster_count, sizeof(overdraw_cluster_t), compare_clusters);
+
+  uint32_t written = 0;
+  for (uint32_t k = 0; k < cluster_count; k++) {
+    memcpy(&output[written], &indices[clusters[k].first * 3], clusters[k].count * 3 * sizeof(uint32_t));
+    written += clusters[k].count * 3;
+  }
+  memcpy(indices, output, written * sizeof(uint32_t));
+
+done:
+  free(timestamps);
+  free(clusters);
+  free(output);
+  return ok;
+}
+
+/* VERTEX FETCH */
+
+uint32_t mesh_optimize_vertex_fetch(void* vertices, uint32_t vertex_count, uint32_t stride,
+				    uint32_t* indices, uint32_t index_count)
+{
+  if (!mesh_indices_valid(indices, index_count, vertex_count))
+    return vertex_count;
+
+  uint32_t* remap = malloc(vertex_count * sizeof(uint32_t));
+  uint8_t* reordered = malloc((size_t)vertex_count * stride);
+  if (!remap || !reordered) {
+    fprintf(stderr, "Memory allocation failed for vertex fetch optimization\n");
+    free(remap);
+    free(reordered);
+    return vertex_count;
+  }
+  memset(remap, 0xFF, vertex_count * sizeof(uint32_t));
+
+  const uint8_t* bytes = vertices;
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < index_count; i++) {
+    uint32_t v = indices[i];
+    if (remap[v] == UINT32_MAX) {
+      memcpy(reordered + (size_t)count * stride, bytes + (size_t)v * stride, stride);
+      remap[v] = count++;
+    }
+    indices[i] = remap[v];
+  }
+
+  memcpy(vertices, reordered, (size_t)count * stride);
+  free(remap);
+  free(reordered);
+  return count;
+}
+
+uint32_t mesh_optimize(float* vertices, uint32_t vertex_count, uint32_t components,
+		       uint32_t* indices, uint32_t index_count, mesh_optimize_stats_t* stats_out)
+{
+  uint32_t stride = components * sizeof(float);
+  stats_out->vertices_before = vertex_count;
+  stats_out->vertices_after = vertex_count;
+
+  // Every step indexes per-vertex arrays, one bad index would read or write out of bounds
+  if (!mesh_indices_valid(indices, index_count, vertex_count)) {
+    stats_out->before = stats_out->after = (mesh_cache_stats_t){ 0.0f, 0.0f };
+    return vertex_count;
+  }
+
+  stats_out->before = mesh_analyze(indices, index_count, vertex_count, MESH_CACHE_SIZE);
+
+  // Each step works on the previous one's output: welding finds shared vertices so the cache
+  // order can reuse them, overdraw clusters come from the cache order, fetch order follows both
+  mesh_weld(vertices, vertex_count, stride, indices, index_count);
+  if (mesh_optimize_vertex_cache(indices, index_count, vertex_count))
+    mesh_optimize_overdraw(indices, index_count, vertices, vertex_count, stride);
+  vertex_count = mesh_optimize_vertex_fetch(vertices, vertex_count, stride, indices, index_count);
+
+  stats_out->vertices_after = vertex_count;
+  stats_out->after = mesh_analyze(indices, index_count, vertex_count, MESH_CACHE_SIZE);
+  return vertex_count;
+}
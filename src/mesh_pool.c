@@ -0,0 +1,179 @@
+#include "mesh_pool.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct mesh_pool {
+  GLuint vao;
+  GLuint vbo;
+  GLuint ebo;
+  vertex_layout_t layout;
+  uint32_t vertex_count;
+  uint32_t vertex_capacity;
+  uint32_t index_bytes;
+  uint32_t index_capacity;     // bytes
+  uint16_t* narrow;            // scratch for 16-bit conversion
+  uint32_t narrow_capacity;
+};
+
+// New storage of size with the first used bytes of old copied over, old is deleted
+static GLuint grow_buffer(GLuint old, GLsizeiptr used, GLsizeiptr size)
+{
+  GLuint buffer;
+  glGenBuffers(1, &buffer);
+  gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+
+  if (old != 0) {
+    if (used > 0) {
+      gl_state_bind_buffer(GL_COPY_READ_BUFFER, old);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    }
+    gl_state_forget_buffer(old);
+    glDeleteBuffers(1, &old);
+  }
+  return buffer;
+}
+
+static void reserve_vertices(mesh_pool_t* pool, uint32_t capacity)
+{
+  pool->vbo = grow_buffer(pool->vbo, (GLsizeiptr)pool->vertex_count * pool->layout.stride,
+			  (GLsizeiptr)capacity * pool->layout.stride);
+  pool->vertex_capacity = capacity;
+
+  // Attribute pointers capture the buffer bound when they're set
+  gl_state_bind_vertex_array(pool->vao);
+  gl_state_bind_buffer(GL_ARRAY_BUFFER, pool->vbo);
+  vertex_layout_apply(&pool->layout);
+}
+
+static void reserve_indices(mesh_pool_t* pool, uint32_t capacity)
+{
+  pool->ebo = grow_buffer(pool->ebo, pool->index_bytes, capacity);
+  pool->index_capacity = capacity;
+
+  gl_state_bind_vertex_array(pool->vao);
+  gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, pool->ebo);
+}
+
+mesh_pool_t* mesh_pool_create(const vertex_layout_t* layout, uint32_t vertex_capacity, uint32_t index_bytes)
+{
+  mesh_pool_t* pool = calloc(1, sizeof(mesh_pool_t));
+  if (!pool) {
+    fprintf(stderr, "Memory allocation failed for mesh pool\n");
+    return NULL;
+  }
+
+  pool->layout = *layout;
+  glGenVertexArrays(1, &pool->vao);
+  reserve_vertices(pool, vertex_capacity ? vertex_capacity : MESH_POOL_DEFAULT_VERTICES);
+  reserve_indices(pool, index_bytes ? index_bytes : MESH_POOL_DEFAULT_INDEX_BYTES);
+  return pool;
+}
+
+static uint32_t grown(uint32_t capacity, uint64_t needed)
+{
+  uint64_t size = capacity;
+  while (size < needed)
+    size *= 2;
+  return size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+}
+
+// Indices as 16 bits in the scratch buffer, NULL if one doesn't fit or the scratch can't grow
+static const uint16_t* narrow_indices(mesh_pool_t* pool, const uint32_t* indices, uint32_t index_count)
+{
+  for (uint32_t i = 0; i < index_count; i++) {
+    if (indices[i] > UINT16_MAX)
+      return NULL;
+  }
+
+  if (index_count > pool->narrow_capacity) {
+    uint16_t* narrow = realloc(pool->narrow, index_count * sizeof(uint16_t));
+    if (!narrow)
+      return NULL;
+    pool->narrow = narrow;
+    pool->narrow_capacity = index_count;
+  }
+
+  for (uint32_t i = 0; i < index_count; i++)
+    pool->narrow[i] = (uint16_t)indices[i];
+  return pool->narrow;
+}
+
+bool mesh_pool_add(mesh_pool_t* pool, const void* vertices, uint32_t vertex_count,
+		   const uint32_t* indices, uint32_t index_count, mesh_t* mesh_out)
+{
+  const void* index_data = narrow_indices(pool, indices, index_count);
+  uint32_t index_size = index_data ? sizeof(uint16_t) : sizeof(uint32_t);
+  if (!index_data)
+    index_data = indices;
+
+  // Offsets have to be a multiple of the index size, and firstIndex in indirect commands is in indices
+  uint64_t index_offset = (pool->index_bytes + index_size - 1) / index_size * index_size;
+  uint64_t vertices_needed = (uint64_t)pool->vertex_count + vertex_count;
+  uint64_t bytes_needed = index_offset + (uint64_t)index_count * index_size;
+  if (vertices_needed > INT32_MAX || bytes_needed > INT32_MAX) {
+    fprintf(stderr, "Mesh pool is full (%u vertices, %u index bytes)\n", pool->vertex_count, pool->index_bytes);
+    return false;
+  }
+
+  if (vertices_needed > pool->vertex_capacity)
+    reserve_vertices(pool, grown(pool->vertex_capacity, vertices_needed));
+  if (bytes_needed > pool->index_capacity)
+    reserve_indices(pool, grown(pool->index_capacity, bytes_needed));
+
+  // Uploads go through the copy target so the VAO's bindings aren't touched
+  gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, pool->vbo);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)pool->vertex_count * pool->layout.stride,
+		  (GLsizeiptr)vertex_count * pool->layout.stride, vertices);
+  gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, pool->ebo);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)index_offset, (GLsizeiptr)index_count * index_size, index_data);
+
+  mesh_out->index_offset = (uint32_t)index_offset;
+  mesh_out->index_count = index_count;
+  mesh_out->index_type = index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  mesh_out->base_vertex = (int32_t)pool->vertex_count;
+  mesh_out->vertex_count = vertex_count;
+
+  pool->vertex_count += vertex_count;
+  pool->index_bytes = (uint32_t)bytes_needed;
+  return true;
+}
+
+void mesh_pool_bind_instances(mesh_pool_t* pool, GLuint buffer, const vertex_layout_t* layout)
+{
+  gl_state_bind_vertex_array(pool->vao);
+  gl_state_bind_buffer(GL_ARRAY_BUFFER, buffer);
+  vertex_layout_apply(layout);
+}
+
+void mesh_pool_packet(const mesh_pool_t* pool, const mesh_t* mesh, render_packet_t* packet)
+{
+  packet->vao = pool->vao;
+  packet->mode = GL_TRIANGLES;
+  packet->index_type = mesh->index_type;
+  packet->count = mesh->index_count;
+  packet->index_offset = mesh->index_offset;
+  packet->base_vertex = mesh->base_vertex;
+}
+
+GLuint mesh_pool_vertex_array(const mesh_pool_t* pool)
+{
+  return pool->vao;
+}
+
+void mesh_pool_destroy(mesh_pool_t* pool)
+{
+  if (!pool)
+    return;
+
+  gl_state_forget_vertex_array(pool->vao);
+  gl_state_forget_buffer(pool->vbo);
+  gl_state_forget_buffer(pool->ebo);
+  glDeleteVertexArrays(1, &pool->vao);
+  glDeleteBuffers(1, &pool->vbo);
+  glDeleteBuffers(1, &pool->ebo);
+  free(pool->narrow);
+  free(pool);
+}
@@ -23,15 +23,11 @@ static int permutation[] =
     128,195,78,66,215,61,156,180
 };
 
-// 'p' is the permutation array repeated twice (512 elements)
-static int32_t p[512];
-
-// Initializes 'p' by copying permutation list twice
-static void init_perlin()
+// 'p' is the permutation array repeated twice (512 elements). Wrapping the index gives
+// the same table without a writable copy, so perlin2d can run on several threads at once
+static inline int32_t p(int32_t i)
 {
-  for (int i = 0; i < 256; i++) {
-    p[i] = p[256 + i] = permutation[i];
-  }
+  return permutation[i & 255];
 }
 
 // Smoothing input values
@@ -63,9 +59,6 @@ static float grad(int hash, float x, float y)
 // Output will be in the range [0, 1].
 float perlin2d(float x, float y)
 {
-
-  init_perlin();
-  
   // Find the unit grid cell containing the point
   int X = (int)floorf(x) & 255;
   int Y = (int)floorf(y) & 255;
@@ -79,15 +72,15 @@ float perlin2d(float x, float y)
   float v = fade(y);
 
   // Hash coordinates of the four square corners
-  int A = p[X] + Y;
-  int B = p[X + 1] + Y;
+  int A = p(X) + Y;
+  int B = p(X + 1) + Y;
 
   // Blend results from the four corners of the square
   float res = lerp(
-		   lerp(grad(p[A],     x,     y),
-			grad(p[B],     x - 1, y),     u),
-		   lerp(grad(p[A + 1], x,     y - 1),
-			grad(p[B + 1], x - 1, y - 1), u),
+		   lerp(grad(p(A),     x,     y),
+			grad(p(B),     x - 1, y),     u),
+		   lerp(grad(p(A + 1), x,     y - 1),
+			grad(p(B + 1), x - 1, y - 1), u),
 		   v
 		   );
 
@@ -0,0 +1,556 @@
+#include "occlusion.h"
+
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLFW/glfw3.h>
+
+// SSE2 is always there on x86-64 and NEON on AArch64, so unlike cull.c there's nothing to pick at runtime
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OCCLUSION_NEON
+#endif
+
+#define OCCLUSION_MAX_LEVELS 16
+#define OCCLUSION_MIN_W 1e-5f      // clip w below this is at or behind the eye
+#define OCCLUSION_DEPTH_EPSILON (8.0f * FLT_EPSILON) // relative rounding allowed for in occluder depth
+
+// Edge functions a * x + b * y + c are >= 0 inside, depth is a plane over the screen too.
+// Pixel ranges are clamped to the buffer with x rounded out to whole groups of 4
+typedef struct {
+  float a[3], b[3], c[3];
+  float dzdx, dzdy, zc;
+  uint32_t x_begin, x_end;
+  uint32_t y_begin, y_end;
+} triangle_setup_t;
+
+struct occlusion {
+  uint32_t width;
+  uint32_t height;
+
+  // World space occluder triangles
+  float (*positions)[3];
+  uint32_t vertex_count;
+  uint32_t* indices;
+  uint32_t index_count;
+
+  // Per frame, written by the job
+  mat4 view_projection;
+  thread_pool_t* workers;
+  float (*projected)[4];       // screen x, y, depth, 1 if in front of the eye
+  triangle_setup_t* setups;
+  uint32_t setup_count;
+
+  // Level 0 is the depth buffer, each level after it the max of 2x2 texels of the one before
+  float* pyramid;
+  uint32_t level_offset[OCCLUSION_MAX_LEVELS];
+  uint32_t level_width[OCCLUSION_MAX_LEVELS];
+  uint32_t level_height[OCCLUSION_MAX_LEVELS];
+  uint32_t level_count;
+
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  bool busy;                   // a frame is being rasterized
+  occlusion_stats_t stats;
+};
+
+// Compare and select, fminf/fmaxf are library calls here
+static inline float min_f(float a, float b) { return b < a ? b : a; }
+static inline float max_f(float a, float b) { return b > a ? b : a; }
+
+/* LANES */
+
+// Four pixels of a row at a time
+#if defined(OCCLUSION_SSE2)
+
+typedef __m128 lane_t;
+typedef __m128 lane_mask_t;
+static inline lane_t lane_set1(float v) { return _mm_set1_ps(v); }
+static inline lane_t lane_ramp(float v) { return _mm_setr_ps(v + 0.5f, v + 1.5f, v + 2.5f, v + 3.5f); }
+static inline lane_t lane_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void lane_store(float* p, lane_t v) { _mm_storeu_ps(p, v); }
+static inline lane_t lane_madd(lane_t a, lane_t b, lane_t c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+static inline lane_t lane_min(lane_t a, lane_t b) { return _mm_min_ps(a, b); }
+static inline lane_mask_t lane_inside(lane_t e0, lane_t e1, lane_t e2)
+{
+  __m128 zero = _mm_setzero_ps();
+  return _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+}
+static inline bool lane_any(lane_mask_t mask) { return _mm_movemask_ps(mask) != 0; }
+static inline lane_t lane_select(lane_mask_t mask, lane_t a, lane_t b)
+{
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+#elif defined(OCCLUSION_NEON)
+
+typedef float32x4_t lane_t;
+typedef uint32x4_t lane_mask_t;
+static inline lane_t lane_set1(float v) { return vdupq_n_f32(v); }
+static inline lane_t lane_ramp(float v)
+{
+  static const float ramp[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+  return vaddq_f32(vdupq_n_f32(v), vld1q_f32(ramp));
+}
+static inline lane_t lane_load(const float* p) { return vld1q_f32(p); }
+static inline void lane_store(float* p, lane_t v) { vst1q_f32(p, v); }
+static inline lane_t lane_madd(lane_t a, lane_t b, lane_t c) { return vaddq_f32(vmulq_f32(a, b), c); }
+static inline lane_t lane_min(lane_t a, lane_t b) { return vminq_f32(a, b); }
+static inline lane_mask_t lane_inside(lane_t e0, lane_t e1, lane_t e2)
+{
+  float32x4_t zero = vdupq_n_f32(0.0f);
+  return vandq_u32(vandq_u32(vcgeq_f32(e0, zero), vcgeq_f32(e1, zero)), vcgeq_f32(e2, zero));
+}
+static inline bool lane_any(lane_mask_t mask) { return vmaxvq_u32(mask) != 0; }
+static inline lane_t lane_select(lane_mask_t mask, lane_t a, lane_t b) { return vbslq_f32(mask, a, b); }
+
+#else
+
+typedef struct { float v[4]; } lane_t;
+typedef struct { bool v[4]; } lane_mask_t;
+static inline lane_t lane_set1(float v) { lane_t r = { { v, v, v, v } }; return r; }
+static inline lane_t lane_ramp(float v) { lane_t r = { { v + 0.5f, v + 1.5f, v + 2.5f, v + 3.5f } }; return r; }
+static inline lane_t lane_load(const float* p) { lane_t r; memcpy(r.v, p, sizeof(r.v)); return r; }
+static inline void lane_store(float* p, lane_t v) { memcpy(p, v.v, sizeof(v.v)); }
+static inline lane_t lane_madd(lane_t a, lane_t b, lane_t c)
+{
+  for (uint32_t i = 0; i < 4; i++)
+    a.v[i] = a.v[i] * b.v[i] + c.v[i];
+  return a;
+}
+static inline lane_t lane_min(lane_t a, lane_t b)
+{
+  for (uint32_t i = 0; i < 4; i++)
+    a.v[i] = b.v[i] < a.v[i] ? b.v[i] : a.v[i];
+  return a;
+}
+static inline lane_mask_t lane_inside(lane_t e0, lane_t e1, lane_t e2)
+{
+  lane_mask_t mask;
+  for (uint32_t i = 0; i < 4; i++)
+    mask.v[i] = e0.v[i] >= 0.0f && e1.v[i] >= 0.0f && e2.v[i] >= 0.0f;
+  return mask;
+}
+static inline bool lane_any(lane_mask_t mask) { return mask.v[0] || mask.v[1] || mask.v[2] || mask.v[3]; }
+static inline lane_t lane_select(lane_mask_t mask, lane_t a, lane_t b)
+{
+  for (uint32_t i = 0; i < 4; i++)
+    b.v[i] = mask.v[i] ? a.v[i] : b.v[i];
+  return b;
+}
+
+#endif
+
+const char* occlusion_simd_name(void)
+{
+#if defined(OCCLUSION_SSE2)
+  return "sse2";
+#elif defined(OCCLUSION_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+/* SETUP */
+
+static void wait_ready(occlusion_t* occlusion);
+
+occlusion_t* occlusion_create(uint32_t width, uint32_t height)
+{
+  if (width == 0 || height == 0 || width % 4 != 0) {
+    fprintf(stderr, "Occlusion buffer width must be a non-zero multiple of 4, got %ux%u\n", width, height);
+    return NULL;
+  }
+
+  occlusion_t* occlusion = calloc(1, sizeof(occlusion_t));
+  if (!occlusion) {
+    fprintf(stderr, "Memory allocation failed for occlusion culler\n");
+    return NULL;
+  }
+  occlusion->width = width;
+  occlusion->height = height;
+
+  // Level sizes halve rounding up until 1x1
+  uint32_t texels = 0;
+  uint32_t w = width, h = height;
+  for (;;) {
+    occlusion->level_offset[occlusion->level_count] = texels;
+    occlusion->level_width[occlusion->level_count] = w;
+    occlusion->level_height[occlusion->level_count] = h;
+    occlusion->level_count++;
+    texels += w * h;
+    if ((w == 1 && h == 1) || occlusion->level_count == OCCLUSION_MAX_LEVELS)
+      break;
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+  }
+
+  occlusion->pyramid = malloc(texels * sizeof(float));
+  if (!occlusion->pyramid) {
+    fprintf(stderr, "Memory allocation failed for occlusion culler\n");
+    free(occlusion);
+    return NULL;
+  }
+  // Nothing drawn yet is all far plane, which hides nothing
+  for (uint32_t i = 0; i < texels; i++)
+    occlusion->pyramid[i] = 1.0f;
+
+  pthread_mutex_init(&occlusion->lock, NULL);
+  pthread_cond_init(&occlusion->ready, NULL);
+  return occlusion;
+}
+
+bool occlusion_add_occluder(occlusion_t* occlusion, const float* positions, uint32_t stride, uint32_t vertex_count,
+			    const uint32_t* indices, uint32_t index_count, mat4 transform)
+{
+  // The job reads all of these
+  wait_ready(occlusion);
+
+  // Added once at load, so sized exactly. Each array is kept as soon as it's grown, the counts
+  // only move once all of them are
+  index_count -= index_count % 3;
+  uint32_t base = occlusion->vertex_count;
+  uint32_t vertices = base + vertex_count;
+  uint32_t triangles = (occlusion->index_count + index_count) / 3;
+  bool failed = false;
+
+  float (*grown_positions)[3] = realloc(occlusion->positions, (vertices + 1) * sizeof(float[3]));
+  if (grown_positions) occlusion->positions = grown_positions; else failed = true;
+  float (*projected)[4] = realloc(occlusion->projected, (vertices + 1) * sizeof(float[4]));
+  if (projected) occlusion->projected = projected; else failed = true;
+  uint32_t* grown_indices = realloc(occlusion->indices, (triangles * 3 + 1) * sizeof(uint32_t));
+  if (grown_indices) occlusion->indices = grown_indices; else failed = true;
+  triangle_setup_t* setups = realloc(occlusion->setups, (triangles + 1) * sizeof(triangle_setup_t));
+  if (setups) occlusion->setups = setups; else failed = true;
+  if (failed) {
+    fprintf(stderr, "Memory allocation failed for occluder\n");
+    return false;
+  }
+
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    const float* position = positions + (size_t)i * stride;
+    vec4 local = { position[0], position[1], position[2], 1.0f };
+    vec4 world;
+    glm_mat4_mulv(transform, local, world);
+    memcpy(occlusion->positions[base + i], world, sizeof(float[3]));
+  }
+  for (uint32_t i = 0; i < index_count; i++)
+    occlusion->indices[occlusion->index_count++] = base + indices[i];
+  occlusion->vertex_count += vertex_count;
+  return true;
+}
+
+/* RASTERIZATION */
+
+static void project_vertices(occlusion_t* occlusion)
+{
+  float (*m)[4] = occlusion->view_projection;
+  for (uint32_t i = 0; i < occlusion->vertex_count; i++) {
+    const float* p = occlusion->positions[i];
+    float clip[4];
+    for (uint32_t r = 0; r < 4; r++)
+      clip[r] = m[0][r] * p[0] + m[1][r] * p[1] + m[2][r] * p[2] + m[3][r];
+
+    float* out = occlusion->projected[i];
+    if (clip[3] <= OCCLUSION_MIN_W) {
+      out[3] = 0.0f;
+      continue;
+    }
+    float inverse_w = 1.0f / clip[3];
+    out[0] = (clip[0] * inverse_w * 0.5f + 0.5f) * occlusion->width;
+    out[1] = (clip[1] * inverse_w * 0.5f + 0.5f) * occlusion->height;
+    out[2] = clip[2] * inverse_w * 0.5f + 0.5f;
+    out[3] = 1.0f;
+  }
+}
+
+// False if the triangle covers no pixels. Triangles through the near plane are dropped rather
+// than clipped, which only ever means fewer occluders
+static bool setup_triangle(const occlusion_t* occlusion, uint32_t triangle, triangle_setup_t* setup)
+{
+  const float* v[3];
+  for (uint32_t k = 0; k < 3; k++) {
+    v[k] = occlusion->projected[occlusion->indices[triangle * 3 + k]];
+    if (v[k][3] == 0.0f)
+      return false;
+  }
+
+  // Either winding, occluders are treated as two sided
+  float area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) - (v[2][0] - v[0][0]) * (v[1][1] - v[0][1]);
+  if (fabsf(area) < 1e-8f)
+    return false;
+  if (area < 0.0f) {
+    const float* swap = v[1];
+    v[1] = v[2];
+    v[2] = swap;
+    area = -area;
+  }
+
+  float min_x = min_f(v[0][0], min_f(v[1][0], v[2][0]));
+  float max_x = max_f(v[0][0], max_f(v[1][0], v[2][0]));
+  float min_y = min_f(v[0][1], min_f(v[1][1], v[2][1]));
+  float max_y = max_f(v[0][1], max_f(v[1][1], v[2][1]));
+  if (max_x <= 0.0f || max_y <= 0.0f || min_x >= occlusion->width || min_y >= occlusion->height)
+    return false;
+
+  min_x = max_f(min_x, 0.0f);
+  min_y = max_f(min_y, 0.0f);
+  max_x = min_f(ceilf(max_x), (float)occlusion->width);
+  max_y = min_f(ceilf(max_y), (float)occlusion->height);
+  setup->x_begin = (uint32_t)min_x & ~3u;
+  setup->x_end = ((uint32_t)max_x + 3) & ~3u;
+  setup->y_begin = (uint32_t)min_y;
+  setup->y_end = (uint32_t)max_y;
+
+  for (uint32_t e = 0; e < 3; e++) {
+    const float* from = v[e];
+    const float* to = v[(e + 1) % 3];
+    setup->a[e] = from[1] - to[1];
+    setup->b[e] = to[0] - from[0];
+    setup->c[e] = -(setup->a[e] * from[0] + setup->b[e] * from[1]);
+  }
+
+  float dz1 = v[1][2] - v[0][2];
+  float dz2 = v[2][2] - v[0][2];
+  setup->dzdx = (dz1 * (v[2][1] - v[0][1]) - dz2 * (v[1][1] - v[0][1])) / area;
+  setup->dzdy = (dz2 * (v[1][0] - v[0][0]) - dz1 * (v[2][0] - v[0][0])) / area;
+  setup->zc = v[0][2] - setup->dzdx * v[0][0] - setup->dzdy * v[0][1];
+
+  // Pushed back by a pixel's worth of slope plus the rounding in evaluating the plane, like
+  // glPolygonOffset, so an occluder never hides the object it sits on
+  float slope = fabsf(setup->dzdx) + fabsf(setup->dzdy);
+  float magnitude = fabsf(v[0][2]) + fabsf(setup->dzdx * v[0][0]) + fabsf(setup->dzdy * v[0][1])
+    + slope * (occlusion->width + occlusion->height);
+  setup->zc += slope + magnitude * OCCLUSION_DEPTH_EPSILON;
+  return true;
+}
+
+// Nearest depth wins within a row, tested at pixel centers
+static void raster_row(float* row, float y, const triangle_setup_t* setup)
+{
+  lane_t a0 = lane_set1(setup->a[0]), a1 = lane_set1(setup->a[1]), a2 = lane_set1(setup->a[2]);
+  lane_t c0 = lane_set1(setup->b[0] * y + setup->c[0]);
+  lane_t c1 = lane_set1(setup->b[1] * y + setup->c[1]);
+  lane_t c2 = lane_set1(setup->b[2] * y + setup->c[2]);
+  lane_t dzdx = lane_set1(setup->dzdx);
+  lane_t zc = lane_set1(setup->dzdy * y + setup->zc);
+
+  for (uint32_t x = setup->x_begin; x < setup->x_end; x += 4) {
+    lane_t px = lane_ramp((float)x);
+    lane_mask_t inside = lane_inside(lane_madd(a0, px, c0), lane_madd(a1, px, c1), lane_madd(a2, px, c2));
+    if (!lane_any(inside))
+      continue;
+    lane_t depth = lane_load(row + x);
+    lane_store(row + x, lane_select(inside, lane_min(depth, lane_madd(dzdx, px, zc)), depth));
+  }
+}
+
+// Every triangle's rows that fall in this band, bands never share rows
+static void raster_band(void* arg, uint32_t chunk, uint32_t begin, uint32_t end)
+{
+  occlusion_t* occlusion = arg;
+  (void)chunk;
+  for (uint32_t band = begin; band < end; band++) {
+    uint32_t band_begin = band * occlusion->height / OCCLUSION_BANDS;
+    uint32_t band_end = (band + 1) * occlusion->height / OCCLUSION_BANDS;
+
+    float* depth = occlusion->pyramid;
+    for (uint32_t y = band_begin; y < band_end; y++)
+      for (uint32_t x = 0; x < occlusion->width; x++)
+	depth[y * occlusion->width + x] = 1.0f;
+
+    for (uint32_t t = 0; t < occlusion->setup_count; t++) {
+      const triangle_setup_t* setup = &occlusion->setups[t];
+      uint32_t y_begin = setup->y_begin > band_begin ? setup->y_begin : band_begin;
+      uint32_t y_end = setup->y_end < band_end ? setup->y_end : band_end;
+      for (uint32_t y = y_begin; y < y_end; y++)
+	raster_row(depth + y * occlusion->width, y + 0.5f, setup);
+    }
+  }
+}
+
+static void build_pyramid(occlusion_t* occlusion)
+{
+  for (uint32_t level = 1; level < occlusion->level_count; level++) {
+    const float* src = occlusion->pyramid + occlusion->level_offset[level - 1];
+    float* dst = occlusion->pyramid + occlusion->level_offset[level];
+    uint32_t src_width = occlusion->level_width[level - 1];
+    uint32_t src_height = occlusion->level_height[level - 1];
+
+    // Odd edges repeat their last texel
+    for (uint32_t y = 0; y < occlusion->level_height[level]; y++) {
+      uint32_t y0 = y * 2;
+      uint32_t y1 = y0 + 1 < src_height ? y0 + 1 : y0;
+      for (uint32_t x = 0; x < occlusion->level_width[level]; x++) {
+	uint32_t x0 = x * 2;
+	uint32_t x1 = x0 + 1 < src_width ? x0 + 1 : x0;
+	float a = max_f(src[y0 * src_width + x0], src[y0 * src_width + x1]);
+	float b = max_f(src[y1 * src_width + x0], src[y1 * src_width + x1]);
+	dst[y * occlusion->level_width[level] + x] = max_f(a, b);
+      }
+    }
+  }
+}
+
+static void render(occlusion_t* occlusion)
+{
+  double start = glfwGetTime();
+
+  project_vertices(occlusion);
+  occlusion->setup_count = 0;
+  for (uint32_t t = 0; t < occlusion->index_count / 3; t++)
+    occlusion->setup_count += setup_triangle(occlusion, t, &occlusion->setups[occlusion->setup_count]);
+
+  thread_pool_parallel_for(occlusion->workers, OCCLUSION_BANDS, 1, raster_band, occlusion);
+  build_pyramid(occlusion);
+
+  occlusion->stats.triangles = occlusion->setup_count;
+  occlusion->stats.raster_ms = (glfwGetTime() - start) * 1000.0;
+}
+
+static void render_job(void* arg)
+{
+  occlusion_t* occlusion = arg;
+  render(occlusion);
+
+  pthread_mutex_lock(&occlusion->lock);
+  occlusion->busy = false;
+  pthread_cond_broadcast(&occlusion->ready);
+  pthread_mutex_unlock(&occlusion->lock);
+}
+
+static void wait_ready(occlusion_t* occlusion)
+{
+  pthread_mutex_lock(&occlusion->lock);
+  if (occlusion->busy) {
+    double start = glfwGetTime();
+    while (occlusion->busy)
+      pthread_cond_wait(&occlusion->ready, &occlusion->lock);
+    occlusion->stats.wait_ms += (glfwGetTime() - start) * 1000.0;
+  }
+  pthread_mutex_unlock(&occlusion->lock);
+}
+
+void occlusion_begin_frame(occlusion_t* occlusion, mat4 view_projection, thread_pool_t* workers)
+{
+  wait_ready(occlusion);
+
+  memset(&occlusion->stats, 0, sizeof(occlusion->stats));
+  glm_mat4_copy(view_projection, occlusion->view_projection);
+  occlusion->workers = workers;
+
+  occlusion->busy = true;
+  if (!workers || !thread_pool_submit(workers, render_job, occlusion))
+    render_job(occlusion);
+}
+
+/* TESTS */
+
+static bool box_visible(const occlusion_t* occlusion, const aabb_t* bounds)
+{
+  float (*m)[4] = (float (*)[4])occlusion->view_projection;
+  float min_x = FLT_MAX, min_y = FLT_MAX, min_z = FLT_MAX;
+  float max_x = -FLT_MAX, max_y = -FLT_MAX;
+
+  for (uint32_t i = 0; i < 8; i++) {
+    float corner[3] = {
+      i & 1 ? bounds->max[0] : bounds->min[0],
+      i & 2 ? bounds->max[1] : bounds->min[1],
+      i & 4 ? bounds->max[2] : bounds->min[2],
+    };
+    float clip[4];
+    for (uint32_t r = 0; r < 4; r++)
+      clip[r] = m[0][r] * corner[0] + m[1][r] * corner[1] + m[2][r] * corner[2] + m[3][r];
+    if (clip[3] <= OCCLUSION_MIN_W)
+      return true;
+
+    float inverse_w = 1.0f / clip[3];
+    float x = (clip[0] * inverse_w * 0.5f + 0.5f) * occlusion->width;
+    float y = (clip[1] * inverse_w * 0.5f + 0.5f) * occlusion->height;
+    float z = clip[2] * inverse_w * 0.5f + 0.5f;
+    min_x = min_f(min_x, x);
+    max_x = max_f(max_x, x);
+    min_y = min_f(min_y, y);
+    max_y = max_f(max_y, y);
+    min_z = min_f(min_z, z);
+  }
+
+  // Off screen is the frustum test's call, not ours
+  if (max_x < 0.0f || max_y < 0.0f || min_x >= occlusion->width || min_y >= occlusion->height || min_z < 0.0f)
+    return true;
+  // Occluders cover pixels whose center they cover, so a pixel on an occluder's edge may be
+  // partly open. Reading a pixel further out on every side catches those
+  min_x = max_f(min_x - 1.0f, 0.0f);
+  min_y = max_f(min_y - 1.0f, 0.0f);
+  max_x = min_f(max_x + 1.0f, occlusion->width - 1.0f);
+  max_y = min_f(max_y + 1.0f, occlusion->height - 1.0f);
+
+  // Coarsest level where the rect spans at most about 2 texels a side, so at most 9 reads
+  float size = max_f(max_x - min_x, max_y - min_y);
+  uint32_t level = 0;
+  while (level + 1 < occlusion->level_count && size > 2.0f) {
+    size *= 0.5f;
+    level++;
+  }
+
+  const float* texels = occlusion->pyramid + occlusion->level_offset[level];
+  uint32_t level_width = occlusion->level_width[level];
+  uint32_t x_begin = (uint32_t)min_x >> level, x_end = (uint32_t)max_x >> level;
+  uint32_t y_begin = (uint32_t)min_y >> level, y_end = (uint32_t)max_y >> level;
+  float farthest = 0.0f;
+  for (uint32_t y = y_begin; y <= y_end; y++)
+    for (uint32_t x = x_begin; x <= x_end; x++)
+      farthest = max_f(farthest, texels[y * level_width + x]);
+
+  return min_z <= farthest;
+}
+
+bool occlusion_test(occlusion_t* occlusion, const aabb_t* bounds)
+{
+  wait_ready(occlusion);
+  bool visible = box_visible(occlusion, bounds);
+  occlusion->stats.tested++;
+  occlusion->stats.occluded += !visible;
+  return visible;
+}
+
+uint32_t occlusion_filter(occlusion_t* occlusion, const aabb_t* bounds, uint32_t* indices, uint32_t count)
+{
+  wait_ready(occlusion);
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    indices[kept] = indices[i];
+    kept += box_visible(occlusion, &bounds[indices[i]]);
+  }
+  occlusion->stats.tested += count;
+  occlusion->stats.occluded += count - kept;
+  return kept;
+}
+
+occlusion_stats_t occlusion_get_stats(const occlusion_t* occlusion)
+{
+  return occlusion->stats;
+}
+
+void occlusion_destroy(occlusion_t* occlusion)
+{
+  if (!occlusion)
+    return;
+
+  wait_ready(occlusion);
+  pthread_mutex_destroy(&occlusion->lock);
+  pthread_cond_destroy(&occlusion->ready);
+  free(occlusion->positions);
+  free(occlusion->indices);
+  free(occlusion->projected);
+  free(occlusion->setups);
+  free(occlusion->pyramid);
+  free(occlusion);
+}
@@ -0,0 +1,369 @@
+#include "render_queue.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLFW/glfw3.h>
+
+// glMultiDrawElementsIndirect's DrawElementsIndirectCommand
+typedef struct {
+  uint32_t count;
+  uint32_t instance_count;
+  uint32_t first_index;
+  int32_t base_vertex;
+  uint32_t base_instance;
+} draw_command_t;
+
+// One GL call: a plain draw of packet when command_count is 0, otherwise a multi-draw of
+// command_count commands starting at first_command. packet is a sorted position
+typedef struct {
+  uint32_t packet;
+  uint32_t first_command;
+  uint32_t command_count;
+} draw_batch_t;
+
+// Keys are sorted alongside packet indices, 16 bytes per move instead of a whole packet
+typedef struct {
+  uint64_t key;
+  uint32_t index;
+} sort_entry_t;
+
+struct render_queue {
+  render_packet_t* packets;
+  sort_entry_t* entries;
+  sort_entry_t* scratch;
+  uint32_t count;
+  uint32_t capacity;
+
+  // Per-instance data in push order, gathered into draw order straight into the stream
+  instance_data_t* instances;
+  uint32_t instance_count;
+  uint32_t instance_capacity;
+
+  // Rebuilt every submit, at most one of each per packet
+  draw_batch_t* batches;
+  draw_command_t* commands;
+  uint32_t batch_count;
+  uint32_t command_count;
+  GLintptr indirect_offset;
+
+  ring_buffer_t* stream;
+
+  render_queue_stats_t stats;
+};
+
+static bool reserve(render_queue_t* queue, uint32_t capacity)
+{
+  render_packet_t* packets = realloc(queue->packets, capacity * sizeof(render_packet_t));
+  if (packets) queue->packets = packets;
+  sort_entry_t* entries = realloc(queue->entries, capacity * sizeof(sort_entry_t));
+  if (entries) queue->entries = entries;
+  sort_entry_t* scratch = realloc(queue->scratch, capacity * sizeof(sort_entry_t));
+  if (scratch) queue->scratch = scratch;
+  draw_batch_t* batches = realloc(queue->batches, capacity * sizeof(draw_batch_t));
+  if (batches) queue->batches = batches;
+  draw_command_t* commands = realloc(queue->commands, capacity * sizeof(draw_command_t));
+  if (commands) queue->commands = commands;
+  if (!packets || !entries || !scratch || !batches || !commands) {
+    fprintf(stderr, "Memory allocation failed for render queue\n");
+    return false;
+  }
+  queue->capacity = capacity;
+  return true;
+}
+
+render_queue_t* render_queue_create(uint32_t capacity, ring_buffer_t* stream)
+{
+  render_queue_t* queue = calloc(1, sizeof(render_queue_t));
+  if (!queue) {
+    fprintf(stderr, "Memory allocation failed for render queue\n");
+    return NULL;
+  }
+
+  if (!reserve(queue, capacity ? capacity : RENDER_QUEUE_DEFAULT_CAPACITY)) {
+    render_queue_destroy(queue);
+    return NULL;
+  }
+
+  queue->stream = stream;
+  return queue;
+}
+
+static uint64_t field(uint32_t value, uint32_t bits)
+{
+  return (uint64_t)(value & ((1u << bits) - 1));
+}
+
+uint64_t render_key(uint32_t layer, uint32_t shader, uint32_t material, uint32_t texture,
+		    float depth, bool back_to_front)
+{
+  if (depth < 0.0f) depth = 0.0f;
+  if (depth > 1.0f) depth = 1.0f;
+  uint32_t max_depth = (1u << RENDER_KEY_DEPTH_BITS) - 1;
+  uint32_t quantized = (uint32_t)(depth * (float)max_depth);
+  if (back_to_front)
+    quantized = max_depth - quantized;
+
+  uint64_t key = field(layer, RENDER_KEY_LAYER_BITS);
+  key = key << RENDER_KEY_SHADER_BITS | field(shader, RENDER_KEY_SHADER_BITS);
+  key = key << RENDER_KEY_MATERIAL_BITS | field(material, RENDER_KEY_MATERIAL_BITS);
+  key = key << RENDER_KEY_TEXTURE_BITS | field(texture, RENDER_KEY_TEXTURE_BITS);
+  key = key << RENDER_KEY_DEPTH_BITS | quantized;
+  return key;
+}
+
+uint64_t render_key_instanced(uint32_t layer, uint32_t shader, uint32_t material, uint32_t texture,
+			      uint32_t mesh)
+{
+  uint64_t key = render_key(layer, shader, material, texture, 0.0f, false);
+  return key | field(mesh, RENDER_KEY_DEPTH_BITS);
+}
+
+static bool reserve_instances(render_queue_t* queue, uint32_t capacity)
+{
+  instance_data_t* instances = realloc(queue->instances, capacity * sizeof(instance_data_t));
+  if (!instances) {
+    fprintf(stderr, "Memory allocation failed for render queue instances\n");
+    return false;
+  }
+  queue->instances = instances;
+  queue->instance_capacity = capacity;
+  return true;
+}
+
+void render_queue_push(render_queue_t* queue, const render_packet_t* packet)
+{
+  if (queue->count == queue->capacity && !reserve(queue, queue->capacity * 2))
+    return;
+
+  queue->packets[queue->count] = *packet;
+  queue->packets[queue->count].instance = RENDER_NO_INSTANCE;
+  queue->entries[queue->count].key = packet->key;
+  queue->entries[queue->count].index = queue->count;
+  queue->count++;
+}
+
+void render_queue_push_instanced(render_queue_t* queue, const render_packet_t* packet,
+				 const instance_data_t* instance)
+{
+  if (queue->instance_count == queue->instance_capacity &&
+      !reserve_instances(queue, queue->instance_capacity ? queue->instance_capacity * 2 : queue->capacity))
+    return;
+
+  uint32_t count = queue->count;
+  render_queue_push(queue, packet);
+  if (queue->count == count)
+    return;
+
+  queue->packets[count].instance = queue->instance_count;
+  queue->instances[queue->instance_count++] = *instance;
+}
+
+GLuint render_queue_instance_buffer(const render_queue_t* queue)
+{
+  return ring_buffer_id(queue->stream);
+}
+
+void render_queue_sort(render_queue_t* queue)
+{
+  double start = glfwGetTime();
+  queue->stats.packets = queue->count;
+  if (queue->count < 2) {
+    queue->stats.sort_ms = 0.0;
+    return;
+  }
+
+  // All eight histograms in one read of the keys
+  uint32_t histograms[8][256];
+  memset(histograms, 0, sizeof(histograms));
+  for (uint32_t i = 0; i < queue->count; i++) {
+    uint64_t key = queue->entries[i].key;
+    for (uint32_t pass = 0; pass < 8; pass++)
+      histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+  }
+
+  sort_entry_t* src = queue->entries;
+  sort_entry_t* dst = queue->scratch;
+
+  for (uint32_t pass = 0; pass < 8; pass++) {
+    uint32_t* histogram = histograms[pass];
+    uint32_t shift = pass * 8;
+
+    // Every key has the same byte here, this pass wouldn't move anything
+    if (histogram[(src[0].key >> shift) & 0xFF] == queue->count)
+      continue;
+
+    uint32_t offset = 0;
+    for (uint32_t b = 0; b < 256; b++) {
+      uint32_t count = histogram[b];
+      histogram[b] = offset;
+      offset += count;
+    }
+
+    for (uint32_t i = 0; i < queue->count; i++)
+      dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+    sort_entry_t* swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  // Odd number of passes leaves the result in scratch
+  queue->entries = src;
+  queue->scratch = dst;
+
+  queue->stats.sort_ms = (glfwGetTime() - start) * 1000.0;
+}
+
+// Same program, textures, material and VAO, so a run of these can share one multi-draw
+static bool same_state(const render_packet_t* a, const render_packet_t* b)
+{
+  return b->instance != RENDER_NO_INSTANCE &&
+    a->shader->id == b->shader->id && a->vao == b->vao &&
+    a->texture == b->texture && a->sampler == b->sampler && a->texture_unit == b->texture_unit &&
+    a->material == b->material && a->material_index == b->material_index &&
+    a->mode == b->mode && a->index_type == b->index_type;
+}
+
+// Same mesh too, so only the instance data differs
+static bool same_draw(const render_packet_t* a, const render_packet_t* b)
+{
+  return same_state(a, b) &&
+    a->count == b->count && a->index_offset == b->index_offset && a->base_vertex == b->base_vertex;
+}
+
+static uint32_t index_size(GLenum type)
+{
+  return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+// Group the sorted packets into batches and build their indirect commands. Instance data is
+// gathered in the same order into this frame's stream region, so each command reads a contiguous
+// range from its base instance. The instance attributes point at the start of the stream buffer,
+// which is why the region is aligned to whole instances
+static void build_batches(render_queue_t* queue)
+{
+  queue->batch_count = 0;
+  queue->command_count = 0;
+
+  ring_alloc_t alloc = { NULL, 0 };
+  bool instanced = queue->instance_count > 0 &&
+    ring_buffer_alloc(queue->stream, queue->instance_count * sizeof(instance_data_t),
+		      sizeof(instance_data_t), &alloc);
+  instance_data_t* upload = alloc.data;
+  uint32_t base_instance = alloc.offset / sizeof(instance_data_t);
+
+  for (uint32_t i = 0; i < queue->count;) {
+    const render_packet_t* packet = &queue->packets[queue->entries[i].index];
+
+    if (packet->instance == RENDER_NO_INSTANCE) {
+      queue->batches[queue->batch_count++] = (draw_batch_t){ i, 0, 0 };
+      i++;
+      continue;
+    }
+
+    // Nowhere to put the instance data, these are dropped for the frame
+    if (!instanced) {
+      i++;
+      continue;
+    }
+
+    draw_batch_t* batch = queue->batch_count > 0 ? &queue->batches[queue->batch_count - 1] : NULL;
+    if (!batch || batch->command_count == 0 ||
+	!same_state(&queue->packets[queue->entries[batch->packet].index], packet)) {
+      batch = &queue->batches[queue->batch_count++];
+      *batch = (draw_batch_t){ i, queue->command_count, 0 };
+    }
+
+    uint32_t run = 1;
+    while (i + run < queue->count && same_draw(packet, &queue->packets[queue->entries[i + run].index]))
+      run++;
+
+    queue->commands[queue->command_count++] = (draw_command_t){
+      packet->count, run, packet->index_offset / index_size(packet->index_type),
+      packet->base_vertex, base_instance
+    };
+    batch->command_count++;
+
+    for (uint32_t r = 0; r < run; r++)
+      *upload++ = queue->instances[queue->packets[queue->entries[i + r].index].instance];
+    base_instance += run;
+    i += run;
+  }
+
+  // Commands go in after the fact, there are usually far fewer than instances
+  queue->indirect_offset = -1;
+  ring_alloc_t commands;
+  if (queue->command_count > 0 &&
+      ring_buffer_alloc(queue->stream, queue->command_count * sizeof(draw_command_t), sizeof(uint32_t), &commands)) {
+    memcpy(commands.data, queue->commands, queue->command_count * sizeof(draw_command_t));
+    queue->indirect_offset = commands.offset;
+  }
+}
+
+void render_queue_submit(render_queue_t* queue)
+{
+  double start = glfwGetTime();
+
+  build_batches(queue);
+
+  for (uint32_t b = 0; b < queue->batch_count; b++) {
+    const draw_batch_t* batch = &queue->batches[b];
+    const render_packet_t* packet = &queue->packets[queue->entries[batch->packet].index];
+
+    gl_state_use_program(packet->shader->id);
+    if (packet->texture != 0) {
+      gl_state_bind_texture(packet->texture_unit, GL_TEXTURE_2D, packet->texture);
+      gl_state_bind_sampler(packet->texture_unit, packet->sampler);
+    }
+    if (packet->material)
+      uniform_buffer_bind(packet->material, packet->material_index);
+    gl_state_bind_vertex_array(packet->vao);
+
+    if (batch->command_count == 0) {
+      glDrawElementsBaseVertex(packet->mode, packet->count, packet->index_type,
+			       (void*)(uintptr_t)packet->index_offset, packet->base_vertex);
+    } else if (queue->indirect_offset >= 0) {
+      gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, ring_buffer_id(queue->stream));
+      glMultiDrawElementsIndirect(packet->mode, packet->index_type,
+				  (void*)(uintptr_t)(queue->indirect_offset + batch->first_command * sizeof(draw_command_t)),
+				  batch->command_count, 0);
+    }
+  }
+
+  queue->stats.draws = queue->batch_count;
+  queue->stats.commands = queue->command_count;
+  queue->stats.instances = queue->instance_count;
+  queue->stats.submit_ms = (glfwGetTime() - start) * 1000.0;
+}
+
+void render_queue_clear(render_queue_t* queue)
+{
+  queue->count = 0;
+  queue->instance_count = 0;
+}
+
+const render_packet_t* render_queue_packet(const render_queue_t* queue, uint32_t i)
+{
+  return i < queue->count ? &queue->packets[queue->entries[i].index] : NULL;
+}
+
+render_queue_stats_t render_queue_get_stats(const render_queue_t* queue)
+{
+  return queue->stats;
+}
+
+void render_queue_destroy(render_queue_t* queue)
+{
+  if (!queue)
+    return;
+
+  free(queue->packets);
+  free(queue->entries);
+  free(queue->scratch);
+  free(queue->instances);
+  free(queue->batches);
+  free(queue->commands);
+  free(queue);
+}
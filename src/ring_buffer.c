@@ -0,0 +1,160 @@
+#include "ring_buffer.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLFW/glfw3.h>
+
+#define RING_FENCE_TIMEOUT_NS 1000000000ull
+
+struct ring_buffer {
+  GLuint id;
+  uint8_t* mapping;
+  size_t frame_size;
+  GLint uniform_alignment;
+  GLint storage_alignment;
+  GLsync fences[RING_BUFFER_FRAMES];
+  uint32_t frame;              // region being written
+  size_t offset;               // into the region
+  uint32_t failed;
+  ring_buffer_stats_t stats;
+};
+
+static const GLbitfield map_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+ring_buffer_t* ring_buffer_create(size_t frame_size)
+{
+  ring_buffer_t* ring = calloc(1, sizeof(ring_buffer_t));
+  if (!ring) {
+    fprintf(stderr, "Memory allocation failed for ring buffer\n");
+    return NULL;
+  }
+
+  ring->frame_size = frame_size ? frame_size : RING_BUFFER_DEFAULT_FRAME_SIZE;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ring->uniform_alignment);
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ring->storage_alignment);
+
+  // Immutable storage is what makes the mapping allowed to stay up while the GPU reads it
+  GLsizeiptr size = (GLsizeiptr)(ring->frame_size * RING_BUFFER_FRAMES);
+  glGenBuffers(1, &ring->id);
+  gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, ring->id);
+  glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, map_flags);
+  ring->mapping = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, map_flags);
+  if (!ring->mapping) {
+    fprintf(stderr, "Failed to map ring buffer (%zu bytes)\n", (size_t)size);
+    ring_buffer_destroy(ring);
+    return NULL;
+  }
+
+  // Allocations made before the first frame land in the last region, begin_frame moves on from there
+  ring->frame = RING_BUFFER_FRAMES - 1;
+  return ring;
+}
+
+void ring_buffer_begin_frame(ring_buffer_t* ring)
+{
+  ring->frame = (ring->frame + 1) % RING_BUFFER_FRAMES;
+  ring->offset = 0;
+  ring->failed = 0;
+
+  GLsync fence = ring->fences[ring->frame];
+  if (!fence) {
+    ring->stats.wait_ms = 0.0;
+    return;
+  }
+
+  // Usually signalled long ago, only a GPU running RING_BUFFER_FRAMES behind blocks here
+  double start = glfwGetTime();
+  GLbitfield flags = 0;
+  for (;;) {
+    GLenum result = glClientWaitSync(fence, flags, RING_FENCE_TIMEOUT_NS);
+    if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+      break;
+    if (result == GL_WAIT_FAILED) {
+      fprintf(stderr, "Ring buffer fence wait failed\n");
+      break;
+    }
+    flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  }
+  glDeleteSync(fence);
+  ring->fences[ring->frame] = NULL;
+  ring->stats.wait_ms = (glfwGetTime() - start) * 1000.0;
+}
+
+void ring_buffer_end_frame(ring_buffer_t* ring)
+{
+  if (ring->fences[ring->frame])
+    glDeleteSync(ring->fences[ring->frame]);
+  ring->fences[ring->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  ring->stats.used = ring->offset;
+  if (ring->offset > ring->stats.peak)
+    ring->stats.peak = ring->offset;
+  ring->stats.failed = ring->failed;
+}
+
+bool ring_buffer_alloc(ring_buffer_t* ring, size_t size, size_t alignment, ring_alloc_t* alloc_out)
+{
+  // Regions start at multiples of frame_size, which may not be a multiple of alignment,
+  // so align the absolute offset
+  size_t base = ring->frame * ring->frame_size;
+  size_t offset = base + ring->offset;
+  if (alignment > 1)
+    offset = (offset + alignment - 1) / alignment * alignment;
+
+  if (offset + size > base + ring->frame_size) {
+    if (ring->failed++ == 0)
+      fprintf(stderr, "Ring buffer full (%zu of %zu bytes used this frame)\n", ring->offset, ring->frame_size);
+    return false;
+  }
+
+  ring->offset = offset + size - base;
+  alloc_out->data = ring->mapping + offset;
+  alloc_out->offset = (GLintptr)offset;
+  return true;
+}
+
+bool ring_buffer_bind_block(ring_buffer_t* ring, const ubo_layout_t* layout, const void* data)
+{
+  bool uniform = layout->interface == GL_UNIFORM_BLOCK;
+  ring_alloc_t alloc;
+  if (!ring_buffer_alloc(ring, layout->size, uniform ? ring->uniform_alignment : ring->storage_alignment, &alloc))
+    return false;
+
+  memcpy(alloc.data, data, layout->size);
+  gl_state_bind_buffer_range(uniform ? GL_UNIFORM_BUFFER : GL_SHADER_STORAGE_BUFFER, layout->binding,
+			     ring->id, alloc.offset, layout->size);
+  return true;
+}
+
+GLuint ring_buffer_id(const ring_buffer_t* ring)
+{
+  return ring->id;
+}
+
+ring_buffer_stats_t ring_buffer_get_stats(const ring_buffer_t* ring)
+{
+  return ring->stats;
+}
+
+void ring_buffer_destroy(ring_buffer_t* ring)
+{
+  if (!ring)
+    return;
+
+  for (uint32_t i = 0; i < RING_BUFFER_FRAMES; i++) {
+    if (ring->fences[i])
+      glDeleteSync(ring->fences[i]);
+  }
+
+  if (ring->id) {
+    if (ring->mapping) {
+      gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, ring->id);
+      glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    gl_state_forget_buffer(ring->id);
+    glDeleteBuffers(1, &ring->id);
+  }
+  free(ring);
+}
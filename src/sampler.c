@@ -0,0 +1,64 @@
+#include "sampler.h"
+#include "gl_state.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  sampler_desc_t desc;
+  GLuint id;
+} sampler_entry_t;
+
+static sampler_entry_t cache[SAMPLER_CACHE_SIZE];
+static uint32_t cache_count = 0;
+
+// Compare field by field so padding never breaks a match
+static bool desc_equal(const sampler_desc_t* a, const sampler_desc_t* b)
+{
+  return a->min_filter == b->min_filter && a->mag_filter == b->mag_filter &&
+    a->wrap_s == b->wrap_s && a->wrap_t == b->wrap_t && a->anisotropy == b->anisotropy;
+}
+
+GLuint sampler_get(const sampler_desc_t* desc)
+{
+  // Only a handful of distinct samplers ever exist, a linear scan beats hashing here
+  for (uint32_t i = 0; i < cache_count; i++) {
+    if (desc_equal(&cache[i].desc, desc))
+      return cache[i].id;
+  }
+
+  if (cache_count == SAMPLER_CACHE_SIZE) {
+    fprintf(stderr, "Sampler cache full (%d entries).\n", SAMPLER_CACHE_SIZE);
+    return 0;
+  }
+
+  GLuint id;
+  glGenSamplers(1, &id);
+  glSamplerParameteri(id, GL_TEXTURE_MIN_FILTER, desc->min_filter);
+  glSamplerParameteri(id, GL_TEXTURE_MAG_FILTER, desc->mag_filter);
+  glSamplerParameteri(id, GL_TEXTURE_WRAP_S, desc->wrap_s);
+  glSamplerParameteri(id, GL_TEXTURE_WRAP_T, desc->wrap_t);
+
+  if (desc->anisotropy > 1.0f) {
+    float max_anisotropy = 1.0f;
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &max_anisotropy);
+    glSamplerParameterf(id, GL_TEXTURE_MAX_ANISOTROPY,
+			desc->anisotropy < max_anisotropy ? desc->anisotropy : max_anisotropy);
+  }
+
+  cache[cache_count].desc = *desc;
+  cache[cache_count].id = id;
+  cache_count++;
+
+  return id;
+}
+
+void sampler_cache_destroy(void)
+{
+  for (uint32_t i = 0; i < cache_count; i++) {
+    gl_state_forget_sampler(cache[i].id);
+    glDeleteSamplers(1, &cache[i].id);
+  }
+  cache_count = 0;
+}
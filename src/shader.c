@@ -1,112 +1,498 @@
 #include "shader.h"
+#include "shader_cache.h"
+#include "shader_preprocess.h"
+#include "gl_state.h"
+#include "uniform_buffer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <GLFW/glfw3.h>
 
-char* read_file(const char* file_path)
+/* PARALLEL COMPILE */
+
+// GL_KHR_parallel_shader_compile (and the ARB version) aren't in our glad build
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP max_compiler_threads_fn)(GLuint count);
+
+static int32_t parallel_compile = -1; // -1 = not checked yet
+
+static bool parallel_compile_supported(void)
 {
-  FILE* file = fopen(file_path, "r");
-  if (!file) {
-    fprintf(stderr, "Could not open shader file %s\n", file_path);
-    return NULL;
-  };
+  if (parallel_compile >= 0)
+    return parallel_compile;
 
-  fseek(file, 0, SEEK_END);
-  size_t length = ftell(file);
-  rewind(file);
+  max_compiler_threads_fn max_threads = NULL;
+  if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+    max_threads = (max_compiler_threads_fn)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+  else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+    max_threads = (max_compiler_threads_fn)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
 
-  // Temporarily malloc, eventually manually reserve memory
-  char* content = (char*)malloc(length + 1);
-  if (!content) {
-    fprintf(stderr, "Memory allocation failed for shader file\n");
-    fclose(file);
-    return NULL;
-  };
+  // 0xFFFFFFFF lets the driver pick how many threads to use
+  if (max_threads)
+    max_threads(0xFFFFFFFFu);
 
-  fread(content, 1, length, file);
-  content[length] = '\0';
-  
-  fclose(file);
-  return content;
+  parallel_compile = max_threads != NULL;
+  printf("Parallel shader compile: %s\n", parallel_compile ? "yes" : "no");
+  return parallel_compile;
 }
 
+// Start compiling without asking for the status, which would make the driver finish first
 static uint32_t compile_shader(const char* source, GLenum type)
 {
   uint32_t shader = glCreateShader(type);
   glShaderSource(shader, 1, &source, NULL);
   glCompileShader(shader);
+  return shader;
+}
 
+static void check_compile(uint32_t shader, const char* path)
+{
   int32_t success;
   char info_log[512];
   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
   if(!success) {
     glGetShaderInfoLog(shader, 512, NULL, info_log);
-    fprintf(stderr, "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s\n", info_log);
+    fprintf(stderr, "ERROR::SHADER::COMPILATION_FAILED %s\n%s\n", path, info_log);
   };
+}
 
-  return shader;
+typedef struct {
+  shader_t* out;
+  shader_t shader;
+  char* vertex_path;
+  char* fragment_path;
+  uint32_t vertex;
+  uint32_t fragment;
+  uint64_t key;
+  bool cached;
+  bool reload;                 // swap into out only if the new program links
+  bool done;
+  double start;
+} shader_job_t;
 
+struct shader_batch {
+  shader_job_t* jobs;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t remaining;
+};
+
+static char* copy_string(const char* str)
+{
+  size_t length = strlen(str);
+  char* copy = malloc(length + 1);
+  if (copy)
+    memcpy(copy, str, length + 1);
+  return copy;
 }
 
-shader_t shader_create(const char* vertex_path, const char* fragment_path)
+// Collect the results of a program whose compile and link have completed
+static void finish_job(shader_job_t* job)
 {
-  shader_t shader;
+  int32_t success = job->cached;
+
+  if (!job->cached) {
+    check_compile(job->vertex, job->vertex_path);
+    check_compile(job->fragment, job->fragment_path);
+
+    char info_log[512];
+    glGetProgramiv(job->shader.id, GL_LINK_STATUS, &success);
+    if (!success) {
+      glGetProgramInfoLog(job->shader.id, 512, NULL, info_log);
+      fprintf(stderr, "ERROR::SHADER::LINKING_FAILED\n%s\n", info_log);
+    } else {
+      shader_cache_store(job->key, job->shader.id);
+    }
+
+    glDetachShader(job->shader.id, job->vertex);
+    glDetachShader(job->shader.id, job->fragment);
+    glDeleteShader(job->vertex);
+    glDeleteShader(job->fragment);
+  }
+
+  // A block that no longer matches its C struct would read garbage, so a reload is refused
+  if (success && !ubo_layout_verify(job->shader.id)) {
+    fprintf(stderr, "ERROR::SHADER::BLOCK_LAYOUT_MISMATCH %s + %s\n", job->vertex_path, job->fragment_path);
+    if (job->reload)
+      success = false;
+  }
+
+  double ms = (glfwGetTime() - job->start) * 1000.0;
+  shader_cache_record(job->cached, ms);
+  printf("Shader %s + %s %s in %.2f ms\n", job->vertex_path, job->fragment_path,
+	 job->cached ? "loaded from cache" : "compiled", ms);
+
+  job->done = true;
+
+  if (!job->reload) {
+    if (success) {
+      shader_refresh_uniforms(&job->shader);
+      shader_reflect(&job->shader);
+    }
+    *job->out = job->shader;
+    return;
+  }
+
+  // The old program keeps drawing unless the new one is good, and the uniform table is
+  // rebuilt in place so handles resolved against the old program stay valid
+  if (success) {
+    GLuint old = job->out->id;
+    job->out->id = job->shader.id;
+    shader_refresh_uniforms(job->out);
+    shader_reflect(job->out);
+    gl_state_forget_program(old);
+    glDeleteProgram(old);
+    printf("Shader reloaded: (ID %u)\n", job->out->id);
+  } else {
+    glDeleteProgram(job->shader.id);
+    fprintf(stderr, "Shader reload failed, keeping the old program: %s + %s\n",
+	    job->vertex_path, job->fragment_path);
+  }
+}
+
+shader_batch_t* shader_batch_create(void)
+{
+  shader_batch_t* batch = calloc(1, sizeof(shader_batch_t));
+  if (!batch)
+    fprintf(stderr, "Memory allocation failed for shader batch\n");
+  return batch;
+}
 
-  char* vertex_src = read_file(vertex_path);
-  char* fragment_src = read_file(fragment_path);
+void shader_batch_add(shader_batch_t* batch, shader_t* out, const char* vertex_path, const char* fragment_path)
+{
+  shader_batch_add_variant(batch, out, vertex_path, fragment_path, NULL);
+}
+
+static void batch_add(shader_batch_t* batch, shader_t* out, const char* vertex_path,
+		      const char* fragment_path, const char* defines, bool reload)
+{
+  parallel_compile_supported();
+
+  if (batch->count == batch->capacity) {
+    uint32_t capacity = batch->capacity ? batch->capacity * 2 : 8;
+    shader_job_t* jobs = realloc(batch->jobs, capacity * sizeof(shader_job_t));
+    if (!jobs) {
+      fprintf(stderr, "Memory allocation failed for shader batch\n");
+      return;
+    }
+    batch->jobs = jobs;
+    batch->capacity = capacity;
+  }
+
+  shader_job_t* job = &batch->jobs[batch->count];
+  memset(job, 0, sizeof(*job));
+  job->out = out;
+  job->reload = reload;
+  job->start = glfwGetTime();
+
+  char* vertex_src = shader_preprocess(vertex_path, defines, NULL);
+  char* fragment_src = shader_preprocess(fragment_path, defines, NULL);
 
   if (!vertex_src || !fragment_src) {
-      shader.id = 0;
-      return shader;
+      free(vertex_src);
+      free(fragment_src);
+      return;
   };
 
-  uint32_t vertex = compile_shader(vertex_src, GL_VERTEX_SHADER);
-  uint32_t fragment = compile_shader(fragment_src, GL_FRAGMENT_SHADER);
+  job->vertex_path = copy_string(vertex_path);
+  job->fragment_path = copy_string(fragment_path);
 
-  shader.id = glCreateProgram();
-  glAttachShader(shader.id, vertex);
-  glAttachShader(shader.id, fragment);
-  glLinkProgram(shader.id);
+  const char* sources[] = { vertex_src, fragment_src };
+  job->key = shader_cache_key(sources, 2, defines);
 
-  int32_t success;
-  char info_log[512];
-  glGetProgramiv(shader.id, GL_LINK_STATUS, &success);
-  if (!success) {
-      glGetProgramInfoLog(shader.id, 512, NULL, info_log);
-      fprintf(stderr, "ERROR::SHADER::LINKING_FAILED\n%s\n", info_log);
-  };
+  job->shader.id = glCreateProgram();
+
+  // Warm start: reuse the program binary linked on a previous run
+  job->cached = shader_cache_load(job->key, job->shader.id);
+
+  if (!job->cached) {
+    job->vertex = compile_shader(vertex_src, GL_VERTEX_SHADER);
+    job->fragment = compile_shader(fragment_src, GL_FRAGMENT_SHADER);
+
+    glAttachShader(job->shader.id, job->vertex);
+    glAttachShader(job->shader.id, job->fragment);
+    glProgramParameteri(job->shader.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(job->shader.id);
+  }
 
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
   free(vertex_src);
   free(fragment_src);
 
+  // Cleared when finish_job copies the built program over it
+  if (!reload)
+    out->compiling = true;
+  batch->count++;
+  batch->remaining++;
+}
+
+void shader_batch_add_variant(shader_batch_t* batch, shader_t* out, const char* vertex_path,
+			      const char* fragment_path, const char* defines)
+{
+  memset(out, 0, sizeof(*out));
+  batch_add(batch, out, vertex_path, fragment_path, defines, false);
+}
+
+void shader_batch_reload(shader_batch_t* batch, shader_t* shader, const char* vertex_path,
+			 const char* fragment_path, const char* defines)
+{
+  batch_add(batch, shader, vertex_path, fragment_path, defines, true);
+}
+
+bool shader_batch_poll(shader_batch_t* batch)
+{
+  // Without the extension any status query blocks, so finish one program per poll
+  // and let the caller render a frame in between
+  bool parallel = parallel_compile_supported();
+  bool finished_one = false;
+
+  for (uint32_t i = 0; i < batch->count && batch->remaining > 0; i++) {
+    shader_job_t* job = &batch->jobs[i];
+    if (job->done)
+      continue;
+
+    if (parallel && !job->cached) {
+      GLint complete = GL_FALSE;
+      glGetProgramiv(job->shader.id, GL_COMPLETION_STATUS_KHR, &complete);
+      if (!complete)
+	continue;
+    } else if (finished_one) {
+      break;
+    }
+
+    finish_job(job);
+    batch->remaining--;
+    finished_one = true;
+  }
+
+  return batch->remaining == 0;
+}
+
+void shader_batch_finish(shader_batch_t* batch)
+{
+  for (uint32_t i = 0; i < batch->count; i++) {
+    if (!batch->jobs[i].done) {
+      finish_job(&batch->jobs[i]);
+      batch->remaining--;
+    }
+  }
+}
+
+void shader_batch_destroy(shader_batch_t* batch)
+{
+  if (!batch)
+    return;
+
+  // Anything unfinished is finished so the programs aren't leaked
+  shader_batch_finish(batch);
+  for (uint32_t i = 0; i < batch->count; i++) {
+    free(batch->jobs[i].vertex_path);
+    free(batch->jobs[i].fragment_path);
+  }
+  free(batch->jobs);
+  free(batch);
+}
+
+shader_t shader_create(const char* vertex_path, const char* fragment_path)
+{
+  shader_t shader = { 0 };
+
+  shader_batch_t* batch = shader_batch_create();
+  if (!batch)
+    return shader;
+
+  shader_batch_add(batch, &shader, vertex_path, fragment_path);
+  shader_batch_destroy(batch);
+
   return shader;
 
 }
 
 void shader_use(const shader_t* shader)
 {
-  glUseProgram(shader->id);
+  gl_state_use_program(shader->id);
+}
+
+/* UNIFORM TABLE */
+
+// FNV-1a, only ever run on names at link time and when resolving handles
+static uint32_t hash_name(const char* name)
+{
+  uint32_t hash = 2166136261u;
+  while (*name) {
+    hash ^= (uint8_t)*name++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static shader_uniform_t find_uniform(const shader_uniforms_t* uniforms, const char* name)
+{
+  if (!uniforms->index)
+    return -1;
+
+  uint32_t hash = hash_name(name);
+  for (uint32_t i = hash & uniforms->index_mask;; i = (i + 1) & uniforms->index_mask) {
+    uint16_t entry = uniforms->index[i];
+    if (entry == 0)
+      return -1;
+    if (uniforms->hashes[entry - 1] == hash && strcmp(uniforms->names[entry - 1], name) == 0)
+      return entry - 1;
+  }
+}
+
+static bool add_uniform(shader_uniforms_t* uniforms, const char* name, GLint location)
+{
+  if (uniforms->count == uniforms->capacity) {
+    uint32_t capacity = uniforms->capacity ? uniforms->capacity * 2 : 16;
+    char** names = realloc(uniforms->names, capacity * sizeof(char*));
+    if (names) uniforms->names = names;
+    uint32_t* hashes = realloc(uniforms->hashes, capacity * sizeof(uint32_t));
+    if (hashes) uniforms->hashes = hashes;
+    GLint* locations = realloc(uniforms->locations, capacity * sizeof(GLint));
+    if (locations) uniforms->locations = locations;
+    if (!names || !hashes || !locations)
+      return false;
+    uniforms->capacity = capacity;
+  }
+
+  size_t length = strlen(name);
+  char* copy = malloc(length + 1);
+  if (!copy)
+    return false;
+  memcpy(copy, name, length + 1);
+
+  uniforms->names[uniforms->count] = copy;
+  uniforms->hashes[uniforms->count] = hash_name(name);
+  uniforms->locations[uniforms->count] = location;
+  uniforms->count++;
+  return true;
+}
+
+// Rebuild the hash index over all entries, kept at most half full
+static void index_uniforms(shader_uniforms_t* uniforms)
+{
+  uint32_t size = 16;
+  while (size < uniforms->count * 2)
+    size *= 2;
+
+  free(uniforms->index);
+  uniforms->index = calloc(size, sizeof(uint16_t));
+  if (!uniforms->index) {
+    uniforms->count = 0;
+    return;
+  }
+  uniforms->index_mask = size - 1;
+
+  for (uint32_t entry = 0; entry < uniforms->count; entry++) {
+    uint32_t i = uniforms->hashes[entry] & uniforms->index_mask;
+    while (uniforms->index[i] != 0)
+      i = (i + 1) & uniforms->index_mask;
+    uniforms->index[i] = (uint16_t)(entry + 1);
+  }
+}
+
+void shader_refresh_uniforms(shader_t* shader)
+{
+  shader_uniforms_t* uniforms = &shader->uniforms;
+
+  // Everything is inactive until the program says otherwise
+  for (uint32_t i = 0; i < uniforms->count; i++)
+    uniforms->locations[i] = -1;
+
+  GLint count = 0, max_length = 0;
+  glGetProgramiv(shader->id, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(shader->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+  char* name = malloc(max_length > 0 ? max_length : 1);
+  if (!name)
+    return;
+
+  for (GLint i = 0; i < count; i++) {
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(shader->id, i, max_length, NULL, &size, &type, name);
+
+    // Uniform block members have no location, they're set through buffers
+    GLint location = glGetUniformLocation(shader->id, name);
+    if (location < 0)
+      continue;
+
+    // Arrays are reported as "name[0]", register the plain name too
+    char* bracket = strstr(name, "[0]");
+    for (uint32_t pass = 0; pass < (bracket ? 2 : 1); pass++) {
+      if (pass == 1)
+	*bracket = '\0';
+      // Names are unique per program, so only entries from a previous link can match
+      shader_uniform_t existing = find_uniform(uniforms, name);
+      if (existing >= 0)
+	uniforms->locations[existing] = location;
+      else
+	add_uniform(uniforms, name, location);
+    }
+  }
+
+  free(name);
+  index_uniforms(uniforms);
+}
+
+shader_uniform_t shader_uniform(const shader_t* shader, const char* name)
+{
+  return find_uniform(&shader->uniforms, name);
+}
+
+static GLint uniform_location(const shader_t* shader, shader_uniform_t uniform)
+{
+  return uniform >= 0 ? shader->uniforms.locations[uniform] : -1;
+}
+
+void shader_set_uniform_bool(const shader_t* shader, shader_uniform_t uniform, bool value)
+{
+  glUniform1i(uniform_location(shader, uniform), (int32_t)value);
+}
+
+void shader_set_uniform_int(const shader_t* shader, shader_uniform_t uniform, int32_t value)
+{
+  glUniform1i(uniform_location(shader, uniform), value);
+}
+
+void shader_set_uniform_float(const shader_t* shader, shader_uniform_t uniform, float value)
+{
+  glUniform1f(uniform_location(shader, uniform), value);
 }
 
 void shader_set_bool(const shader_t* shader, const char* name, bool value)
 {
-  glUniform1i(glGetUniformLocation(shader->id, name), (int32_t)value);
+  shader_set_uniform_bool(shader, shader_uniform(shader, name), value);
 }
 
 void shader_set_int(const shader_t* shader, const char* name, int32_t value)
 {
-  glUniform1i(glGetUniformLocation(shader->id, name), value);
+  shader_set_uniform_int(shader, shader_uniform(shader, name), value);
 }
 
 void shader_set_float(const shader_t* shader, const char* name, float value)
 {
-  glUniform1f(glGetUniformLocation(shader->id, name), value);
+  shader_set_uniform_float(shader, shader_uniform(shader, name), value);
 }
 
 void shader_destroy(shader_t* shader)
 {
+  gl_state_forget_program(shader->id);
   glDeleteProgram(shader->id);
   shader->id = 0;
+
+  shader_uniforms_t* uniforms = &shader->uniforms;
+  for (uint32_t i = 0; i < uniforms->count; i++)
+    free(uniforms->names[i]);
+  free(uniforms->names);
+  free(uniforms->hashes);
+  free(uniforms->locations);
+  free(uniforms->index);
+  memset(uniforms, 0, sizeof(*uniforms));
+
+  shader_reflection_free(&shader->reflection);
 }
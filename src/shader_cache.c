@@ -0,0 +1,149 @@
+#include "shader_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;           // driver specific binary format enum
+  uint32_t length;
+} shader_cache_header_t;
+
+static shader_cache_stats_t stats;
+
+// FNV-1a 64, continuing from hash
+static uint64_t hash_string(uint64_t hash, const char* str)
+{
+  while (str && *str) {
+    hash ^= (uint8_t)*str++;
+    hash *= 1099511628211ull;
+  }
+  // Separator so ("ab", "c") and ("a", "bc") differ
+  hash ^= 0xFF;
+  hash *= 1099511628211ull;
+  return hash;
+}
+
+static bool binaries_supported(void)
+{
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  return formats > 0;
+}
+
+static void cache_path(uint64_t key, char* path, size_t size)
+{
+  snprintf(path, size, SHADER_CACHE_DIR "%016llx.bin", (unsigned long long)key);
+}
+
+uint64_t shader_cache_key(const char* const* sources, uint32_t count, const char* defines)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (uint32_t i = 0; i < count; i++)
+    hash = hash_string(hash, sources[i]);
+  hash = hash_string(hash, defines);
+  hash = hash_string(hash, (const char*)glGetString(GL_VENDOR));
+  hash = hash_string(hash, (const char*)glGetString(GL_RENDERER));
+  hash = hash_string(hash, (const char*)glGetString(GL_VERSION));
+  return hash;
+}
+
+bool shader_cache_load(uint64_t key, GLuint program)
+{
+  if (!binaries_supported())
+    return false;
+
+  char path[256];
+  cache_path(key, path, sizeof(path));
+  FILE* file = fopen(path, "rb");
+  if (!file)
+    return false;
+
+  shader_cache_header_t header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != SHADER_CACHE_MAGIC ||
+      header.version != SHADER_CACHE_VERSION || header.key != key) {
+    fclose(file);
+    return false;
+  }
+
+  void* binary = malloc(header.length);
+  if (!binary || fread(binary, 1, header.length, file) != header.length) {
+    free(binary);
+    fclose(file);
+    return false;
+  }
+  fclose(file);
+
+  // The driver may still reject it (ie it changed without changing its strings)
+  glProgramBinary(program, header.format, binary, header.length);
+  free(binary);
+
+  GLint success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  return success != 0;
+}
+
+void shader_cache_store(uint64_t key, GLuint program)
+{
+  if (!binaries_supported())
+    return;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  void* binary = malloc(length);
+  if (!binary)
+    return;
+
+  shader_cache_header_t header = { SHADER_CACHE_MAGIC, SHADER_CACHE_VERSION, key, 0, 0 };
+  GLenum format = 0;
+  GLsizei written = 0;
+  glGetProgramBinary(program, length, &written, &format, binary);
+  header.format = format;
+  header.length = (uint32_t)written;
+
+  make_dir(SHADER_CACHE_DIR);
+
+  char path[256];
+  cache_path(key, path, sizeof(path));
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "Could not write shader cache file %s\n", path);
+    free(binary);
+    return;
+  }
+
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(binary, 1, header.length, file);
+  fclose(file);
+  free(binary);
+}
+
+void shader_cache_record(bool hit, double ms)
+{
+  if (hit) {
+    stats.hits++;
+    stats.hit_ms += ms;
+  } else {
+    stats.misses++;
+    stats.miss_ms += ms;
+  }
+}
+
+shader_cache_stats_t shader_cache_get_stats(void)
+{
+  return stats;
+}
@@ -0,0 +1,311 @@
+#include "shader_preprocess.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+char* read_file(const char* file_path)
+{
+  FILE* file = fopen(file_path, "r");
+  if (!file) {
+    fprintf(stderr, "Could not open shader file %s\n", file_path);
+    return NULL;
+  };
+
+  fseek(file, 0, SEEK_END);
+  size_t length = ftell(file);
+  rewind(file);
+
+  // Temporarily malloc, eventually manually reserve memory
+  char* content = (char*)malloc(length + 1);
+  if (!content) {
+    fprintf(stderr, "Memory allocation failed for shader file\n");
+    fclose(file);
+    return NULL;
+  };
+
+  size_t read = fread(content, 1, length, file);
+  content[read] = '\0';
+
+  fclose(file);
+  return content;
+}
+
+/* OUTPUT TEXT */
+
+typedef struct {
+  char* data;
+  size_t length;
+  size_t capacity;
+  bool failed;
+} text_t;
+
+static void text_append(text_t* text, const char* str, size_t length)
+{
+  if (text->failed)
+    return;
+
+  if (text->length + length + 1 > text->capacity) {
+    size_t capacity = text->capacity ? text->capacity : 1024;
+    while (capacity < text->length + length + 1)
+      capacity *= 2;
+    char* data = realloc(text->data, capacity);
+    if (!data) {
+      fprintf(stderr, "Memory allocation failed for shader source\n");
+      text->failed = true;
+      return;
+    }
+    text->data = data;
+    text->capacity = capacity;
+  }
+
+  memcpy(text->data + text->length, str, length);
+  text->length += length;
+  text->data[text->length] = '\0';
+}
+
+static void text_append_line(text_t* text, uint32_t line, uint32_t source)
+{
+  char directive[32];
+  int length = snprintf(directive, sizeof(directive), "#line %u %u\n", line, source);
+  text_append(text, directive, length);
+}
+
+/* DEFINES */
+
+static int compare_strings(const void* a, const void* b)
+{
+  return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+char* shader_define_block(const char* const* defines, uint32_t count)
+{
+  text_t text = { 0 };
+  text_append(&text, "", 0);
+
+  const char** sorted = malloc((count ? count : 1) * sizeof(const char*));
+  if (!sorted) {
+    free(text.data);
+    return NULL;
+  }
+  memcpy(sorted, defines, count * sizeof(const char*));
+  qsort(sorted, count, sizeof(const char*), compare_strings);
+
+  for (uint32_t i = 0; i < count; i++) {
+    // Repeats of the same define collapse into one line
+    if (i > 0 && strcmp(sorted[i], sorted[i - 1]) == 0)
+      continue;
+
+    const char* equals = strchr(sorted[i], '=');
+    size_t name_length = equals ? (size_t)(equals - sorted[i]) : strlen(sorted[i]);
+    text_append(&text, "#define ", 8);
+    text_append(&text, sorted[i], name_length);
+    if (equals) {
+      text_append(&text, " ", 1);
+      text_append(&text, equals + 1, strlen(equals + 1));
+    } else {
+      text_append(&text, " 1", 2);
+    }
+    text_append(&text, "\n", 1);
+  }
+
+  free(sorted);
+  if (text.failed) {
+    free(text.data);
+    return NULL;
+  }
+  return text.data;
+}
+
+/* INCLUDES */
+
+static int32_t deps_find(const shader_deps_t* deps, const char* path)
+{
+  for (uint32_t i = 0; i < deps->count; i++) {
+    if (strcmp(deps->paths[i], path) == 0)
+      return i;
+  }
+  return -1;
+}
+
+static int32_t deps_add(shader_deps_t* deps, const char* path)
+{
+  if (deps->count == deps->capacity) {
+    uint32_t capacity = deps->capacity ? deps->capacity * 2 : 8;
+    char** paths = realloc(deps->paths, capacity * sizeof(char*));
+    if (!paths)
+      return -1;
+    deps->paths = paths;
+    deps->capacity = capacity;
+  }
+
+  size_t length = strlen(path);
+  char* copy = malloc(length + 1);
+  if (!copy)
+    return -1;
+  memcpy(copy, path, length + 1);
+
+  deps->paths[deps->count] = copy;
+  return deps->count++;
+}
+
+// Include paths are relative to the directory of the file doing the including
+static char* resolve_include(const char* from, const char* name, size_t name_length)
+{
+  const char* slash = strrchr(from, '/');
+  size_t dir_length = slash ? (size_t)(slash - from + 1) : 0;
+
+  char* path = malloc(dir_length + name_length + 1);
+  if (!path)
+    return NULL;
+  memcpy(path, from, dir_length);
+  memcpy(path + dir_length, name, name_length);
+  path[dir_length + name_length] = '\0';
+  return path;
+}
+
+// Parse `#include "name"`, returns false for any other line
+static bool parse_include(const char* line, const char* end, const char** name, size_t* name_length)
+{
+  while (line < end && (*line == ' ' || *line == '\t'))
+    line++;
+  if (end - line < 8 || strncmp(line, "#include", 8) != 0)
+    return false;
+  line += 8;
+  while (line < end && (*line == ' ' || *line == '\t'))
+    line++;
+  if (line == end || *line != '"')
+    return false;
+
+  const char* close = memchr(line + 1, '"', end - line - 1);
+  if (!close)
+    return false;
+
+  *name = line + 1;
+  *name_length = close - line - 1;
+  return true;
+}
+
+// Line of the #version directive, 0 if there's none. Only blank lines and comments may come
+// before it, so anything else ends the search, as does a #version inside a comment
+static uint32_t version_line(const char* source)
+{
+  uint32_t line_number = 1;
+  const char* c = source;
+
+  while (*c) {
+    if (*c == '\n') {
+      line_number++;
+      c++;
+    } else if (*c == ' ' || *c == '\t' || *c == '\r') {
+      c++;
+    } else if (c[0] == '/' && c[1] == '/') {
+      c += strcspn(c, "\n");
+    } else if (c[0] == '/' && c[1] == '*') {
+      const char* close = strstr(c + 2, "*/");
+      const char* stop = close ? close + 2 : c + strlen(c);
+      for (; c < stop; c++)
+	line_number += *c == '\n';
+    } else {
+      return strncmp(c, "#version", 8) == 0 ? line_number : 0;
+    }
+  }
+  return 0;
+}
+
+static bool preprocess_file(text_t* text, const char* path, const char* defines,
+			    shader_deps_t* deps, uint32_t depth)
+{
+  if (depth > SHADER_INCLUDE_DEPTH) {
+    fprintf(stderr, "Shader includes nested too deeply at %s\n", path);
+    return false;
+  }
+
+  int32_t source = deps_add(deps, path);
+  if (source < 0) {
+    fprintf(stderr, "Memory allocation failed for shader includes\n");
+    return false;
+  }
+
+  char* content = read_file(path);
+  if (!content)
+    return false;
+
+  bool ok = true;
+  uint32_t line_number = 1;
+  const char* line = content;
+
+  if (depth > 0)
+    text_append_line(text, 1, source);
+
+  // Only the top level file gets the defines, after #version or first if there isn't one
+  uint32_t version = depth == 0 && defines ? version_line(content) : 0;
+  if (depth == 0 && defines && version == 0) {
+    text_append(text, defines, strlen(defines));
+    text_append_line(text, 1, source);
+  }
+
+  while (*line && ok) {
+    const char* end = line + strcspn(line, "\n");
+    const char* next = *end ? end + 1 : end;
+
+    const char* name;
+    size_t name_length;
+    if (parse_include(line, end, &name, &name_length)) {
+      char* include = resolve_include(path, name, name_length);
+      if (!include) {
+	ok = false;
+      } else if (deps_find(deps, include) < 0) {
+	ok = preprocess_file(text, include, NULL, deps, depth + 1);
+	text_append_line(text, line_number + 1, source);
+      } else {
+	// Already spliced in once, a repeat include becomes a blank line
+	text_append(text, "\n", 1);
+      }
+      free(include);
+    } else {
+      text_append(text, line, next - line);
+      if (*end == '\0')
+	text_append(text, "\n", 1);
+
+      if (version != 0 && line_number == version) {
+	text_append(text, defines, strlen(defines));
+	text_append_line(text, line_number + 1, source);
+      }
+    }
+
+    line = next;
+    line_number++;
+  }
+
+  free(content);
+  return ok && !text->failed;
+}
+
+char* shader_preprocess(const char* path, const char* defines, shader_deps_t* deps)
+{
+  shader_deps_t local = { 0 };
+  if (!deps)
+    deps = &local;
+
+  text_t text = { 0 };
+  bool ok = preprocess_file(&text, path, defines, deps, 0);
+  shader_deps_free(&local);
+
+  if (!ok) {
+    fprintf(stderr, "Failed to preprocess shader %s\n", path);
+    free(text.data);
+    return NULL;
+  }
+  return text.data;
+}
+
+void shader_deps_free(shader_deps_t* deps)
+{
+  for (uint32_t i = 0; i < deps->count; i++)
+    free(deps->paths[i]);
+  free(deps->paths);
+  deps->paths = NULL;
+  deps->count = 0;
+  deps->capacity = 0;
+}
@@ -0,0 +1,248 @@
+#include "shader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REFLECT_NAME_MAX 128
+
+// Components per location and locations used, ie GL_FLOAT_MAT4 is 4 locations of 4
+static uint32_t type_components(GLenum type, uint32_t* columns)
+{
+  *columns = 1;
+  switch (type) {
+  case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT: case GL_DOUBLE:
+    return 1;
+  case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_DOUBLE_VEC2:
+    return 2;
+  case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_DOUBLE_VEC3:
+    return 3;
+  case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_DOUBLE_VEC4:
+    return 4;
+  case GL_FLOAT_MAT2: *columns = 2; return 2;
+  case GL_FLOAT_MAT3: *columns = 3; return 3;
+  case GL_FLOAT_MAT4: *columns = 4; return 4;
+  default:
+    return 0;
+  }
+}
+
+// Texture target a sampler type reads, 0 for anything that isn't a sampler
+static GLenum sampler_target(GLenum type)
+{
+  switch (type) {
+  case GL_SAMPLER_1D: case GL_INT_SAMPLER_1D: case GL_UNSIGNED_INT_SAMPLER_1D: case GL_SAMPLER_1D_SHADOW:
+    return GL_TEXTURE_1D;
+  case GL_SAMPLER_2D: case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_SAMPLER_2D_SHADOW:
+    return GL_TEXTURE_2D;
+  case GL_SAMPLER_3D: case GL_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_3D:
+    return GL_TEXTURE_3D;
+  case GL_SAMPLER_CUBE: case GL_INT_SAMPLER_CUBE: case GL_UNSIGNED_INT_SAMPLER_CUBE: case GL_SAMPLER_CUBE_SHADOW:
+    return GL_TEXTURE_CUBE_MAP;
+  case GL_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+  case GL_SAMPLER_2D_ARRAY_SHADOW:
+    return GL_TEXTURE_2D_ARRAY;
+  case GL_SAMPLER_BUFFER: case GL_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+    return GL_TEXTURE_BUFFER;
+  case GL_SAMPLER_2D_MULTISAMPLE: case GL_INT_SAMPLER_2D_MULTISAMPLE: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+    return GL_TEXTURE_2D_MULTISAMPLE;
+  default:
+    return 0;
+  }
+}
+
+static char* copy_string(const char* str)
+{
+  size_t length = strlen(str);
+  char* copy = malloc(length + 1);
+  if (copy)
+    memcpy(copy, str, length + 1);
+  return copy;
+}
+
+void shader_reflection_free(shader_reflection_t* reflection)
+{
+  for (uint32_t i = 0; i < reflection->input_count; i++)
+    free(reflection->inputs[i].name);
+  for (uint32_t i = 0; i < reflection->sampler_count; i++)
+    free(reflection->samplers[i].name);
+  for (uint32_t i = 0; i < reflection->block_count; i++)
+    free(reflection->blocks[i].name);
+  free(reflection->inputs);
+  free(reflection->samplers);
+  free(reflection->blocks);
+  memset(reflection, 0, sizeof(*reflection));
+}
+
+static void reflect_inputs(GLuint program, shader_reflection_t* reflection)
+{
+  GLint count = 0;
+  glGetProgramInterfaceiv(program, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+  reflection->inputs = calloc(count > 0 ? count : 1, sizeof(shader_input_t));
+  if (!reflection->inputs)
+    return;
+
+  const GLenum props[] = { GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE };
+  for (GLint i = 0; i < count; i++) {
+    GLint values[3];
+    glGetProgramResourceiv(program, GL_PROGRAM_INPUT, i, 3, props, 3, NULL, values);
+
+    // Built-ins have no location
+    if (values[1] < 0)
+      continue;
+
+    char name[REFLECT_NAME_MAX];
+    glGetProgramResourceName(program, GL_PROGRAM_INPUT, i, sizeof(name), NULL, name);
+
+    shader_input_t* input = &reflection->inputs[reflection->input_count++];
+    input->name = copy_string(name);
+    input->type = values[0];
+    input->location = values[1];
+    input->array_size = values[2];
+  }
+}
+
+static int compare_units(const void* a, const void* b)
+{
+  return ((const shader_sampler_t*)a)->unit - ((const shader_sampler_t*)b)->unit;
+}
+
+static void reflect_samplers(GLuint program, shader_reflection_t* reflection)
+{
+  GLint count = 0;
+  glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+  reflection->samplers = calloc(count > 0 ? count : 1, sizeof(shader_sampler_t));
+  if (!reflection->samplers)
+    return;
+
+  const GLenum props[] = { GL_TYPE, GL_LOCATION };
+  bool all_zero = true;
+  for (GLint i = 0; i < count; i++) {
+    GLint values[2];
+    glGetProgramResourceiv(program, GL_UNIFORM, i, 2, props, 2, NULL, values);
+
+    GLenum target = sampler_target(values[0]);
+    if (target == 0 || values[1] < 0)
+      continue;
+
+    char name[REFLECT_NAME_MAX];
+    glGetProgramResourceName(program, GL_UNIFORM, i, sizeof(name), NULL, name);
+
+    shader_sampler_t* sampler = &reflection->samplers[reflection->sampler_count++];
+    sampler->name = copy_string(name);
+    sampler->type = values[0];
+    sampler->target = target;
+    sampler->location = values[1];
+    glGetUniformiv(program, sampler->location, &sampler->unit);
+    if (sampler->unit != 0)
+      all_zero = false;
+  }
+
+  // No layout(binding = N) anywhere, so every sampler would read unit 0
+  if (all_zero && reflection->sampler_count > 1) {
+    for (uint32_t i = 0; i < reflection->sampler_count; i++) {
+      reflection->samplers[i].unit = i;
+      glProgramUniform1i(program, reflection->samplers[i].location, i);
+    }
+  }
+
+  qsort(reflection->samplers, reflection->sampler_count, sizeof(shader_sampler_t), compare_units);
+}
+
+static void reflect_blocks(GLuint program, shader_reflection_t* reflection)
+{
+  const GLenum interfaces[] = { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK };
+  GLint counts[2] = { 0, 0 };
+  for (uint32_t i = 0; i < 2; i++)
+    glGetProgramInterfaceiv(program, interfaces[i], GL_ACTIVE_RESOURCES, &counts[i]);
+
+  reflection->blocks = calloc(counts[0] + counts[1] > 0 ? counts[0] + counts[1] : 1, sizeof(shader_block_t));
+  if (!reflection->blocks)
+    return;
+
+  const GLenum props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+  for (uint32_t i = 0; i < 2; i++) {
+    for (GLint b = 0; b < counts[i]; b++) {
+      GLint values[2];
+      glGetProgramResourceiv(program, interfaces[i], b, 2, props, 2, NULL, values);
+
+      char name[REFLECT_NAME_MAX];
+      glGetProgramResourceName(program, interfaces[i], b, sizeof(name), NULL, name);
+
+      shader_block_t* block = &reflection->blocks[reflection->block_count++];
+      block->name = copy_string(name);
+      block->interface = interfaces[i];
+      block->binding = values[0];
+      block->size = values[1];
+    }
+  }
+}
+
+void shader_reflect(shader_t* shader)
+{
+  shader_reflection_free(&shader->reflection);
+  if (shader->id == 0)
+    return;
+
+  reflect_inputs(shader->id, &shader->reflection);
+  reflect_samplers(shader->id, &shader->reflection);
+  reflect_blocks(shader->id, &shader->reflection);
+}
+
+int32_t shader_sampler_index(const shader_t* shader, const char* name)
+{
+  for (uint32_t i = 0; i < shader->reflection.sampler_count; i++) {
+    if (shader->reflection.samplers[i].name && strcmp(shader->reflection.samplers[i].name, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+bool shader_validate_vertex_layout(const shader_t* shader, const vertex_layout_t* const* layouts, uint32_t count)
+{
+  bool ok = true;
+
+  for (uint32_t i = 0; i < shader->reflection.input_count; i++) {
+    const shader_input_t* input = &shader->reflection.inputs[i];
+    uint32_t columns;
+    uint32_t components = type_components(input->type, &columns);
+    uint32_t locations = columns * (input->array_size > 0 ? input->array_size : 1);
+
+    for (uint32_t l = 0; l < locations; l++) {
+      const vertex_attribute_t* attribute = NULL;
+      for (uint32_t b = 0; b < count && !attribute; b++)
+	attribute = vertex_layout_find(layouts[b], input->location + l);
+      if (!attribute) {
+	fprintf(stderr, "Vertex input %s (location %d) has no attribute in the vertex layout\n",
+		input->name, input->location + l);
+	ok = false;
+      } else if (components != 0 && attribute->components != components) {
+	// GL fills in missing components, but a mismatch is almost always a layout bug
+	fprintf(stderr, "Vertex input %s (location %d) reads %u components, layout provides %u\n",
+		input->name, input->location + l, components, attribute->components);
+	ok = false;
+      }
+    }
+  }
+
+  return ok;
+}
+
+bool shader_validate_samplers(const shader_t* shader)
+{
+  bool ok = true;
+  const shader_reflection_t* reflection = &shader->reflection;
+
+  // Sorted by unit, so clashes are neighbours
+  for (uint32_t i = 1; i < reflection->sampler_count; i++) {
+    const shader_sampler_t* a = &reflection->samplers[i - 1];
+    const shader_sampler_t* b = &reflection->samplers[i];
+    if (a->unit == b->unit && a->target != b->target) {
+      fprintf(stderr, "Samplers %s and %s both read unit %d as different texture types\n",
+	      a->name, b->name, a->unit);
+      ok = false;
+    }
+  }
+
+  return ok;
+}
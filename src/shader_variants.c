@@ -0,0 +1,142 @@
+#include "shader_variants.h"
+#include "shader_preprocess.h"
+#include "shader_watch.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  uint64_t hash;
+  char* defines;             // normalized #define block, compared on a hash match
+  shader_t* shader;          // heap allocated so pointers handed out survive growth
+} shader_variant_t;
+
+struct shader_variants {
+  char* vertex_path;
+  char* fragment_path;
+  shader_variant_t* entries;
+  uint32_t count;
+  uint32_t capacity;
+};
+
+// FNV-1a 64
+static uint64_t hash_defines(const char* defines)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (; *defines; defines++) {
+    hash ^= (uint8_t)*defines;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static char* copy_string(const char* str)
+{
+  size_t length = strlen(str);
+  char* copy = malloc(length + 1);
+  if (copy)
+    memcpy(copy, str, length + 1);
+  return copy;
+}
+
+shader_variants_t* shader_variants_create(const char* vertex_path, const char* fragment_path)
+{
+  shader_variants_t* variants = calloc(1, sizeof(shader_variants_t));
+  if (!variants) {
+    fprintf(stderr, "Memory allocation failed for shader variants\n");
+    return NULL;
+  }
+
+  variants->vertex_path = copy_string(vertex_path);
+  variants->fragment_path = copy_string(fragment_path);
+  if (!variants->vertex_path || !variants->fragment_path) {
+    fprintf(stderr, "Memory allocation failed for shader variants\n");
+    shader_variants_destroy(variants);
+    return NULL;
+  }
+
+  return variants;
+}
+
+const shader_t* shader_variant(shader_variants_t* variants, const char* const* defines, uint32_t count,
+			       shader_batch_t* batch)
+{
+  char* block = shader_define_block(defines, count);
+  if (!block)
+    return NULL;
+
+  // Few variants per shader, a linear scan over hashes is plenty
+  uint64_t hash = hash_defines(block);
+  for (uint32_t i = 0; i < variants->count; i++) {
+    if (variants->entries[i].hash == hash && strcmp(variants->entries[i].defines, block) == 0) {
+      free(block);
+      return variants->entries[i].shader;
+    }
+  }
+
+  if (variants->count == variants->capacity) {
+    uint32_t capacity = variants->capacity ? variants->capacity * 2 : 8;
+    shader_variant_t* entries = realloc(variants->entries, capacity * sizeof(shader_variant_t));
+    if (!entries) {
+      fprintf(stderr, "Memory allocation failed for shader variants\n");
+      free(block);
+      return NULL;
+    }
+    variants->entries = entries;
+    variants->capacity = capacity;
+  }
+
+  shader_t* shader = malloc(sizeof(shader_t));
+  if (!shader) {
+    fprintf(stderr, "Memory allocation failed for shader variants\n");
+    free(block);
+    return NULL;
+  }
+
+  if (batch) {
+    shader_batch_add_variant(batch, shader, variants->vertex_path, variants->fragment_path, block);
+  } else {
+    shader_batch_t* local = shader_batch_create();
+    if (!local) {
+      free(shader);
+      free(block);
+      return NULL;
+    }
+    shader_batch_add_variant(local, shader, variants->vertex_path, variants->fragment_path, block);
+    shader_batch_destroy(local);
+  }
+
+  shader_variant_t* entry = &variants->entries[variants->count++];
+  entry->hash = hash;
+  entry->defines = block;
+  entry->shader = shader;
+
+  // Recompiled when its sources change, if hot reload is on
+  shader_watch_add(shader, variants->vertex_path, variants->fragment_path, block);
+
+  return shader;
+}
+
+uint32_t shader_variants_count(const shader_variants_t* variants)
+{
+  return variants->count;
+}
+
+void shader_variants_destroy(shader_variants_t* variants)
+{
+  if (!variants)
+    return;
+
+  for (uint32_t i = 0; i < variants->count; i++) {
+    shader_watch_remove(variants->entries[i].shader);
+    shader_destroy(variants->entries[i].shader);
+    free(variants->entries[i].shader);
+    free(variants->entries[i].defines);
+  }
+  free(variants->entries);
+  free(variants->vertex_path);
+  free(variants->fragment_path);
+  free(variants);
+}
@@ -0,0 +1,179 @@
+#include "shader_watch.h"
+#include "shader_preprocess.h"
+#include "file_watch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  shader_t* shader;
+  char* vertex_path;
+  char* fragment_path;
+  char* defines;
+  shader_deps_t deps;          // both stages and everything they include
+  bool compiling;              // part of the batch in flight
+  bool stale;                  // needs a rebuild once the current batch is done
+} watched_shader_t;
+
+static file_watch_t* watch = NULL;
+static watched_shader_t shaders[SHADER_WATCH_MAX];
+static uint32_t shader_count = 0;
+
+// Only one batch at a time, anything changed meanwhile waits for the next one
+static shader_batch_t* batch = NULL;
+
+static char* copy_string(const char* str)
+{
+  if (!str)
+    return NULL;
+  size_t length = strlen(str);
+  char* copy = malloc(length + 1);
+  if (copy)
+    memcpy(copy, str, length + 1);
+  return copy;
+}
+
+// Includes can come and go between edits, so the file list is rebuilt after every reload
+static void refresh_deps(watched_shader_t* entry)
+{
+  shader_deps_free(&entry->deps);
+  free(shader_preprocess(entry->vertex_path, NULL, &entry->deps));
+  free(shader_preprocess(entry->fragment_path, NULL, &entry->deps));
+
+  for (uint32_t i = 0; i < entry->deps.count; i++)
+    file_watch_add(watch, entry->deps.paths[i]);
+}
+
+static bool depends_on(const watched_shader_t* entry, const char* path)
+{
+  for (uint32_t i = 0; i < entry->deps.count; i++) {
+    if (strcmp(entry->deps.paths[i], path) == 0)
+      return true;
+  }
+  return false;
+}
+
+static void finish_batch(void)
+{
+  if (!batch)
+    return;
+
+  shader_batch_destroy(batch);
+  batch = NULL;
+
+  for (uint32_t i = 0; i < shader_count; i++) {
+    if (shaders[i].compiling) {
+      shaders[i].compiling = false;
+      refresh_deps(&shaders[i]);
+    }
+  }
+}
+
+void shader_watch_init(void)
+{
+  watch = file_watch_create();
+}
+
+void shader_watch_add(shader_t* shader, const char* vertex_path, const char* fragment_path, const char* defines)
+{
+  if (!watch)
+    return;
+
+  if (shader_count == SHADER_WATCH_MAX) {
+    fprintf(stderr, "Too many watched shaders (%d).\n", SHADER_WATCH_MAX);
+    return;
+  }
+
+  watched_shader_t* entry = &shaders[shader_count];
+  memset(entry, 0, sizeof(*entry));
+  entry->shader = shader;
+  entry->vertex_path = copy_string(vertex_path);
+  entry->fragment_path = copy_string(fragment_path);
+  entry->defines = copy_string(defines);
+  if (!entry->vertex_path || !entry->fragment_path || (defines && !entry->defines)) {
+    free(entry->vertex_path);
+    free(entry->fragment_path);
+    free(entry->defines);
+    return;
+  }
+
+  refresh_deps(entry);
+  shader_count++;
+}
+
+void shader_watch_remove(const shader_t* shader)
+{
+  for (uint32_t i = 0; i < shader_count; i++) {
+    if (shaders[i].shader != shader)
+      continue;
+
+    // The batch holds a pointer to the shader, so it can't outlive it
+    if (shaders[i].compiling)
+      finish_batch();
+
+    free(shaders[i].vertex_path);
+    free(shaders[i].fragment_path);
+    free(shaders[i].defines);
+    shader_deps_free(&shaders[i].deps);
+    shaders[i] = shaders[--shader_count];
+    return;
+  }
+}
+
+void shader_watch_poll(void)
+{
+  if (!watch)
+    return;
+
+  const char* changed[FILE_WATCH_MAX_FILES];
+  uint32_t changed_count = file_watch_poll(watch, changed, FILE_WATCH_MAX_FILES);
+
+  // A shared include marks every program that pulls it in
+  for (uint32_t c = 0; c < changed_count; c++) {
+    for (uint32_t i = 0; i < shader_count; i++) {
+      if (depends_on(&shaders[i], changed[c]))
+	shaders[i].stale = true;
+    }
+  }
+
+  if (batch) {
+    if (!shader_batch_poll(batch))
+      return;
+    finish_batch();
+  }
+
+  // Compiles go through a batch so GL_KHR_parallel_shader_compile keeps them off this thread
+  for (uint32_t i = 0; i < shader_count; i++) {
+    watched_shader_t* entry = &shaders[i];
+
+    // Still waiting on its first compile, which would overwrite the reload when it lands. One
+    // whose first build failed, even before reaching GL, is rebuilt like any other
+    if (!entry->stale || entry->shader->compiling)
+      continue;
+
+    if (!batch && !(batch = shader_batch_create()))
+      return;
+
+    printf("Shader changed, recompiling: %s + %s\n", entry->vertex_path, entry->fragment_path);
+    shader_batch_reload(batch, entry->shader, entry->vertex_path, entry->fragment_path, entry->defines);
+    entry->stale = false;
+    entry->compiling = true;
+  }
+}
+
+void shader_watch_shutdown(void)
+{
+  finish_batch();
+
+  for (uint32_t i = 0; i < shader_count; i++) {
+    free(shaders[i].vertex_path);
+    free(shaders[i].fragment_path);
+    free(shaders[i].defines);
+    shader_deps_free(&shaders[i].deps);
+  }
+  shader_count = 0;
+
+  file_watch_destroy(watch);
+  watch = NULL;
+}
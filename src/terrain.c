@@ -0,0 +1,644 @@
+#include "terrain.h"
+#include "gl_state.h"
+#include "noise.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLFW/glfw3.h>
+
+#define TERRAIN_SKIRT_CELLS 4.0f       // skirt depth in grid spacings of the chunk's LOD
+
+// Floats per source vertex: position, normal
+#define TERRAIN_SOURCE_COMPONENTS 6
+
+static const vertex_format_t terrain_format = {
+  2, {
+    { 0, 3, VERTEX_FLOAT },
+    { 1, 3, VERTEX_OCT16 },
+  }
+};
+
+// What vertex_layout_from_format makes of terrain_format, spelled out so it can be a constant
+const vertex_layout_t terrain_vertex_layout = {
+  16, 0, 2, {
+    { 0, 3, GL_FLOAT, GL_FALSE, 0 },                   // position, y is world height
+    { 1, 2, GL_SHORT, GL_TRUE, 12 },                   // octahedral normal
+  }
+};
+
+typedef struct chunk_job chunk_job_t;
+
+struct chunk_job {
+  terrain_t* terrain;
+  int32_t x, z;
+  uint32_t lod;
+  uint8_t* vertices;           // encoded in terrain_vertex_layout
+  float min_y, max_y;
+  double generate_ms;
+  chunk_job_t* next;
+};
+
+struct terrain {
+  thread_pool_t* workers;
+  terrain_window_t window;     // centered on the camera's chunk
+
+  // Every slot fits a LOD 0 chunk, coarser ones use the start of theirs
+  GLuint vao;
+  GLuint vbo;
+  GLuint ebo;
+  uint32_t slot_vertices;
+  uint32_t index_offset[TERRAIN_LODS];  // bytes into ebo
+  uint32_t index_count[TERRAIN_LODS];
+
+  pthread_mutex_t lock;
+  pthread_cond_t idle;
+  chunk_job_t* finished;       // pushed by workers
+  uint32_t in_flight;          // jobs not finished yet
+
+  // Main thread only
+  chunk_job_t* ready;          // finished, waiting for an upload
+  uint32_t pending;            // submitted and not uploaded or dropped yet
+  terrain_stats_t stats;
+};
+
+/* HEIGHTS */
+
+float terrain_height(float x, float z)
+{
+  float height = 0.0f;
+  float total = 0.0f;
+  float amplitude = 1.0f;
+  float frequency = TERRAIN_NOISE_SCALE;
+
+  // Each octave offset so their lattice points don't line up
+  for (uint32_t octave = 0; octave < TERRAIN_OCTAVES; octave++) {
+    height += perlin2d(x * frequency + octave * 17.31f, z * frequency + octave * 7.13f) * amplitude;
+    total += amplitude;
+    amplitude *= 0.5f;
+    frequency *= 2.0f;
+  }
+  return TERRAIN_ELEVATION + height / total * TERRAIN_HEIGHT;
+}
+
+/* CHUNK MESHES */
+
+static uint32_t lod_quads(uint32_t lod)
+{
+  return TERRAIN_CHUNK_QUADS >> lod;
+}
+
+uint32_t terrain_lod_vertices(uint32_t lod)
+{
+  uint32_t side = lod_quads(lod) + 1;
+  return side * side + 4 * side;
+}
+
+// Two triangles per grid quad and per skirt quad
+uint32_t terrain_lod_indices(uint32_t lod)
+{
+  uint32_t quads = lod_quads(lod);
+  return quads * quads * 6 + 4 * quads * 6;
+}
+
+static float lod_skirt(uint32_t lod)
+{
+  return TERRAIN_SKIRT_CELLS * TERRAIN_CHUNK_SIZE / lod_quads(lod);
+}
+
+// Grid index of the k-th vertex along edge e, edges run counterclockwise seen from above so skirt
+// faces all point outwards
+static uint32_t edge_vertex(uint32_t e, uint32_t k, uint32_t quads)
+{
+  uint32_t side = quads + 1;
+  switch (e) {
+  case 0: return k * side;                          // x = 0, z rising
+  case 1: return quads * side + k;                  // z = max, x rising
+  case 2: return (quads - k) * side + quads;        // x = max, z falling
+  default: return quads - k;                        // z = 0, x falling
+  }
+}
+
+// Heights with a one sample border around the grid, so edge normals come out the same as the
+// neighbouring chunk's at the same LOD
+bool terrain_build_chunk(int32_t chunk_x, int32_t chunk_z, uint32_t lod, void* vertices, float y_range_out[2])
+{
+  uint32_t quads = lod_quads(lod);
+  uint32_t side = quads + 1;
+  uint32_t border_side = side + 2;
+  float spacing = TERRAIN_CHUNK_SIZE / quads;
+  float origin_x = chunk_x * TERRAIN_CHUNK_SIZE;
+  float origin_z = chunk_z * TERRAIN_CHUNK_SIZE;
+
+  float* heights = malloc(border_side * border_side * sizeof(float));
+  float* source = malloc(terrain_lod_vertices(lod) * TERRAIN_SOURCE_COMPONENTS * sizeof(float));
+  if (!heights || !source) {
+    fprintf(stderr, "Memory allocation failed for terrain chunk (%d, %d)\n", chunk_x, chunk_z);
+    free(heights);
+    free(source);
+    return false;
+  }
+
+  for (uint32_t z = 0; z < border_side; z++)
+    for (uint32_t x = 0; x < border_side; x++)
+      heights[z * border_side + x] = terrain_height(origin_x + ((float)x - 1.0f) * spacing,
+						    origin_z + ((float)z - 1.0f) * spacing);
+
+  y_range_out[0] = INFINITY;
+  y_range_out[1] = -INFINITY;
+  for (uint32_t z = 0; z < side; z++) {
+    for (uint32_t x = 0; x < side; x++) {
+      const float* h = &heights[(z + 1) * border_side + x + 1];
+      float* vertex = &source[(z * side + x) * TERRAIN_SOURCE_COMPONENTS];
+      vertex[0] = x * spacing;
+      vertex[1] = h[0];
+      vertex[2] = z * spacing;
+
+      // Central differences, scaled by 2 * spacing
+      vec3 normal = { h[-1] - h[1], 2.0f * spacing, h[-(int32_t)border_side] - h[border_side] };
+      glm_vec3_normalize(normal);
+      memcpy(vertex + 3, normal, sizeof(vec3));
+
+      if (h[0] < y_range_out[0]) y_range_out[0] = h[0];
+      if (h[0] > y_range_out[1]) y_range_out[1] = h[0];
+    }
+  }
+
+  // Skirts copy the edge vertices, dropped straight down
+  float skirt = lod_skirt(lod);
+  float* out = &source[side * side * TERRAIN_SOURCE_COMPONENTS];
+  for (uint32_t e = 0; e < 4; e++) {
+    for (uint32_t k = 0; k < side; k++) {
+      memcpy(out, &source[edge_vertex(e, k, quads) * TERRAIN_SOURCE_COMPONENTS],
+	     TERRAIN_SOURCE_COMPONENTS * sizeof(float));
+      out[1] -= skirt;
+      out += TERRAIN_SOURCE_COMPONENTS;
+    }
+  }
+
+  vertex_format_convert(&terrain_format, source, terrain_lod_vertices(lod), vertices);
+  free(heights);
+  free(source);
+  return true;
+}
+
+uint32_t terrain_build_indices(uint32_t lod, uint16_t* out)
+{
+  uint32_t quads = lod_quads(lod);
+  uint32_t side = quads + 1;
+  uint16_t* start = out;
+
+  for (uint32_t z = 0; z < quads; z++) {
+    for (uint32_t x = 0; x < quads; x++) {
+      uint16_t i0 = (uint16_t)(z * side + x);
+      uint16_t i1 = (uint16_t)(i0 + 1);
+      uint16_t i2 = (uint16_t)(i0 + side);
+      uint16_t i3 = (uint16_t)(i2 + 1);
+      *out++ = i0; *out++ = i2; *out++ = i1;
+      *out++ = i1; *out++ = i2; *out++ = i3;
+    }
+  }
+
+  for (uint32_t e = 0; e < 4; e++) {
+    uint32_t skirt = side * side + e * side;
+    for (uint32_t k = 0; k < quads; k++) {
+      uint16_t g0 = (uint16_t)edge_vertex(e, k, quads);
+      uint16_t g1 = (uint16_t)edge_vertex(e, k + 1, quads);
+      uint16_t s0 = (uint16_t)(skirt + k);
+      uint16_t s1 = (uint16_t)(skirt + k + 1);
+      *out++ = g0; *out++ = s0; *out++ = g1;
+      *out++ = g1; *out++ = s0; *out++ = s1;
+    }
+  }
+  return (uint32_t)(out - start);
+}
+
+/* WINDOW */
+
+static int compare_offsets(const void* a, const void* b)
+{
+  const int32_t* oa = a;
+  const int32_t* ob = b;
+  int32_t ring_a = abs(oa[0]) > abs(oa[1]) ? abs(oa[0]) : abs(oa[1]);
+  int32_t ring_b = abs(ob[0]) > abs(ob[1]) ? abs(ob[0]) : abs(ob[1]);
+  if (ring_a != ring_b)
+    return ring_a - ring_b;
+  return (oa[0] * oa[0] + oa[1] * oa[1]) - (ob[0] * ob[0] + ob[1] * ob[1]);
+}
+
+static int32_t wrap(int32_t value, uint32_t size)
+{
+  int32_t m = value % (int32_t)size;
+  return m < 0 ? m + (int32_t)size : m;
+}
+
+bool terrain_window_init(terrain_window_t* window, uint32_t view_chunks)
+{
+  memset(window, 0, sizeof(*window));
+  window->view_chunks = view_chunks;
+  window->size = view_chunks * 2 + 1;
+  uint32_t cells = window->size * window->size;
+  window->slot_count = cells + 2 * window->size;
+
+  window->cells = malloc(cells * sizeof(terrain_cell_t));
+  window->order = malloc(cells * sizeof(int32_t[2]));
+  window->free_slots = malloc(window->slot_count * sizeof(uint32_t));
+  if (!window->cells || !window->order || !window->free_slots) {
+    fprintf(stderr, "Memory allocation failed for terrain\n");
+    terrain_window_free(window);
+    return false;
+  }
+
+  int32_t view = (int32_t)view_chunks;
+  uint32_t n = 0;
+  for (int32_t z = -view; z <= view; z++) {
+    for (int32_t x = -view; x <= view; x++) {
+      window->order[n][0] = x;
+      window->order[n][1] = z;
+      n++;
+    }
+  }
+  qsort(window->order, cells, sizeof(int32_t[2]), compare_offsets);
+
+  for (uint32_t i = 0; i < cells; i++)
+    window->cells[i] = (terrain_cell_t){ INT32_MAX, INT32_MAX, -1, -1, 0, 0.0f, 0.0f };
+  for (uint32_t i = 0; i < window->slot_count; i++)
+    window->free_slots[window->free_count++] = window->slot_count - 1 - i;
+  return true;
+}
+
+terrain_cell_t* terrain_window_cell(terrain_window_t* window, int32_t x, int32_t z)
+{
+  return &window->cells[wrap(z, window->size) * window->size + wrap(x, window->size)];
+}
+
+int32_t terrain_window_ring(const terrain_window_t* window, int32_t x, int32_t z)
+{
+  int32_t dx = abs(x - window->center_x);
+  int32_t dz = abs(z - window->center_z);
+  return dx > dz ? dx : dz;
+}
+
+int32_t terrain_window_lod(const terrain_window_t* window, int32_t x, int32_t z)
+{
+  int32_t lod = terrain_window_ring(window, x, z) / TERRAIN_LOD_RINGS;
+  return lod < TERRAIN_LODS ? lod : TERRAIN_LODS - 1;
+}
+
+bool terrain_window_recenter(terrain_window_t* window, int32_t center_x, int32_t center_z)
+{
+  if (window->centered && center_x == window->center_x && center_z == window->center_z)
+    return false;
+  window->centered = true;
+  window->center_x = center_x;
+  window->center_z = center_z;
+
+  uint32_t cells = window->size * window->size;
+  for (uint32_t i = 0; i < cells; i++) {
+    int32_t x = center_x + window->order[i][0];
+    int32_t z = center_z + window->order[i][1];
+    terrain_cell_t* cell = terrain_window_cell(window, x, z);
+    if (cell->x == x && cell->z == z)
+      continue;
+    if (cell->lod >= 0)
+      window->free_slots[window->free_count++] = cell->slot;
+    *cell = (terrain_cell_t){ x, z, -1, -1, 0, 0.0f, 0.0f };
+  }
+  return true;
+}
+
+uint32_t terrain_window_place(terrain_window_t* window, terrain_cell_t* cell, uint32_t lod)
+{
+  uint32_t slot = window->free_slots[--window->free_count];
+
+  // The old LOD drew until now
+  if (cell->lod >= 0)
+    window->free_slots[window->free_count++] = cell->slot;
+  cell->lod = (int32_t)lod;
+  cell->pending_lod = -1;
+  cell->slot = slot;
+  return slot;
+}
+
+void terrain_window_free(terrain_window_t* window)
+{
+  free(window->cells);
+  free(window->order);
+  free(window->free_slots);
+  window->cells = NULL;
+  window->order = NULL;
+  window->free_slots = NULL;
+}
+
+/* SETUP */
+
+terrain_t* terrain_create(thread_pool_t* workers, uint32_t view_chunks)
+{
+  terrain_t* terrain = calloc(1, sizeof(terrain_t));
+  if (!terrain) {
+    fprintf(stderr, "Memory allocation failed for terrain\n");
+    return NULL;
+  }
+
+  terrain->workers = workers;
+  terrain->slot_vertices = terrain_lod_vertices(0);
+  if (!terrain_window_init(&terrain->window, view_chunks ? view_chunks : TERRAIN_DEFAULT_VIEW_CHUNKS)) {
+    free(terrain);
+    return NULL;
+  }
+
+  uint32_t index_total = 0;
+  for (uint32_t lod = 0; lod < TERRAIN_LODS; lod++) {
+    terrain->index_count[lod] = terrain_lod_indices(lod);
+    terrain->index_offset[lod] = index_total * sizeof(uint16_t);
+    index_total += terrain->index_count[lod];
+  }
+  uint16_t* indices = malloc(index_total * sizeof(uint16_t));
+  if (!indices) {
+    fprintf(stderr, "Memory allocation failed for terrain\n");
+    terrain_destroy(terrain);
+    return NULL;
+  }
+  for (uint32_t lod = 0; lod < TERRAIN_LODS; lod++)
+    terrain_build_indices(lod, indices + terrain->index_offset[lod] / sizeof(uint16_t));
+
+  glGenVertexArrays(1, &terrain->vao);
+  glGenBuffers(1, &terrain->vbo);
+  glGenBuffers(1, &terrain->ebo);
+  gl_state_bind_vertex_array(terrain->vao);
+  gl_state_bind_buffer(GL_ARRAY_BUFFER, terrain->vbo);
+  glBufferData(GL_ARRAY_BUFFER,
+	       (GLsizeiptr)terrain->window.slot_count * terrain->slot_vertices * terrain_vertex_layout.stride,
+	       NULL, GL_DYNAMIC_DRAW);
+  vertex_layout_apply(&terrain_vertex_layout);
+  gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, terrain->ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_total * sizeof(uint16_t), indices, GL_STATIC_DRAW);
+  free(indices);
+
+  pthread_mutex_init(&terrain->lock, NULL);
+  pthread_cond_init(&terrain->idle, NULL);
+  return terrain;
+}
+
+void terrain_bind_instances(terrain_t* terrain, GLuint buffer, const vertex_layout_t* layout)
+{
+  gl_state_bind_vertex_array(terrain->vao);
+  gl_state_bind_buffer(GL_ARRAY_BUFFER, buffer);
+  vertex_layout_apply(layout);
+}
+
+/* STREAMING */
+
+// Vertices stay NULL if memory ran out, the job is dropped when it comes back
+static void generate_chunk(chunk_job_t* job)
+{
+  float y_range[2];
+  job->vertices = malloc(terrain_lod_vertices(job->lod) * terrain_vertex_layout.stride);
+  if (!job->vertices) {
+    fprintf(stderr, "Memory allocation failed for terrain chunk (%d, %d)\n", job->x, job->z);
+    return;
+  }
+  if (!terrain_build_chunk(job->x, job->z, job->lod, job->vertices, y_range)) {
+    free(job->vertices);
+    job->vertices = NULL;
+    return;
+  }
+  job->min_y = y_range[0];
+  job->max_y = y_range[1];
+}
+
+static void chunk_job(void* arg)
+{
+  chunk_job_t* job = arg;
+  terrain_t* terrain = job->terrain;
+
+  double start = glfwGetTime();
+  generate_chunk(job);
+  job->generate_ms = (glfwGetTime() - start) * 1000.0;
+
+  pthread_mutex_lock(&terrain->lock);
+  job->next = terrain->finished;
+  terrain->finished = job;
+  if (--terrain->in_flight == 0)
+    pthread_cond_broadcast(&terrain->idle);
+  pthread_mutex_unlock(&terrain->lock);
+}
+
+static void submit(terrain_t* terrain, int32_t x, int32_t z, uint32_t lod)
+{
+  chunk_job_t* job = calloc(1, sizeof(chunk_job_t));
+  if (!job) {
+    fprintf(stderr, "Memory allocation failed for terrain chunk (%d, %d)\n", x, z);
+    return;
+  }
+  job->terrain = terrain;
+  job->x = x;
+  job->z = z;
+  job->lod = lod;
+
+  terrain_window_cell(&terrain->window, x, z)->pending_lod = (int32_t)lod;
+  terrain->pending++;
+
+  pthread_mutex_lock(&terrain->lock);
+  terrain->in_flight++;
+  pthread_mutex_unlock(&terrain->lock);
+  if (!terrain->workers || !thread_pool_submit(terrain->workers, chunk_job, job))
+    chunk_job(job);
+}
+
+static void drop(terrain_t* terrain, chunk_job_t* job)
+{
+  terrain->pending--;
+  free(job->vertices);
+  free(job);
+}
+
+// Still what its cell is waiting for, the camera may have moved on or asked for another LOD. A job
+// that ran out of memory stops its cell waiting, so the next update asks for the chunk again
+static bool wanted(terrain_t* terrain, const chunk_job_t* job)
+{
+  terrain_cell_t* cell = terrain_window_cell(&terrain->window, job->x, job->z);
+  if (cell->x != job->x || cell->z != job->z || cell->pending_lod != (int32_t)job->lod)
+    return false;
+  if (!job->vertices) {
+    cell->pending_lod = -1;
+    return false;
+  }
+  return true;
+}
+
+static void upload(terrain_t* terrain, chunk_job_t* job)
+{
+  terrain_cell_t* cell = terrain_window_cell(&terrain->window, job->x, job->z);
+  uint32_t slot = terrain_window_place(&terrain->window, cell, job->lod);
+  GLsizeiptr stride = terrain_vertex_layout.stride;
+
+  gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, terrain->vbo);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)slot * terrain->slot_vertices * stride,
+		  (GLsizeiptr)terrain_lod_vertices(job->lod) * stride, job->vertices);
+  cell->min_y = job->min_y;
+  cell->max_y = job->max_y;
+
+  terrain->stats.uploads++;
+  terrain->stats.generate_ms += job->generate_ms;
+}
+
+void terrain_update(terrain_t* terrain, const vec3 camera_position)
+{
+  double start = glfwGetTime();
+  terrain->stats.uploads = 0;
+  terrain->stats.generate_ms = 0.0;
+
+  // Cells that now stand for a different chunk let go of the old one, its jobs are dropped
+  // when they come back
+  int32_t center_x = (int32_t)floorf(camera_position[0] / TERRAIN_CHUNK_SIZE);
+  int32_t center_z = (int32_t)floorf(camera_position[2] / TERRAIN_CHUNK_SIZE);
+  terrain_window_recenter(&terrain->window, center_x, center_z);
+
+  pthread_mutex_lock(&terrain->lock);
+  chunk_job_t* finished = terrain->finished;
+  terrain->finished = NULL;
+  pthread_mutex_unlock(&terrain->lock);
+  while (finished) {
+    chunk_job_t* next = finished->next;
+    finished->next = terrain->ready;
+    terrain->ready = finished;
+    finished = next;
+  }
+
+  // Nearest ready chunk first, stale ones are dropped on the way
+  while (terrain->stats.uploads < TERRAIN_UPLOADS_PER_FRAME && terrain->window.free_count > 0) {
+    chunk_job_t** best = NULL;
+    for (chunk_job_t** link = &terrain->ready; *link;) {
+      chunk_job_t* job = *link;
+      if (!wanted(terrain, job)) {
+	*link = job->next;
+	drop(terrain, job);
+	continue;
+      }
+      if (!best || terrain_window_ring(&terrain->window, job->x, job->z) <
+	  terrain_window_ring(&terrain->window, (*best)->x, (*best)->z))
+	best = link;
+      link = &job->next;
+    }
+    if (!best)
+      break;
+
+    chunk_job_t* job = *best;
+    *best = job->next;
+    upload(terrain, job);
+    drop(terrain, job);
+  }
+
+  // Ask for what's missing nearest first. Capping what's outstanding keeps the pool's queue short,
+  // so chunks the camera has since moved away from don't hold up the ones it's moving towards
+  uint32_t limit = terrain->workers ? (thread_pool_size(terrain->workers) + 1) * TERRAIN_JOBS_PER_THREAD
+    : TERRAIN_UPLOADS_PER_FRAME;
+  uint32_t cells = terrain->window.size * terrain->window.size;
+  for (uint32_t i = 0; i < cells && terrain->pending < limit; i++) {
+    int32_t x = center_x + terrain->window.order[i][0];
+    int32_t z = center_z + terrain->window.order[i][1];
+    int32_t lod = terrain_window_lod(&terrain->window, x, z);
+
+    const terrain_cell_t* cell = terrain_window_cell(&terrain->window, x, z);
+    if (cell->lod != lod && cell->pending_lod != lod)
+      submit(terrain, x, z, (uint32_t)lod);
+  }
+
+  terrain->stats.resident = 0;
+  for (uint32_t i = 0; i < cells; i++)
+    terrain->stats.resident += terrain->window.cells[i].lod >= 0;
+  terrain->stats.pending = terrain->pending;
+  terrain->stats.upload_ms = (glfwGetTime() - start) * 1000.0;
+}
+
+/* DRAWING */
+
+void terrain_draw(terrain_t* terrain, render_queue_t* queue, const shader_t* shader, mat4 view_projection)
+{
+  terrain->stats.drawn = 0;
+  if (shader->id == 0)
+    return;
+
+  vec4 planes[6];
+  glm_frustum_planes(view_projection, planes);
+
+  uint32_t cells = terrain->window.size * terrain->window.size;
+  for (uint32_t i = 0; i < cells; i++) {
+    const terrain_cell_t* cell = &terrain->window.cells[i];
+    if (cell->lod < 0)
+      continue;
+
+    float x = cell->x * TERRAIN_CHUNK_SIZE;
+    float z = cell->z * TERRAIN_CHUNK_SIZE;
+    vec3 box[2] = {
+      { x, cell->min_y - lod_skirt(cell->lod), z },
+      { x + TERRAIN_CHUNK_SIZE, cell->max_y, z + TERRAIN_CHUNK_SIZE },
+    };
+    if (!glm_aabb_frustum(box, planes))
+      continue;
+
+    instance_data_t instance = {
+      .color = { 1.0f, 1.0f, 1.0f, 1.0f },
+      .uv_rect = { 0.0f, 0.0f, 1.0f, 1.0f },
+    };
+    glm_mat4_identity(instance.transform);
+    instance.transform[3][0] = x;
+    instance.transform[3][2] = z;
+
+    render_packet_t packet = {
+      .key = render_key_instanced(0, shader->id, 0, 0, cell->slot),
+      .shader = shader,
+      .vao = terrain->vao,
+      .mode = GL_TRIANGLES,
+      .index_type = GL_UNSIGNED_SHORT,
+      .count = terrain->index_count[cell->lod],
+      .index_offset = terrain->index_offset[cell->lod],
+      .base_vertex = (int32_t)(cell->slot * terrain->slot_vertices),
+    };
+    render_queue_push_instanced(queue, &packet, &instance);
+    terrain->stats.drawn++;
+  }
+}
+
+terrain_stats_t terrain_get_stats(const terrain_t* terrain)
+{
+  return terrain->stats;
+}
+
+void terrain_destroy(terrain_t* terrain)
+{
+  if (!terrain)
+    return;
+
+  // Jobs hold on to the terrain until they're finished
+  if (terrain->vao != 0) {
+    pthread_mutex_lock(&terrain->lock);
+    while (terrain->in_flight > 0)
+      pthread_cond_wait(&terrain->idle, &terrain->lock);
+    pthread_mutex_unlock(&terrain->lock);
+    pthread_mutex_destroy(&terrain->lock);
+    pthread_cond_destroy(&terrain->idle);
+
+    gl_state_forget_vertex_array(terrain->vao);
+    glDeleteVertexArrays(1, &terrain->vao);
+    gl_state_forget_buffer(terrain->vbo);
+    gl_state_forget_buffer(terrain->ebo);
+    glDeleteBuffers(1, &terrain->vbo);
+    glDeleteBuffers(1, &terrain->ebo);
+  }
+
+  chunk_job_t* lists[] = { terrain->finished, terrain->ready };
+  for (uint32_t i = 0; i < 2; i++) {
+    while (lists[i]) {
+      chunk_job_t* next = lists[i]->next;
+      free(lists[i]->vertices);
+      free(lists[i]);
+      lists[i] = next;
+    }
+  }
+  terrain_window_free(&terrain->window);
+  free(terrain);
+}
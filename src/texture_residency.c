@@ -0,0 +1,236 @@
+#include "texture_residency.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  char* source;
+  residency_load_fn load;
+  void* user;
+  texture_t texture;         // id = 0 while evicted
+  size_t bytes;              // bytes currently resident
+  uint32_t full_levels;      // levels when loaded at full resolution
+  uint64_t last_used;        // frame of the last acquire
+  bool failed;               // don't retry a source that failed to load
+} residency_entry_t;
+
+static residency_entry_t entries[RESIDENCY_MAX_TEXTURES];
+static uint32_t entry_count = 0;
+static uint64_t frame = 1;
+static residency_stats_t stats;
+static bool warned_over_budget = false;
+
+static texture_t load_bmp(const char* source, void* user)
+{
+  (void)user;
+  return texture_load_bmp(source);
+}
+
+size_t texture_level_bytes(const texture_t* texture, uint32_t level)
+{
+  size_t width = texture->width >> level;
+  size_t height = texture->height >> level;
+  if (width == 0) width = 1;
+  if (height == 0) height = 1;
+  return width * height * 4;
+}
+
+size_t texture_bytes(const texture_t* texture)
+{
+  size_t bytes = 0;
+  for (uint32_t level = 0; level < texture->levels; level++)
+    bytes += texture_level_bytes(texture, level);
+  return bytes;
+}
+
+static void release(residency_entry_t* entry)
+{
+  if (entry->texture.id == 0)
+    return;
+
+  texture_destroy_bmp(&entry->texture);
+  stats.resident_bytes -= entry->bytes;
+  stats.resident_textures--;
+  entry->bytes = 0;
+}
+
+// Reallocate one level smaller and copy the remaining mips across on the GPU
+static void drop_top_mip(residency_entry_t* entry)
+{
+  texture_t* texture = &entry->texture;
+  texture_t smaller = *texture;
+  smaller.width = texture->width > 1 ? texture->width >> 1 : 1;
+  smaller.height = texture->height > 1 ? texture->height >> 1 : 1;
+  smaller.levels = texture->levels - 1;
+
+  glGenTextures(1, &smaller.id);
+  gl_state_edit_texture(GL_TEXTURE_2D, smaller.id);
+  glTexStorage2D(GL_TEXTURE_2D, smaller.levels, texture->format, smaller.width, smaller.height);
+
+  for (uint32_t level = 0; level < smaller.levels; level++) {
+    uint32_t width = smaller.width >> level;
+    uint32_t height = smaller.height >> level;
+    glCopyImageSubData(texture->id, GL_TEXTURE_2D, level + 1, 0, 0, 0,
+		       smaller.id, GL_TEXTURE_2D, level, 0, 0, 0,
+		       width ? width : 1, height ? height : 1, 1);
+  }
+
+  gl_state_forget_texture(texture->id);
+  glDeleteTextures(1, &texture->id);
+  *texture = smaller;
+
+  size_t bytes = texture_bytes(texture);
+  stats.resident_bytes -= entry->bytes - bytes;
+  entry->bytes = bytes;
+  stats.mip_drops++;
+}
+
+// Shrink or evict least recently used textures until back under budget. Anything used last frame
+// is probably about to be used again this frame, so it stays rather than being reloaded right after
+static void enforce_budget(void)
+{
+  while (stats.resident_bytes > stats.budget_bytes) {
+    residency_entry_t* lru = NULL;
+    for (uint32_t i = 0; i < entry_count; i++) {
+      residency_entry_t* entry = &entries[i];
+      if (entry->texture.id == 0 || entry->last_used + 1 >= frame)
+	continue;
+      if (!lru || entry->last_used < lru->last_used)
+	lru = entry;
+    }
+
+    // Everything resident is in use this frame or was last frame, nothing can go
+    if (!lru) {
+      if (!warned_over_budget) {
+	fprintf(stderr, "Texture residency over budget: %zu of %zu bytes in use this frame.\n",
+		stats.resident_bytes, stats.budget_bytes);
+	warned_over_budget = true;
+      }
+      return;
+    }
+
+    uint32_t size = lru->texture.width > lru->texture.height ? lru->texture.width : lru->texture.height;
+    if (lru->texture.levels > 1 && size > RESIDENCY_MIN_DROP_SIZE) {
+      drop_top_mip(lru);
+    } else {
+      release(lru);
+      stats.evictions++;
+    }
+  }
+
+  warned_over_budget = false;
+}
+
+void residency_init(size_t budget_bytes)
+{
+  memset(&stats, 0, sizeof(stats));
+  stats.budget_bytes = budget_bytes;
+  entry_count = 0;
+  frame = 1;
+}
+
+void residency_set_budget(size_t budget_bytes)
+{
+  stats.budget_bytes = budget_bytes;
+  enforce_budget();
+}
+
+residency_handle_t residency_register(const char* source, residency_load_fn load, void* user)
+{
+  if (entry_count == RESIDENCY_MAX_TEXTURES) {
+    fprintf(stderr, "Too many textures registered for residency (%d).\n", RESIDENCY_MAX_TEXTURES);
+    return RESIDENCY_INVALID_HANDLE;
+  }
+
+  size_t length = strlen(source);
+  residency_entry_t* entry = &entries[entry_count];
+  memset(entry, 0, sizeof(*entry));
+  entry->source = malloc(length + 1);
+  if (!entry->source)
+    return RESIDENCY_INVALID_HANDLE;
+  memcpy(entry->source, source, length + 1);
+  entry->load = load ? load : load_bmp;
+  entry->user = user;
+
+  return entry_count++;
+}
+
+const texture_t* residency_acquire(residency_handle_t handle)
+{
+  if (handle >= entry_count)
+    return NULL;
+
+  residency_entry_t* entry = &entries[handle];
+  entry->last_used = frame;
+
+  if (entry->failed)
+    return &entry->texture;
+
+  // Replaced from outside (hot reload) with a different size, resync the accounting
+  if (entry->texture.id != 0 && texture_bytes(&entry->texture) != entry->bytes) {
+    size_t bytes = texture_bytes(&entry->texture);
+    stats.resident_bytes = stats.resident_bytes - entry->bytes + bytes;
+    entry->bytes = bytes;
+    entry->full_levels = entry->texture.levels;
+  }
+
+  // Evicted, or shrunk while unused, so bring back the full chain
+  bool shrunk = entry->texture.id != 0 && entry->texture.levels < entry->full_levels;
+  if (entry->texture.id == 0 || shrunk) {
+    bool reload = entry->full_levels != 0;
+    release(entry);
+
+    entry->texture = entry->load(entry->source, entry->user);
+    if (entry->texture.id == 0) {
+      fprintf(stderr, "Failed to load texture %s for residency.\n", entry->source);
+      entry->failed = true;
+      return &entry->texture;
+    }
+
+    entry->full_levels = entry->texture.levels;
+    entry->bytes = texture_bytes(&entry->texture);
+    stats.resident_bytes += entry->bytes;
+    stats.resident_textures++;
+    if (reload)
+      stats.reloads++;
+
+    enforce_budget();
+  }
+
+  return &entry->texture;
+}
+
+void residency_retry(residency_handle_t handle)
+{
+  if (handle < entry_count)
+    entries[handle].failed = false;
+}
+
+texture_t* residency_texture(residency_handle_t handle)
+{
+  if (handle >= entry_count)
+    return NULL;
+  return &entries[handle].texture;
+}
+
+void residency_begin_frame(void)
+{
+  frame++;
+  enforce_budget();
+}
+
+residency_stats_t residency_get_stats(void)
+{
+  return stats;
+}
+
+void residency_shutdown(void)
+{
+  for (uint32_t i = 0; i < entry_count; i++) {
+    release(&entries[i]);
+    free(entries[i].source);
+  }
+  entry_count = 0;
+}
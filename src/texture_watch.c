@@ -0,0 +1,167 @@
+#include "texture_watch.h"
+#include "file_watch.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  texture_t* texture;
+  char* path;
+  texture_watch_fn changed;
+  void* user;
+  bool decoding;               // a decode job is in flight
+  bool stale;                  // changed again while decoding, decode once more when it lands
+} watched_texture_t;
+
+typedef struct {
+  uint32_t index;
+  bool ok;
+  bmp_image_t image;
+} decode_job_t;
+
+static file_watch_t* watch = NULL;
+static thread_pool_t* workers = NULL;
+static watched_texture_t textures[TEXTURE_WATCH_MAX];
+static uint32_t texture_count = 0;
+
+// Finished decodes, pushed by workers and drained in texture_watch_poll
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static decode_job_t* done[TEXTURE_WATCH_MAX];
+static uint32_t done_count = 0;
+
+static void decode(void* arg)
+{
+  decode_job_t* job = arg;
+  bmp_result_t result = bmp_decode_file(textures[job->index].path, &job->image);
+  job->ok = result == BMP_OK;
+  if (!job->ok)
+    fprintf(stderr, "Failed to decode %s: %s.\n", textures[job->index].path, bmp_result_string(result));
+
+  pthread_mutex_lock(&done_lock);
+  done[done_count++] = job;
+  pthread_mutex_unlock(&done_lock);
+}
+
+static void start_decode(uint32_t index)
+{
+  decode_job_t* job = calloc(1, sizeof(decode_job_t));
+  if (!job)
+    return;
+  job->index = index;
+
+  if (!thread_pool_submit(workers, decode, job)) {
+    free(job);
+    textures[index].stale = true;  // try again next poll
+    return;
+  }
+  textures[index].decoding = true;
+  textures[index].stale = false;
+}
+
+void texture_watch_init(thread_pool_t* pool)
+{
+  workers = pool;
+  watch = file_watch_create();
+}
+
+void texture_watch_add(texture_t* texture, const char* path, texture_watch_fn changed, void* user)
+{
+  if (!watch)
+    return;
+
+  if (texture_count == TEXTURE_WATCH_MAX) {
+    fprintf(stderr, "Too many watched textures (%d).\n", TEXTURE_WATCH_MAX);
+    return;
+  }
+
+  if (!file_watch_add(watch, path))
+    return;
+
+  size_t length = strlen(path);
+  char* copy = malloc(length + 1);
+  if (!copy)
+    return;
+  memcpy(copy, path, length + 1);
+
+  watched_texture_t* entry = &textures[texture_count++];
+  entry->texture = texture;
+  entry->path = copy;
+  entry->changed = changed;
+  entry->user = user;
+  entry->decoding = false;
+  entry->stale = false;
+}
+
+void texture_watch_poll(void)
+{
+  if (!watch)
+    return;
+
+  const char* changed[TEXTURE_WATCH_MAX];
+  uint32_t changed_count = file_watch_poll(watch, changed, TEXTURE_WATCH_MAX);
+
+  // Only textures backed by a changed file are touched
+  for (uint32_t c = 0; c < changed_count; c++) {
+    for (uint32_t i = 0; i < texture_count; i++) {
+      if (strcmp(textures[i].path, changed[c]) != 0)
+	continue;
+      if (textures[i].changed)
+	textures[i].changed(textures[i].user);
+      if (textures[i].decoding)
+	textures[i].stale = true;
+      else
+	start_decode(i);
+    }
+  }
+
+  decode_job_t* finished[TEXTURE_WATCH_MAX];
+  pthread_mutex_lock(&done_lock);
+  uint32_t finished_count = done_count;
+  memcpy(finished, done, done_count * sizeof(decode_job_t*));
+  done_count = 0;
+  pthread_mutex_unlock(&done_lock);
+
+  for (uint32_t j = 0; j < finished_count; j++) {
+    decode_job_t* job = finished[j];
+    watched_texture_t* entry = &textures[job->index];
+    entry->decoding = false;
+
+    // An evicted texture (id 0) will pick up the new file when it's next loaded anyway, the
+    // changed callback lets its owner retry one that failed to load
+    if (job->ok && entry->texture->id != 0 && !entry->stale) {
+      texture_replace_bmp(entry->texture, &job->image);
+      printf("Texture reloaded: %s (ID %u)\n", entry->path, entry->texture->id);
+    } else if (!job->ok) {
+      fprintf(stderr, "Texture reload failed, keeping the old one: %s\n", entry->path);
+    }
+    bmp_image_free(&job->image);
+    free(job);
+  }
+
+  // Written again mid-decode (what just landed is already out of date) or the submit failed
+  for (uint32_t i = 0; i < texture_count; i++) {
+    if (textures[i].stale && !textures[i].decoding)
+      start_decode(i);
+  }
+}
+
+void texture_watch_shutdown(void)
+{
+  if (workers)
+    thread_pool_wait(workers);
+
+  for (uint32_t j = 0; j < done_count; j++) {
+    bmp_image_free(&done[j]->image);
+    free(done[j]);
+  }
+  done_count = 0;
+
+  for (uint32_t i = 0; i < texture_count; i++)
+    free(textures[i].path);
+  texture_count = 0;
+
+  file_watch_destroy(watch);
+  watch = NULL;
+}
@@ -0,0 +1,258 @@
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+  job_fn fn;
+  void* arg;
+} job_t;
+
+struct thread_pool {
+  pthread_t threads[THREAD_POOL_MAX_THREADS];
+  uint32_t thread_count;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work_ready;   // signalled when a job is queued or on shutdown
+  pthread_cond_t work_done;    // signalled when the pool goes idle
+
+  job_t queue[THREAD_POOL_QUEUE_SIZE]; // ring buffer
+  uint32_t head;
+  uint32_t count;
+  uint32_t active;             // jobs currently running
+  bool stopping;
+};
+
+uint32_t thread_cpu_count(void)
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t)count : 1;
+}
+
+static void* worker_main(void* arg)
+{
+  thread_pool_t* pool = arg;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (pool->count == 0 && !pool->stopping)
+      pthread_cond_wait(&pool->work_ready, &pool->lock);
+
+    if (pool->count == 0 && pool->stopping)
+      break;
+
+    job_t job = pool->queue[pool->head];
+    pool->head = (pool->head + 1) % THREAD_POOL_QUEUE_SIZE;
+    pool->count--;
+    pool->active++;
+    pthread_mutex_unlock(&pool->lock);
+
+    job.fn(job.arg);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->active--;
+    if (pool->count == 0 && pool->active == 0)
+      pthread_cond_broadcast(&pool->work_done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+thread_pool_t* thread_pool_create(uint32_t thread_count)
+{
+  if (thread_count == 0) {
+    uint32_t cores = thread_cpu_count();
+    thread_count = cores > 1 ? cores - 1 : 1;
+  }
+  if (thread_count > THREAD_POOL_MAX_THREADS)
+    thread_count = THREAD_POOL_MAX_THREADS;
+
+  thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+  if (!pool) {
+    fprintf(stderr, "Memory allocation failed for thread pool\n");
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work_ready, NULL);
+  pthread_cond_init(&pool->work_done, NULL);
+
+  for (uint32_t i = 0; i < thread_count; i++) {
+    if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+      fprintf(stderr, "Failed to start worker thread %u\n", i);
+      break;
+    }
+    pool->thread_count++;
+  }
+
+  // A pool nobody pulls from would queue jobs forever, callers run inline without one instead
+  if (pool->thread_count == 0) {
+    thread_pool_destroy(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+bool thread_pool_submit(thread_pool_t* pool, job_fn fn, void* arg)
+{
+  if (!pool) {
+    fn(arg);
+    return true;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->count == THREAD_POOL_QUEUE_SIZE) {
+    pthread_mutex_unlock(&pool->lock);
+    return false;
+  }
+
+  uint32_t tail = (pool->head + pool->count) % THREAD_POOL_QUEUE_SIZE;
+  pool->queue[tail].fn = fn;
+  pool->queue[tail].arg = arg;
+  pool->count++;
+  pthread_cond_signal(&pool->work_ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  return true;
+}
+
+void thread_pool_wait(thread_pool_t* pool)
+{
+  if (!pool)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->count != 0 || pool->active != 0)
+    pthread_cond_wait(&pool->work_done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+uint32_t thread_pool_size(const thread_pool_t* pool)
+{
+  return pool ? pool->thread_count : 0;
+}
+
+/* PARALLEL FOR */
+
+// Shared by the caller and its helper jobs. Helpers may only get to run after the caller has
+// finished every chunk, so the last one out frees it instead of the caller waiting for them
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t finished;
+  range_fn fn;
+  void* arg;
+  uint32_t count;
+  uint32_t chunk_size;
+  uint32_t chunks;
+  uint32_t next;               // next chunk to hand out
+  uint32_t done;               // chunks completed
+  uint32_t references;
+} parallel_for_t;
+
+static void release(parallel_for_t* work)
+{
+  pthread_mutex_lock(&work->lock);
+  bool last = --work->references == 0;
+  pthread_mutex_unlock(&work->lock);
+
+  if (last) {
+    pthread_mutex_destroy(&work->lock);
+    pthread_cond_destroy(&work->finished);
+    free(work);
+  }
+}
+
+// Run chunks until none are left
+static void run_chunks(parallel_for_t* work)
+{
+  pthread_mutex_lock(&work->lock);
+  while (work->next < work->chunks) {
+    uint32_t chunk = work->next++;
+    pthread_mutex_unlock(&work->lock);
+
+    uint32_t begin = chunk * work->chunk_size;
+    uint32_t end = work->count - begin < work->chunk_size ? work->count : begin + work->chunk_size;
+    work->fn(work->arg, chunk, begin, end);
+
+    pthread_mutex_lock(&work->lock);
+    if (++work->done == work->chunks)
+      pthread_cond_signal(&work->finished);
+  }
+  pthread_mutex_unlock(&work->lock);
+}
+
+static void parallel_for_job(void* arg)
+{
+  run_chunks(arg);
+  release(arg);
+}
+
+void thread_pool_parallel_for(thread_pool_t* pool, uint32_t count, uint32_t chunk_size, range_fn fn, void* arg)
+{
+  if (count == 0)
+    return;
+  if (chunk_size == 0)
+    chunk_size = count;
+  uint32_t chunks = (count + chunk_size - 1) / chunk_size;
+
+  parallel_for_t* work = pool && chunks > 1 ? calloc(1, sizeof(parallel_for_t)) : NULL;
+  if (!work) {
+    for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+      uint32_t begin = chunk * chunk_size;
+      fn(arg, chunk, begin, count - begin < chunk_size ? count : begin + chunk_size);
+    }
+    return;
+  }
+
+  pthread_mutex_init(&work->lock, NULL);
+  pthread_cond_init(&work->finished, NULL);
+  work->fn = fn;
+  work->arg = arg;
+  work->count = count;
+  work->chunk_size = chunk_size;
+  work->chunks = chunks;
+  work->references = 1;
+
+  // One helper per worker at most, the caller takes a share too
+  uint32_t helpers = chunks - 1 < pool->thread_count ? chunks - 1 : pool->thread_count;
+  for (uint32_t i = 0; i < helpers; i++) {
+    pthread_mutex_lock(&work->lock);
+    work->references++;
+    pthread_mutex_unlock(&work->lock);
+    if (!thread_pool_submit(pool, parallel_for_job, work)) {
+      release(work);
+      break;
+    }
+  }
+
+  run_chunks(work);
+
+  pthread_mutex_lock(&work->lock);
+  while (work->done < work->chunks)
+    pthread_cond_wait(&work->finished, &work->lock);
+  pthread_mutex_unlock(&work->lock);
+  release(work);
+}
+
+void thread_pool_destroy(thread_pool_t* pool)
+{
+  if (!pool)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->work_ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (uint32_t i = 0; i < pool->thread_count; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->work_ready);
+  pthread_cond_destroy(&pool->work_done);
+  free(pool);
+}
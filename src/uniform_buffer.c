@@ -0,0 +1,193 @@
+#include "uniform_buffer.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const ubo_member_t frame_members[] = {
+  UBO_MEMBER(frame_uniforms_t, view, "Frame.view"),
+  UBO_MEMBER(frame_uniforms_t, projection, "Frame.projection"),
+  UBO_MEMBER(frame_uniforms_t, view_projection, "Frame.view_projection"),
+  UBO_MEMBER(frame_uniforms_t, camera_position, "Frame.camera_position"),
+  UBO_MEMBER(frame_uniforms_t, time, "Frame.time"),
+};
+
+static const ubo_member_t material_members[] = {
+  UBO_MEMBER(material_uniforms_t, base_color, "Material.base_color"),
+  UBO_MEMBER(material_uniforms_t, uv_transform, "Material.uv_transform"),
+  UBO_MEMBER(material_uniforms_t, roughness, "Material.roughness"),
+  UBO_MEMBER(material_uniforms_t, metallic, "Material.metallic"),
+};
+
+const ubo_layout_t frame_uniforms_layout = {
+  "Frame", GL_UNIFORM_BLOCK, UBO_BINDING_FRAME, sizeof(frame_uniforms_t),
+  frame_members, sizeof(frame_members) / sizeof(frame_members[0])
+};
+
+const ubo_layout_t material_uniforms_layout = {
+  "Material", GL_UNIFORM_BLOCK, UBO_BINDING_MATERIAL, sizeof(material_uniforms_t),
+  material_members, sizeof(material_members) / sizeof(material_members[0])
+};
+
+/* LAYOUT VERIFICATION */
+
+static const ubo_layout_t* layouts[UBO_MAX_LAYOUTS];
+static uint32_t layout_count = 0;
+
+void ubo_layout_register(const ubo_layout_t* layout)
+{
+  for (uint32_t i = 0; i < layout_count; i++) {
+    if (layouts[i] == layout)
+      return;
+  }
+
+  if (layout_count == UBO_MAX_LAYOUTS) {
+    fprintf(stderr, "Too many block layouts (%d).\n", UBO_MAX_LAYOUTS);
+    return;
+  }
+  layouts[layout_count++] = layout;
+}
+
+static const ubo_layout_t* find_layout(const char* block, GLenum interface)
+{
+  for (uint32_t i = 0; i < layout_count; i++) {
+    if (layouts[i]->interface == interface && strcmp(layouts[i]->block, block) == 0)
+      return layouts[i];
+  }
+  return NULL;
+}
+
+static const ubo_member_t* find_member(const ubo_layout_t* layout, const char* name)
+{
+  for (uint32_t i = 0; i < layout->member_count; i++) {
+    if (strcmp(layout->members[i].name, name) == 0)
+      return &layout->members[i];
+  }
+  return NULL;
+}
+
+static bool verify_block(GLuint program, GLenum interface, GLuint block, const ubo_layout_t* layout)
+{
+  bool ok = true;
+
+  const GLenum props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES };
+  GLint values[3];
+  glGetProgramResourceiv(program, interface, block, 3, props, 3, NULL, values);
+
+  if ((GLuint)values[0] != layout->binding) {
+    fprintf(stderr, "Block %s is at binding %d, C expects %u\n", layout->block, values[0], layout->binding);
+    ok = false;
+  }
+
+  // GL may or may not pad the block out to a vec4, either way the C struct has to cover it
+  if ((uint32_t)values[1] > layout->size) {
+    fprintf(stderr, "Block %s is %d bytes, C struct is %u\n", layout->block, values[1], layout->size);
+    ok = false;
+  }
+
+  GLint variable_count = values[2];
+  GLint variables[64];
+  if (variable_count > 64)
+    variable_count = 64;
+
+  const GLenum variables_prop = GL_ACTIVE_VARIABLES;
+  glGetProgramResourceiv(program, interface, block, 1, &variables_prop, variable_count, NULL, variables);
+
+  GLenum variable_interface = interface == GL_UNIFORM_BLOCK ? GL_UNIFORM : GL_BUFFER_VARIABLE;
+  for (GLint v = 0; v < variable_count; v++) {
+    char name[128];
+    glGetProgramResourceName(program, variable_interface, variables[v], sizeof(name), NULL, name);
+
+    const GLenum offset_prop = GL_OFFSET;
+    GLint offset;
+    glGetProgramResourceiv(program, variable_interface, variables[v], 1, &offset_prop, 1, NULL, &offset);
+
+    const ubo_member_t* member = find_member(layout, name);
+    if (!member) {
+      fprintf(stderr, "Block member %s has no C mirror\n", name);
+      ok = false;
+    } else if ((uint32_t)offset != member->offset) {
+      fprintf(stderr, "Block member %s is at offset %d, C has it at %u\n", name, offset, member->offset);
+      ok = false;
+    }
+  }
+
+  return ok;
+}
+
+bool ubo_layout_verify(GLuint program)
+{
+  bool ok = true;
+  const GLenum interfaces[] = { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK };
+
+  for (uint32_t i = 0; i < 2; i++) {
+    GLint block_count = 0;
+    glGetProgramInterfaceiv(program, interfaces[i], GL_ACTIVE_RESOURCES, &block_count);
+
+    for (GLint b = 0; b < block_count; b++) {
+      char name[128];
+      glGetProgramResourceName(program, interfaces[i], b, sizeof(name), NULL, name);
+
+      const ubo_layout_t* layout = find_layout(name, interfaces[i]);
+      if (layout && !verify_block(program, interfaces[i], b, layout))
+	ok = false;
+    }
+  }
+
+  return ok;
+}
+
+/* BUFFERS */
+
+uniform_buffer_t uniform_buffer_create(const ubo_layout_t* layout, uint32_t count)
+{
+  uniform_buffer_t buffer = { 0 };
+
+  buffer.target = layout->interface == GL_UNIFORM_BLOCK ? GL_UNIFORM_BUFFER : GL_SHADER_STORAGE_BUFFER;
+  buffer.binding = layout->binding;
+  buffer.size = layout->size;
+  buffer.count = count;
+
+  GLint alignment = 1;
+  glGetIntegerv(buffer.target == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT :
+		GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  if (alignment < 1)
+    alignment = 1;
+  buffer.stride = (layout->size + alignment - 1) / alignment * alignment;
+
+  glGenBuffers(1, &buffer.id);
+  if (buffer.id == 0) {
+    fprintf(stderr, "Failed to create buffer for block %s.\n", layout->block);
+    return buffer;
+  }
+
+  gl_state_bind_buffer(buffer.target, buffer.id);
+  glBufferData(buffer.target, (GLsizeiptr)buffer.stride * count, NULL, GL_DYNAMIC_DRAW);
+
+  ubo_layout_register(layout);
+
+  return buffer;
+}
+
+void uniform_buffer_update(const uniform_buffer_t* buffer, uint32_t index, const void* data)
+{
+  gl_state_bind_buffer(buffer->target, buffer->id);
+  glBufferSubData(buffer->target, (GLintptr)buffer->stride * index, buffer->size, data);
+}
+
+void uniform_buffer_bind(const uniform_buffer_t* buffer, uint32_t index)
+{
+  // gl_state keeps what's bound at each binding point, rebinding the same material is a compare
+  gl_state_bind_buffer_range(buffer->target, buffer->binding, buffer->id,
+			     (GLintptr)buffer->stride * index, buffer->size);
+}
+
+void uniform_buffer_destroy(uniform_buffer_t* buffer)
+{
+  if (!buffer || buffer->id == 0)
+    return;
+
+  gl_state_forget_buffer(buffer->id);
+  glDeleteBuffers(1, &buffer->id);
+  buffer->id = 0;
+}
@@ -0,0 +1,240 @@
+#include "vertex_layout.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+const vertex_layout_t vertex_layout_pos_color_uv = {
+  8 * sizeof(float), 0, 3, {
+    { 0, 3, GL_FLOAT, GL_FALSE, 0 },                   // position
+    { 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float) },   // color
+    { 2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float) },   // texture coords
+  }
+};
+
+// A mat4 attribute takes one location per column
+const vertex_layout_t vertex_layout_instance = {
+  sizeof(instance_data_t), 1, 6, {
+    { VERTEX_INSTANCE_LOCATION + 0, 4, GL_FLOAT, GL_FALSE, offsetof(instance_data_t, transform) + 0 * sizeof(vec4) },
+    { VERTEX_INSTANCE_LOCATION + 1, 4, GL_FLOAT, GL_FALSE, offsetof(instance_data_t, transform) + 1 * sizeof(vec4) },
+    { VERTEX_INSTANCE_LOCATION + 2, 4, GL_FLOAT, GL_FALSE, offsetof(instance_data_t, transform) + 2 * sizeof(vec4) },
+    { VERTEX_INSTANCE_LOCATION + 3, 4, GL_FLOAT, GL_FALSE, offsetof(instance_data_t, transform) + 3 * sizeof(vec4) },
+    { VERTEX_INSTANCE_LOCATION + 4, 4, GL_FLOAT, GL_FALSE, offsetof(instance_data_t, color) },
+    { VERTEX_INSTANCE_LOCATION + 5, 4, GL_FLOAT, GL_FALSE, offsetof(instance_data_t, uv_rect) },
+  }
+};
+
+void vertex_layout_apply(const vertex_layout_t* layout)
+{
+  for (uint32_t i = 0; i < layout->count; i++) {
+    const vertex_attribute_t* attribute = &layout->attributes[i];
+    glVertexAttribPointer(attribute->location, attribute->components, attribute->type, attribute->normalized,
+			  layout->stride, (void*)(uintptr_t)attribute->offset);
+    glEnableVertexAttribArray(attribute->location);
+    glVertexAttribDivisor(attribute->location, layout->divisor);
+  }
+}
+
+const vertex_attribute_t* vertex_layout_find(const vertex_layout_t* layout, uint32_t location)
+{
+  for (uint32_t i = 0; i < layout->count; i++) {
+    if (layout->attributes[i].location == location)
+      return &layout->attributes[i];
+  }
+  return NULL;
+}
+
+/* VERTEX FORMATS */
+
+const vertex_format_t vertex_format_pos_color_uv = {
+  3, {
+    { 0, 3, VERTEX_FLOAT },
+    { 1, 3, VERTEX_FLOAT },
+    { 2, 2, VERTEX_FLOAT },
+  }
+};
+
+// 16 bytes instead of 32
+const vertex_format_t vertex_format_pos_color_uv_compact = {
+  3, {
+    { 0, 3, VERTEX_HALF },
+    { 1, 3, VERTEX_UNORM8 },
+    { 2, 2, VERTEX_HALF },
+  }
+};
+
+// Components GL reads, the octahedral encoding turns 3 floats into 2 and bytes are always RGBA
+static uint32_t encoded_components(const vertex_element_t* element)
+{
+  switch (element->encoding) {
+  case VERTEX_OCT16:
+    return 2;
+  case VERTEX_UNORM8:
+    return 4;
+  default:
+    return element->components;
+  }
+}
+
+static uint32_t encoded_size(const vertex_element_t* element)
+{
+  uint32_t components = encoded_components(element);
+  switch (element->encoding) {
+  case VERTEX_HALF: case VERTEX_SNORM16: case VERTEX_OCT16:
+    return components * 2;
+  case VERTEX_UNORM8:
+    return components;
+  default:
+    return components * 4;
+  }
+}
+
+vertex_layout_t vertex_layout_from_format(const vertex_format_t* format)
+{
+  vertex_layout_t layout = { 0 };
+  for (uint32_t i = 0; i < format->count; i++) {
+    const vertex_element_t* element = &format->elements[i];
+    vertex_attribute_t* attribute = &layout.attributes[layout.count++];
+    attribute->location = element->location;
+    attribute->components = encoded_components(element);
+    attribute->offset = layout.stride;
+
+    switch (element->encoding) {
+    case VERTEX_HALF:
+      attribute->type = GL_HALF_FLOAT;
+      attribute->normalized = GL_FALSE;
+      break;
+    case VERTEX_UNORM8:
+      attribute->type = GL_UNSIGNED_BYTE;
+      attribute->normalized = GL_TRUE;
+      break;
+    case VERTEX_SNORM16: case VERTEX_OCT16:
+      attribute->type = GL_SHORT;
+      attribute->normalized = GL_TRUE;
+      break;
+    default:
+      attribute->type = GL_FLOAT;
+      attribute->normalized = GL_FALSE;
+      break;
+    }
+
+    // Unaligned attributes are slow or unsupported on some hardware
+    layout.stride += (encoded_size(element) + 3) & ~3u;
+  }
+  return layout;
+}
+
+uint32_t vertex_format_source_components(const vertex_format_t* format)
+{
+  uint32_t components = 0;
+  for (uint32_t i = 0; i < format->count; i++)
+    components += format->elements[i].components;
+  return components;
+}
+
+// Round to nearest even, overflow goes to infinity and tiny values to half denormals
+static uint16_t float_to_half(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  int32_t exponent = (int32_t)((bits >> 23) & 0xFF);
+
+  if (exponent == 0xFF)
+    return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+
+  exponent = exponent - 127 + 15;
+  if (exponent >= 31)
+    return sign | 0x7C00;
+
+  uint32_t shift = 13;
+  uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+  if (exponent <= 0) {
+    if (exponent < -10)
+      return sign;
+    mantissa |= 0x800000;
+    shift = 14 - exponent;
+    half = mantissa >> shift;
+  }
+
+  // A carry out of the mantissa correctly bumps the exponent
+  uint32_t rest = mantissa & ((1u << shift) - 1);
+  uint32_t halfway = 1u << (shift - 1);
+  if (rest > halfway || (rest == halfway && (half & 1)))
+    half++;
+  return sign | half;
+}
+
+static float clampf(float value, float low, float high)
+{
+  return value < low ? low : value > high ? high : value;
+}
+
+static int16_t to_snorm16(float value)
+{
+  return (int16_t)lroundf(clampf(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static void oct_encode(const float* normal, int16_t* out)
+{
+  float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+  float x = length > 0.0f ? normal[0] / length : 0.0f;
+  float y = length > 0.0f ? normal[1] / length : 0.0f;
+
+  // Lower hemisphere folds over the diagonals
+  if (normal[2] < 0.0f) {
+    float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+  out[0] = to_snorm16(x);
+  out[1] = to_snorm16(y);
+}
+
+void vertex_format_convert(const vertex_format_t* format, const float* src, uint32_t vertex_count, void* dst)
+{
+  vertex_layout_t layout = vertex_layout_from_format(format);
+  memset(dst, 0, (size_t)layout.stride * vertex_count);
+
+  uint8_t* vertex = dst;
+  for (uint32_t v = 0; v < vertex_count; v++, vertex += layout.stride) {
+    for (uint32_t i = 0; i < format->count; i++) {
+      const vertex_element_t* element = &format->elements[i];
+      uint8_t* out = vertex + layout.attributes[i].offset;
+
+      switch (element->encoding) {
+      case VERTEX_HALF:
+	for (uint32_t c = 0; c < element->components; c++) {
+	  uint16_t half = float_to_half(src[c]);
+	  memcpy(out + c * 2, &half, 2);
+	}
+	break;
+      case VERTEX_UNORM8:
+	// Missing components read as 0 except alpha, which is opaque
+	for (uint32_t c = 0; c < 4; c++) {
+	  float value = c < element->components ? src[c] : c == 3 ? 1.0f : 0.0f;
+	  out[c] = (uint8_t)lroundf(clampf(value, 0.0f, 1.0f) * 255.0f);
+	}
+	break;
+      case VERTEX_SNORM16:
+	for (uint32_t c = 0; c < element->components; c++) {
+	  int16_t snorm = to_snorm16(src[c]);
+	  memcpy(out + c * 2, &snorm, 2);
+	}
+	break;
+      case VERTEX_OCT16: {
+	int16_t oct[2];
+	oct_encode(src, oct);
+	memcpy(out, oct, sizeof(oct));
+	break;
+      }
+      default:
+	memcpy(out, src, element->components * sizeof(float));
+	break;
+      }
+      src += element->components;
+    }
+  }
+}
@@ -0,0 +1,699 @@
+#include "virtual_texture.h"
+#include "gl_state.h"
+#include "noise.h"
+#include "sampler.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VT_PADDED_SIZE (VT_PAGE_SIZE + 2 * VT_PAGE_BORDER)
+#define VT_SLOT_PENDING 0xFFFFFFFEu    // map value for a page that is being generated
+#define VT_TERRAIN_TEXELS_PER_UNIT 256.0f
+
+typedef struct {
+  virtual_texture_t* vt;
+  uint32_t page;
+  uint8_t* pixels;
+} vt_job_t;
+
+struct virtual_texture {
+  vt_desc_t desc;
+  uint32_t max_mip;
+  uint32_t phys_size;          // physical texture texels per side
+  thread_pool_t* pool;
+
+  GLuint page_table;           // RGBA8 mip chain: physical page x, y, mapped mip, 255
+  GLuint physical;             // RGBA8 atlas of bordered pages
+  vt_page_table_t table;       // CPU copy of page_table
+
+  vt_slot_t* slots;
+  uint32_t slot_count;
+
+  // Open addressing page id -> slot map, covers resident and pending pages
+  uint32_t* map_keys;
+  uint32_t* map_values;
+  uint32_t map_bits;
+
+  uint32_t* scratch;           // sorted copy of the feedback
+  size_t scratch_size;
+
+  // Finished jobs, written by workers and drained by vt_update
+  pthread_mutex_t lock;
+  vt_job_t* done[VT_MAX_PENDING];
+  uint32_t done_count;
+  uint32_t pending;
+
+  GLuint feedback_fbo;
+  GLuint feedback_color;       // R32UI page ids
+  GLuint feedback_depth;
+  GLuint feedback_pbo[2];
+  uint32_t feedback_width;
+  uint32_t feedback_height;
+  uint32_t feedback_index;
+  bool feedback_ready[2];
+  GLint saved_viewport[4];
+
+  uint64_t frame;
+  vt_stats_t stats;
+};
+
+/* PAGE MAP */
+
+static uint32_t map_hash(const virtual_texture_t* vt, uint32_t key)
+{
+  return (key * 0x9E3779B1u) >> (32 - vt->map_bits);
+}
+
+static uint32_t map_find(const virtual_texture_t* vt, uint32_t key)
+{
+  uint32_t mask = (1u << vt->map_bits) - 1;
+  for (uint32_t i = map_hash(vt, key);; i = (i + 1) & mask) {
+    if (vt->map_keys[i] == key)
+      return i;
+    if (vt->map_keys[i] == VT_PAGE_NONE)
+      return VT_PAGE_NONE;
+  }
+}
+
+static uint32_t map_get(const virtual_texture_t* vt, uint32_t key)
+{
+  uint32_t i = map_find(vt, key);
+  return i == VT_PAGE_NONE ? VT_PAGE_NONE : vt->map_values[i];
+}
+
+static void map_set(virtual_texture_t* vt, uint32_t key, uint32_t value)
+{
+  uint32_t mask = (1u << vt->map_bits) - 1;
+  uint32_t i = map_hash(vt, key);
+  while (vt->map_keys[i] != VT_PAGE_NONE && vt->map_keys[i] != key)
+    i = (i + 1) & mask;
+  vt->map_keys[i] = key;
+  vt->map_values[i] = value;
+}
+
+// Linear probing delete, shifts later entries back instead of leaving tombstones
+static void map_remove(virtual_texture_t* vt, uint32_t key)
+{
+  uint32_t mask = (1u << vt->map_bits) - 1;
+  uint32_t i = map_find(vt, key);
+  if (i == VT_PAGE_NONE)
+    return;
+
+  for (uint32_t j = (i + 1) & mask; vt->map_keys[j] != VT_PAGE_NONE; j = (j + 1) & mask) {
+    uint32_t home = map_hash(vt, vt->map_keys[j]);
+    // Entry at j can fill the hole at i unless its home slot lies cyclically in (i, j]
+    bool stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+    if (!stays) {
+      vt->map_keys[i] = vt->map_keys[j];
+      vt->map_values[i] = vt->map_values[j];
+      i = j;
+    }
+  }
+  vt->map_keys[i] = VT_PAGE_NONE;
+}
+
+/* PAGE TABLE */
+
+static uint32_t level_pages(const virtual_texture_t* vt, uint32_t mip)
+{
+  return vt->desc.virtual_pages >> mip;
+}
+
+static uint32_t table_pages(const vt_page_table_t* table, uint32_t mip)
+{
+  return table->virtual_pages >> mip;
+}
+
+static uint32_t slot_entry(const vt_page_table_t* table, uint32_t slot, uint32_t mip)
+{
+  uint32_t x = slot % table->phys_pages;
+  uint32_t y = slot / table->phys_pages;
+  // RGBA8 in memory order: r = x, g = y, b = mip, a = 255
+  return x | (y << 8) | (mip << 16) | 0xFF000000u;
+}
+
+// Resident entries point at their own level, fallbacks at a coarser one. Entries that were
+// never written have alpha 0
+static bool entry_is_resident(uint32_t entry, uint32_t level)
+{
+  return (entry >> 24) != 0 && ((entry >> 16) & 0xFFu) == level;
+}
+
+// Hand entry down to every texel under (x, y) that isn't resident itself, stopping at texels that
+// already hold it since everything under them does too
+static void propagate_entry(vt_page_table_t* table, uint32_t level, uint32_t x, uint32_t y, uint32_t entry,
+			    vt_dirty_t* dirty)
+{
+  uint32_t* texel = &table->levels[level][y * table_pages(table, level) + x];
+  if (*texel == entry || entry_is_resident(*texel, level))
+    return;
+
+  *texel = entry;
+  vt_dirty_t* rect = &dirty[level];
+  if (x < rect->x0) rect->x0 = x;
+  if (y < rect->y0) rect->y0 = y;
+  if (x > rect->x1) rect->x1 = x;
+  if (y > rect->y1) rect->y1 = y;
+
+  if (level == 0)
+    return;
+  for (uint32_t child = 0; child < 4; child++)
+    propagate_entry(table, level - 1, x * 2 + (child & 1), y * 2 + (child >> 1), entry, dirty);
+}
+
+bool vt_page_table_init(vt_page_table_t* table, uint32_t virtual_pages, uint32_t phys_pages)
+{
+  memset(table, 0, sizeof(*table));
+  table->virtual_pages = virtual_pages;
+  table->phys_pages = phys_pages;
+  while ((1u << table->max_mip) < virtual_pages)
+    table->max_mip++;
+
+  for (uint32_t level = 0; level <= table->max_mip; level++) {
+    size_t count = (size_t)table_pages(table, level) * table_pages(table, level);
+    table->levels[level] = calloc(count, sizeof(uint32_t));
+    if (!table->levels[level]) {
+      fprintf(stderr, "Memory allocation failed for virtual texture page table\n");
+      vt_page_table_free(table);
+      return false;
+    }
+  }
+  return true;
+}
+
+void vt_page_table_map(vt_page_table_t* table, uint32_t page, uint32_t slot, vt_dirty_t* dirty_out)
+{
+  uint32_t mip = VT_PAGE_MIP(page);
+  uint32_t x = VT_PAGE_X(page);
+  uint32_t y = VT_PAGE_Y(page);
+  uint32_t pages = table_pages(table, mip);
+
+  for (uint32_t level = 0; level <= mip; level++)
+    dirty_out[level] = (vt_dirty_t){ UINT32_MAX, UINT32_MAX, 0, 0 };
+
+  uint32_t entry;
+  if (slot != VT_PAGE_NONE)
+    entry = slot_entry(table, slot, mip);
+  else if (mip < table->max_mip)
+    entry = table->levels[mip + 1][(y >> 1) * (pages >> 1) + (x >> 1)];
+  else
+    return;
+
+  // The page itself may still hold its own resident entry from before it was unmapped
+  table->levels[mip][y * pages + x] = entry;
+  dirty_out[mip] = (vt_dirty_t){ x, y, x, y };
+  if (mip > 0) {
+    for (uint32_t child = 0; child < 4; child++)
+      propagate_entry(table, mip - 1, x * 2 + (child & 1), y * 2 + (child >> 1), entry, dirty_out);
+  }
+}
+
+uint32_t vt_page_table_entry(const vt_page_table_t* table, uint32_t mip, uint32_t x, uint32_t y)
+{
+  return table->levels[mip][y * table_pages(table, mip) + x];
+}
+
+void vt_page_table_free(vt_page_table_t* table)
+{
+  for (uint32_t level = 0; level < VT_MAX_LEVELS; level++) {
+    free(table->levels[level]);
+    table->levels[level] = NULL;
+  }
+}
+
+// Recompute the entries under a page after it was mapped or unmapped and upload the texels whose
+// fallback actually changed. Pending pages aren't mapped yet
+static void refresh_page_table(virtual_texture_t* vt, uint32_t page)
+{
+  uint32_t slot = map_get(vt, page);
+  if (slot == VT_SLOT_PENDING)
+    slot = VT_PAGE_NONE;
+
+  vt_dirty_t dirty[VT_MAX_LEVELS];
+  vt_page_table_map(&vt->table, page, slot, dirty);
+
+  gl_state_edit_texture(GL_TEXTURE_2D, vt->page_table);
+  for (uint32_t level = 0; level <= VT_PAGE_MIP(page); level++) {
+    const vt_dirty_t* rect = &dirty[level];
+    if (rect->x0 > rect->x1)
+      continue;
+
+    // The region is a sub-rectangle of the level, so rows are a full level apart
+    uint32_t level_width = level_pages(vt, level);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, level_width);
+    glTexSubImage2D(GL_TEXTURE_2D, level, rect->x0, rect->y0, rect->x1 - rect->x0 + 1, rect->y1 - rect->y0 + 1,
+		    GL_RGBA, GL_UNSIGNED_BYTE, vt->table.levels[level] + rect->y0 * level_width + rect->x0);
+  }
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+/* PAGE GENERATION */
+
+static void generate_page(void* arg)
+{
+  vt_job_t* job = arg;
+  virtual_texture_t* vt = job->vt;
+  uint32_t page = job->page;
+
+  int64_t texel_x = (int64_t)VT_PAGE_X(page) * VT_PAGE_SIZE - VT_PAGE_BORDER;
+  int64_t texel_y = (int64_t)VT_PAGE_Y(page) * VT_PAGE_SIZE - VT_PAGE_BORDER;
+  vt->desc.generate(vt->desc.user, VT_PAGE_MIP(page), texel_x, texel_y, VT_PADDED_SIZE, job->pixels);
+
+  pthread_mutex_lock(&vt->lock);
+  vt->done[vt->done_count++] = job;
+  pthread_mutex_unlock(&vt->lock);
+}
+
+static void request_page(virtual_texture_t* vt, uint32_t page)
+{
+  vt_job_t* job = malloc(sizeof(vt_job_t));
+  uint8_t* pixels = malloc(VT_PADDED_SIZE * VT_PADDED_SIZE * 4);
+  if (!job || !pixels) {
+    free(job);
+    free(pixels);
+    return;
+  }
+
+  job->vt = vt;
+  job->page = page;
+  job->pixels = pixels;
+
+  if (!thread_pool_submit(vt->pool, generate_page, job)) {
+    free(pixels);
+    free(job);
+    return;
+  }
+
+  map_set(vt, page, VT_SLOT_PENDING);
+  vt->pending++;
+  vt->stats.requests++;
+}
+
+uint32_t vt_find_slot(const vt_slot_t* slots, uint32_t slot_count, uint64_t frame)
+{
+  uint32_t best = VT_PAGE_NONE;
+  for (uint32_t i = 0; i < slot_count; i++) {
+    const vt_slot_t* slot = &slots[i];
+    if (slot->page == VT_PAGE_NONE)
+      return i;
+    if (slot->pinned || slot->last_used + 1 >= frame)
+      continue;
+    if (best == VT_PAGE_NONE || slot->last_used < slots[best].last_used)
+      best = i;
+  }
+  return best;
+}
+
+static void map_page(virtual_texture_t* vt, uint32_t page, uint32_t slot, const uint8_t* pixels)
+{
+  vt_slot_t* target = &vt->slots[slot];
+
+  if (target->page != VT_PAGE_NONE) {
+    uint32_t old = target->page;
+    map_remove(vt, old);
+    target->page = VT_PAGE_NONE;
+    refresh_page_table(vt, old);
+    vt->stats.evictions++;
+    vt->stats.resident_pages--;
+  }
+
+  gl_state_edit_texture(GL_TEXTURE_2D, vt->physical);
+  glTexSubImage2D(GL_TEXTURE_2D, 0,
+		  (slot % vt->desc.phys_pages) * VT_PADDED_SIZE, (slot / vt->desc.phys_pages) * VT_PADDED_SIZE,
+		  VT_PADDED_SIZE, VT_PADDED_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+  target->page = page;
+  target->last_used = vt->frame;
+  map_set(vt, page, slot);
+  refresh_page_table(vt, page);
+  vt->stats.resident_pages++;
+}
+
+/* PUBLIC */
+
+virtual_texture_t* vt_create(const vt_desc_t* desc, thread_pool_t* pool)
+{
+  uint32_t pages = desc->virtual_pages;
+  if (pages == 0 || pages > 4096 || (pages & (pages - 1)) != 0 ||
+      desc->phys_pages < 2 || desc->phys_pages > 256 || !desc->generate) {
+    fprintf(stderr, "Invalid virtual texture description.\n");
+    return NULL;
+  }
+
+  virtual_texture_t* vt = calloc(1, sizeof(virtual_texture_t));
+  if (!vt) {
+    fprintf(stderr, "Memory allocation failed for virtual texture\n");
+    return NULL;
+  }
+
+  vt->desc = *desc;
+  vt->pool = pool;
+  vt->frame = 1;
+  vt->phys_size = desc->phys_pages * VT_PADDED_SIZE;
+  vt->slot_count = desc->phys_pages * desc->phys_pages;
+  while ((1u << vt->max_mip) < pages)
+    vt->max_mip++;
+
+  // Map load factor stays under 1/2 with every slot and pending page in it
+  vt->map_bits = 1;
+  while ((1u << vt->map_bits) < 2 * (vt->slot_count + VT_MAX_PENDING))
+    vt->map_bits++;
+
+  vt->slots = malloc(vt->slot_count * sizeof(vt_slot_t));
+  vt->map_keys = malloc(((size_t)1 << vt->map_bits) * sizeof(uint32_t));
+  vt->map_values = malloc(((size_t)1 << vt->map_bits) * sizeof(uint32_t));
+  if (!vt->slots || !vt->map_keys || !vt->map_values) {
+    fprintf(stderr, "Memory allocation failed for virtual texture\n");
+    vt_destroy(vt);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < vt->slot_count; i++) {
+    vt->slots[i].page = VT_PAGE_NONE;
+    vt->slots[i].last_used = 0;
+    vt->slots[i].pinned = false;
+  }
+  memset(vt->map_keys, 0xFF, ((size_t)1 << vt->map_bits) * sizeof(uint32_t));
+
+  if (!vt_page_table_init(&vt->table, pages, desc->phys_pages)) {
+    vt_destroy(vt);
+    return NULL;
+  }
+
+  pthread_mutex_init(&vt->lock, NULL);
+
+  glGenTextures(1, &vt->page_table);
+  gl_state_edit_texture(GL_TEXTURE_2D, vt->page_table);
+  glTexStorage2D(GL_TEXTURE_2D, vt->max_mip + 1, GL_RGBA8, pages, pages);
+
+  glGenTextures(1, &vt->physical);
+  gl_state_edit_texture(GL_TEXTURE_2D, vt->physical);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, vt->phys_size, vt->phys_size);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  // The coarsest page covers the whole texture, generate it now and never evict it
+  uint32_t root = VT_PAGE_ID(0, 0, vt->max_mip);
+  uint8_t* pixels = malloc(VT_PADDED_SIZE * VT_PADDED_SIZE * 4);
+  if (!pixels) {
+    vt_destroy(vt);
+    return NULL;
+  }
+  desc->generate(desc->user, vt->max_mip, -VT_PAGE_BORDER, -VT_PAGE_BORDER, VT_PADDED_SIZE, pixels);
+
+  // Mapping the root fills in every level of the page table
+  map_page(vt, root, 0, pixels);
+  vt->slots[0].pinned = true;
+  free(pixels);
+
+  return vt;
+}
+
+void vt_update(virtual_texture_t* vt)
+{
+  vt->frame++;
+  vt->stats.uploads = 0;
+
+  vt_job_t* jobs[VT_MAX_UPLOADS_PER_FRAME];
+  uint32_t count = 0;
+
+  pthread_mutex_lock(&vt->lock);
+  count = vt->done_count < VT_MAX_UPLOADS_PER_FRAME ? vt->done_count : VT_MAX_UPLOADS_PER_FRAME;
+  memcpy(jobs, vt->done, count * sizeof(vt_job_t*));
+  memmove(vt->done, vt->done + count, (vt->done_count - count) * sizeof(vt_job_t*));
+  vt->done_count -= count;
+  pthread_mutex_unlock(&vt->lock);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  for (uint32_t i = 0; i < count; i++) {
+    vt_job_t* job = jobs[i];
+    uint32_t slot = vt_find_slot(vt->slots, vt->slot_count, vt->frame);
+
+    map_remove(vt, job->page);
+    if (slot != VT_PAGE_NONE) {
+      map_page(vt, job->page, slot, job->pixels);
+      vt->stats.uploads++;
+    }
+
+    vt->pending--;
+    free(job->pixels);
+    free(job);
+  }
+
+  vt->stats.pending_pages = vt->pending;
+}
+
+static int compare_page_ids(const void* a, const void* b)
+{
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+}
+
+void vt_feedback_submit(virtual_texture_t* vt, const uint32_t* page_ids, size_t count)
+{
+  vt->stats.requests = 0;
+
+  if (count > vt->scratch_size) {
+    uint32_t* scratch = realloc(vt->scratch, count * sizeof(uint32_t));
+    if (!scratch)
+      return;
+    vt->scratch = scratch;
+    vt->scratch_size = count;
+  }
+
+  size_t unique = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (page_ids[i] != VT_PAGE_NONE)
+      vt->scratch[unique++] = page_ids[i];
+  }
+
+  // Sorting groups duplicates and, with the mip in the top byte, puts coarse pages last
+  qsort(vt->scratch, unique, sizeof(uint32_t), compare_page_ids);
+
+  // Walk coarse to fine so fallbacks get requested before the detail that needs them
+  uint32_t requested = 0;
+  for (size_t i = unique; i-- > 0;) {
+    uint32_t page = vt->scratch[i];
+    if (i + 1 < unique && vt->scratch[i + 1] == page)
+      continue;
+
+    uint32_t mip = VT_PAGE_MIP(page);
+    if (mip > vt->max_mip || VT_PAGE_X(page) >= level_pages(vt, mip) || VT_PAGE_Y(page) >= level_pages(vt, mip))
+      continue;
+
+    // Keep the page, or whichever ancestor stands in for it, from being evicted
+    for (uint32_t level = mip; level <= vt->max_mip; level++) {
+      uint32_t shift = level - mip;
+      uint32_t slot = map_get(vt, VT_PAGE_ID(VT_PAGE_X(page) >> shift, VT_PAGE_Y(page) >> shift, level));
+      if (slot != VT_PAGE_NONE && slot != VT_SLOT_PENDING) {
+	vt->slots[slot].last_used = vt->frame;
+	break;
+      }
+    }
+
+    if (map_get(vt, page) == VT_PAGE_NONE && requested < VT_MAX_REQUESTS_PER_FRAME &&
+	vt->pending < VT_MAX_PENDING) {
+      request_page(vt, page);
+      requested++;
+    }
+  }
+}
+
+void vt_feedback_begin(virtual_texture_t* vt, uint32_t viewport_width, uint32_t viewport_height)
+{
+  uint32_t width = viewport_width / VT_FEEDBACK_SCALE;
+  uint32_t height = viewport_height / VT_FEEDBACK_SCALE;
+  if (width == 0) width = 1;
+  if (height == 0) height = 1;
+
+  // (Re)create the feedback target when the viewport changes size
+  if (width != vt->feedback_width || height != vt->feedback_height) {
+    if (vt->feedback_fbo) {
+      glDeleteFramebuffers(1, &vt->feedback_fbo);
+      glDeleteRenderbuffers(1, &vt->feedback_color);
+      glDeleteRenderbuffers(1, &vt->feedback_depth);
+      gl_state_forget_buffer(vt->feedback_pbo[0]);
+      gl_state_forget_buffer(vt->feedback_pbo[1]);
+      glDeleteBuffers(2, vt->feedback_pbo);
+    }
+
+    glGenRenderbuffers(1, &vt->feedback_color);
+    glBindRenderbuffer(GL_RENDERBUFFER, vt->feedback_color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height);
+
+    glGenRenderbuffers(1, &vt->feedback_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, vt->feedback_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &vt->feedback_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->feedback_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, vt->feedback_color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, vt->feedback_depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      fprintf(stderr, "Virtual texture feedback framebuffer incomplete.\n");
+
+    glGenBuffers(2, vt->feedback_pbo);
+    for (uint32_t i = 0; i < 2; i++) {
+      gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, vt->feedback_pbo[i]);
+      glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * sizeof(uint32_t), NULL, GL_STREAM_READ);
+      vt->feedback_ready[i] = false;
+    }
+    gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    vt->feedback_width = width;
+    vt->feedback_height = height;
+  }
+
+  glGetIntegerv(GL_VIEWPORT, vt->saved_viewport);
+  glBindFramebuffer(GL_FRAMEBUFFER, vt->feedback_fbo);
+  glViewport(0, 0, width, height);
+
+  const GLuint clear_page[4] = { VT_PAGE_NONE, 0, 0, 0 };
+  glClearBufferuiv(GL_COLOR, 0, clear_page);
+  glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void vt_feedback_end(virtual_texture_t* vt)
+{
+  uint32_t current = vt->feedback_index;
+  uint32_t previous = current ^ 1;
+
+  // Start this frame's readback, it lands in the PBO without stalling
+  gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, vt->feedback_pbo[current]);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, vt->feedback_width, vt->feedback_height, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+  vt->feedback_ready[current] = true;
+
+  // Last frame's readback has had a frame to finish
+  if (vt->feedback_ready[previous]) {
+    gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, vt->feedback_pbo[previous]);
+    const uint32_t* ids = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+					   (GLsizeiptr)vt->feedback_width * vt->feedback_height * sizeof(uint32_t),
+					   GL_MAP_READ_BIT);
+    if (ids) {
+      vt_feedback_submit(vt, ids, (size_t)vt->feedback_width * vt->feedback_height);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    vt->feedback_ready[previous] = false;
+  }
+
+  gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+  vt->feedback_index = previous;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(vt->saved_viewport[0], vt->saved_viewport[1], vt->saved_viewport[2], vt->saved_viewport[3]);
+}
+
+void vt_bind(const virtual_texture_t* vt, const shader_t* shader,
+	     uint32_t page_table_unit, uint32_t physical_unit, bool feedback_pass)
+{
+  sampler_desc_t table_sampler = { GL_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, 1.0f };
+  sampler_desc_t physical_sampler = { GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, 1.0f };
+
+  // Uniforms are set on the current program
+  shader_use(shader);
+
+  gl_state_bind_texture(page_table_unit, GL_TEXTURE_2D, vt->page_table);
+  gl_state_bind_sampler(page_table_unit, sampler_get(&table_sampler));
+
+  gl_state_bind_texture(physical_unit, GL_TEXTURE_2D, vt->physical);
+  gl_state_bind_sampler(physical_unit, sampler_get(&physical_sampler));
+
+  shader_set_int(shader, "vt_page_table", page_table_unit);
+  shader_set_int(shader, "vt_physical", physical_unit);
+  shader_set_float(shader, "vt_virtual_pages", (float)vt->desc.virtual_pages);
+  shader_set_float(shader, "vt_page_size", (float)VT_PAGE_SIZE);
+  shader_set_float(shader, "vt_page_border", (float)VT_PAGE_BORDER);
+  shader_set_float(shader, "vt_physical_size", (float)vt->phys_size);
+  shader_set_float(shader, "vt_max_mip", (float)vt->max_mip);
+  // The feedback target is smaller, so its derivatives overestimate the mip by log2(scale)
+  shader_set_float(shader, "vt_mip_bias", feedback_pass ? -log2f((float)VT_FEEDBACK_SCALE) : 0.0f);
+}
+
+vt_stats_t vt_get_stats(const virtual_texture_t* vt)
+{
+  return vt->stats;
+}
+
+void vt_generate_terrain(void* user, uint32_t mip, int64_t texel_x, int64_t texel_y,
+			 uint32_t size, uint8_t* rgba)
+{
+  // Colour ramp from water to snow by height
+  static const float stops[][4] = {
+    { 0.00f,  20,  50, 120 },
+    { 0.42f,  40,  90, 170 },
+    { 0.46f, 194, 178, 128 },
+    { 0.52f,  70, 130,  50 },
+    { 0.66f,  50,  90,  40 },
+    { 0.74f, 110, 100,  90 },
+    { 0.82f, 240, 240, 245 },
+    { 1.00f, 255, 255, 255 },
+  };
+  const uint32_t stop_count = sizeof(stops) / sizeof(stops[0]);
+  const float scale = (float)(1u << mip) / VT_TERRAIN_TEXELS_PER_UNIT;
+  (void)user;
+
+  for (uint32_t y = 0; y < size; y++) {
+    for (uint32_t x = 0; x < size; x++) {
+      float wx = ((float)(texel_x + x) + 0.5f) * scale;
+      float wy = ((float)(texel_y + y) + 0.5f) * scale;
+
+      // Three octaves, normalised back to [0, 1]
+      float height = perlin2d(wx, wy) * 0.57f + perlin2d(wx * 2.0f, wy * 2.0f) * 0.29f +
+	perlin2d(wx * 4.0f, wy * 4.0f) * 0.14f;
+
+      uint32_t i = 1;
+      while (i < stop_count - 1 && height > stops[i][0])
+	i++;
+      float t = (height - stops[i - 1][0]) / (stops[i][0] - stops[i - 1][0]);
+      t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+
+      uint8_t* texel = rgba + ((size_t)y * size + x) * 4;
+      for (uint32_t c = 0; c < 3; c++)
+	texel[c] = (uint8_t)(stops[i - 1][c + 1] + t * (stops[i][c + 1] - stops[i - 1][c + 1]));
+      texel[3] = 255;
+    }
+  }
+}
+
+void vt_destroy(virtual_texture_t* vt)
+{
+  if (!vt)
+    return;
+
+  // Let in-flight jobs land before their target goes away
+  if (vt->pool && vt->pending)
+    thread_pool_wait(vt->pool);
+  for (uint32_t i = 0; i < vt->done_count; i++) {
+    free(vt->done[i]->pixels);
+    free(vt->done[i]);
+  }
+
+  if (vt->page_table) {
+    gl_state_forget_texture(vt->page_table);
+    gl_state_forget_texture(vt->physical);
+    glDeleteTextures(1, &vt->page_table);
+    glDeleteTextures(1, &vt->physical);
+    pthread_mutex_destroy(&vt->lock);
+  }
+  if (vt->feedback_fbo) {
+    glDeleteFramebuffers(1, &vt->feedback_fbo);
+    glDeleteRenderbuffers(1, &vt->feedback_color);
+    glDeleteRenderbuffers(1, &vt->feedback_depth);
+    gl_state_forget_buffer(vt->feedback_pbo[0]);
+    gl_state_forget_buffer(vt->feedback_pbo[1]);
+    glDeleteBuffers(2, vt->feedback_pbo);
+  }
+
+  vt_page_table_free(&vt->table);
+  free(vt->slots);
+  free(vt->map_keys);
+  free(vt->map_values);
+  free(vt->scratch);
+  free(vt);
+}
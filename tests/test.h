@@ -0,0 +1,29 @@
+#pragma once
+
+// Minimal checks for the CPU-only parts of the engine, no window or GL context needed.
+// Each suite is a function run by name from test_main.c, ctest runs them one per test
+
+#include <stdbool.h>
+
+#ifndef TEST_ASSET_DIR
+#define TEST_ASSET_DIR "../assets"
+#endif
+
+// Report a failed condition without stopping the suite
+#define CHECK(cond) test_check((cond), #cond, __FILE__, __LINE__)
+
+bool test_check(bool ok, const char* expr, const char* file, int line);
+
+/* SUITES */
+
+void test_bmp(void);
+void test_bvh(void);
+void test_clipmap(void);
+void test_cull(void);
+void test_mesh_optimizer(void);
+void test_occlusion(void);
+void test_render_queue(void);
+void test_shader_preprocess(void);
+void test_terrain(void);
+void test_vertex_layout(void);
+void test_virtual_texture(void);
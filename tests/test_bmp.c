@@ -0,0 +1,96 @@
+#include "test.h"
+#include "bmp_decode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BRICKS_PATH TEST_ASSET_DIR "/textures/bricks.bmp"
+
+static uint8_t* read_file(const char* path, size_t* size)
+{
+  FILE* file = fopen(path, "rb");
+  if (!file)
+    return NULL;
+
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  rewind(file);
+  uint8_t* data = length > 0 ? malloc((size_t)length) : NULL;
+  *size = data ? fread(data, 1, (size_t)length, file) : 0;
+  fclose(file);
+  return data;
+}
+
+static void put16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put32(uint8_t* p, uint32_t v) { put16(p, (uint16_t)v); put16(p + 2, (uint16_t)(v >> 16)); }
+
+// The bundled texture decodes the same from disk and from memory
+static void test_bricks(void)
+{
+  bmp_image_t image;
+  if (!CHECK(bmp_decode_file(BRICKS_PATH, &image) == BMP_OK))
+    return;
+  CHECK(image.width == 200 && image.height == 200);
+  CHECK(image.row_size == 600);
+  CHECK(image.pixels != NULL);
+
+  size_t size;
+  uint8_t* data = read_file(BRICKS_PATH, &size);
+  bmp_image_t from_memory;
+  if (CHECK(data != NULL) && CHECK(bmp_decode_memory(data, size, &from_memory) == BMP_OK)) {
+    CHECK(memcmp(image.pixels, from_memory.pixels, image.row_size * image.height) == 0);
+    bmp_image_free(&from_memory);
+  }
+
+  // Every cut short copy is rejected, not read past
+  for (size_t cut = 0; data && cut < size; cut += cut < 256 ? 1 : 997) {
+    bmp_image_t truncated;
+    CHECK(bmp_decode_memory(data, cut, &truncated) != BMP_OK);
+    CHECK(truncated.pixels == NULL);
+  }
+
+  // Wrong magic
+  if (data) {
+    data[0] = 'X';
+    bmp_image_t bad;
+    CHECK(bmp_decode_memory(data, size, &bad) == BMP_ERROR_SIGNATURE);
+  }
+
+  free(data);
+  bmp_image_free(&image);
+}
+
+// 2x2 24-bit bottom-up file comes out as top-down BGR rows
+static void test_row_order(void)
+{
+  uint8_t file[70] = { 0 };
+  put16(file + 0, BMP_MAGIC);
+  put32(file + 2, sizeof(file));
+  put32(file + 10, 54);
+  put32(file + 14, 40);
+  put32(file + 18, 2);
+  put32(file + 22, 2);
+  put16(file + 26, 1);
+  put16(file + 28, 24);
+
+  // File rows are 6 bytes padded to 8, bottom row first
+  const uint8_t bottom[6] = { 1, 2, 3, 4, 5, 6 };
+  const uint8_t top[6] = { 7, 8, 9, 10, 11, 12 };
+  memcpy(file + 54, bottom, 6);
+  memcpy(file + 62, top, 6);
+
+  bmp_image_t image;
+  if (!CHECK(bmp_decode_memory(file, sizeof(file), &image) == BMP_OK))
+    return;
+  CHECK(image.width == 2 && image.height == 2);
+  CHECK(memcmp(image.pixels, top, 6) == 0);
+  CHECK(memcmp(image.pixels + image.row_size, bottom, 6) == 0);
+  bmp_image_free(&image);
+}
+
+void test_bmp(void)
+{
+  test_bricks();
+  test_row_order();
+}
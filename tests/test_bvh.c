@@ -0,0 +1,145 @@
+#include "test.h"
+#include "bvh.h"
+#include "test_random.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BOX_COUNT 20000
+#define RAY_COUNT 500
+
+static int compare_indices(const void* a, const void* b)
+{
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+// Same plane test the tree uses, on every box
+static uint32_t brute_cull(const aabb_t* boxes, uint32_t count, mat4 view_projection, uint32_t* visible)
+{
+  vec4 planes[6];
+  glm_frustum_planes(view_projection, planes);
+
+  uint32_t visible_count = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    bool inside = true;
+    for (uint32_t p = 0; p < 6 && inside; p++) {
+      float distance = planes[p][3], reach = 0.0f;
+      for (uint32_t c = 0; c < 3; c++) {
+	distance += planes[p][c] * 0.5f * (boxes[i].min[c] + boxes[i].max[c]);
+	reach += fabsf(planes[p][c]) * 0.5f * (boxes[i].max[c] - boxes[i].min[c]);
+      }
+      inside = distance + reach >= 0.0f;
+    }
+    if (inside)
+      visible[visible_count++] = i;
+  }
+  return visible_count;
+}
+
+// Nearest slab entry over every box, negative for a miss
+static float brute_ray(const aabb_t* boxes, uint32_t count, const vec3 origin, const vec3 direction, float max_t)
+{
+  float closest = -1.0f;
+  for (uint32_t i = 0; i < count; i++) {
+    float near = 0.0f, far = max_t;
+    for (uint32_t c = 0; c < 3; c++) {
+      float t0 = (boxes[i].min[c] - origin[c]) / direction[c];
+      float t1 = (boxes[i].max[c] - origin[c]) / direction[c];
+      near = fmaxf(near, fminf(t0, t1));
+      far = fminf(far, fmaxf(t0, t1));
+    }
+    if (near <= far && (closest < 0.0f || near < closest))
+      closest = near;
+  }
+  return closest;
+}
+
+static void check_cull(const bvh_t* bvh, const aabb_t* boxes, uint32_t* visible, uint32_t* expected)
+{
+  vec3 targets[] = { { 0.0f, 0.0f, -1.0f }, { 1.0f, 0.3f, 0.2f }, { -0.4f, -1.0f, 0.1f } };
+  for (uint32_t v = 0; v < sizeof(targets) / sizeof(targets[0]); v++) {
+    mat4 projection, view, view_projection;
+    vec3 eye = { 0.0f, 0.0f, 0.0f }, up = { 0.0f, 1.0f, 0.0f };
+    glm_perspective(glm_rad(60.0f), 1.5f, 0.1f, 60.0f, projection);
+    glm_lookat(eye, targets[v], up, view);
+    glm_mat4_mul(projection, view, view_projection);
+
+    uint32_t expected_count = brute_cull(boxes, BOX_COUNT, view_projection, expected);
+    uint32_t count = bvh_cull_frustum(bvh, view_projection, visible);
+    qsort(visible, count, sizeof(uint32_t), compare_indices);
+    CHECK(expected_count > 0);
+    CHECK(count == expected_count);
+    CHECK(memcmp(visible, expected, expected_count * sizeof(uint32_t)) == 0);
+  }
+}
+
+static void check_rays(const bvh_t* bvh, const aabb_t* boxes)
+{
+  uint32_t misses = 0, wrong = 0;
+  for (uint32_t r = 0; r < RAY_COUNT; r++) {
+    vec3 origin = { random_range(-60.0f, 60.0f), random_range(-60.0f, 60.0f), random_range(-60.0f, 60.0f) };
+    vec3 direction = { random_range(-1.0f, 1.0f), random_range(-1.0f, 1.0f), random_range(-1.0f, 1.0f) };
+    float max_t = r % 2 ? 1000.0f : 20.0f;
+
+    bvh_hit_t hit;
+    bool found = bvh_raycast(bvh, origin, direction, max_t, NULL, NULL, &hit);
+    float expected = brute_ray(boxes, BOX_COUNT, origin, direction, max_t);
+    misses += expected < 0.0f;
+    if (found != (expected >= 0.0f) || (found && fabsf(hit.t - expected) > 1e-4f * fmaxf(1.0f, expected)))
+      wrong++;
+  }
+  CHECK(wrong == 0);
+  CHECK(misses > 0 && misses < RAY_COUNT);
+}
+
+// Culling and raycasts through the tree find exactly what testing every box does, built serially
+// or on workers and after a refit
+void test_bvh(void)
+{
+  aabb_t* boxes = malloc(BOX_COUNT * sizeof(aabb_t));
+  uint32_t* visible = malloc(BOX_COUNT * sizeof(uint32_t));
+  uint32_t* expected = malloc(BOX_COUNT * sizeof(uint32_t));
+  thread_pool_t* workers = thread_pool_create(2);
+
+  srand(17);
+  for (uint32_t i = 0; i < BOX_COUNT; i++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      float center = random_range(-50.0f, 50.0f), extent = random_range(0.05f, 1.5f);
+      boxes[i].min[c] = center - extent;
+      boxes[i].max[c] = center + extent;
+    }
+  }
+
+  for (uint32_t threaded = 0; threaded < 2; threaded++) {
+    bvh_t* bvh = bvh_build(boxes, BOX_COUNT, threaded ? workers : NULL);
+    if (!CHECK(bvh != NULL))
+      continue;
+    bvh_stats_t stats = bvh_get_stats(bvh);
+    CHECK(stats.depth <= BVH_MAX_DEPTH && stats.leaf_count > 0);
+
+    check_cull(bvh, boxes, visible, expected);
+    check_rays(bvh, boxes);
+
+    // Move a tenth of the boxes and refit, the tree must still find them where they went
+    for (uint32_t i = 0; i < BOX_COUNT; i += 10) {
+      for (uint32_t c = 0; c < 3; c++) {
+	float offset = random_range(-5.0f, 5.0f);
+	boxes[i].min[c] += offset;
+	boxes[i].max[c] += offset;
+      }
+      bvh_update(bvh, i, &boxes[i]);
+    }
+    bvh_refit(bvh);
+    check_cull(bvh, boxes, visible, expected);
+    check_rays(bvh, boxes);
+
+    bvh_destroy(bvh);
+  }
+
+  thread_pool_destroy(workers);
+  free(expected);
+  free(visible);
+  free(boxes);
+}
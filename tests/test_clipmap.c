@@ -0,0 +1,113 @@
+#include "test.h"
+#include "clipmap.h"
+
+#include <stdlib.h>
+
+#define MOVE_COUNT 400
+
+// Which level sample each texel holds, as the heights texture would after every update
+typedef struct {
+  int32_t x, z;
+} texel_t;
+
+static texel_t texels[CLIPMAP_LEVELS][CLIPMAP_SIZE][CLIPMAP_SIZE];
+
+static int32_t floor_half(int32_t value)
+{
+  return value >= 0 ? value / 2 : -((1 - value) / 2);
+}
+
+// Trims for cameras worked out by hand from the level spacings, level 0 against level 1
+static void test_trims(void)
+{
+  static const struct {
+    float x, z;
+    uint32_t trim;
+  } cases[] = {
+    { 0.0f, 0.0f, 0 },         // both centered on sample 0
+    { 2.5f, 0.0f, 1 },         // level 0 snaps to 2, level 1 still to 0, so one quad in along x
+    { 2.5f, 2.5f, 3 },
+    { 0.0f, 3.9f, 2 },
+    { -0.5f, 0.0f, 1 },        // both snap to -2, which is sample -1 of level 1
+    { -2.5f, 0.0f, 0 },        // level 0 snaps to -4, level 1 to -2
+    { 4.5f, -0.5f, 2 },
+  };
+
+  int32_t fine[2], coarse[2];
+  for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    vec3 camera = { cases[i].x, 0.0f, cases[i].z };
+    clipmap_level_grid(0, camera, fine);
+    clipmap_level_grid(1, camera, coarse);
+    CHECK(clipmap_level_trim(fine, coarse) == cases[i].trim);
+  }
+
+  // Straight from grids: level 0 at -60, level 1 at -62 puts the finer center on sample 1
+  CHECK(clipmap_level_trim((int32_t[2]){ -60, -62 }, (int32_t[2]){ -62, -62 }) == 1);
+  CHECK(clipmap_level_trim((int32_t[2]){ -62, -60 }, (int32_t[2]){ -62, -62 }) == 2);
+}
+
+// Every texel of every window holds the sample the shader expects there, through small steps,
+// jumps of a window or more and negative coordinates. The rings' reads, this level's neighbours
+// for normals and the coarser level's for morphing, stay inside the windows
+void test_clipmap(void)
+{
+  bool valid[CLIPMAP_LEVELS] = { false };
+  int32_t windows[CLIPMAP_LEVELS][2] = { { 0 } };
+  uint32_t stale = 0, outside = 0, bad_trims = 0;
+
+  srand(23);
+  vec3 camera = { 3.5f, 0.0f, -7.25f };
+  for (uint32_t move = 0; move < MOVE_COUNT; move++) {
+    float reach = move % 50 == 49 ? 2000.0f : move % 7 == 0 ? 60.0f : 3.0f;
+    camera[0] += reach * ((float)rand() / (float)RAND_MAX * 2.0f - 1.0f);
+    camera[2] += reach * ((float)rand() / (float)RAND_MAX * 2.0f - 1.0f);
+
+    int32_t grids[CLIPMAP_LEVELS][2];
+    for (uint32_t l = 0; l < CLIPMAP_LEVELS; l++) {
+      clipmap_level_grid(l, camera, grids[l]);
+      int32_t window[2] = { grids[l][0] - 1, grids[l][1] - 1 };
+
+      clipmap_region_t regions[2];
+      uint32_t region_count = clipmap_window_regions(valid[l], windows[l], window, regions);
+      for (uint32_t r = 0; r < region_count; r++)
+	for (int32_t z = regions[r].z0; z < regions[r].z0 + (int32_t)regions[r].height; z++)
+	  for (int32_t x = regions[r].x0; x < regions[r].x0 + (int32_t)regions[r].width; x++)
+	    texels[l][z & (CLIPMAP_SIZE - 1)][x & (CLIPMAP_SIZE - 1)] = (texel_t){ x, z };
+      windows[l][0] = window[0];
+      windows[l][1] = window[1];
+      valid[l] = true;
+
+      for (int32_t z = window[1]; z < window[1] + CLIPMAP_SIZE; z++) {
+	for (int32_t x = window[0]; x < window[0] + CLIPMAP_SIZE; x++) {
+	  texel_t held = texels[l][z & (CLIPMAP_SIZE - 1)][x & (CLIPMAP_SIZE - 1)];
+	  stale += held.x != x || held.z != z;
+	}
+      }
+
+      // Neighbours of the grid's edge samples for normals
+      for (uint32_t c = 0; c < 2; c++)
+	outside += grids[l][c] - 1 < window[c] || grids[l][c] + CLIPMAP_GRID + 1 >= window[c] + CLIPMAP_SIZE;
+    }
+
+    for (uint32_t l = 1; l < CLIPMAP_LEVELS; l++) {
+      // The trim leaves out the finer grid, which starts a quarter of the grid in, plus a quad
+      // along each axis whose bit is set
+      uint32_t trim = clipmap_level_trim(grids[l - 1], grids[l]);
+      bad_trims += trim > 3;
+      for (uint32_t c = 0; c < 2; c++) {
+	// Samples between the finer grid's, and the one after for bilinear
+	int32_t first = floor_half(grids[l - 1][c]), last = floor_half(grids[l - 1][c] + CLIPMAP_GRID) + 1;
+	outside += first < windows[l][c] || last >= windows[l][c] + CLIPMAP_SIZE;
+
+	int32_t inset = CLIPMAP_GRID / 4 + (int32_t)(trim >> c & 1);
+	bad_trims += floor_half(grids[l - 1][c]) != grids[l][c] + inset;
+      }
+    }
+  }
+
+  CHECK(stale == 0);
+  CHECK(outside == 0);
+  CHECK(bad_trims == 0);
+
+  test_trims();
+}
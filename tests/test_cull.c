@@ -0,0 +1,60 @@
+#include "test.h"
+#include "cull.h"
+#include "test_random.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Not a multiple of any SIMD width or of CULL_CHUNK_SIZE, so tails and chunk packing are covered
+#define OBJECT_COUNT 100003
+
+// Every SIMD path this CPU has must agree with the scalar one, threaded or not
+void test_cull(void)
+{
+  cull_objects_t* objects = cull_objects_create(0);
+  if (!CHECK(objects != NULL))
+    return;
+
+  srand(11);
+  for (uint32_t i = 0; i < OBJECT_COUNT; i++) {
+    vec3 center = { random_range(-200.0f, 200.0f), random_range(-50.0f, 50.0f), random_range(-200.0f, 200.0f) };
+    vec3 extents = { random_range(0.1f, 8.0f), random_range(0.1f, 8.0f), random_range(0.1f, 8.0f) };
+    cull_objects_add(objects, center, extents);
+  }
+
+  // Looking down a few axes, so some planes are axis aligned and some aren't
+  vec3 targets[] = { { 0.0f, 0.0f, -1.0f }, { 1.0f, 0.2f, 0.3f }, { -0.5f, -1.0f, 0.0f } };
+  const char* paths[] = { "sse2", "avx2", "neon" };
+  uint32_t* expected = malloc(OBJECT_COUNT * sizeof(uint32_t));
+  uint32_t* visible = malloc(OBJECT_COUNT * sizeof(uint32_t));
+  thread_pool_t* workers = thread_pool_create(2);
+
+  for (uint32_t v = 0; v < sizeof(targets) / sizeof(targets[0]); v++) {
+    mat4 projection, view, view_projection;
+    vec3 eye = { 0.0f, 0.0f, 0.0f }, up = { 0.0f, 1.0f, 0.0f };
+    glm_perspective(glm_rad(60.0f), 16.0f / 9.0f, 0.1f, 150.0f, projection);
+    glm_lookat(eye, targets[v], up, view);
+    glm_mat4_mul(projection, view, view_projection);
+
+    CHECK(cull_set_simd("scalar"));
+    uint32_t expected_count = cull_frustum(objects, view_projection, NULL, expected);
+    CHECK(expected_count > 0 && expected_count < OBJECT_COUNT);
+
+    for (uint32_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++) {
+      if (!cull_set_simd(paths[p]))
+	continue;
+      for (uint32_t threaded = 0; threaded < 2; threaded++) {
+	uint32_t count = cull_frustum(objects, view_projection, threaded ? workers : NULL, visible);
+	CHECK(count == expected_count);
+	CHECK(memcmp(visible, expected, expected_count * sizeof(uint32_t)) == 0);
+      }
+    }
+  }
+
+  CHECK(!cull_set_simd("avx512"));
+
+  thread_pool_destroy(workers);
+  free(visible);
+  free(expected);
+  cull_objects_destroy(objects);
+}
@@ -0,0 +1,57 @@
+#include "test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  const char* name;
+  void (*run)(void);
+} test_suite_t;
+
+static const test_suite_t suites[] = {
+  { "bmp", test_bmp },
+  { "bvh", test_bvh },
+  { "clipmap", test_clipmap },
+  { "cull", test_cull },
+  { "mesh_optimizer", test_mesh_optimizer },
+  { "occlusion", test_occlusion },
+  { "render_queue", test_render_queue },
+  { "shader_preprocess", test_shader_preprocess },
+  { "terrain", test_terrain },
+  { "vertex_layout", test_vertex_layout },
+  { "virtual_texture", test_virtual_texture },
+};
+
+static unsigned failures = 0;
+
+bool test_check(bool ok, const char* expr, const char* file, int line)
+{
+  if (!ok) {
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    failures++;
+  }
+  return ok;
+}
+
+// engine_tests [suite], every suite when none is named
+int main(int argc, char** argv)
+{
+  const char* only = argc > 1 ? argv[1] : NULL;
+  unsigned ran = 0;
+
+  for (size_t i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+    if (only && strcmp(only, suites[i].name) != 0)
+      continue;
+
+    unsigned before = failures;
+    suites[i].run();
+    printf("%-12s %s\n", suites[i].name, failures == before ? "ok" : "FAILED");
+    ran++;
+  }
+
+  if (ran == 0) {
+    fprintf(stderr, "No test suite named %s\n", only);
+    return 1;
+  }
+  return failures ? 1 : 0;
+}
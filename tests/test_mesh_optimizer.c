@@ -0,0 +1,179 @@
+#include "test.h"
+#include "mesh_optimizer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GRID 24                        // quads per side
+#define COMPONENTS 5                   // position and a uv, like a stripped down quad vertex
+
+typedef struct {
+  uint32_t v[3];
+} triangle_t;
+
+// Rotate so the smallest id comes first, which keeps the winding
+static triangle_t canonical(uint32_t a, uint32_t b, uint32_t c)
+{
+  if (b < a && b < c)
+    return (triangle_t){ { b, c, a } };
+  if (c < a && c < b)
+    return (triangle_t){ { c, a, b } };
+  return (triangle_t){ { a, b, c } };
+}
+
+static int compare_triangles(const void* a, const void* b)
+{
+  return memcmp(a, b, sizeof(triangle_t));
+}
+
+// Triangles as sorted grid point ids, read back from the positions so renumbering doesn't matter
+static triangle_t* grid_triangles(const float* vertices, const uint32_t* indices, uint32_t index_count)
+{
+  triangle_t* triangles = malloc(index_count / 3 * sizeof(triangle_t));
+  for (uint32_t t = 0; t < index_count / 3; t++) {
+    uint32_t id[3];
+    for (uint32_t k = 0; k < 3; k++) {
+      const float* p = vertices + (size_t)indices[t * 3 + k] * COMPONENTS;
+      id[k] = (uint32_t)p[0] + (uint32_t)p[1] * (GRID + 1);
+    }
+    triangles[t] = canonical(id[0], id[1], id[2]);
+  }
+  qsort(triangles, index_count / 3, sizeof(triangle_t), compare_triangles);
+  return triangles;
+}
+
+// Four unshared vertices per quad and the quads in shuffled order, so every step has work to do
+static void build_grid(float* vertices, uint32_t* indices)
+{
+  for (uint32_t q = 0; q < GRID * GRID; q++) {
+    uint32_t x = q % GRID, y = q / GRID;
+    const uint32_t corners[4][2] = { { x, y }, { x + 1, y }, { x + 1, y + 1 }, { x, y + 1 } };
+    for (uint32_t c = 0; c < 4; c++) {
+      float* v = vertices + (size_t)(q * 4 + c) * COMPONENTS;
+      v[0] = (float)corners[c][0];
+      v[1] = (float)corners[c][1];
+      v[2] = 0.0f;
+      v[3] = (float)corners[c][0] / GRID;
+      v[4] = (float)corners[c][1] / GRID;
+    }
+  }
+
+  srand(3);
+  uint32_t* order = malloc(GRID * GRID * sizeof(uint32_t));
+  for (uint32_t q = 0; q < GRID * GRID; q++)
+    order[q] = q;
+  for (uint32_t q = GRID * GRID - 1; q > 0; q--) {
+    uint32_t r = (uint32_t)rand() % (q + 1);
+    uint32_t swap = order[q];
+    order[q] = order[r];
+    order[r] = swap;
+  }
+  for (uint32_t q = 0; q < GRID * GRID; q++) {
+    uint32_t base = order[q] * 4;
+    const uint32_t quad[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+    memcpy(indices + q * 6, quad, sizeof(quad));
+  }
+  free(order);
+}
+
+// Forsyth only reorders whole triangles, each keeps its vertices and winding
+static void test_vertex_cache(void)
+{
+  const uint32_t vertex_count = GRID * GRID * 4, index_count = GRID * GRID * 6;
+  float* vertices = malloc(vertex_count * COMPONENTS * sizeof(float));
+  uint32_t* indices = malloc(index_count * sizeof(uint32_t));
+  build_grid(vertices, indices);
+
+  // Weld first so there's reuse for the cache order to find
+  mesh_weld(vertices, vertex_count, COMPONENTS * sizeof(float), indices, index_count);
+  triangle_t* before = malloc(index_count / 3 * sizeof(triangle_t));
+  for (uint32_t t = 0; t < index_count / 3; t++)
+    before[t] = canonical(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]);
+  qsort(before, index_count / 3, sizeof(triangle_t), compare_triangles);
+  float acmr_before = mesh_analyze(indices, index_count, vertex_count, MESH_CACHE_SIZE).acmr;
+
+  CHECK(mesh_optimize_vertex_cache(indices, index_count, vertex_count));
+  triangle_t* after = malloc(index_count / 3 * sizeof(triangle_t));
+  for (uint32_t t = 0; t < index_count / 3; t++)
+    after[t] = canonical(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]);
+  qsort(after, index_count / 3, sizeof(triangle_t), compare_triangles);
+
+  CHECK(memcmp(before, after, index_count / 3 * sizeof(triangle_t)) == 0);
+  CHECK(mesh_analyze(indices, index_count, vertex_count, MESH_CACHE_SIZE).acmr < acmr_before);
+
+  free(after);
+  free(before);
+  free(indices);
+  free(vertices);
+}
+
+// The whole pipeline welds to one vertex per grid point and still draws the same triangles
+static void test_optimize(void)
+{
+  const uint32_t vertex_count = GRID * GRID * 4, index_count = GRID * GRID * 6;
+  float* vertices = malloc(vertex_count * COMPONENTS * sizeof(float));
+  uint32_t* indices = malloc(index_count * sizeof(uint32_t));
+  build_grid(vertices, indices);
+  triangle_t* before = grid_triangles(vertices, indices, index_count);
+
+  mesh_optimize_stats_t stats;
+  uint32_t count = mesh_optimize(vertices, vertex_count, COMPONENTS, indices, index_count, &stats);
+  CHECK(count == (GRID + 1) * (GRID + 1));
+  CHECK(stats.vertices_before == vertex_count && stats.vertices_after == count);
+  CHECK(stats.after.acmr < stats.before.acmr);
+  CHECK(mesh_indices_valid(indices, index_count, count));
+
+  triangle_t* after = grid_triangles(vertices, indices, index_count);
+  CHECK(memcmp(before, after, index_count / 3 * sizeof(triangle_t)) == 0);
+
+  free(after);
+  free(before);
+  free(indices);
+  free(vertices);
+}
+
+// An index past the vertices is refused everywhere and nothing is touched
+static void test_out_of_range(void)
+{
+  float vertices[4 * COMPONENTS] = { 0 };
+  uint32_t indices[6] = { 0, 1, 2, 0, 2, 4 };
+  const uint32_t original[6] = { 0, 1, 2, 0, 2, 4 };
+
+  CHECK(!mesh_indices_valid(indices, 6, 4));
+  CHECK(mesh_indices_valid(indices, 6, 5));
+  CHECK(!mesh_optimize_vertex_cache(indices, 6, 4));
+  CHECK(!mesh_optimize_overdraw(indices, 6, vertices, 4, COMPONENTS * sizeof(float)));
+  CHECK(mesh_optimize_vertex_fetch(vertices, 4, COMPONENTS * sizeof(float), indices, 6) == 4);
+  CHECK(mesh_weld(vertices, 4, COMPONENTS * sizeof(float), indices, 6) == 4);
+
+  mesh_optimize_stats_t stats;
+  CHECK(mesh_optimize(vertices, 4, COMPONENTS, indices, 6, &stats) == 4);
+  CHECK(stats.vertices_after == 4);
+  CHECK(memcmp(indices, original, sizeof(original)) == 0);
+}
+
+// A count that isn't whole triangles is refused too, the tail would otherwise be written from
+// triangles that were never output
+static void test_partial_triangle(void)
+{
+  float vertices[4 * COMPONENTS] = { 0 };
+  uint32_t indices[8] = { 0, 1, 2, 0, 2, 3, 1, 3 };
+  const uint32_t original[8] = { 0, 1, 2, 0, 2, 3, 1, 3 };
+
+  CHECK(!mesh_indices_valid(indices, 7, 4));
+  CHECK(mesh_indices_valid(indices, 6, 4));
+  CHECK(!mesh_optimize_vertex_cache(indices, 7, 4));
+  CHECK(!mesh_optimize_overdraw(indices, 8, vertices, 4, COMPONENTS * sizeof(float)));
+
+  mesh_optimize_stats_t stats;
+  CHECK(mesh_optimize(vertices, 4, COMPONENTS, indices, 7, &stats) == 4);
+  CHECK(memcmp(indices, original, sizeof(original)) == 0);
+}
+
+void test_mesh_optimizer(void)
+{
+  test_vertex_cache();
+  test_optimize();
+  test_out_of_range();
+  test_partial_triangle();
+}
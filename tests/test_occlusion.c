@@ -0,0 +1,47 @@
+#include "test.h"
+#include "occlusion.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// A flat occluder registered for an object must never hide that object, from any angle, while
+// still hiding what is behind it
+void test_occlusion(void)
+{
+  const float quad[] = { -0.5f, -0.5f, 0.0f, 0.5f, -0.5f, 0.0f, 0.5f, 0.5f, 0.0f, -0.5f, 0.5f, 0.0f };
+  const uint32_t quad_indices[] = { 0, 1, 2, 2, 3, 0 };
+  const aabb_t quad_bounds = { { -0.5f, -0.5f, 0.0f }, { 0.5f, 0.5f, 0.0f } };
+  const aabb_t behind = { { -0.1f, -0.1f, -2.1f }, { 0.1f, 0.1f, -1.9f } };
+
+  occlusion_t* occlusion = occlusion_create(OCCLUSION_DEFAULT_WIDTH, OCCLUSION_DEFAULT_HEIGHT);
+  if (!CHECK(occlusion != NULL))
+    return;
+  mat4 transform;
+  glm_mat4_identity(transform);
+  CHECK(occlusion_add_occluder(occlusion, quad, 3, 4, quad_indices, 6, transform));
+
+  mat4 projection;
+  glm_perspective(glm_rad(60.0f), 2.0f, 0.1f, 100.0f, projection);
+
+  // Close enough to fill the screen out to far enough to be a few pixels, head on to grazing
+  uint32_t hidden = 0;
+  for (uint32_t d = 0; d < 6; d++) {
+    for (uint32_t a = 0; a < 16; a++) {
+      float distance = 0.3f * powf(2.5f, (float)d), angle = glm_rad(-85.0f + 170.0f * a / 15.0f);
+      vec3 eye = { distance * sinf(angle), 0.1f * distance, distance * cosf(angle) };
+      vec3 target = { 0.05f * a, -0.02f * d, 0.0f }, up = { 0.0f, 1.0f, 0.0f };
+
+      mat4 view, view_projection;
+      glm_lookat(eye, target, up, view);
+      glm_mat4_mul(projection, view, view_projection);
+      occlusion_begin_frame(occlusion, view_projection, NULL);
+      CHECK(occlusion_test(occlusion, &quad_bounds));
+      hidden += !occlusion_test(occlusion, &behind);
+    }
+  }
+
+  // Head on, the small box behind the middle is covered everywhere it could be seen
+  CHECK(hidden > 0);
+
+  occlusion_destroy(occlusion);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Seeded scene generation shared by the tests and the benches, seed with srand first
+
+#include <stdlib.h>
+
+static inline float random_range(float low, float high)
+{
+  return low + (high - low) * (float)rand() / (float)RAND_MAX;
+}
@@ -0,0 +1,60 @@
+#include "test.h"
+#include "render_queue.h"
+
+#include <stdlib.h>
+
+#define PACKET_COUNT 5000
+
+// Push order rides along in base_vertex, equal keys have to come out in that order
+static void check_sorted(uint64_t (*make_key)(uint32_t i))
+{
+  render_queue_t* queue = render_queue_create(16, NULL);
+  if (!CHECK(queue != NULL))
+    return;
+
+  for (uint32_t i = 0; i < PACKET_COUNT; i++) {
+    render_packet_t packet = { .key = make_key(i), .base_vertex = (int32_t)i };
+    render_queue_push(queue, &packet);
+  }
+  render_queue_sort(queue);
+
+  bool ordered = true, stable = true;
+  for (uint32_t i = 1; i < PACKET_COUNT; i++) {
+    const render_packet_t* a = render_queue_packet(queue, i - 1);
+    const render_packet_t* b = render_queue_packet(queue, i);
+    ordered &= a->key <= b->key;
+    stable &= a->key != b->key || a->base_vertex < b->base_vertex;
+  }
+  CHECK(ordered);
+  CHECK(stable);
+  CHECK(render_queue_packet(queue, PACKET_COUNT) == NULL);
+
+  render_queue_destroy(queue);
+}
+
+// Few distinct values spread over every byte, so all eight passes run
+static uint64_t key_all_bytes(uint32_t i)
+{
+  uint32_t r = (i * 2654435761u) >> 16;
+  return render_key((r >> 0) & 3, (r >> 2) & 7, (r >> 5) & 3, (r >> 7) & 7, (float)(r & 15) / 16.0f, false);
+}
+
+// Only the low byte differs, a single pass leaves the result in the scratch array
+static uint64_t key_one_byte(uint32_t i)
+{
+  return (i * 7919u) % 13u;
+}
+
+// Every pass is skipped
+static uint64_t key_equal(uint32_t i)
+{
+  (void)i;
+  return 0x1234u;
+}
+
+void test_render_queue(void)
+{
+  check_sorted(key_all_bytes);
+  check_sorted(key_one_byte);
+  check_sorted(key_equal);
+}
@@ -0,0 +1,71 @@
+#include "test.h"
+#include "shader_preprocess.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Written next to wherever the tests run, ctest runs them in the build directory
+#define SOURCE_PATH "test_preprocess.glsl"
+
+static char* preprocess(const char* source, const char* defines)
+{
+  FILE* file = fopen(SOURCE_PATH, "w");
+  if (!CHECK(file != NULL))
+    return NULL;
+  fputs(source, file);
+  fclose(file);
+
+  char* text = shader_preprocess(SOURCE_PATH, defines, NULL);
+  remove(SOURCE_PATH);
+  return text;
+}
+
+// Defines land after the #version line and #line puts the next line back at its own number
+static void check_after_version(const char* source, const char* version, uint32_t next_line)
+{
+  char* text = preprocess(source, "#define FOO 1\n");
+  if (!CHECK(text != NULL))
+    return;
+
+  char expected[64];
+  snprintf(expected, sizeof(expected), "%s\n#define FOO 1\n#line %u 0\n", version, next_line);
+  CHECK(strstr(text, expected) != NULL);
+  CHECK(strstr(text, "#define FOO") == strstr(text, expected) + strlen(version) + 1);
+  free(text);
+}
+
+void test_shader_preprocess(void)
+{
+  check_after_version("#version 460 core\nvoid main() {}\n", "#version 460 core", 2);
+
+  // Leading license block, line comments and blank lines
+  check_after_version("/*\n * Copyright (c) someone\n * Licensed under whatever\n */\n"
+		      "// more notes\n\n#version 450\nvoid main() {}\n", "#version 450", 8);
+
+  // A #version in a comment isn't the directive
+  check_after_version("// #version 100\n/* #version 110 */ #version 330 core\nvoid main() {}\n",
+		      "/* #version 110 */ #version 330 core", 3);
+
+  // Without one the defines go first
+  char* text = preprocess("// no version\nvoid main() {}\n", "#define FOO 1\n");
+  if (CHECK(text != NULL)) {
+    CHECK(strncmp(text, "#define FOO 1\n#line 1 0\n", 24) == 0);
+    free(text);
+  }
+
+  // Code before #version means it isn't the directive either, defines go first
+  text = preprocess("float x;\n#version 450\n", "#define FOO 1\n");
+  if (CHECK(text != NULL)) {
+    CHECK(strncmp(text, "#define FOO 1\n", 14) == 0);
+    free(text);
+  }
+
+  // The define block itself is sorted
+  const char* defines[] = { "B=2", "A" };
+  char* block = shader_define_block(defines, 2);
+  if (CHECK(block != NULL)) {
+    CHECK(strcmp(block, "#define A 1\n#define B 2\n") == 0);
+    free(block);
+  }
+}
@@ -0,0 +1,241 @@
+#include "test.h"
+#include "terrain.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t lod_side(uint32_t lod)
+{
+  return (TERRAIN_CHUNK_QUADS >> lod) + 1;
+}
+
+static const float* vertex_position(const uint8_t* vertices, uint32_t index)
+{
+  return (const float*)(vertices + (size_t)index * terrain_vertex_layout.stride);
+}
+
+static const int16_t* vertex_normal(const uint8_t* vertices, uint32_t index)
+{
+  size_t offset = (size_t)index * terrain_vertex_layout.stride + terrain_vertex_layout.attributes[1].offset;
+  return (const int16_t*)(vertices + offset);
+}
+
+static uint8_t* build_chunk(int32_t x, int32_t z, uint32_t lod)
+{
+  uint8_t* vertices = malloc(terrain_lod_vertices(lod) * terrain_vertex_layout.stride);
+  float y_range[2];
+  if (!CHECK(vertices && terrain_build_chunk(x, z, lod, vertices, y_range))) {
+    free(vertices);
+    return NULL;
+  }
+
+  uint32_t side = lod_side(lod);
+  float min_y = vertex_position(vertices, 0)[1], max_y = min_y;
+  for (uint32_t i = 1; i < side * side; i++) {
+    float y = vertex_position(vertices, i)[1];
+    if (y < min_y) min_y = y;
+    if (y > max_y) max_y = y;
+  }
+  CHECK(y_range[0] == min_y && y_range[1] == max_y);
+  return vertices;
+}
+
+// Every index in range, no degenerate triangles, every vertex used, grid faces up and skirts face out
+static void test_indices(void)
+{
+  for (uint32_t lod = 0; lod < TERRAIN_LODS; lod++) {
+    uint32_t vertex_count = terrain_lod_vertices(lod);
+    uint32_t index_count = terrain_lod_indices(lod);
+    uint16_t* indices = malloc((index_count + 1) * sizeof(uint16_t));
+    bool* used = calloc(vertex_count, sizeof(bool));
+    uint8_t* vertices = build_chunk(0, 0, lod);
+    if (!CHECK(indices && used) || !vertices) {
+      free(indices);
+      free(used);
+      free(vertices);
+      return;
+    }
+
+    indices[index_count] = 0xBEEF;
+    CHECK(terrain_build_indices(lod, indices) == index_count);
+    CHECK(indices[index_count] == 0xBEEF);
+
+    uint32_t side = lod_side(lod);
+    uint32_t grid_indices = (side - 1) * (side - 1) * 6;
+    bool ok = true;
+    for (uint32_t t = 0; t < index_count && ok; t += 3) {
+      const uint16_t* tri = &indices[t];
+      ok &= CHECK(tri[0] < vertex_count && tri[1] < vertex_count && tri[2] < vertex_count);
+      ok &= CHECK(tri[0] != tri[1] && tri[1] != tri[2] && tri[0] != tri[2]);
+      if (!ok)
+	break;
+      used[tri[0]] = used[tri[1]] = used[tri[2]] = true;
+
+      const float* a = vertex_position(vertices, tri[0]);
+      const float* b = vertex_position(vertices, tri[1]);
+      const float* c = vertex_position(vertices, tri[2]);
+      vec3 ab = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+      vec3 ac = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+      vec3 normal;
+      glm_vec3_cross(ab, ac, normal);
+      if (t < grid_indices) {
+	ok &= CHECK(normal[1] > 0.0f);
+      } else {
+	// Horizontal, pointing away from the chunk's middle
+	float half = TERRAIN_CHUNK_SIZE * 0.5f;
+	float out_x = (a[0] + b[0] + c[0]) / 3.0f - half;
+	float out_z = (a[2] + b[2] + c[2]) / 3.0f - half;
+	ok &= CHECK(normal[1] == 0.0f && normal[0] * out_x + normal[2] * out_z > 0.0f);
+      }
+    }
+    for (uint32_t i = 0; i < vertex_count && ok; i++)
+      ok &= CHECK(used[i]);
+
+    free(indices);
+    free(used);
+    free(vertices);
+  }
+}
+
+// Vertex k along a's far edge and b's near one, b being the next chunk along x (along_x) or z
+static uint32_t edge_index(uint32_t side, bool far, bool along_x, uint32_t k)
+{
+  uint32_t across = far ? side - 1 : 0;
+  return along_x ? k * side + across : across * side + k;
+}
+
+// Neighbouring chunks put the vertices they share on their common edge at the same world position.
+// At the same LOD the normals match too, and every edge has a skirt hanging straight down from it
+static void test_edges(void)
+{
+  srand(49);
+  for (uint32_t round = 0; round < 24; round++) {
+    int32_t x = rand() % 64 - 32;
+    int32_t z = rand() % 64 - 32;
+    uint32_t lod_a = (uint32_t)rand() % TERRAIN_LODS;
+    uint32_t lod_b = round % 3 == 0 ? lod_a : (uint32_t)rand() % TERRAIN_LODS;
+    bool along_x = round & 1;
+
+    uint8_t* a = build_chunk(x, z, lod_a);
+    uint8_t* b = build_chunk(along_x ? x + 1 : x, along_x ? z : z + 1, lod_b);
+    if (!a || !b) {
+      free(a);
+      free(b);
+      return;
+    }
+
+    // Shared vertices sit every step of the coarser chunk
+    uint32_t side_a = lod_side(lod_a), side_b = lod_side(lod_b);
+    uint32_t coarse = lod_a > lod_b ? lod_a : lod_b;
+    uint32_t step_a = 1u << (coarse - lod_a), step_b = 1u << (coarse - lod_b);
+    bool ok = true;
+    for (uint32_t k = 0; k < lod_side(coarse) && ok; k++) {
+      uint32_t ia = edge_index(side_a, true, along_x, k * step_a);
+      uint32_t ib = edge_index(side_b, false, along_x, k * step_b);
+      const float* pa = vertex_position(a, ia);
+      const float* pb = vertex_position(b, ib);
+      ok &= CHECK(pa[0] == pb[0] + (along_x ? TERRAIN_CHUNK_SIZE : 0.0f));
+      ok &= CHECK(pa[2] == pb[2] + (along_x ? 0.0f : TERRAIN_CHUNK_SIZE));
+      ok &= CHECK(pa[1] == pb[1]);
+      if (lod_a == lod_b)
+	ok &= CHECK(memcmp(vertex_normal(a, ia), vertex_normal(b, ib), 2 * sizeof(int16_t)) == 0);
+    }
+
+    // Skirt vertices follow the grid, one edge after another, each under some edge vertex
+    for (uint32_t s = side_a * side_a; s < terrain_lod_vertices(lod_a) && ok; s++) {
+      const float* skirt = vertex_position(a, s);
+      bool under = false;
+      for (uint32_t g = 0; g < side_a * side_a && !under; g++) {
+	const float* grid = vertex_position(a, g);
+	bool edge = grid[0] == 0.0f || grid[2] == 0.0f ||
+	  grid[0] == TERRAIN_CHUNK_SIZE || grid[2] == TERRAIN_CHUNK_SIZE;
+	under = edge && grid[0] == skirt[0] && grid[2] == skirt[2] && skirt[1] < grid[1];
+      }
+      ok &= CHECK(under);
+    }
+
+    free(a);
+    free(b);
+  }
+}
+
+// Every slot is either free or held by exactly one cell with a mesh, however the window moves
+static bool check_slots(const terrain_window_t* window)
+{
+  uint32_t* holders = calloc(window->slot_count, sizeof(uint32_t));
+  if (!CHECK(holders != NULL))
+    return false;
+
+  bool ok = true;
+  for (uint32_t i = 0; i < window->free_count; i++) {
+    ok &= CHECK(window->free_slots[i] < window->slot_count);
+    if (window->free_slots[i] < window->slot_count)
+      holders[window->free_slots[i]]++;
+  }
+
+  uint32_t cells = window->size * window->size;
+  for (uint32_t i = 0; i < cells; i++) {
+    const terrain_cell_t* cell = &window->cells[i];
+    if (!window->centered || cell->lod < 0)
+      continue;
+    ok &= CHECK(terrain_window_ring(window, cell->x, cell->z) <= (int32_t)window->view_chunks);
+    ok &= CHECK(cell->slot < window->slot_count);
+    if (cell->slot < window->slot_count)
+      holders[cell->slot]++;
+  }
+
+  for (uint32_t slot = 0; slot < window->slot_count; slot++)
+    ok &= CHECK(holders[slot] == 1);
+  free(holders);
+  return ok;
+}
+
+static void test_slots(void)
+{
+  terrain_window_t window;
+  if (!CHECK(terrain_window_init(&window, 3)))
+    return;
+  CHECK(window.size == 7 && window.slot_count == 7 * 7 + 2 * 7);
+  check_slots(&window);
+
+  // Short steps keep most cells, teleports replace all of them, meshes land and change LOD in between
+  srand(50);
+  int32_t center_x = 0, center_z = 0;
+  for (uint32_t step = 0; step < 500; step++) {
+    if (step % 37 == 36) {
+      center_x += rand() % 41 - 20;
+      center_z += rand() % 41 - 20;
+    } else {
+      center_x += rand() % 3 - 1;
+      center_z += rand() % 3 - 1;
+    }
+    bool moved = step == 0 || center_x != window.center_x || center_z != window.center_z;
+    CHECK(terrain_window_recenter(&window, center_x, center_z) == moved);
+
+    uint32_t placements = (uint32_t)rand() % 24;
+    for (uint32_t i = 0; i < placements && window.free_count > 0; i++) {
+      const int32_t* offset = window.order[(uint32_t)rand() % (window.size * window.size)];
+      int32_t x = center_x + offset[0];
+      int32_t z = center_z + offset[1];
+      terrain_cell_t* cell = terrain_window_cell(&window, x, z);
+      CHECK(cell->x == x && cell->z == z);
+
+      // Sometimes a stale LOD, so cells get replaced at a LOD they already had
+      uint32_t lod = (uint32_t)terrain_window_lod(&window, x, z);
+      if (rand() % 4 == 0)
+	lod = (uint32_t)rand() % TERRAIN_LODS;
+      uint32_t slot = terrain_window_place(&window, cell, lod);
+      CHECK(cell->slot == slot && cell->lod == (int32_t)lod && cell->pending_lod == -1);
+    }
+    if (!check_slots(&window))
+      break;
+  }
+  terrain_window_free(&window);
+}
+
+void test_terrain(void)
+{
+  test_indices();
+  test_edges();
+  test_slots();
+}
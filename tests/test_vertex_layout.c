@@ -0,0 +1,128 @@
+#include "test.h"
+#include "vertex_layout.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static float half_to_float(uint16_t half)
+{
+  int32_t exponent = (half >> 10) & 0x1F;
+  float mantissa = (float)(half & 0x3FF);
+  float value;
+  if (exponent == 0)
+    value = ldexpf(mantissa, -24);
+  else if (exponent == 31)
+    value = mantissa ? NAN : INFINITY;
+  else
+    value = ldexpf(mantissa + 1024.0f, exponent - 25);
+  return half & 0x8000 ? -value : value;
+}
+
+// Same as oct_decode in octahedral.glsl
+static void oct_decode(const int16_t* encoded, float* normal)
+{
+  float x = fmaxf((float)encoded[0] / 32767.0f, -1.0f);
+  float y = fmaxf((float)encoded[1] / 32767.0f, -1.0f);
+  float z = 1.0f - fabsf(x) - fabsf(y);
+  if (z < 0.0f) {
+    float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+  float length = sqrtf(x * x + y * y + z * z);
+  normal[0] = x / length;
+  normal[1] = y / length;
+  normal[2] = z / length;
+}
+
+static uint16_t encode_half(float value)
+{
+  static const vertex_format_t format = { 1, { { 0, 1, VERTEX_HALF } } };
+  uint8_t out[4];
+  vertex_format_convert(&format, &value, 1, out);
+  uint16_t half;
+  memcpy(&half, out, sizeof(half));
+  return half;
+}
+
+// Every finite half survives a round trip exactly, and floats in between round to nearest even
+static void test_half(void)
+{
+  bool exact = true;
+  for (uint32_t bits = 0; bits < 0x10000; bits++) {
+    if (((bits >> 10) & 0x1F) == 31)
+      continue;
+    exact &= encode_half(half_to_float((uint16_t)bits)) == bits;
+  }
+  CHECK(exact);
+
+  // Halfway between 1 and the next half (1 + 2^-10) goes to the even one
+  CHECK(encode_half(1.0f + ldexpf(1.0f, -11)) == 0x3C00);
+  CHECK(encode_half(1.0f + 3.0f * ldexpf(1.0f, -11)) == 0x3C02);
+  CHECK(encode_half(65504.0f) == 0x7BFF);
+  CHECK(encode_half(1e6f) == 0x7C00);
+  CHECK(encode_half(-1e6f) == 0xFC00);
+  CHECK(encode_half(ldexpf(1.0f, -24)) == 0x0001);
+  CHECK(encode_half(ldexpf(1.0f, -26)) == 0x0000);
+}
+
+// Unit vectors come back within snorm16 precision, including the folded lower hemisphere
+static void test_oct16(void)
+{
+  static const vertex_format_t format = { 1, { { 0, 3, VERTEX_OCT16 } } };
+  float worst = 0.0f;
+  srand(7);
+
+  for (uint32_t i = 0; i < 20000; i++) {
+    float normal[3];
+    float length;
+    do {
+      for (uint32_t c = 0; c < 3; c++)
+	normal[c] = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+      length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    } while (length < 0.1f || length > 1.0f);
+    for (uint32_t c = 0; c < 3; c++)
+      normal[c] /= length;
+
+    int16_t encoded[2];
+    vertex_format_convert(&format, normal, 1, encoded);
+    float decoded[3];
+    oct_decode(encoded, decoded);
+    float dx = decoded[0] - normal[0], dy = decoded[1] - normal[1], dz = decoded[2] - normal[2];
+    worst = fmaxf(worst, sqrtf(dx * dx + dy * dy + dz * dz));
+  }
+
+  // Distance on the unit sphere is the angle, a few snorm16 steps at most
+  CHECK(worst < 1e-4f);
+  CHECK(vertex_layout_from_format(&format).attributes[0].components == 2);
+}
+
+// Colors are 4 bytes, RGB sources get an opaque alpha, and the compact quad stays 16 bytes
+static void test_unorm8(void)
+{
+  vertex_layout_t layout = vertex_layout_from_format(&vertex_format_pos_color_uv_compact);
+  CHECK(layout.stride == 16);
+  const vertex_attribute_t* color = vertex_layout_find(&layout, 1);
+  if (CHECK(color != NULL)) {
+    CHECK(color->components == 4);
+    CHECK(color->type == GL_UNSIGNED_BYTE && color->normalized);
+    CHECK(color->offset % 4 == 0);
+  }
+
+  const float vertex[8] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.5f, -2.0f, 0.0f, 0.0f };
+  uint8_t encoded[16];
+  vertex_format_convert(&vertex_format_pos_color_uv_compact, vertex, 1, encoded);
+  if (color) {
+    const uint8_t* rgba = encoded + color->offset;
+    CHECK(rgba[0] == 255 && rgba[1] == 128 && rgba[2] == 0 && rgba[3] == 255);
+  }
+}
+
+void test_vertex_layout(void)
+{
+  test_half();
+  test_oct16();
+  test_unorm8();
+}
@@ -0,0 +1,152 @@
+#include "test.h"
+#include "virtual_texture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define VIRTUAL_PAGES 64
+#define PHYS_PAGES 4
+#define SLOT_COUNT (PHYS_PAGES * PHYS_PAGES)
+#define ROUNDS 400
+
+// Slot held by each page of each level, VT_PAGE_NONE when not resident
+static uint32_t resident[VT_MAX_LEVELS][VIRTUAL_PAGES * VIRTUAL_PAGES];
+
+static uint32_t expected_entry(uint32_t max_mip, uint32_t mip, uint32_t x, uint32_t y)
+{
+  for (uint32_t level = mip; level <= max_mip; level++) {
+    uint32_t shift = level - mip;
+    uint32_t slot = resident[level][(y >> shift) * (VIRTUAL_PAGES >> level) + (x >> shift)];
+    if (slot != VT_PAGE_NONE)
+      return (slot % PHYS_PAGES) | ((slot / PHYS_PAGES) << 8) | (level << 16) | 0xFF000000u;
+  }
+  return 0;
+}
+
+// Every entry against a walk up its ancestors, and every texel that changed must be in its level's dirty rect
+static bool check_table(const vt_page_table_t* table, const uint32_t* const* before, const vt_dirty_t* dirty,
+			uint32_t dirty_levels)
+{
+  bool ok = true;
+  for (uint32_t mip = 0; mip <= table->max_mip; mip++) {
+    uint32_t pages = VIRTUAL_PAGES >> mip;
+    for (uint32_t y = 0; y < pages; y++) {
+      for (uint32_t x = 0; x < pages; x++) {
+	uint32_t entry = vt_page_table_entry(table, mip, x, y);
+	ok &= CHECK(entry == expected_entry(table->max_mip, mip, x, y));
+	if (!before || entry == before[mip][y * pages + x])
+	  continue;
+	ok &= CHECK(mip < dirty_levels);
+	if (mip < dirty_levels) {
+	  const vt_dirty_t* rect = &dirty[mip];
+	  ok &= CHECK(x >= rect->x0 && x <= rect->x1 && y >= rect->y0 && y <= rect->y1);
+	}
+      }
+    }
+  }
+  return ok;
+}
+
+static void test_page_table(void)
+{
+  vt_page_table_t table;
+  if (!CHECK(vt_page_table_init(&table, VIRTUAL_PAGES, PHYS_PAGES)))
+    return;
+  CHECK(table.max_mip == 6);
+
+  uint32_t* before[VT_MAX_LEVELS] = { 0 };
+  for (uint32_t level = 0; level <= table.max_mip; level++) {
+    size_t count = (size_t)(VIRTUAL_PAGES >> level) * (VIRTUAL_PAGES >> level);
+    before[level] = malloc(count * sizeof(uint32_t));
+    for (size_t i = 0; i < count; i++)
+      resident[level][i] = VT_PAGE_NONE;
+  }
+
+  bool slot_used[SLOT_COUNT] = { false };
+  vt_dirty_t dirty[VT_MAX_LEVELS];
+  vt_page_table_map(&table, VT_PAGE_ID(0, 0, table.max_mip), 0, dirty);
+  resident[table.max_mip][0] = 0;
+  slot_used[0] = true;
+  check_table(&table, NULL, NULL, 0);
+
+  // Random residency sets: map pages into free slots until the cache is full, unmap at random.
+  // Most picks land on the finest levels, which have the most pages, so skew towards coarse ones too
+  srand(29);
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    uint32_t mip = (uint32_t)rand() % table.max_mip;
+    uint32_t pages = VIRTUAL_PAGES >> mip;
+    uint32_t x = (uint32_t)rand() % pages;
+    uint32_t y = (uint32_t)rand() % pages;
+    uint32_t* held = &resident[mip][y * pages + x];
+
+    uint32_t slot = VT_PAGE_NONE;
+    if (*held == VT_PAGE_NONE) {
+      uint32_t first = (uint32_t)rand() % SLOT_COUNT;
+      for (uint32_t i = 0; i < SLOT_COUNT && slot == VT_PAGE_NONE; i++) {
+	if (!slot_used[(first + i) % SLOT_COUNT])
+	  slot = (first + i) % SLOT_COUNT;
+      }
+      if (slot == VT_PAGE_NONE)
+	continue;
+      slot_used[slot] = true;
+    } else {
+      slot_used[*held] = false;
+    }
+    *held = slot;
+
+    for (uint32_t level = 0; level <= table.max_mip; level++) {
+      size_t count = (size_t)(VIRTUAL_PAGES >> level) * (VIRTUAL_PAGES >> level);
+      memcpy(before[level], table.levels[level], count * sizeof(uint32_t));
+    }
+    vt_page_table_map(&table, VT_PAGE_ID(x, y, mip), slot, dirty);
+    if (!check_table(&table, (const uint32_t* const*)before, dirty, mip + 1))
+      break;
+  }
+
+  // Unmapping the coarsest page has nothing to fall back to and leaves it alone
+  uint32_t root = vt_page_table_entry(&table, table.max_mip, 0, 0);
+  vt_page_table_map(&table, VT_PAGE_ID(0, 0, table.max_mip), VT_PAGE_NONE, dirty);
+  CHECK(vt_page_table_entry(&table, table.max_mip, 0, 0) == root);
+
+  for (uint32_t level = 0; level <= table.max_mip; level++)
+    free(before[level]);
+  vt_page_table_free(&table);
+}
+
+// Against the rule spelled out: first free slot, else the oldest unpinned slot not used last frame
+static void test_find_slot(void)
+{
+  vt_slot_t slots[SLOT_COUNT];
+  srand(30);
+  for (uint32_t round = 0; round < 2000; round++) {
+    uint32_t count = 1 + (uint32_t)rand() % SLOT_COUNT;
+    uint64_t frame = (uint64_t)(rand() % 12);
+    for (uint32_t i = 0; i < count; i++) {
+      slots[i].page = rand() % 8 == 0 ? VT_PAGE_NONE : i;
+      slots[i].last_used = (uint64_t)(rand() % 12);
+      slots[i].pinned = rand() % 4 == 0;
+    }
+
+    uint32_t expected = VT_PAGE_NONE;
+    for (uint32_t i = 0; i < count && expected == VT_PAGE_NONE; i++) {
+      if (slots[i].page == VT_PAGE_NONE)
+	expected = i;
+    }
+    if (expected == VT_PAGE_NONE) {
+      for (uint32_t i = 0; i < count; i++) {
+	if (slots[i].pinned || slots[i].last_used + 1 >= frame)
+	  continue;
+	if (expected == VT_PAGE_NONE || slots[i].last_used < slots[expected].last_used)
+	  expected = i;
+      }
+    }
+    if (!CHECK(vt_find_slot(slots, count, frame) == expected))
+      break;
+  }
+}
+
+void test_virtual_texture(void)
+{
+  test_page_table();
+  test_find_slot();
+}